@@ -75,11 +75,18 @@ LoRaClass::LoRaClass() :
   _ss(LORA_DEFAULT_SS_PIN), _reset(LORA_DEFAULT_RESET_PIN), _dio0(LORA_DEFAULT_DIO0_PIN),
   _frequency(0),
   _packetIndex(0),
+  _packetLength(0),
+  _payloadLength(0),
   _implicitHeaderMode(0),
-  _onReceive(NULL)
+  _registerCache(false),
+  _onReceive(NULL),
+  _onTxDone(NULL),
+  _onDio0(NULL),
+  _dio0Pending(false)
 {
   // overide Stream timeout value
   setTimeout(0);
+  memset(_shadowValid, 0, sizeof(_shadowValid));
 }
 
 int LoRaClass::begin(long frequency,bool PABOOST)
@@ -93,6 +100,8 @@ int LoRaClass::begin(long frequency,bool PABOOST)
   delay(20);
   digitalWrite(_reset, HIGH);
   delay(50);
+  // forget the registers cached before the reset
+  memset(_shadowValid, 0, sizeof(_shadowValid));
   // set SS high
   digitalWrite(_ss, HIGH);
   // start SPI
@@ -146,14 +155,19 @@ int LoRaClass::beginPacket(int implicitHeader)
   } else {
     explicitHeaderMode();
   }
-  // reset FIFO address and paload length
+  // reset FIFO address and paload length, written once the packet is complete
   writeRegister(REG_FIFO_ADDR_PTR, 0);
-  writeRegister(REG_PAYLOAD_LENGTH, 0);
+  _payloadLength = 0;
   return 1;
 }
 
 int LoRaClass::endPacket(bool async)
 {
+  if (async && _onTxDone) {
+    // DIO0 => TXDONE
+    writeRegister(REG_DIO_MAPPING_1, 0x40);
+  }
+  writeRegister(REG_PAYLOAD_LENGTH, _payloadLength);
   // put in TX mode
   writeRegister(REG_OP_MODE, MODE_LONG_RANGE_MODE | MODE_TX);
 
@@ -196,6 +210,7 @@ int LoRaClass::parsePacket(int size)
     } else {
       packetLength = readRegister(REG_RX_NB_BYTES);
     }
+    _packetLength = packetLength;
     // set FIFO address to current RX address
     writeRegister(REG_FIFO_ADDR_PTR, readRegister(REG_FIFO_RX_CURRENT_ADDR));
     // put in standby mode
@@ -252,23 +267,20 @@ size_t LoRaClass::write(uint8_t byte)
 
 size_t LoRaClass::write(const uint8_t *buffer, size_t size)
 {
-  int currentLength = readRegister(REG_PAYLOAD_LENGTH);
   // check size
-  if ((currentLength + size) > MAX_PKT_LENGTH) {
-    size = MAX_PKT_LENGTH - currentLength;
-  }
-  // write data
-  for (size_t i = 0; i < size; i++) {
-    writeRegister(REG_FIFO, buffer[i]);
+  if ((_payloadLength + size) > MAX_PKT_LENGTH) {
+    size = MAX_PKT_LENGTH - _payloadLength;
   }
+  // write data in one burst
+  writeFifo(buffer, size);
   // update length
-  writeRegister(REG_PAYLOAD_LENGTH, currentLength + size);
+  _payloadLength += size;
   return size;
 }
 
 int LoRaClass::available()
 {
-  return (readRegister(REG_RX_NB_BYTES) - _packetIndex);
+  return (_packetLength - _packetIndex);
 }
 
 int LoRaClass::read()
@@ -280,6 +292,17 @@ int LoRaClass::read()
   return readRegister(REG_FIFO);
 }
 
+size_t LoRaClass::read(uint8_t *buffer, size_t size)
+{
+  // read what is left of the packet in one burst
+  if (size > (size_t) available()) {
+    size = available();
+  }
+  readFifo(buffer, size);
+  _packetIndex += size;
+  return size;
+}
+
 int LoRaClass::peek()
 {
   if (!available()) {
@@ -311,8 +334,41 @@ void LoRaClass::onReceive(void(*callback)(int))
   }
 }
 
+void LoRaClass::onTxDone(void(*callback)())
+{
+  _onTxDone = callback;
+
+  if (callback) {
+    writeRegister(REG_DIO_MAPPING_1, 0x40);
+    attachInterrupt(digitalPinToInterrupt(_dio0), LoRaClass::onDio0Rise, RISING);
+  } else {
+    detachInterrupt(digitalPinToInterrupt(_dio0));
+  }
+}
+
+void LoRaClass::onDio0(void(*callback)())
+{
+  // with a callback, the interrupt only flags DIO0 and calls it, and handleDio0
+  // reads the IRQ flags over SPI and runs the other callbacks outside of it
+  _dio0Pending = false;
+  _onDio0 = callback;
+}
+
+bool LoRaClass::handleDio0()
+{
+  if (!_dio0Pending) {
+    return false;
+  }
+  _dio0Pending = false;
+  handleDio0Rise();
+  return true;
+}
+
 void LoRaClass::receive(int size)
 {
+  // DIO0 => RXDONE
+  writeRegister(REG_DIO_MAPPING_1, 0x00);
+
   if (size > 0) {
     implicitHeaderMode();
     writeRegister(REG_PAYLOAD_LENGTH, size & 0xff);
@@ -525,6 +581,14 @@ void LoRaClass::setSPIFrequency(uint32_t frequency)
   _spiSettings = SPISettings(frequency, MSBFIRST, SPI_MODE0);
 }
 
+void LoRaClass::enableRegisterCache(bool enable)
+{
+  // configuration registers are then read from a shadow copy, and rewriting them with the
+  // value they hold is skipped, so read-modify-write helpers cost one transaction or none
+  _registerCache = enable;
+  memset(_shadowValid, 0, sizeof(_shadowValid));
+}
+
 void LoRaClass::dumpRegisters(Stream& out)
 {
   for (int i = 0; i < 128; i++) {
@@ -552,11 +616,15 @@ void LoRaClass::handleDio0Rise()
   int irqFlags = readRegister(REG_IRQ_FLAGS);
   // clear IRQ's
   writeRegister(REG_IRQ_FLAGS, irqFlags);
-  if ((irqFlags & IRQ_PAYLOAD_CRC_ERROR_MASK) == 0) {
+  if ((irqFlags & IRQ_TX_DONE_MASK) != 0) {
+    // sent a packet
+    if (_onTxDone) { _onTxDone(); }
+  } else if ((irqFlags & IRQ_RX_DONE_MASK) != 0 && (irqFlags & IRQ_PAYLOAD_CRC_ERROR_MASK) == 0) {
     // received a packet
     _packetIndex = 0;
     // read packet length
     int packetLength = _implicitHeaderMode ? readRegister(REG_PAYLOAD_LENGTH) : readRegister(REG_RX_NB_BYTES);
+    _packetLength = packetLength;
     // set FIFO address to current RX address
     writeRegister(REG_FIFO_ADDR_PTR, readRegister(REG_FIFO_RX_CURRENT_ADDR));
     if (_onReceive) { _onReceive(packetLength); }
@@ -565,16 +633,92 @@ void LoRaClass::handleDio0Rise()
   }
 }
 
+bool LoRaClass::isCachedRegister(uint8_t address)
+{
+  // only registers the radio never changes by itself, in LoRa mode
+  switch (address) {
+    case REG_FRF_MSB:
+    case REG_FRF_MID:
+    case REG_FRF_LSB:
+    case REG_PA_CONFIG:
+    case REG_LR_OCP:
+    case REG_FIFO_TX_BASE_ADDR:
+    case REG_FIFO_RX_BASE_ADDR:
+    case REG_MODEM_CONFIG_1:
+    case REG_MODEM_CONFIG_2:
+    case REG_PREAMBLE_MSB:
+    case REG_PREAMBLE_LSB:
+    case REG_MODEM_CONFIG_3:
+    case REG_DETECTION_OPTIMIZE:
+    case REG_LR_INVERTIQ:
+    case REG_DETECTION_THRESHOLD:
+    case REG_SYNC_WORD:
+    case REG_LR_INVERTIQ2:
+    case REG_DIO_MAPPING_1:
+    case REG_PaDac:
+      return true;
+    default:
+      return false;
+  }
+}
+
 uint8_t LoRaClass::readRegister(uint8_t address)
 {
-  return singleTransfer(address & 0x7f, 0x00);
+  address &= 0x7f;
+  const bool cached = _registerCache && isCachedRegister(address);
+  const uint32_t bit = (uint32_t) 1 << (address & 31);
+  if (cached && (_shadowValid[address >> 5] & bit)) {
+    return _shadow[address];
+  }
+  uint8_t value = singleTransfer(address, 0x00);
+  if (cached) {
+    _shadow[address] = value;
+    _shadowValid[address >> 5] |= bit;
+  }
+  return value;
 }
 
 void LoRaClass::writeRegister(uint8_t address, uint8_t value)
 {
+  address &= 0x7f;
+  if (_registerCache && isCachedRegister(address)) {
+    const uint32_t bit = (uint32_t) 1 << (address & 31);
+    if ((_shadowValid[address >> 5] & bit) && _shadow[address] == value) {
+      return;
+    }
+    _shadow[address] = value;
+    _shadowValid[address >> 5] |= bit;
+  }
   singleTransfer(address | 0x80, value);
 }
 
+void LoRaClass::readFifo(uint8_t *buffer, size_t size)
+{
+  if (size == 0) {
+    return;
+  }
+  memset(buffer, 0, size);
+  digitalWrite(_ss, LOW);
+  SPI.beginTransaction(_spiSettings);
+  SPI.transfer(REG_FIFO & 0x7f);
+  SPI.transfer(buffer, size);
+  SPI.endTransaction();
+  digitalWrite(_ss, HIGH);
+}
+
+void LoRaClass::writeFifo(const uint8_t *buffer, size_t size)
+{
+  if (size == 0) {
+    return;
+  }
+  digitalWrite(_ss, LOW);
+  SPI.beginTransaction(_spiSettings);
+  SPI.transfer(REG_FIFO | 0x80);
+  SPI.writeBytes(buffer, size);
+  SPI.endTransaction();
+  digitalWrite(_ss, HIGH);
+}
+
 uint8_t LoRaClass::singleTransfer(uint8_t address, uint8_t value)
 {
   uint8_t response;
@@ -587,9 +731,14 @@ uint8_t LoRaClass::singleTransfer(uint8_t address, uint8_t value)
   return response;
 }
 
-void LoRaClass::onDio0Rise()
+void IRAM_ATTR LoRaClass::onDio0Rise()
 {
-  LoRa.handleDio0Rise();
+  if (LoRa._onDio0) {
+    LoRa._dio0Pending = true;
+    LoRa._onDio0();
+  } else {
+    LoRa.handleDio0Rise();
+  }
 }
 
 LoRaClass LoRa;
@@ -61,7 +61,12 @@ public:
   virtual int peek();
   virtual void flush();
 
+  size_t read(uint8_t *buffer, size_t size);
+
   void onReceive(void(*callback)(int));
+  void onTxDone(void(*callback)());
+  void onDio0(void(*callback)());
+  bool handleDio0();
 
   void receive(int size = 0);
   void idle();
@@ -90,6 +95,7 @@ public:
 
   void setPins(int ss = LORA_DEFAULT_SS_PIN, int reset = LORA_DEFAULT_RESET_PIN, int dio0 = LORA_DEFAULT_DIO0_PIN);
   void setSPIFrequency(uint32_t frequency);
+  void enableRegisterCache(bool enable = true);
 
   void dumpRegisters(Stream& out);
 
@@ -102,6 +108,9 @@ private:
   uint8_t readRegister(uint8_t address);
   void writeRegister(uint8_t address, uint8_t value);
   uint8_t singleTransfer(uint8_t address, uint8_t value);
+  void readFifo(uint8_t *buffer, size_t size);
+  void writeFifo(const uint8_t *buffer, size_t size);
+  static bool isCachedRegister(uint8_t address);
 
   static void onDio0Rise();
 
@@ -112,8 +121,16 @@ private:
   int _dio0;
   int _frequency;
   int _packetIndex;
+  int _packetLength;
+  int _payloadLength;
   int _implicitHeaderMode;
+  bool _registerCache;
+  uint8_t _shadow[128];
+  uint32_t _shadowValid[4];
   void (*_onReceive)(int);
+  void (*_onTxDone)();
+  void (*_onDio0)();
+  volatile bool _dio0Pending;
 };
 
 extern LoRaClass LoRa;
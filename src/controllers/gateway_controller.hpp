@@ -14,10 +14,36 @@
 #include "interfaces/lora_interface.hpp"
 #include "interfaces/wifi_handler.hpp"
 #include "models/enums.hpp"
+#include "models/field_view.hpp"
+#include "models/join_message.hpp"
+#include "models/link_command.hpp"
+#include "models/meter_reading.hpp"
+#include "models/reading_batch.hpp"
+#include "models/reading_columns.hpp"
 #include "models/lora_dto.hpp"
 #include "models/serializable_data.hpp"
+#include "services/adr_engine.hpp"
 #include "services/crypto.hpp"
 #include "services/logger.hpp"
+#include "services/node_registry.hpp"
+#include "services/session_table.hpp"
+
+/// The most fields a Gateway forwards from one received message.
+#define GATEWAY_MAX_FIELDS 16
+
+/// The most received frames of readings a Gateway queues before decoding them.
+#define GATEWAY_FRAME_QUEUE_LENGTH 4
+
+/// How long a Gateway waits before asking a node without a session to join again, in
+/// milliseconds, so that a node sending often is not asked with every frame.
+#define GATEWAY_REJOIN_INTERVAL 60000
+
+/// How many frames in a row claiming the session of a node a Gateway drops for a failed MIC
+/// before asking the node to join again, as it may hold a key the node never got.
+#define GATEWAY_REJOIN_FAILURES 3
+
+/// The REST endpoint that readings are uploaded to.
+#define GATEWAY_DATA_SEND_PATH "/.netlify/functions/server"
 
 /**
  * @brief The control logic for the microcontroller's operation as a Gateway.
@@ -36,6 +62,269 @@ class GatewayController : public BaseController {
 
         /// The encryption service
         Crypto *cryptoService;
+
+        /// The short addresses assigned to the nodes that joined.
+        NodeRegistry *nodeRegistry;
+
+        /// The session keys and replay windows of the nodes that joined, or null without a
+        /// network key.
+        SessionTable *sessions;
+
+        /// Picks the spreading factor of the network and the TX power of each node, or null if
+        /// every node keeps the defaults.
+        AdrEngine *adr;
+
+        /// The fields of the last received message, pointing into the LoRa interface's buffer.
+        FieldView receivedFields[GATEWAY_MAX_FIELDS];
+
+        /// The received frames of readings waiting to be decoded.
+        ReceivedFrame queuedFrames[GATEWAY_FRAME_QUEUE_LENGTH];
+
+        /// The number of frames waiting to be decoded.
+        size_t queuedFrameCount;
+
+        /// The readings decoded from the queued frames, one column per field.
+        ReadingColumns *columns;
+
+        /// Whether each node, by address, was asked to join again, and when, in milliseconds.
+        bool rejoinAsked[NODE_REGISTRY_CAPACITY];
+        unsigned long rejoinAskedAt[NODE_REGISTRY_CAPACITY];
+
+        /**
+         * @brief Assign a short address to a node that asked to join, start a new session for
+         * it if there is a network key, and tell it. The new session key only replaces the one
+         * the node has once a frame sealed with it opens. A request repeating the node nonce
+         * of the last join is answered as before, as the node did not hear the answer, if the
+         * gateway still holds that join; otherwise it is a replay, and refused.
+         * 
+         * @param message The join request of the node, reused as the answer.
+         */
+        void acceptJoin(JoinMessage &message) {
+            message.nodeAddress = nodeRegistry->join(message.deviceID);
+            if (message.nodeAddress == 0) {
+                return;
+            }
+            if (sessions != nullptr) {
+                const NodeSession *session = sessions->find(message.nodeAddress);
+                if (message.nodeNonce == 0 || message.nodeNonce == nodeRegistry->lastNonce(message.nodeAddress)) {
+                    if (message.nodeNonce == 0 || session == nullptr || session->gatewayNonce == 0) {
+                        logger->logSerial("Reused node nonce from node " + String(message.nodeAddress) + ", rejecting join.", true);
+                        return;
+                    }
+                    message.gatewayNonce = session->gatewayNonce;
+                    sendJoinAccept(message);
+                    return;
+                }
+                do {
+                    message.gatewayNonce = esp_random();
+                } while (message.gatewayNonce == 0);
+                uint8_t sessionKey[AES_KEYLEN];
+                cryptoService->deriveSessionKey(message.nodeAddress, message.nodeNonce, message.gatewayNonce, sessionKey);
+                session = sessions->open(message.nodeAddress, sessionKey, message.gatewayNonce);
+                memset(sessionKey, 0, sizeof(sessionKey));
+                if (session == nullptr) {
+                    logger->logSerial("Session table full, rejecting join.", true);
+                    return;
+                }
+                nodeRegistry->recordNonce(message.nodeAddress, message.nodeNonce);
+            }
+            // A node starts over at full power when it joins.
+            if (adr != nullptr) {
+                adr->forget(message.nodeAddress);
+            }
+            sendJoinAccept(message);
+        }
+
+        /**
+         * @brief Send a node the answer to its join request.
+         * 
+         * @param message The answer.
+         */
+        void sendJoinAccept(const JoinMessage &message) {
+            if (!loraInterface->sendJoinAccept(message, cryptoService)) {
+                logger->logSerial("Join Accept deferred, node " + String(message.nodeAddress) + " will ask again.", true);
+            }
+        }
+
+        /**
+         * @brief Ask the node of the last packet to join again if the packet is sealed under a
+         * session the gateway does not hold, as sessions are lost when it reboots, or under
+         * one whose last GATEWAY_REJOIN_FAILURES frames failed their MIC, as the gateway may
+         * hold a key the node never got. At most once every GATEWAY_REJOIN_INTERVAL per node.
+         * Without this, the node would go unheard until its session expires.
+         * 
+         * @return bool Whether the packet was sealed under an unknown session, and cannot be
+         * opened.
+         */
+        bool askToRejoin() {
+            const uint16_t keyID = loraInterface->packetKeyID();
+            const NodeSession *session = sessions != nullptr ? sessions->find(keyID) : nullptr;
+            const bool unknown = session == nullptr;
+            if (sessions == nullptr || keyID == 0 || (!unknown && session->failures < GATEWAY_REJOIN_FAILURES)) {
+                return false;
+            }
+            const char *deviceID = nodeRegistry->lookup(keyID);
+            const unsigned long now = millis();
+            if (deviceID == nullptr || (rejoinAsked[keyID - 1] && now - rejoinAskedAt[keyID - 1] < GATEWAY_REJOIN_INTERVAL)) {
+                return unknown;
+            }
+            logger->logSerial((unknown ? "No session for node " : "Failed MICs from node ") + String(keyID) + ", asking it to join again.", true);
+            JoinMessage request = {};
+            strncpy(request.deviceID, deviceID, MAX_DEVICE_ID_LENGTH);
+            request.nodeAddress = keyID;
+            if (loraInterface->sendRejoin(request, cryptoService)) {
+                rejoinAsked[keyID - 1] = true;
+                rejoinAskedAt[keyID - 1] = now;
+            }
+            return unknown;
+        }
+
+        /**
+         * @brief Find the short address of the node a decoded reading came from. A frame
+         * opened by a session can only come from that session's node, so its readings are
+         * bound to it, and dropped if they claim another address. Readings that carry a Device
+         * ID instead are uploaded under it at once, unless their node joined, so that only
+         * joined nodes take up registry slots.
+         * 
+         * @param reading The decoded reading.
+         * @param senderAddress The node whose session opened the frame, or 0.
+         * @return uint16_t The address of the node, or 0 if the reading is dropped or was
+         * uploaded already.
+         */
+        uint16_t resolveNode(const MeterReading &reading, uint16_t senderAddress) {
+            if (senderAddress != 0) {
+                if (reading.nodeAddress != 0 && reading.nodeAddress != senderAddress) {
+                    logger->logSerial("Node " + String(senderAddress) + " sent a reading as node " + String(reading.nodeAddress) + ", dropped!", true);
+                    return 0;
+                }
+                return senderAddress;
+            }
+            if (reading.nodeAddress == 0) {
+                const uint16_t joined = reading.deviceID[0] != '\0' ? nodeRegistry->find(reading.deviceID) : 0;
+                if (joined == 0 && reading.deviceID[0] != '\0') {
+                    uploadReading(reading);
+                }
+                return joined;
+            }
+            if (nodeRegistry->lookup(reading.nodeAddress) == nullptr) {
+                logger->logSerial("Unknown node address " + String(reading.nodeAddress), true);
+                return 0;
+            }
+            return reading.nodeAddress;
+        }
+
+        /**
+         * @brief Replace a short address among received fields with the Device ID it stands
+         * for, pointing into the registry. The address must be that of the node whose session
+         * opened the message, if one did.
+         * 
+         * @param fields The received fields.
+         * @param fieldCount The number of received fields.
+         * @param senderAddress The node whose session opened the message, or 0.
+         * @return bool Whether the fields have a known sender.
+         */
+        bool resolveSender(FieldView *fields, size_t fieldCount, uint16_t senderAddress) {
+            const char *addressKey = findFieldSpec(NODE_ADDRESS_TAG)->name;
+            for (size_t i = 0; i < fieldCount; i++) {
+                if (!fields[i].keyEquals(addressKey)) {
+                    continue;
+                }
+                uint16_t nodeAddress = 0;
+                for (uint8_t j = 0; j < fields[i].valLength && fields[i].val[j] >= '0' && fields[i].val[j] <= '9'; j++) {
+                    nodeAddress = nodeAddress * 10 + (fields[i].val[j] - '0');
+                }
+                if (senderAddress != 0 && nodeAddress != senderAddress) {
+                    logger->logSerial("Node " + String(senderAddress) + " sent a message as node " + String(nodeAddress) + ", dropped!", true);
+                    return false;
+                }
+                const char *deviceID = nodeRegistry->lookup(nodeAddress);
+                if (deviceID == nullptr) {
+                    logger->logSerial("Unknown node address " + String(nodeAddress), true);
+                    return false;
+                }
+                fields[i].key = findFieldSpec(DEVICE_ID_TAG)->name;
+                fields[i].keyLength = strlen(fields[i].key);
+                fields[i].val = deviceID;
+                fields[i].valLength = strlen(deviceID);
+            }
+            return true;
+        }
+
+        /**
+         * @brief Upload one reading unpacked from a batch, with its age at upload time.
+         * 
+         * @param reading The reading to upload.
+         */
+        void uploadReading(const MeterReading &reading) {
+            FieldView fields[MeterReadingSchema::FIELD_COUNT + 1];
+            char scratch[36];
+            char ageText[12];
+            const size_t fieldCount = MeterReadingSchema::toFields(reading, fields, scratch, sizeof(scratch));
+            FieldView &age = fields[fieldCount];
+            age.key = findFieldSpec(AGE_TAG)->name;
+            age.keyLength = strlen(age.key);
+            age.val = ageText;
+            age.valLength = formatFixed((millis() - reading.timestamp) / 1000, 0, ageText, sizeof(ageText));
+            restClient->makeGETRequest(GATEWAY_DATA_SEND_PATH, fields, fieldCount + 1);
+        }
+
+        /**
+         * @brief Record the signal quality of the frames decoded into the columns, once per
+         * frame, and send their nodes the settings the engine assigns them. The readings of a
+         * frame sit in consecutive rows, so only the first row of each frame is looked at. The
+         * nodes listen between frames, so they hear the commands whenever they are sent. A
+         * command the duty cycle defers is sent with a later frame of its node.
+         * 
+         */
+        void adaptLinks() {
+            for (size_t i = 0; i < columns->size(); i++) {
+                if (
+                    i > 0
+                    && columns->nodeAddress[i] == columns->nodeAddress[i - 1]
+                    && columns->receivedAt[i] == columns->receivedAt[i - 1]
+                ) {
+                    continue;
+                }
+                adr->record(columns->nodeAddress[i], columns->snr[i], columns->rssi[i], columns->receivedAt[i]);
+                LinkCommand command;
+                if (
+                    adr->command(columns->nodeAddress[i], millis(), command)
+                    && loraInterface->sendLinkCommand(command, cryptoService, sessions)
+                ) {
+                    adr->commandSent(command);
+                }
+            }
+        }
+
+        /**
+         * @brief Open the sealed queued frames in one batch, then decode every queued frame
+         * into columns and upload the readings, as many frames at a time as the columns hold.
+         * 
+         */
+        void ingestQueuedFrames() {
+            loraInterface->openFrames(queuedFrames, queuedFrameCount, cryptoService, sessions);
+            size_t next = 0;
+            while (next < queuedFrameCount) {
+                columns->clear();
+                next += columns->decodeFrames(
+                    queuedFrames + next,
+                    queuedFrameCount - next,
+                    [this](const MeterReading &reading, uint16_t senderAddress) { return resolveNode(reading, senderAddress); }
+                );
+                if (adr != nullptr) {
+                    adaptLinks();
+                }
+                for (size_t i = 0; i < columns->size(); i++) {
+                    MeterReading reading = {};
+                    strcpy(reading.deviceID, nodeRegistry->lookup(columns->nodeAddress[i]));
+                    reading.current = columns->current[i];
+                    reading.voltage = columns->voltage[i];
+                    reading.timestamp = columns->timestamp[i];
+                    uploadReading(reading);
+                }
+            }
+            queuedFrameCount = 0;
+        }
     
     public:
         /**
@@ -46,6 +335,9 @@ class GatewayController : public BaseController {
          * @param restHost The base URL of the REST backend to send requests to.
          * @param encryptionKey The key to use for encryption of data in communication.
          * @param loraBand The frequency band to be used for LoRA Communication.
+         * @param adaptiveDataRate Whether to assign joined nodes the fastest spreading factor
+         * and lowest TX power they can be heard with, see AdrEngine. Every node must be set to
+         * follow them.
          * @param verbose Whether or not to log the Gatway Controller activities.
          * @param wifiVerbose Whether or not to log the WiFiHandler activities.
          * @param restVerbose Whether or not to log the RESTClient activities.
@@ -57,6 +349,7 @@ class GatewayController : public BaseController {
             const char *restHost,
             const String encryptionKey,
             const LoraBand loraBand = LoraBand::ASIA,
+            bool adaptiveDataRate = false,
             bool verbose = false,
             bool wifiVerbose = false,
             bool restVerbose = false,
@@ -72,8 +365,25 @@ class GatewayController : public BaseController {
             // Set up LoRa interface
             this->loraInterface = new LoraInterface(loraBand, loraInterfaceVerbose);
 
+            // Receive in continuous mode, the radio flagging packets by interrupt
+            this->loraInterface->listen();
+
             // Set up Encryption Service
             this->cryptoService = new Crypto(encryptionKey);
+
+            // Load the short addresses assigned before the last reboot. Sessions are not kept
+            // across reboots, so nodes are asked to join again when they are next heard.
+            this->nodeRegistry = new NodeRegistry(verbose);
+            this->sessions = this->cryptoService->isReady() ? new SessionTable() : nullptr;
+
+            // Set up adaptive data rate, starting from the spreading factor the radio starts at
+            this->adr = adaptiveDataRate ? new AdrEngine() : nullptr;
+
+            // Set up the receive queue and the columns it is decoded into
+            this->queuedFrameCount = 0;
+            this->columns = new ReadingColumns();
+            memset(this->rejoinAsked, 0, sizeof(this->rejoinAsked));
+            memset(this->rejoinAskedAt, 0, sizeof(this->rejoinAskedAt));
             
             // Connect to Wi-Fi
             this->wifi->connectWiFi();
@@ -84,12 +394,43 @@ class GatewayController : public BaseController {
          * 
          */
         void operate() override {
-            LoraDTO dto = loraInterface->receiveLoraMessage(nullptr);
-            if (dto.getDataListSize() == 0) {
+            // Listen at the spreading factor the network switched to, once it is due
+            if (adr != nullptr && adr->update(millis())) {
+                loraInterface->setLinkSettings(adr->spreadingFactor(), LORA_TX_POWER);
+            }
+            // Queued frames are decoded once the receive ring is drained, or the queue fills up.
+            if (loraInterface->receivePacket() == 0) {
+                ingestQueuedFrames();
+                logger->logSerial("Nothing to send!", true);
+                return;
+            }
+            if (askToRejoin()) {
+                return;
+            }
+            // Sealed readings are queued as they are, to be opened together.
+            const bool sealedReading = cryptoService->isReady()
+                && loraInterface->isSealedPacket()
+                && loraInterface->isReadingPacket();
+            if (!sealedReading && !loraInterface->unprotectPacket(cryptoService, sessions)) {
+                return;
+            }
+            JoinMessage joinRequest;
+            if (!sealedReading && loraInterface->parseJoinRequest(joinRequest)) {
+                acceptJoin(joinRequest);
+                return;
+            }
+            if (loraInterface->isReadingPacket()) {
+                loraInterface->copyPacket(queuedFrames[queuedFrameCount++]);
+                if (queuedFrameCount == GATEWAY_FRAME_QUEUE_LENGTH) {
+                    ingestQueuedFrames();
+                }
+                return;
+            }
+            const size_t fieldCount = loraInterface->parseFields(receivedFields, GATEWAY_MAX_FIELDS);
+            if (fieldCount == 0) {
                 logger->logSerial("Nothing to send!", true);
-            } else {
-                const char* dataSendPath = "/.netlify/functions/server";
-                restClient->makeGETRequest(dataSendPath, dto.getDataList(), dto.getDataListSize());
+            } else if (resolveSender(receivedFields, fieldCount, loraInterface->getSenderAddress())) {
+                restClient->makeGETRequest(GATEWAY_DATA_SEND_PATH, receivedFields, fieldCount);
             }
         }
 
@@ -106,5 +447,13 @@ class GatewayController : public BaseController {
             this->loraInterface = nullptr;
             delete this->cryptoService;
             this->cryptoService = nullptr;
+            delete this->nodeRegistry;
+            this->nodeRegistry = nullptr;
+            delete this->sessions;
+            this->sessions = nullptr;
+            delete this->adr;
+            this->adr = nullptr;
+            delete this->columns;
+            this->columns = nullptr;
         }
 };
\ No newline at end of file
@@ -13,18 +13,146 @@
 #include "interfaces/lora_interface.hpp"
 #include "interfaces/power_sensors_interface.hpp"
 #include "models/enums.hpp"
-#include "models/lora_dto.hpp"
+#include "models/meter_reading.hpp"
 #include "services/crypto.hpp"
 #include "services/logger.hpp"
 
+/// How long a Node that failed to join waits before asking the gateway again, in milliseconds.
+#define NODE_JOIN_RETRY_INTERVAL 600000
+
+/// How long a Node keeps a session key before joining again, in milliseconds. Also bounds how
+/// long its frames go unread after the gateway reboots and forgets its session, should its
+/// requests to join again be lost.
+#define NODE_SESSION_LIFETIME 3600000
+
+/// How long a Node waits after joining before it joins again when the gateway asks, in
+/// milliseconds, so that replayed requests cannot keep it joining.
+#define NODE_REJOIN_INTERVAL 60000
+
+/// How often a Node samples and sends a reading, in milliseconds.
+#define NODE_SAMPLE_INTERVAL 1000
+
 /**
  * @brief The control logic for the microcontroller's operation as a Node.
  * 
  */
 class NodeController : public BaseController {
     private:
-        /// The Device ID of the node.
-        String nodeID;
+        /// The reading sent on each iteration, with the Device ID or short address of the
+        /// node filled in once.
+        MeterReading reading;
+
+        /// The NUL-terminated Device ID of the node, sent when joining.
+        char deviceID[MAX_DEVICE_ID_LENGTH + 1];
+
+        /// Whether to ask the gateway for a short address. Joining needs the binary format.
+        bool joinEnabled;
+
+        /// When the node last asked the gateway for a short address, in milliseconds.
+        unsigned long lastJoinAttempt;
+
+        /// Whether the node asked the gateway for a short address yet.
+        bool joinAttempted;
+
+        /// When the current session key was derived, in milliseconds.
+        unsigned long sessionStart;
+
+        /// Whether the gateway asked the node to join again, having lost its session.
+        bool rejoinRequested;
+
+        /// When the node last sampled, in milliseconds.
+        unsigned long lastSample;
+
+        /// Whether the node sampled yet.
+        bool sampled;
+
+        /// Whether the gateway sets the spreading factor and TX power of the node.
+        bool adaptiveDataRate;
+
+        /**
+         * @brief Get the encryption service frames are sealed with: the session key once the
+         * node joined with one, the network key before.
+         * 
+         */
+        Crypto *sealingCrypto() {
+            return this->sessionCrypto->isReady() ? this->sessionCrypto : this->cryptoService;
+        }
+
+        /**
+         * @brief Check whether the node should ask the gateway for a short address and session
+         * key now: when it has none, or its session expired, and it did not just ask, or when
+         * the gateway asked it to and it did not join within NODE_REJOIN_INTERVAL.
+         * 
+         */
+        bool shouldJoin() {
+            const unsigned long now = millis();
+            const bool joined = this->reading.nodeAddress != 0;
+            const bool sessionExpired = this->sessionCrypto->isReady() && now - this->sessionStart >= NODE_SESSION_LIFETIME;
+            const unsigned long sinceJoin = now - this->lastJoinAttempt;
+            return this->joinEnabled && (
+                !this->joinAttempted
+                || ((!joined || sessionExpired) && sinceJoin >= NODE_JOIN_RETRY_INTERVAL)
+                || (this->rejoinRequested && sinceJoin >= NODE_REJOIN_INTERVAL)
+            );
+        }
+
+        /**
+         * @brief Ask the gateway for a short address and session key. followGateway picks up
+         * the answer.
+         * 
+         */
+        void join() {
+            this->joinAttempted = true;
+            this->lastJoinAttempt = millis();
+            this->loraInterface->startJoin(this->deviceID, this->cryptoService);
+        }
+
+        /**
+         * @brief Use the short address and session key the gateway assigned. Readings already
+         * batched are sent first, as a batch carries a single sender and is sealed with a
+         * single key.
+         * 
+         * @param nodeAddress The short address assigned.
+         * @param previousCrypto The encryption service the batched readings are sealed with.
+         */
+        void joined(uint16_t nodeAddress, Crypto *previousCrypto) {
+            this->loraInterface->flushBatch(previousCrypto);
+            this->reading.nodeAddress = nodeAddress;
+            this->reading.deviceID[0] = '\0';
+            this->sessionStart = millis();
+            this->rejoinRequested = false;
+        }
+
+        /**
+         * @brief Apply the answers and commands the gateway sent this node since the last
+         * iteration, and switch to a commanded spreading factor once due. Frames for other
+         * nodes, and readings they send, are skipped without being opened.
+         * 
+         */
+        void followGateway() {
+            while (this->loraInterface->pendingPackets() > 0) {
+                if (
+                    this->loraInterface->receivePacket() == 0
+                    || this->loraInterface->isReadingPacket()
+                    || !this->loraInterface->unprotectDownlink(this->cryptoService, this->sessionCrypto)
+                ) {
+                    continue;
+                }
+                Crypto *previousCrypto = sealingCrypto();
+                const uint16_t nodeAddress = this->loraInterface->acceptJoin(this->cryptoService, this->sessionCrypto);
+                if (nodeAddress != 0) {
+                    joined(nodeAddress, previousCrypto);
+                } else if (this->loraInterface->parseRejoin(this->deviceID, this->reading.nodeAddress)) {
+                    this->logger->logSerial("Gateway lost the session, joining again.", true);
+                    this->rejoinRequested = true;
+                } else if (this->adaptiveDataRate) {
+                    this->loraInterface->applyLinkCommand(this->reading.nodeAddress, this->sessionCrypto->isReady());
+                }
+            }
+            if (this->adaptiveDataRate) {
+                this->loraInterface->updateLink();
+            }
+        }
 
         /// The interface to use the Electrometer based sensors.
         PowerSensorsInterface *powerSensorInterface;
@@ -32,8 +160,11 @@ class NodeController : public BaseController {
         /// The interface to use for LoRa Communication (sending)
         LoraInterface *loraInterface;
 
-        /// The encryption service
+        /// The encryption service holding the network key, for joining.
         Crypto *cryptoService;
+
+        /// The encryption service holding the session key, not ready until the node joined.
+        Crypto *sessionCrypto;
     
     public:
         /**
@@ -44,6 +175,16 @@ class NodeController : public BaseController {
          * @param voltageSensorPin The pin that the voltage sensor is connected to.
          * @param loraBand The frequency band to be used for LoRA Communication.
          * @param encryptionKey The key to use for encryption of data in communication.
+         * @param wireFormat The format to serialize LoRa messages into. Binary Nodes also join
+         * the gateway, to send a short address in place of their Device ID.
+         * @param batchReadings How many readings to send together in one LoRa frame. Batching
+         * needs the binary wire format; 1 sends each reading straight away.
+         * @param batchLatency The longest a reading may wait in a batch, in milliseconds.
+         * @param integrityOnly Whether to only sign readings with AES-CMAC, leaving them
+         * readable by anyone, rather than encrypt them. Joining is encrypted either way.
+         * @param adaptiveDataRate Whether to send with the spreading factor and TX power the
+         * gateway assigns, which it must be set to do too. Needs the binary wire format, as
+         * only joined nodes are assigned settings.
          * @param verbose Whether or not to log the Gatway Controller activities.
          * @param powerSensorsVerbose Whether or not to log the PowerSensorsInterface activities.
          * @param loraInterfaceVerbose Whether or not to log the LoraInterface activities.
@@ -54,12 +195,27 @@ class NodeController : public BaseController {
             uint8_t voltageSensorPin,
             String encryptionKey,
             LoraBand loraBand = LoraBand::ASIA,
+            WireFormat wireFormat = WireFormat::LEGACY_TEXT,
+            size_t batchReadings = 1,
+            unsigned long batchLatency = 60000,
+            bool integrityOnly = false,
+            bool adaptiveDataRate = false,
             bool verbose = false,
             bool powerSensorsVerbose=false,
             bool loraInterfaceVerbose=false
         ) : BaseController(new Logger(verbose, "NodeController")) {
             // Set up device ID
-            this->nodeID = nodeID;
+            nodeID.toCharArray(this->deviceID, sizeof(this->deviceID));
+            memcpy(this->reading.deviceID, this->deviceID, sizeof(this->deviceID));
+            this->reading.nodeAddress = 0;
+            this->joinEnabled = wireFormat == WireFormat::BINARY_TLV;
+            this->lastJoinAttempt = 0;
+            this->joinAttempted = false;
+            this->sessionStart = 0;
+            this->rejoinRequested = false;
+            this->lastSample = 0;
+            this->sampled = false;
+            this->adaptiveDataRate = adaptiveDataRate && this->joinEnabled;
             
             // Set up sensor interfaces
             this->powerSensorInterface = new PowerSensorsInterface(
@@ -71,11 +227,30 @@ class NodeController : public BaseController {
                 powerSensorsVerbose
             );
 
-            // Set up LoRa interface
-            this->loraInterface = new LoraInterface(loraBand, loraInterfaceVerbose);
-
-            // Set up Encryption Service
+            // Set up Encryption Service, and the session key it derives once joined, both
+            // precomputing the keystream of the frames they encrypt next
             this->cryptoService = new Crypto(encryptionKey);
+            this->sessionCrypto = new Crypto();
+            if (!integrityOnly) {
+                this->cryptoService->enableKeystreamPool();
+                this->sessionCrypto->enableKeystreamPool();
+            }
+
+            // Set up LoRa interface, with batches sized to be sealed if there is a key
+            this->loraInterface = new LoraInterface(loraBand, loraInterfaceVerbose, wireFormat);
+            this->loraInterface->setSealing(integrityOnly ? SIGNED : AUTHENTICATED);
+            if (batchReadings > 1) {
+                this->loraInterface->enableBatching(batchReadings, batchLatency, true, this->cryptoService->isReady());
+            }
+
+            // Listen between frames for the gateway asking to join again, and the settings it
+            // assigns
+            if (this->adaptiveDataRate) {
+                this->loraInterface->enableLinkAdaptation();
+            }
+            if (this->joinEnabled) {
+                this->loraInterface->listen();
+            }
         }
 
         /**
@@ -83,18 +258,37 @@ class NodeController : public BaseController {
          * 
          */
         void operate() {
+            // Frames are sent in the background: finish the one in the air once it is sent,
+            // and until the next sampling window, precompute the keystream of the next frames,
+            // so that sealing them only XORs
+            loraInterface->isTransmitting();
+            if (joinEnabled) {
+                followGateway();
+            }
+            // While a join request waits for its answer the node does not send, so as not to
+            // miss it, but keeps the loop running
+            if (loraInterface->isJoining()) {
+                return;
+            }
+            if (sampled && millis() - lastSample < NODE_SAMPLE_INTERVAL) {
+                sealingCrypto()->precomputeKeystream();
+                return;
+            }
+            sampled = true;
+            lastSample = millis();
+            // Get a short address and session key, falling back to the Device ID and network
+            // key until the gateway answers
+            if (shouldJoin()) {
+                join();
+                return;
+            }
             // Sense needed values
-            const double iRMS = powerSensorInterface->getRMSCurrentEmon();
-            //  const double vRMS = emonSensorInterface->getRMSVoltage();
-            // For Serializable Data
-            SerializableData dataList[] = {
-                SerializableData("deviceID", nodeID),
-                SerializableData("current", String(iRMS)),
-                SerializableData("voltage", String(244)),
-            };
-            // Send LoRA Message
-            LoraDTO dto = LoraDTO(dataList, 3);
-            loraInterface->sendLoraMessage(dto, nullptr);
+            reading.current = powerSensorInterface->getRMSCurrentEmon();
+            //  reading.voltage = emonSensorInterface->getRMSVoltage();
+            reading.voltage = 244;
+            reading.timestamp = millis();
+            // Send LoRA Message, possibly batched with the next readings
+            loraInterface->queueReading(reading, sealingCrypto());
         }
 
         /**
@@ -108,5 +302,7 @@ class NodeController : public BaseController {
             this->loraInterface = nullptr;
             delete this->cryptoService;
             this->cryptoService = nullptr;
+            delete this->sessionCrypto;
+            this->sessionCrypto = nullptr;
         }
 };
\ No newline at end of file
@@ -15,12 +15,61 @@
 
 #include "models/serializable_data.hpp"
 #include "models/enums.hpp"
+#include "models/field_view.hpp"
+#include "models/join_message.hpp"
+#include "models/link_command.hpp"
 #include "models/lora_dto.hpp"
+#include "models/meter_reading.hpp"
+#include "models/reading_batch.hpp"
+#include "models/reading_columns.hpp"
+#include "models/wire_format.hpp"
+#include "services/adr_engine.hpp"
+#include "services/airtime.hpp"
+#include "services/cipher_stream.hpp"
 #include "services/crypto.hpp"
+#include "services/duty_cycle.hpp"
 #include "services/logger.hpp"
+#include "services/packet_ring.hpp"
+#include "services/session_table.hpp"
+#include "services/signing_stream.hpp"
 
 #define RST 14
 
+/// The most sealed frames openFrames opens in one batch: enough to reach the bitsliced cipher,
+/// as shorter runs are opened one by one.
+#define LORA_OPEN_BATCH_LENGTH CRYPTO_BATCH_MIN_MESSAGES
+
+/// How long a node waits for the gateway to answer a join request, in milliseconds, from
+/// when it is sent. A node adapting its link waits that long on each spreading factor.
+#define JOIN_ACCEPT_TIMEOUT 3000
+
+/// The longest a frame may stay in the air before its transmission is given up on, in
+/// milliseconds: a full frame takes about 9 seconds at SF12 and 125 kHz.
+#define LORA_TRANSMIT_TIMEOUT 10000
+
+/// The TX power the radio starts at, in dBm, and falls back to when the gateway is lost.
+#define LORA_TX_POWER 14
+
+/// The frames a node adapting its link sends without hearing from the gateway before it
+/// takes the gateway for lost, raises its power and starts scanning the spreading factors.
+#define LORA_LINK_CHECK_LIMIT 24
+
+/// The frames a node scanning for the gateway sends at each spreading factor. Above
+/// ADR_KEEPALIVE_INTERVAL, so that the gateway answers before the node moves on.
+#define LORA_LINK_SCAN_DWELL 12
+
+/// The bandwidth in Hz, coding rate denominator and preamble length the radio sends with,
+/// as LoRaClass::begin leaves them. Low data rate optimization is left off too.
+#define LORA_BANDWIDTH 125000
+#define LORA_CODING_RATE 5
+#define LORA_PREAMBLE_LENGTH 8
+
+/// The priority and stack, in bytes, of the task copying received packets out of the radio
+/// FIFO. Above the loop, so that it runs as soon as DIO0 flags a packet, even while the loop
+/// is blocked in an upload.
+#define LORA_RADIO_TASK_PRIORITY (configMAX_PRIORITIES - 1)
+#define LORA_RADIO_TASK_STACK 4096
+
 /**
  * @brief Interface to handle duplex LoRa Communication.
  * 
@@ -33,15 +82,812 @@ class LoraInterface {
         /// The frequency band to be used for LoRA Communication.
         int band;
 
+        /// The format that outgoing messages are serialized into.
+        WireFormat wireFormat;
+
+        /// The readings waiting to be sent together, or null if batching is disabled.
+        ReadingBatch *batch;
+
+        /// The longest a reading may wait in the batch before it is sent, in milliseconds.
+        unsigned long batchLatency;
+
+        /// The protection readings are sealed with when there is a key: AUTHENTICATED, or
+        /// SIGNED to leave them readable by anyone.
+        FrameProtection sealing;
+
+        /// Whether the batch leaves room for a nonce and MIC, and is sealed when it is sent.
+        bool batchProtected;
+
+        /// The last packet received by receivePacket, which parsed views point into.
+        uint8_t receivedFrame[WIRE_MAX_FRAME_LENGTH + 1];
+
+        /// The number of bytes in the last packet received.
+        size_t receivedLength;
+
+        /// The signal strength, signal to noise ratio and uptime in milliseconds the last
+        /// packet read arrived with.
+        int16_t receivedRssi;
+        float receivedSnr;
+        uint32_t receivedAt;
+
+        /// The short address of the node whose session key opened the last packet, 0 if it
+        /// was sealed with the network key or sent in the clear.
+        uint16_t receivedSender;
+
+        /// The packets copied out of the radio FIFO that the loop has not read yet, or null
+        /// while the radio is polled instead.
+        PacketRing *ring;
+
+        /// The packets the ring had dropped when that was last logged.
+        uint32_t reportedDrops;
+
+        /// Holds the text of numeric binary fields that parsed views point into.
+        char receivedScratch[WIRE_MAX_FRAME_LENGTH];
+
+        /// Whether a frame was handed to the radio and is still in the air.
+        bool transmitting;
+
+        /// The number of bytes of the frame in the air, and the uptime in milliseconds its
+        /// transmission started at.
+        size_t transmittedLength;
+        unsigned long transmitStart;
+
+        /// Whether the spreading factor and TX power follow the LINK_ADR commands of the
+        /// gateway, falling back when it is lost.
+        bool linkAdaptive;
+
+        /// The spreading factor and TX power, in dBm, the radio sends and listens with.
+        uint8_t spreadingFactor;
+        int8_t txPower;
+
+        /// The frames sent since the gateway was last heard from, while the link adapts.
+        uint16_t unansweredFrames;
+
+        /// Whether a commanded spreading factor waits to be switched to, which one, and the
+        /// uptime in milliseconds it is switched to at.
+        bool linkSwitchPending;
+        uint8_t pendingSpreadingFactor;
+        unsigned long linkSwitchAt;
+
+        /// The join request waiting for the gateway to answer, its frame as sent, and the
+        /// number of bytes in it.
+        JoinMessage joinRequest;
+        uint8_t joinFrame[WIRE_MAX_FRAME_LENGTH];
+        size_t joinFrameLength;
+
+        /// Whether a join request waits for an answer, the number of times it is left to be
+        /// sent, and the uptime in milliseconds it was last sent at.
+        bool joining;
+        uint8_t joinAttemptsLeft;
+        unsigned long joinSentAt;
+
+        /// Whether a frame sealed with the session key of this node was opened since it
+        /// joined, and the nonce of the last one. Downlinks whose nonce is not above it are
+        /// replays.
+        bool downlinkOpened;
+        uint32_t downlinkNonce;
+
+        /// The airtime the duty cycle of the sub-band leaves to send with.
+        DutyCycleBudget *dutyCycle;
+
+        /// The readings dropped because the duty cycle left no airtime to send them with.
+        uint32_t droppedReadings;
+
+        /// Set by the TX done handler once the frame in the air is sent.
+        inline static std::atomic<bool> transmitDone { false };
+
+        /// The uptime in milliseconds of the last DIO0 interrupt, the time the packet it
+        /// flagged arrived at.
+        inline static std::atomic<uint32_t> interruptAt { 0 };
+
+        /// The interface the DIO0 handler hands packets to, the one that last called
+        /// listen(). The LoRa driver takes a plain function as its callback.
+        inline static LoraInterface *listener = nullptr;
+
+        /// The task handling DIO0 once the radio listens, and the lock it and the loop take
+        /// around every exchange with the radio. Null until listen().
+        inline static TaskHandle_t radioTask = nullptr;
+        inline static SemaphoreHandle_t radioLock = nullptr;
+
+        /**
+         * @brief Note the time of a DIO0 interrupt, from the interrupt itself, and wake the
+         * radio task to handle it. The driver flags the interrupt, as SPI transfers and
+         * floating point are not allowed in an interrupt on the ESP32. millis() is, as it
+         * lives in IRAM and reads a hardware timer.
+         * 
+         */
+        static IRAM_ATTR void onInterrupt() {
+            interruptAt.store(millis(), std::memory_order_relaxed);
+            if (radioTask != nullptr) {
+                BaseType_t woken = pdFALSE;
+                vTaskNotifyGiveFromISR(radioTask, &woken);
+                if (woken == pdTRUE) {
+                    portYIELD_FROM_ISR();
+                }
+            }
+        }
+
+        /**
+         * @brief Handle every DIO0 interrupt as soon as it is flagged, whatever the loop is
+         * doing: the task outranks the loop, so a packet is copied out of the FIFO before the
+         * next one can overwrite it, even while the loop is blocked in an upload.
+         * 
+         */
+        static void handleRadioTask(void *) {
+            while (true) {
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+                xSemaphoreTakeRecursive(radioLock, portMAX_DELAY);
+                LoRa.handleDio0();
+                xSemaphoreGiveRecursive(radioLock);
+            }
+        }
+
+        /**
+         * @brief Take the radio for a sequence of SPI transfers the radio task must not
+         * interleave with. Nests, and costs nothing before listen().
+         * 
+         */
+        static void lockRadio() {
+            if (radioLock != nullptr) {
+                xSemaphoreTakeRecursive(radioLock, portMAX_DELAY);
+            }
+        }
+
+        /**
+         * @brief Hand the radio back, once for every lockRadio().
+         * 
+         */
+        static void unlockRadio() {
+            if (radioLock != nullptr) {
+                xSemaphoreGiveRecursive(radioLock);
+            }
+        }
+
+        /**
+         * @brief Copy a received packet out of the radio FIFO into the receive ring, from
+         * the radio task. If the ring is full, the packet is left in the FIFO for the next one
+         * to overwrite, and counted as dropped.
+         * 
+         * @param packetSize The number of bytes received.
+         */
+        static void onPacket(int packetSize) {
+            ReceivedFrame *slot = listener->ring->claim();
+            if (slot == nullptr) {
+                return;
+            }
+            slot->length = LoRa.read(slot->bytes, WIRE_MAX_FRAME_LENGTH);
+            slot->rssi = LoRa.packetRssi();
+            slot->snr = LoRa.packetSnr();
+            slot->receivedAt = interruptAt.load(std::memory_order_relaxed);
+            listener->ring->publish();
+        }
+
+        /**
+         * @brief Note that the frame in the air was sent, from the radio task or handleRadio.
+         * 
+         */
+        static void onTransmitDone() {
+            transmitDone.store(true, std::memory_order_release);
+        }
+
+        /**
+         * @brief Put the radio back into continuous receive after a transmission, if packets
+         * are received by interrupt.
+         * 
+         */
+        void resumeListening() {
+            if (this->ring != nullptr) {
+                lockRadio();
+                LoRa.onReceive(onPacket);
+                LoRa.receive();
+                unlockRadio();
+            }
+        }
+
+        /**
+         * @brief Start a packet to transmit, once the frame still in the air, if any, is sent.
+         * The receive interrupt is detached meanwhile, so that it does not read the FIFO
+         * being filled, and the radio is held until endPacket or abortPacket.
+         * 
+         */
+        void beginPacket() {
+            awaitTransmit();
+            lockRadio();
+            if (this->ring != nullptr) {
+                LoRa.onReceive(nullptr);
+            }
+            LoRa.beginPacket();
+        }
+
+        /**
+         * @brief Drop the packet started with beginPacket without sending it, and listen
+         * again.
+         * 
+         */
+        void abortPacket() {
+            resumeListening();
+            unlockRadio();
+        }
+
+        /**
+         * @brief Start transmitting the packet started with beginPacket, and return at once.
+         * The TX done interrupt flags when it is sent, and isTransmitting then finishes up.
+         * If the duty cycle leaves no airtime for it, the packet is dropped instead.
+         * 
+         * @param frameLength The number of bytes in the packet.
+         * @return bool Whether the packet is on air.
+         */
+        bool endPacket(size_t frameLength) {
+            checkLink();
+            if (!this->dutyCycle->spend(airtimeOf(frameLength), millis())) {
+                this->logger->logSerial("Duty cycle spent, frame deferred.", true);
+                abortPacket();
+                return false;
+            }
+            if (this->linkAdaptive && this->unansweredFrames < UINT16_MAX) {
+                this->unansweredFrames++;
+            }
+            transmitDone.store(false, std::memory_order_relaxed);
+            LoRa.onTxDone(onTransmitDone);
+            this->transmitting = true;
+            this->transmittedLength = frameLength;
+            this->transmitStart = millis();
+            LoRa.endPacket(true);
+            unlockRadio();
+            return true;
+        }
+
+        /**
+         * @brief Get the settings the radio sends with.
+         * 
+         */
+        RadioSettings radioSettings() {
+            return RadioSettings {
+                this->spreadingFactor,
+                LORA_BANDWIDTH,
+                LORA_CODING_RATE,
+                LORA_PREAMBLE_LENGTH,
+                false,
+                true,
+                false
+            };
+        }
+
+        /**
+         * @brief Get how long a packet is on air at the current settings, in microseconds.
+         * 
+         * @param frameLength The number of bytes in the packet.
+         */
+        uint32_t airtimeOf(size_t frameLength) {
+            return timeOnAir(radioSettings(), frameLength);
+        }
+
+        /**
+         * @brief Send the pending join request once more. If the duty cycle defers it, the
+         * attempt still counts, and the next one is made after JOIN_ACCEPT_TIMEOUT.
+         * 
+         */
+        void sendJoinRequest() {
+            this->joinAttemptsLeft--;
+            this->joinSentAt = millis();
+            this->logger->logSerial("Sending Join Request", true);
+            transmitFrame(this->joinFrame, this->joinFrameLength);
+        }
+
+        /**
+         * @brief Get the spreading factor a node scanning for the gateway tries after the
+         * current one, wrapping around from the slowest to the fastest.
+         * 
+         */
+        uint8_t nextSpreadingFactor() {
+            return this->spreadingFactor >= ADR_MAX_SPREADING_FACTOR ? ADR_MIN_SPREADING_FACTOR : this->spreadingFactor + 1;
+        }
+
+        /**
+         * @brief Check whether a commanded spreading factor is due to be switched to.
+         * 
+         */
+        bool linkSwitchDue() {
+            return this->linkSwitchPending && (long) (millis() - this->linkSwitchAt) >= 0;
+        }
+
+        /**
+         * @brief Adapt the link of the frame about to be sent, with the radio in standby and
+         * the frame in the FIFO: switch to a commanded spreading factor once due, and once
+         * LORA_LINK_CHECK_LIMIT frames went unanswered, raise the power, then every
+         * LORA_LINK_SCAN_DWELL frames move to ADR_DEFAULT_SPREADING_FACTOR, where a gateway
+         * that lost this node falls back to, and on to the next spreading factor until the
+         * gateway answers. The settings follow from the count of unanswered frames alone, so
+         * checking again for a frame the duty cycle deferred changes nothing.
+         * 
+         */
+        void checkLink() {
+            if (!this->linkAdaptive) {
+                return;
+            }
+            bool changed = false;
+            if (linkSwitchDue()) {
+                this->linkSwitchPending = false;
+                this->spreadingFactor = this->pendingSpreadingFactor;
+                changed = true;
+            }
+            const uint16_t unanswered = this->unansweredFrames;
+            if (unanswered >= LORA_LINK_CHECK_LIMIT && (unanswered - LORA_LINK_CHECK_LIMIT) % LORA_LINK_SCAN_DWELL == 0) {
+                if (unanswered == LORA_LINK_CHECK_LIMIT) {
+                    this->logger->logSerial("Gateway lost, raising TX power.", true);
+                    this->txPower = LORA_TX_POWER;
+                } else {
+                    const uint16_t step = (unanswered - LORA_LINK_CHECK_LIMIT) / LORA_LINK_SCAN_DWELL - 1;
+                    const uint8_t spreadingFactors = ADR_MAX_SPREADING_FACTOR - ADR_MIN_SPREADING_FACTOR + 1;
+                    this->spreadingFactor = ADR_MIN_SPREADING_FACTOR
+                        + (ADR_DEFAULT_SPREADING_FACTOR - ADR_MIN_SPREADING_FACTOR + step) % spreadingFactors;
+                    this->logger->logSerial("Gateway lost, trying SF" + String(this->spreadingFactor), true);
+                }
+                this->linkSwitchPending = false;
+                changed = true;
+            }
+            if (changed) {
+                LoRa.setSpreadingFactor(this->spreadingFactor);
+                LoRa.setTxPower(this->txPower, RF_PACONFIG_PASELECT_PABOOST);
+            }
+        }
+
+        /**
+         * @brief Finish the transmission in the air, reporting how it went, and listen again.
+         * 
+         * @param sent Whether the TX done interrupt flagged it sent, rather than it timing out.
+         */
+        void finishTransmit(bool sent) {
+            this->transmitting = false;
+            lockRadio();
+            LoRa.onTxDone(nullptr);
+            if (!sent) {
+                LoRa.idle();
+            }
+            resumeListening();
+            unlockRadio();
+            const unsigned long airtime = millis() - this->transmitStart;
+            if (sent && this->dutyCycle->isLimited()) {
+                const String usage = String(100 * this->dutyCycle->usage(millis()), 1);
+                this->logger->logOLED("Sent " + String(this->transmittedLength) + " bytes in " + String(airtime) + " ms, " + usage + "% of duty cycle budget used.");
+            } else if (sent) {
+                this->logger->logOLED("Sent " + String(this->transmittedLength) + " bytes in " + String(airtime) + " ms.");
+            } else {
+                this->logger->logSerial("Transmission timed out after " + String(airtime) + " ms!", true);
+            }
+        }
+
+        /**
+         * @brief Take the oldest packet out of the receive ring, or poll the radio and copy a
+         * received packet out of its FIFO if there is no ring, noting the signal quality it
+         * arrived with.
+         * 
+         * @param frame The buffer to copy into. Must hold WIRE_MAX_FRAME_LENGTH + 1 bytes, as
+         * the packet is NUL-terminated for the legacy text path.
+         * @return size_t The number of bytes received, 0 if nothing was.
+         */
+        size_t readPacket(uint8_t *frame) {
+            size_t frameLength = 0;
+            this->receivedSender = 0;
+            const bool radioBusy = isTransmitting();
+            if (this->ring != nullptr) {
+                const ReceivedFrame *packet = this->ring->peek();
+                if (packet != nullptr) {
+                    frameLength = packet->length;
+                    memcpy(frame, packet->bytes, frameLength);
+                    this->receivedRssi = packet->rssi;
+                    this->receivedSnr = packet->snr;
+                    this->receivedAt = packet->receivedAt;
+                    this->ring->release();
+                }
+            } else if (!radioBusy && LoRa.parsePacket() > 0) {
+                frameLength = LoRa.read(frame, WIRE_MAX_FRAME_LENGTH);
+                this->receivedRssi = LoRa.packetRssi();
+                this->receivedSnr = LoRa.packetSnr();
+                this->receivedAt = millis();
+            }
+            frame[frameLength] = '\0';
+            return frameLength;
+        }
+
+        /**
+         * @brief Transmit a serialized frame as one LoRa packet, returning as soon as the radio
+         * starts sending it. isTransmitting tells when it is sent.
+         * 
+         * @param frame The bytes of the frame.
+         * @param frameLength The number of bytes in the frame.
+         * @return bool Whether the frame is on air, rather than deferred by the duty cycle.
+         */
+        bool transmitFrame(const uint8_t *frame, size_t frameLength) {
+            beginPacket();
+            LoRa.write(frame, frameLength);
+            return endPacket(frameLength);
+        }
+
+        /**
+         * @brief Serialize a binary frame straight into the radio FIFO and send it, without
+         * buffering the frame. Protected bodies follow the key ID and a fresh nonce through a
+         * CipherStream, measured first, or a SigningStream when only signed, so at most one
+         * AES block is held in RAM.
+         * 
+         * @param kind The kind of frame to send.
+         * @param cryptoService The encryption service to seal the frame with, or null to send
+         * it in the clear.
+         * @param writeBody Appends the body of the frame to the FrameWriter it is given, and
+         * returns whether it fit. Called twice for encrypted frames, and must write the same
+         * bytes both times.
+         * @return SendResult Whether the frame was sent. Otherwise the partial packet is left
+         * unsent, and the next beginPacket discards it.
+         */
+        template <typename BodyWriter>
+        SendResult streamFrame(FrameKind kind, Crypto *cryptoService, BodyWriter writeBody) {
+            size_t frameLength;
+            if (cryptoService != nullptr && this->sealing == SIGNED) {
+                uint8_t prefix[1 + CRYPTO_PREFIX_LENGTH];
+                sealedPrefix(prefix, kind, SIGNED, cryptoService->getKeyID(), cryptoService->takeNonce());
+                beginPacket();
+                LoRa.write(prefix, sizeof(prefix));
+                SigningStream signer(*cryptoService, LoRa, prefix, sizeof(prefix));
+                FrameWriter writer(signer, WIRE_MAX_FRAME_LENGTH - 1 - CRYPTO_FRAME_OVERHEAD);
+                if (!writeBody(writer)) {
+                    abortPacket();
+                    return FRAME_TOO_LONG;
+                }
+                frameLength = sizeof(prefix) + signer.finish();
+            } else if (cryptoService != nullptr) {
+                const size_t capacity = WIRE_MAX_FRAME_LENGTH - 1 - CRYPTO_FRAME_OVERHEAD;
+                FrameWriter measured(nullptr, capacity);
+                if (!writeBody(measured)) {
+                    return FRAME_TOO_LONG;
+                }
+                uint8_t prefix[1 + CRYPTO_PREFIX_LENGTH];
+                const uint32_t nonce = cryptoService->takeNonce();
+                sealedPrefix(prefix, kind, AUTHENTICATED, cryptoService->getKeyID(), nonce);
+                beginPacket();
+                LoRa.write(prefix, sizeof(prefix));
+                CipherStream cipher(*cryptoService, LoRa, nonce, prefix, 1 + CRYPTO_KEY_ID_LENGTH, measured.size());
+                FrameWriter writer(cipher, capacity);
+                writeBody(writer);
+                const size_t sealedLength = cipher.finish();
+                if (sealedLength == 0) {
+                    abortPacket();
+                    return FRAME_TOO_LONG;
+                }
+                frameLength = sizeof(prefix) + sealedLength;
+            } else {
+                beginPacket();
+                FrameWriter writer(LoRa, WIRE_MAX_FRAME_LENGTH);
+                writer.putByte(makeFrameHeader(kind));
+                if (!writeBody(writer)) {
+                    abortPacket();
+                    return FRAME_TOO_LONG;
+                }
+                frameLength = writer.size();
+            }
+            return endPacket(frameLength) ? FRAME_SENT : FRAME_DEFERRED;
+        }
+
+        /**
+         * @brief Lay out what a sealed frame carries in the clear ahead of its body: the
+         * header, then the key ID and the nonce, both little endian. The header and key ID are
+         * authenticated along with the body, and the nonce too when the frame is SIGNED.
+         * 
+         * @param prefix The 1 + CRYPTO_PREFIX_LENGTH bytes to fill.
+         * @param kind The kind of frame.
+         * @param protection AUTHENTICATED or SIGNED.
+         * @param keyID The ID of the key sealing the frame.
+         * @param nonce The nonce sealing the frame.
+         */
+        static void sealedPrefix(uint8_t *prefix, FrameKind kind, FrameProtection protection, uint16_t keyID, uint32_t nonce) {
+            prefix[0] = makeFrameHeader(kind, protection);
+            for (uint8_t i = 0; i < CRYPTO_KEY_ID_LENGTH; i++) {
+                prefix[1 + i] = (uint8_t) (keyID >> (8 * i));
+            }
+            for (uint8_t i = 0; i < CRYPTO_NONCE_LENGTH; i++) {
+                prefix[1 + CRYPTO_KEY_ID_LENGTH + i] = (uint8_t) (nonce >> (8 * i));
+            }
+        }
+
+        /**
+         * @brief Seal a binary frame built in a buffer in place, making room for its key ID,
+         * nonce and MIC.
+         * 
+         * @param frame The frame, starting with its unprotected header.
+         * @param frameLength The number of bytes in the frame.
+         * @param capacity The number of bytes the buffer can hold.
+         * @param cryptoService The encryption service to seal the frame with, or null to leave
+         * it in the clear.
+         * @param protection AUTHENTICATED to encrypt the body, or SIGNED to only sign it.
+         * @return size_t The length of the sealed frame, or 0 if it did not fit.
+         */
+        size_t protectFrame(
+            uint8_t *frame,
+            size_t frameLength,
+            size_t capacity,
+            Crypto *cryptoService,
+            FrameProtection protection = AUTHENTICATED
+        ) {
+            if (cryptoService == nullptr || !cryptoService->isReady()) {
+                return frameLength;
+            }
+            if (frameLength == 0 || frameLength + CRYPTO_FRAME_OVERHEAD > capacity) {
+                return 0;
+            }
+            const size_t bodyLength = frameLength - 1;
+            uint8_t *body = frame + 1 + CRYPTO_PREFIX_LENGTH;
+            memmove(body, frame + 1, bodyLength);
+            const uint32_t nonce = cryptoService->takeNonce();
+            sealedPrefix(frame, frameKind(frame[0]), protection, cryptoService->getKeyID(), nonce);
+            if (protection == SIGNED) {
+                cryptoService->sign(frame, 1 + CRYPTO_PREFIX_LENGTH + bodyLength, body + bodyLength);
+            } else {
+                cryptoService->encryptAuthenticated(body, bodyLength, nonce, frame, 1 + CRYPTO_KEY_ID_LENGTH, body + bodyLength);
+            }
+            return frameLength + CRYPTO_FRAME_OVERHEAD;
+        }
+
+        /**
+         * @brief Check a received frame against the protection expected of it, opening it in
+         * place if it is sealed. With a ready encryption service only AUTHENTICATED and SIGNED
+         * frames whose MIC or tag matches are accepted, so corrupted and forged frames are dropped before
+         * they are parsed; without one only unprotected frames and legacy text are. Frames
+         * sealed with a session key must also carry a frame counter not seen before.
+         * 
+         * @param frame The received frame.
+         * @param frameLength The number of bytes in the frame, updated once the key ID, nonce
+         * and MIC are dropped.
+         * @param cryptoService The encryption service holding the network key.
+         * @param sessions The sessions of the nodes that joined, or null to only accept frames
+         * sealed with the network key.
+         * @param senderAddress Set to the short address of the node whose session opened the
+         * frame, if not null and a session did.
+         * @return bool Whether the frame is now readable.
+         */
+        bool unprotectFrame(
+            uint8_t *frame,
+            size_t &frameLength,
+            Crypto *cryptoService,
+            SessionTable *sessions = nullptr,
+            uint16_t *senderAddress = nullptr
+        ) {
+            const bool authenticating = cryptoService != nullptr && cryptoService->isReady();
+            if (frameLength == 0) {
+                return true;
+            }
+            if (!isSealedFrame(frame[0])) {
+                const bool clear = !isBinaryFrame(frame[0]) || frameProtection(frame[0]) == UNPROTECTED;
+                if (authenticating || !clear) {
+                    this->logger->logSerial("Rejected frame without a valid protection!", true);
+                    return false;
+                }
+                return true;
+            }
+            SealedMessage message;
+            NodeSession *session = nullptr;
+            Crypto *cipher = nullptr;
+            if (authenticating && sealedMessage(frame, frameLength, message)) {
+                cipher = openingCipher(frameKeyID(frame), message.nonce, cryptoService, sessions, session);
+            }
+            if (cipher == nullptr) {
+                this->logger->logSerial("Cannot open frame!", true);
+                return false;
+            }
+            const bool opened = session != nullptr && session->pending
+                ? openPendingMessage(sessions, *session, frame, message)
+                : openMessage(cipher, frame, message);
+            if (!opened) {
+                if (session != nullptr) {
+                    SessionTable::markFailed(*session);
+                }
+                this->logger->logSerial("MIC check failed, frame dropped!", true);
+                return false;
+            }
+            if (session != nullptr) {
+                SessionTable::markSeen(*session, message.nonce);
+                if (senderAddress != nullptr) {
+                    *senderAddress = session->nodeAddress;
+                }
+            }
+            frameLength = openedLength(frame, message);
+            frame[frameLength] = '\0';
+            return true;
+        }
+
+        /**
+         * @brief Check whether a frame header is that of a binary frame sealed with a key,
+         * AUTHENTICATED or SIGNED.
+         * 
+         */
+        static bool isSealedFrame(uint8_t header) {
+            return isBinaryFrame(header) && (frameProtection(header) == AUTHENTICATED || frameProtection(header) == SIGNED);
+        }
+
+        /**
+         * @brief Open a sealed frame on its own: decrypt an AUTHENTICATED body in place if its
+         * MIC matches, or check the tag of a SIGNED one over the whole frame.
+         * 
+         * @param cipher The cipher holding the key the frame was sealed with.
+         * @param frame The sealed frame.
+         * @param message The message found in the frame with sealedMessage.
+         * @return bool Whether the MIC or tag matched.
+         */
+        static bool openMessage(Crypto *cipher, const uint8_t *frame, const SealedMessage &message) {
+            if (frameProtection(frame[0]) == SIGNED) {
+                return cipher->verifySignature(frame, message.mic - frame, message.mic);
+            }
+            return cipher->decryptAuthenticated(
+                message.data,
+                message.length,
+                message.nonce,
+                message.associated,
+                message.associatedLength,
+                message.mic
+            );
+        }
+
+        /**
+         * @brief Open a sealed frame of a node that was sent a new session key but has not
+         * used it yet: with the new key, which then takes over, or failing that with the key
+         * it had, if the frame counter is fresh under it.
+         * 
+         * @param sessions The sessions of the nodes that joined.
+         * @param session The session of the node, with a pending key.
+         * @param frame The sealed frame.
+         * @param message The message found in the frame with sealedMessage.
+         * @return bool Whether the frame opened with either key.
+         */
+        static bool openPendingMessage(
+            SessionTable *sessions,
+            NodeSession &session,
+            const uint8_t *frame,
+            const SealedMessage &message
+        ) {
+            // A failed MIC check clears the body, so it is kept for the second key.
+            uint8_t sealedBody[WIRE_MAX_FRAME_LENGTH];
+            memcpy(sealedBody, message.data, message.length);
+            if (openMessage(sessions->pendingCipherFor(session), frame, message)) {
+                SessionTable::promote(session);
+                return true;
+            }
+            memcpy(message.data, sealedBody, message.length);
+            return SessionTable::isFresh(session, message.nonce) && openMessage(sessions->cipherFor(session), frame, message);
+        }
+
+        /**
+         * @brief Get the ID of the key a sealed frame was sealed with.
+         * 
+         * @param frame The sealed frame, at least 1 + CRYPTO_KEY_ID_LENGTH bytes long.
+         */
+        static uint16_t frameKeyID(const uint8_t *frame) {
+            uint16_t keyID = 0;
+            for (uint8_t i = 0; i < CRYPTO_KEY_ID_LENGTH; i++) {
+                keyID |= (uint16_t) frame[1 + i] << (8 * i);
+            }
+            return keyID;
+        }
+
+        /**
+         * @brief Pick the cipher to open a sealed frame with from its key ID: the network key
+         * for 0, otherwise the session key of that node, as long as the frame counter is fresh.
+         * A node with a pending key may have started counting again under it, so its frames
+         * are checked once openPendingMessage finds the key that opens them.
+         * 
+         * @param keyID The key ID the frame carries.
+         * @param counter The nonce the frame carries, its frame counter under a session key.
+         * @param cryptoService The encryption service holding the network key.
+         * @param sessions The sessions of the nodes that joined, or null if there are none.
+         * @param session Set to the session the frame belongs to, to be marked seen once the
+         * frame is authenticated; null for the network key.
+         * @return Crypto* The cipher, or null if the frame must be dropped.
+         */
+        Crypto *openingCipher(
+            uint16_t keyID,
+            uint32_t counter,
+            Crypto *cryptoService,
+            SessionTable *sessions,
+            NodeSession *&session
+        ) {
+            session = nullptr;
+            if (keyID == 0) {
+                return cryptoService;
+            }
+            session = sessions != nullptr ? sessions->find(keyID) : nullptr;
+            if (session == nullptr) {
+                this->logger->logSerial("No session for node " + String(keyID) + ", frame dropped!", true);
+                return nullptr;
+            }
+            if (!session->pending && !SessionTable::isFresh(*session, counter)) {
+                this->logger->logSerial("Replayed frame from node " + String(keyID) + " dropped!", true);
+                return nullptr;
+            }
+            return sessions->cipherFor(*session);
+        }
+
+        /**
+         * @brief Find the nonce, body, MIC and associated header and key ID of an
+         * AUTHENTICATED or SIGNED frame.
+         * 
+         * @param frame The sealed frame.
+         * @param frameLength The number of bytes in the frame.
+         * @param message The message to point into the frame.
+         * @return bool Whether the frame is long enough to be sealed.
+         */
+        static bool sealedMessage(uint8_t *frame, size_t frameLength, SealedMessage &message) {
+            if (frameLength < 1 + CRYPTO_FRAME_OVERHEAD) {
+                return false;
+            }
+            message.nonce = 0;
+            for (uint8_t i = 0; i < CRYPTO_NONCE_LENGTH; i++) {
+                message.nonce |= (uint32_t) frame[1 + CRYPTO_KEY_ID_LENGTH + i] << (8 * i);
+            }
+            message.length = frameLength - 1 - CRYPTO_FRAME_OVERHEAD;
+            message.data = frame + 1 + CRYPTO_PREFIX_LENGTH;
+            message.mic = message.data + message.length;
+            message.associated = frame;
+            message.associatedLength = 1 + CRYPTO_KEY_ID_LENGTH;
+            message.authentic = false;
+            return true;
+        }
+
+        /**
+         * @brief Turn an opened frame back into an unprotected one, dropping its key ID, nonce
+         * and MIC.
+         * 
+         * @param frame The frame, its body already decrypted.
+         * @param message The message the body was opened as.
+         * @return size_t The number of bytes in the unprotected frame.
+         */
+        static size_t openedLength(uint8_t *frame, const SealedMessage &message) {
+            memmove(frame + 1, message.data, message.length);
+            frame[0] = makeFrameHeader(frameKind(frame[0]));
+            return 1 + message.length;
+        }
+
     public:
         /**
          * @brief Construct a new LoRa Interface object.
          * 
          * @param loraBand The frequency band to be used for LoRA Communication.
          * @param verbose Whether or not to print verbose logs.
+         * @param wireFormat The format to serialize outgoing messages into. Incoming messages
+         * are accepted in every format.
          */
-        LoraInterface(LoraBand loraBand = LoraBand::ASIA, bool verbose = false) {
+        LoraInterface(
+            LoraBand loraBand = LoraBand::ASIA,
+            bool verbose = false,
+            WireFormat wireFormat = WireFormat::LEGACY_TEXT
+        ) {
             this->logger = new Logger(verbose, "LoraInterface");
+            this->wireFormat = wireFormat;
+            this->batch = nullptr;
+            this->batchLatency = 0;
+            this->batchProtected = false;
+            this->sealing = AUTHENTICATED;
+            this->receivedLength = 0;
+            this->receivedRssi = 0;
+            this->receivedSnr = 0;
+            this->receivedAt = 0;
+            this->receivedSender = 0;
+            this->ring = nullptr;
+            this->reportedDrops = 0;
+            this->transmitting = false;
+            this->transmittedLength = 0;
+            this->transmitStart = 0;
+            this->linkAdaptive = false;
+            this->spreadingFactor = ADR_DEFAULT_SPREADING_FACTOR;
+            this->txPower = LORA_TX_POWER;
+            this->unansweredFrames = 0;
+            this->linkSwitchPending = false;
+            this->pendingSpreadingFactor = ADR_DEFAULT_SPREADING_FACTOR;
+            this->linkSwitchAt = 0;
+            this->droppedReadings = 0;
+            this->joinRequest = {};
+            this->joinFrameLength = 0;
+            this->joining = false;
+            this->joinAttemptsLeft = 0;
+            this->joinSentAt = 0;
+            this->downlinkOpened = false;
+            this->downlinkNonce = 0;
 
             // Set frequency band
             switch (loraBand) {
@@ -55,10 +901,13 @@ class LoraInterface {
                     this->band = 915E6;
                     break;
             }
+            this->dutyCycle = new DutyCycleBudget(DutyCycleBudget::dutyCycleDivisorOf(this->band), millis());
 
             // Initialize LoRa
             LoRa.begin(this->band, true);
-	        LoRa.setTxPower(14, RF_PACONFIG_PASELECT_PABOOST);
+            LoRa.enableRegisterCache();
+            LoRa.onDio0(onInterrupt);
+	        LoRa.setTxPower(LORA_TX_POWER, RF_PACONFIG_PASELECT_PABOOST);
         }
 
         /**
@@ -68,59 +917,891 @@ class LoraInterface {
          * @param cryptoService The encryption service to use. Will encrypt the message if
          * not set to null.
          */
-        void sendLoraMessage(LoraDTO loraDTO, Crypto *cryptoService = nullptr) {
+        void sendLoraMessage(const LoraDTO &loraDTO, Crypto *cryptoService = nullptr) {
             this->logger->logSerial("Sending LoRa Message", true);
-            // Serialize the data list
-            String serializedData = loraDTO.toString();
-
-            // Encrypt if crypto service ready
-            if (cryptoService != nullptr && cryptoService->isReady()) {
-                serializedData = cryptoService->encrypt(serializedData);
+            const bool encrypt = cryptoService != nullptr && cryptoService->isReady();
+            // Encrypted messages always go out as binary frames, which are binary safe.
+            if (this->wireFormat == WireFormat::BINARY_TLV || encrypt) {
+                const SendResult result = streamFrame(
+                    RECORD_FRAME,
+                    encrypt ? cryptoService : nullptr,
+                    [&](FrameWriter &writer) { return loraDTO.writeFields(writer); }
+                );
+                if (result != FRAME_TOO_LONG) {
+                    return;
+                }
+                if (encrypt) {
+                    this->logger->logSerial("Binary frame too long to encrypt, not sent.", true);
+                    return;
+                }
+                this->logger->logSerial("Binary frame too long, sending text instead.", true);
             } else {
                 this->logger->logSerial("Crypto Service not initialized!", true);
             }
 
+            // Serialize the data list
+            String serializedData = loraDTO.toString();
+
             //Send LoRa packet to receiver
-            LoRa.beginPacket();
+            beginPacket();
             LoRa.print(serializedData);
-            LoRa.endPacket();
-            this->logger->logOLED("Sent " + String(serializedData.length()) + " bytes" + String(serializedData));
-            delay(1000);
-            this->logger->logOLED("Sent 0 bytes.");
+            endPacket(serializedData.length());
+        }
+
+        /**
+         * @brief Choose how readings are sealed when there is a key. Join messages are always
+         * AUTHENTICATED.
+         * 
+         * @param protection AUTHENTICATED to encrypt and authenticate readings, or SIGNED to
+         * only sign them, for data that may be public but must not be tampered with.
+         */
+        void setSealing(FrameProtection protection) {
+            this->sealing = protection == SIGNED ? SIGNED : AUTHENTICATED;
+        }
+
+        /**
+         * @brief Receive packets by interrupt from now on, in continuous receive mode. The
+         * DIO0 interrupt wakes a task that outranks the loop, which copies each packet out
+         * of the FIFO into a PacketRing as soon as it arrives, and receivePacket drains the
+         * ring instead of polling. The loop takes the radio from the task around its own SPI
+         * transfers. Only one interface can listen at a time.
+         * 
+         */
+        void listen() {
+            if (this->ring == nullptr) {
+                this->ring = new PacketRing();
+            }
+            listener = this;
+            if (radioTask == nullptr) {
+                radioLock = xSemaphoreCreateRecursiveMutex();
+                xTaskCreatePinnedToCore(
+                    handleRadioTask,
+                    "lora-radio",
+                    LORA_RADIO_TASK_STACK,
+                    nullptr,
+                    LORA_RADIO_TASK_PRIORITY,
+                    &radioTask,
+                    ARDUINO_RUNNING_CORE
+                );
+                // Handle an interrupt flagged before the task was there to be woken
+                xTaskNotifyGive(radioTask);
+            }
+            resumeListening();
+        }
+
+        /**
+         * @brief Handle the interrupt the radio flagged since the last call, from the loop,
+         * until listen() hands DIO0 over to the radio task: finish the transmission it
+         * flagged sent. Cheap when nothing was flagged, and a no-op once the task runs.
+         * 
+         */
+        void handleRadio() {
+            if (radioTask == nullptr) {
+                LoRa.handleDio0();
+            }
+        }
+
+        /**
+         * @brief Check whether a frame is still in the air, finishing its transmission if the
+         * TX done interrupt flagged it sent, or it timed out. Sending returns as soon as the
+         * radio starts transmitting, so callers can keep working meanwhile.
+         * 
+         * @return bool Whether the radio is still transmitting.
+         */
+        bool isTransmitting() {
+            if (!this->transmitting) {
+                return false;
+            }
+            handleRadio();
+            if (transmitDone.load(std::memory_order_acquire)) {
+                finishTransmit(true);
+            } else if (millis() - this->transmitStart > LORA_TRANSMIT_TIMEOUT) {
+                finishTransmit(false);
+            }
+            return this->transmitting;
+        }
+
+        /**
+         * @brief Wait until the frame in the air, if any, is sent or times out. Sending the
+         * next frame waits for it anyway, as the radio holds one frame at a time.
+         * 
+         */
+        void awaitTransmit() {
+            while (isTransmitting()) {
+                delay(1);
+            }
         }
 
         /**
-         * @brief Receive the LoRa Message.
+         * @brief Get the number of packets received by interrupt that were not read yet.
+         * Always 0 while the radio is polled instead.
          * 
-         * @param cryptoService The encryption service to use. Will try to decrypt the message if 
+         */
+        size_t pendingPackets() {
+            if (this->ring == nullptr) {
+                return 0;
+            }
+            return this->ring->size();
+        }
+
+        /**
+         * @brief Set the spreading factor and TX power the radio sends and listens with, once
+         * the frame in the air, if any, is sent.
+         * 
+         * @param spreadingFactor The spreading factor, from 7 to 12.
+         * @param txPower The TX power, in dBm.
+         */
+        void setLinkSettings(uint8_t spreadingFactor, int8_t txPower) {
+            awaitTransmit();
+            lockRadio();
+            LoRa.idle();
+            LoRa.setSpreadingFactor(spreadingFactor);
+            LoRa.setTxPower(txPower, RF_PACONFIG_PASELECT_PABOOST);
+            this->spreadingFactor = spreadingFactor;
+            this->txPower = txPower;
+            resumeListening();
+            unlockRadio();
+            this->logger->logSerial("Link set to SF" + String(spreadingFactor) + " at " + String(txPower) + " dBm", true);
+        }
+
+        /**
+         * @brief Follow the LINK_ADR commands of the gateway from now on, see
+         * applyLinkCommand, and fall back to full power and a scan of the spreading factors
+         * when LORA_LINK_CHECK_LIMIT frames in a row go unanswered. Joining scans too.
+         * 
+         */
+        void enableLinkAdaptation() {
+            this->linkAdaptive = true;
+            this->unansweredFrames = 0;
+        }
+
+        /**
+         * @brief Switch to a commanded spreading factor once due, if the radio is not
+         * sending. Called regularly while the link adapts.
+         * 
+         */
+        void updateLink() {
+            if (linkSwitchDue() && !isTransmitting()) {
+                this->linkSwitchPending = false;
+                setLinkSettings(this->pendingSpreadingFactor, this->txPower);
+            }
+        }
+
+        /**
+         * @brief Check whether the duty cycle of the sub-band leaves airtime to send a frame
+         * now, at the current settings.
+         * 
+         * @param frameLength The number of bytes in the frame.
+         */
+        bool canTransmit(size_t frameLength) {
+            return this->dutyCycle->allows(airtimeOf(frameLength), millis());
+        }
+
+        /**
+         * @brief Get the short address of the node whose session key opened the last packet,
+         * 0 if it was sealed with the network key or sent in the clear. Only such a node can
+         * have sent it, whatever address the packet itself carries.
+         * 
+         */
+        uint16_t getSenderAddress() {
+            return this->receivedSender;
+        }
+
+        /**
+         * @brief Get the airtime budget of the sub-band, whose usage, airtime spent and
+         * deferred frames are the duty cycle metrics.
+         * 
+         */
+        DutyCycleBudget *getDutyCycleBudget() {
+            return this->dutyCycle;
+        }
+
+        /**
+         * @brief Get the number of readings dropped because the duty cycle left no airtime to
+         * send them with.
+         * 
+         */
+        uint32_t getDroppedReadings() {
+            return this->droppedReadings;
+        }
+
+        /**
+         * @brief Send a reading, serialized straight from its compile-time schema into the
+         * radio without going through String or float formatting.
+         * 
+         * A reading the duty cycle leaves no airtime for is dropped, and counted, as the next
+         * one carries fresher values.
+         * 
+         * @param reading The reading to send.
+         * @param cryptoService The encryption service to use. Will encrypt the message if
          * not set to null.
+         */
+        void sendReading(const MeterReading &reading, Crypto *cryptoService = nullptr) {
+            this->logger->logSerial("Sending LoRa Reading", true);
+            const bool encrypt = cryptoService != nullptr && cryptoService->isReady();
+            SendResult result = FRAME_TOO_LONG;
+            if (this->wireFormat == WireFormat::BINARY_TLV || encrypt) {
+                result = streamFrame(
+                    RECORD_FRAME,
+                    encrypt ? cryptoService : nullptr,
+                    [&](FrameWriter &writer) { return MeterReadingSchema::writeFields(reading, writer) && writer.ok(); }
+                );
+                if (result == FRAME_TOO_LONG && encrypt) {
+                    this->logger->logSerial("Binary frame too long to encrypt, not sent.", true);
+                    return;
+                }
+            }
+            if (result == FRAME_TOO_LONG) {
+                char text[WIRE_MAX_FRAME_LENGTH + 1];
+                const size_t textLength = MeterReadingSchema::toText(reading, text, sizeof(text));
+                result = transmitFrame((const uint8_t *) text, textLength) ? FRAME_SENT : FRAME_DEFERRED;
+            }
+            if (result == FRAME_DEFERRED) {
+                this->droppedReadings++;
+            }
+        }
+
+        /**
+         * @brief Send queued readings together in BATCH_FRAMEs instead of one packet each.
+         * Only binary readings are batched, and encrypted ones only if the batch was sized for
+         * protected frames.
+         * 
+         * @param maxReadings The most readings to send in one frame.
+         * @param maxLatency The longest a reading may wait before it is sent, in milliseconds.
+         * @param deltaEncoding Whether to send each reading as its change from the previous
+         * one, in DELTA_FRAMEs.
+         * @param protectedFrames Whether batches will be sealed, and must leave room for the
+         * nonce and MIC.
+         */
+        void enableBatching(
+            size_t maxReadings = BATCH_MAX_READINGS,
+            unsigned long maxLatency = 60000,
+            bool deltaEncoding = true,
+            bool protectedFrames = false
+        ) {
+            delete this->batch;
+            this->batch = new ReadingBatch(
+                maxReadings,
+                deltaEncoding,
+                protectedFrames ? WIRE_MAX_FRAME_LENGTH - CRYPTO_FRAME_OVERHEAD : WIRE_MAX_FRAME_LENGTH
+            );
+            this->batchLatency = maxLatency;
+            this->batchProtected = protectedFrames;
+        }
+
+        /**
+         * @brief Queue a reading to be sent. Without batching, or when it cannot be batched,
+         * the reading is sent straight away; otherwise the batch is sent once it is full or its
+         * oldest reading reaches the latency deadline. While the duty cycle leaves no airtime
+         * for the batch, it keeps coalescing readings beyond its size, until one frame holds no
+         * more, and the readings that do not fit are dropped.
+         * 
+         * @param reading The reading to send. Its timestamp must be set.
+         * @param cryptoService The encryption service to use. Will encrypt the message if
+         * not set to null.
+         */
+        void queueReading(const MeterReading &reading, Crypto *cryptoService = nullptr) {
+            const bool encrypt = cryptoService != nullptr && cryptoService->isReady();
+            if (this->batch == nullptr || this->wireFormat != WireFormat::BINARY_TLV || encrypt != this->batchProtected) {
+                sendReading(reading, cryptoService);
+                return;
+            }
+            if (!this->batch->add(reading)) {
+                const bool added = flushBatch(cryptoService) ? this->batch->add(reading) : this->batch->add(reading, true);
+                if (!added) {
+                    this->droppedReadings++;
+                    this->logger->logSerial("Duty cycle spent and batch full, reading dropped.", true);
+                    return;
+                }
+            }
+            const unsigned long now = millis();
+            if (this->batch->isFull() || now - this->batch->oldestTimestamp() >= this->batchLatency) {
+                flushBatch(cryptoService);
+            }
+        }
+
+        /**
+         * @brief Send the queued readings now, if there are any and the duty cycle leaves
+         * airtime for them. Otherwise they stay queued.
+         * 
+         * @param cryptoService The encryption service to seal a protected batch with.
+         * @return bool Whether the batch is empty now.
+         */
+        bool flushBatch(Crypto *cryptoService = nullptr) {
+            if (this->batch == nullptr || this->batch->size() == 0) {
+                return true;
+            }
+            const size_t overhead = this->batchProtected && cryptoService != nullptr ? CRYPTO_FRAME_OVERHEAD : 0;
+            if (!canTransmit(this->batch->maxEncodedLength() + overhead)) {
+                return false;
+            }
+            const uint32_t now = millis();
+            this->logger->logSerial("Sending LoRa Batch", true);
+            const SendResult result = streamFrame(this->batch->kind(), this->batchProtected ? cryptoService : nullptr, [&](FrameWriter &writer) {
+                return this->batch->writeBody(writer, now);
+            });
+            if (result == FRAME_DEFERRED) {
+                return false;
+            }
+            this->batch->clear();
+            return true;
+        }
+
+        /**
+         * @brief Ask the gateway for a short address, and return at once. isJoining sends the
+         * request again on the next spreading factor while it goes unanswered, and
+         * acceptJoin picks out the answer among received packets. If the gateway starts a
+         * session, its key is derived from the network key and installed then.
+         * 
+         * @param deviceID The NUL-terminated Device ID of this node.
+         * @param cryptoService The encryption service holding the network key, to seal the
+         * request with, or null to join in the clear.
+         */
+        void startJoin(const char *deviceID, Crypto *cryptoService = nullptr) {
+            this->joinRequest = {};
+            strncpy(this->joinRequest.deviceID, deviceID, MAX_DEVICE_ID_LENGTH);
+            // The gateway takes a node nonce of 0 for one it never saw.
+            do {
+                this->joinRequest.nodeNonce = esp_random();
+            } while (this->joinRequest.nodeNonce == 0);
+            this->joinFrameLength = encodeJoinMessage(JOIN_REQUEST, this->joinRequest, this->joinFrame, sizeof(this->joinFrame));
+            this->joinFrameLength = protectFrame(this->joinFrame, this->joinFrameLength, WIRE_MAX_FRAME_LENGTH, cryptoService);
+            // A node adapting its link joins at full power, trying every spreading factor in
+            // turn until the gateway answers, as the network may have left the default one.
+            this->joinAttemptsLeft = this->linkAdaptive ? ADR_MAX_SPREADING_FACTOR - ADR_MIN_SPREADING_FACTOR + 1 : 1;
+            if (this->linkAdaptive) {
+                this->linkSwitchPending = false;
+                setLinkSettings(this->spreadingFactor, LORA_TX_POWER);
+                this->unansweredFrames = 0;
+            }
+            this->joining = true;
+            sendJoinRequest();
+        }
+
+        /**
+         * @brief Check whether a join request still waits for the gateway to answer. Once one
+         * went JOIN_ACCEPT_TIMEOUT without an answer after it was sent, it is sent again on
+         * the next spreading factor, until every one was tried.
+         * 
+         * @return bool Whether the node is still joining.
+         */
+        bool isJoining() {
+            if (!this->joining) {
+                return false;
+            }
+            if (isTransmitting()) {
+                this->joinSentAt = millis();
+                return true;
+            }
+            if (millis() - this->joinSentAt < JOIN_ACCEPT_TIMEOUT) {
+                return true;
+            }
+            if (this->joinAttemptsLeft == 0) {
+                this->logger->logSerial("No Join Accept received!", true);
+                this->joining = false;
+                return false;
+            }
+            setLinkSettings(nextSpreadingFactor(), LORA_TX_POWER);
+            sendJoinRequest();
+            return true;
+        }
+
+        /**
+         * @brief Check whether the last packet received, already unprotected, is the
+         * JOIN_ACCEPT answering the pending join request, and if so end the join.
+         * 
+         * @param cryptoService The encryption service holding the network key, to derive the
+         * session key with, or null if the node joined in the clear.
+         * @param sessionCrypto The encryption service to start the session of the node on, or
+         * null to keep using the network key.
+         * @return uint16_t The short address assigned to the node, 0 if the packet was not
+         * the answer.
+         */
+        uint16_t acceptJoin(Crypto *cryptoService = nullptr, Crypto *sessionCrypto = nullptr) {
+            JoinMessage accept;
+            if (
+                !this->joining
+                || !decodeJoinMessage(this->receivedFrame, this->receivedLength, JOIN_ACCEPT, accept)
+                || strcmp(accept.deviceID, this->joinRequest.deviceID) != 0
+                || accept.nodeNonce != this->joinRequest.nodeNonce
+            ) {
+                return 0;
+            }
+            this->logger->logSerial("Joined as " + String(accept.nodeAddress), true);
+            this->joining = false;
+            this->unansweredFrames = 0;
+            const bool authenticating = cryptoService != nullptr && cryptoService->isReady();
+            if (authenticating && sessionCrypto != nullptr && accept.gatewayNonce != 0) {
+                uint8_t sessionKey[AES_KEYLEN];
+                cryptoService->deriveSessionKey(accept.nodeAddress, accept.nodeNonce, accept.gatewayNonce, sessionKey);
+                sessionCrypto->startSession(sessionKey, accept.nodeAddress);
+                memset(sessionKey, 0, sizeof(sessionKey));
+            }
+            this->downlinkOpened = false;
+            this->downlinkNonce = 0;
+            return accept.nodeAddress;
+        }
+
+        /**
+         * @brief Answer a join request with the short address assigned to the node.
+         * 
+         * @param accept The Device ID and short address of the node.
+         * @param cryptoService The encryption service to seal the accept with, or null to
+         * send it in the clear.
+         * @return bool Whether the accept is on air, rather than deferred by the duty cycle,
+         * in which case the node asks again.
+         */
+        bool sendJoinAccept(const JoinMessage &accept, Crypto *cryptoService = nullptr) {
+            uint8_t frame[WIRE_MAX_FRAME_LENGTH];
+            size_t frameLength = encodeJoinMessage(JOIN_ACCEPT, accept, frame, sizeof(frame));
+            frameLength = protectFrame(frame, frameLength, sizeof(frame), cryptoService);
+            this->logger->logSerial("Sending Join Accept", true);
+            return transmitFrame(frame, frameLength);
+        }
+
+        /**
+         * @brief Ask a node to join again, as its frames are sealed under a session this
+         * gateway does not hold.
+         * 
+         * @param request The Device ID and short address of the node.
+         * @param cryptoService The encryption service holding the network key, to seal the
+         * request with.
+         * @return bool Whether the request is on air, rather than deferred by the duty cycle.
+         */
+        bool sendRejoin(const JoinMessage &request, Crypto *cryptoService) {
+            uint8_t frame[WIRE_MAX_FRAME_LENGTH];
+            size_t frameLength = encodeJoinMessage(REJOIN, request, frame, sizeof(frame));
+            frameLength = protectFrame(frame, frameLength, sizeof(frame), cryptoService);
+            this->logger->logSerial("Sending Rejoin to " + String(request.nodeAddress), true);
+            return transmitFrame(frame, frameLength);
+        }
+
+        /**
+         * @brief Tell a node the spreading factor and TX power to send with. With sessions,
+         * the command is sealed with the session key of the node under the next nonce of its
+         * downlinks, so that neither other nodes nor a replay of it can move the node.
+         * 
+         * @param command The settings and the short address of the node.
+         * @param cryptoService The encryption service to seal the command with when there are
+         * no sessions, or null to send it in the clear.
+         * @param sessions The sessions of the nodes that joined, or null if there are none.
+         * @return bool Whether the command is on air, rather than deferred by the duty cycle
+         * or left unsent as the node has no session.
+         */
+        bool sendLinkCommand(const LinkCommand &command, Crypto *cryptoService = nullptr, SessionTable *sessions = nullptr) {
+            Crypto *cipher = cryptoService;
+            if (sessions != nullptr) {
+                NodeSession *session = sessions->find(command.nodeAddress);
+                if (session == nullptr) {
+                    this->logger->logSerial("No session for node " + String(command.nodeAddress) + ", command dropped!", true);
+                    return false;
+                }
+                cipher = sessions->downlinkCipherFor(*session);
+            }
+            uint8_t frame[WIRE_MAX_FRAME_LENGTH];
+            size_t frameLength = encodeLinkCommand(command, frame, sizeof(frame));
+            frameLength = protectFrame(frame, frameLength, sizeof(frame), cipher);
+            this->logger->logSerial("Sending SF" + String(command.spreadingFactor) + " at " + String(command.txPower) + " dBm to " + String(command.nodeAddress), true);
+            return transmitFrame(frame, frameLength);
+        }
+
+        /**
+         * @brief Receive the LoRa Message. Binary frames are told apart from legacy text by the
+         * marker bit of their first byte, so nodes of either format can share a gateway.
+         * 
+         * @param cryptoService The encryption service to use. If set and ready, only frames
+         * sealed with it are accepted.
          * @return LoraDTO The received LoRa data.
          */
         LoraDTO receiveLoraMessage(Crypto *cryptoService = nullptr) {
             // Receive message
-            int parsed = LoRa.parsePacket();
-            this->logger->logSerial(String(parsed), true);
-            String message = LoRa.available() ? LoRa.readString() : "";
-
-            // Logging
-            if (message.length() > 0) {
-                // Decrypt if crypto service ready
-                if (cryptoService != nullptr && cryptoService->isReady()) {
-                    message = cryptoService->decrypt(message);
-                } else {
-                    this->logger->logSerial("Crypto Service not initialized!", true);
+            uint8_t frame[WIRE_MAX_FRAME_LENGTH + 1];
+            size_t frameLength = readPacket(frame);
+            if (frameLength == 0) {
+                this->logger->logSerial("Nothing received!", true);
+                return LoraDTO();
+            }
+            if (!unprotectFrame(frame, frameLength, cryptoService)) {
+                return LoraDTO();
+            }
+            if (isBinaryFrame(frame[0])) {
+                this->logger->logSerial("Received binary frame", true);
+                this->logger->logOLED("Received " + String(frameLength) + " byte binary frame.");
+                return LoraDTO::fromBinary(frame, frameLength);
+            }
+
+            // Legacy text is never encrypted, so it only gets here without a key
+            if (this->logger->isVerbose()) {
+                this->logger->logSerial("Received LoRa Message: " + String((char *) frame), true);
+            }
+            this->logger->logOLED("Received " + String(frameLength) + " bytes: " + String((char *) frame));
+            // Deserialize received message straight from the frame
+            return LoraDTO::fromText((char *) frame, frameLength);
+        }
+
+        /**
+         * @brief Receive the LoRa Message as views into an internal buffer, without allocating.
+         * The views stay valid until the next call.
+         * 
+         * @param slots The caller-owned array the received fields are stored in.
+         * @param capacity The number of slots available. Fields beyond it are dropped.
+         * @param cryptoService The encryption service to use. If set and ready, only frames
+         * sealed with it are accepted.
+         * @return size_t The number of fields received.
+         */
+        size_t receiveLoraFields(FieldView *slots, size_t capacity, Crypto *cryptoService = nullptr) {
+            if (receivePacket() == 0 || !unprotectPacket(cryptoService)) {
+                return 0;
+            }
+            return parseFields(slots, capacity);
+        }
+
+        /**
+         * @brief Take the next packet received, from the receive ring or by polling the radio,
+         * and keep it for parseFields or parseBatch.
+         * 
+         * @return size_t The number of bytes received, 0 if nothing was.
+         */
+        size_t receivePacket() {
+            this->receivedLength = readPacket(this->receivedFrame);
+            if (this->ring != nullptr && this->ring->dropped() != this->reportedDrops) {
+                this->reportedDrops = this->ring->dropped();
+                this->logger->logSerial("Receive ring full, " + String(this->reportedDrops) + " packets dropped so far!", true);
+            }
+            if (this->receivedLength == 0) {
+                this->logger->logSerial("Nothing received!", true);
+            }
+            return this->receivedLength;
+        }
+
+        /**
+         * @brief Check the last packet received against the protection expected of it, and
+         * open it in place if it is sealed, before it is parsed.
+         * 
+         * @param cryptoService The encryption service holding the network key. If set and
+         * ready, only sealed frames with a valid MIC are readable.
+         * @param sessions The sessions of the nodes that joined, or null to only open frames
+         * sealed with the network key.
+         * @return bool Whether the packet is readable.
+         */
+        bool unprotectPacket(Crypto *cryptoService, SessionTable *sessions = nullptr) {
+            return unprotectFrame(this->receivedFrame, this->receivedLength, cryptoService, sessions, &this->receivedSender);
+        }
+
+        /**
+         * @brief Check the last packet received by a node, and open it in place if it is
+         * sealed: with the network key under key ID 0, or with the session key of the node
+         * under its own address, as long as the nonce is a downlink one above that of the
+         * last downlink opened. Frames sealed for other nodes are skipped quietly. Once opened
+         * with the session key, the node is noted as the sender.
+         * 
+         * @param cryptoService The encryption service holding the network key.
+         * @param sessionCrypto The encryption service holding the session key of the node,
+         * not ready until it joined.
+         * @return bool Whether the packet is readable.
+         */
+        bool unprotectDownlink(Crypto *cryptoService, Crypto *sessionCrypto) {
+            this->receivedSender = 0;
+            const uint16_t keyID = packetKeyID();
+            if (keyID == 0) {
+                return unprotectPacket(cryptoService);
+            }
+            SealedMessage message;
+            if (
+                sessionCrypto == nullptr
+                || !sessionCrypto->isReady()
+                || keyID != sessionCrypto->getKeyID()
+                || !sealedMessage(this->receivedFrame, this->receivedLength, message)
+            ) {
+                return false;
+            }
+            if ((message.nonce & SESSION_DOWNLINK_NONCE) == 0 || (this->downlinkOpened && message.nonce <= this->downlinkNonce)) {
+                this->logger->logSerial("Replayed downlink dropped!", true);
+                return false;
+            }
+            if (!openMessage(sessionCrypto, this->receivedFrame, message)) {
+                this->logger->logSerial("MIC check failed, frame dropped!", true);
+                return false;
+            }
+            this->downlinkOpened = true;
+            this->downlinkNonce = message.nonce;
+            this->receivedSender = keyID;
+            this->receivedLength = openedLength(this->receivedFrame, message);
+            this->receivedFrame[this->receivedLength] = '\0';
+            return true;
+        }
+
+        /**
+         * @brief Check whether the last packet received is a BATCH_FRAME or DELTA_FRAME, to be
+         * read with parseBatch rather than parseFields.
+         * 
+         */
+        bool isBatchPacket() {
+            return this->receivedLength > 0
+                && isBinaryFrame(this->receivedFrame[0])
+                && (
+                    frameKind(this->receivedFrame[0]) == BATCH_FRAME
+                    || frameKind(this->receivedFrame[0]) == DELTA_FRAME
+                );
+        }
+
+        /**
+         * @brief Check whether the last packet received is a binary frame of readings, to be
+         * queued for ReadingColumns rather than read with parseFields.
+         * 
+         */
+        bool isReadingPacket() {
+            return this->receivedLength > 0
+                && isBinaryFrame(this->receivedFrame[0])
+                && frameKind(this->receivedFrame[0]) != CONTROL_FRAME;
+        }
+
+        /**
+         * @brief Check whether the last packet received is an AUTHENTICATED or SIGNED binary
+         * frame, still to be opened.
+         * 
+         */
+        bool isSealedPacket() {
+            return this->receivedLength > 0 && isSealedFrame(this->receivedFrame[0]);
+        }
+
+        /**
+         * @brief Get the key ID the last packet received is sealed under: the short address
+         * of the node whose session key sealed it, or 0 for the network key or a packet that
+         * is not sealed.
+         * 
+         */
+        uint16_t packetKeyID() {
+            return isSealedPacket() && this->receivedLength > CRYPTO_KEY_ID_LENGTH ? frameKeyID(this->receivedFrame) : 0;
+        }
+
+        /**
+         * @brief Open the sealed frames of a receive queue in place, through
+         * Crypto::decryptAuthenticatedBatch. Consecutive frames sealed with the same key are
+         * opened together, up to LORA_OPEN_BATCH_LENGTH at a time, on the bitsliced cipher
+         * only once a run reaches CRYPTO_BATCH_MIN_MESSAGES; SIGNED frames have nothing
+         * to decrypt and are checked one by one, as are the frames of a node with a pending
+         * key. Frames in the clear are left as they are, and sealed ones that cannot be
+         * opened, or replay a frame counter, are emptied. Opened frames note the node whose
+         * session opened them as their sender.
+         * 
+         * @param frames The queued frames.
+         * @param frameCount The number of queued frames.
+         * @param cryptoService The encryption service holding the network key.
+         * @param sessions The sessions of the nodes that joined, or null to only open frames
+         * sealed with the network key.
+         * @return size_t The number of frames left readable.
+         */
+        size_t openFrames(ReceivedFrame *frames, size_t frameCount, Crypto *cryptoService, SessionTable *sessions = nullptr) {
+            const bool authenticating = cryptoService != nullptr && cryptoService->isReady();
+            SealedMessage messages[LORA_OPEN_BATCH_LENGTH];
+            ReceivedFrame *sealed[LORA_OPEN_BATCH_LENGTH];
+            Crypto *batchCipher = nullptr;
+            NodeSession *batchSession = nullptr;
+            uint16_t batchKeyID = 0;
+            size_t batched = 0, readable = 0;
+            const auto openBatch = [&]() {
+                batchCipher->decryptAuthenticatedBatch(messages, batched);
+                for (size_t j = 0; j < batched; j++) {
+                    // A frame counter may repeat within a batch, so it is checked again.
+                    const bool fresh = batchSession == nullptr || SessionTable::isFresh(*batchSession, messages[j].nonce);
+                    if (messages[j].authentic && fresh) {
+                        if (batchSession != nullptr) {
+                            SessionTable::markSeen(*batchSession, messages[j].nonce);
+                        }
+                        sealed[j]->senderAddress = batchSession != nullptr ? batchSession->nodeAddress : 0;
+                        sealed[j]->length = openedLength(sealed[j]->bytes, messages[j]);
+                        readable++;
+                    } else {
+                        if (batchSession != nullptr && !messages[j].authentic) {
+                            SessionTable::markFailed(*batchSession);
+                        }
+                        this->logger->logSerial(fresh ? "MIC check failed, frame dropped!" : "Replayed frame dropped!", true);
+                        sealed[j]->length = 0;
+                    }
                 }
-                this->logger->logSerial("Received LoRa Message: " + message, true);
-                this->logger->logOLED("Received " + String(parsed) + " bytes: " + message);
-                if (message.indexOf("=") == -1) {
-                    return LoraDTO(nullptr, 0);
+                batched = 0;
+            };
+            for (size_t i = 0; i < frameCount; i++) {
+                ReceivedFrame &frame = frames[i];
+                if (frame.length == 0 || !isSealedFrame(frame.bytes[0])) {
+                    readable += frame.length > 0;
+                    continue;
                 }
-                // Deserialize received message
-                return LoraDTO::fromString(message);
-            } else {
-                this->logger->logSerial("Nothing received!", true);
-                return LoraDTO(nullptr, 0);
+                SealedMessage message;
+                if (!authenticating || !sealedMessage(frame.bytes, frame.length, message)) {
+                    frame.length = 0;
+                    continue;
+                }
+                const uint16_t keyID = frameKeyID(frame.bytes);
+                if (batched > 0 && keyID != batchKeyID) {
+                    openBatch();
+                }
+                NodeSession *session;
+                Crypto *cipher = openingCipher(keyID, message.nonce, cryptoService, sessions, session);
+                if (cipher == nullptr) {
+                    frame.length = 0;
+                    continue;
+                }
+                // The frames of a node with a pending key are opened one by one, until one
+                // tells which key the node uses.
+                const bool pending = session != nullptr && session->pending;
+                if (frameProtection(frame.bytes[0]) == SIGNED || pending) {
+                    const bool opened = pending
+                        ? openPendingMessage(sessions, *session, frame.bytes, message)
+                        : openMessage(cipher, frame.bytes, message);
+                    if (opened) {
+                        if (session != nullptr) {
+                            SessionTable::markSeen(*session, message.nonce);
+                        }
+                        frame.senderAddress = session != nullptr ? session->nodeAddress : 0;
+                        frame.length = openedLength(frame.bytes, message);
+                        readable++;
+                    } else {
+                        if (session != nullptr) {
+                            SessionTable::markFailed(*session);
+                        }
+                        this->logger->logSerial("MIC check failed, frame dropped!", true);
+                        frame.length = 0;
+                    }
+                    continue;
+                }
+                batchCipher = cipher;
+                batchSession = session;
+                batchKeyID = keyID;
+                messages[batched] = message;
+                sealed[batched++] = &frame;
+                if (batched == LORA_OPEN_BATCH_LENGTH) {
+                    openBatch();
+                }
+            }
+            if (batched > 0) {
+                openBatch();
+            }
+            return readable;
+        }
+
+        /**
+         * @brief Copy the last packet received into a receive queue entry, with the signal
+         * quality it arrived with.
+         * 
+         * @param frame The queue entry to fill.
+         */
+        void copyPacket(ReceivedFrame &frame) {
+            memcpy(frame.bytes, this->receivedFrame, this->receivedLength);
+            frame.length = this->receivedLength;
+            frame.rssi = this->receivedRssi;
+            frame.snr = this->receivedSnr;
+            frame.receivedAt = this->receivedAt;
+            frame.senderAddress = this->receivedSender;
+        }
+
+        /**
+         * @brief Parse the last packet received as a join request.
+         * 
+         * @param request The message to fill with the Device ID of the joining node.
+         * @return bool Whether the packet was a join request.
+         */
+        bool parseJoinRequest(JoinMessage &request) {
+            return decodeJoinMessage(this->receivedFrame, this->receivedLength, JOIN_REQUEST, request);
+        }
+
+        /**
+         * @brief Check whether the last packet received, already unprotected, asks this node
+         * to join again.
+         * 
+         * @param deviceID The NUL-terminated Device ID of this node.
+         * @param nodeAddress The short address of this node.
+         */
+        bool parseRejoin(const char *deviceID, uint16_t nodeAddress) {
+            JoinMessage request;
+            return nodeAddress != 0
+                && decodeJoinMessage(this->receivedFrame, this->receivedLength, REJOIN, request)
+                && request.nodeAddress == nodeAddress
+                && strcmp(request.deviceID, deviceID) == 0;
+        }
+
+        /**
+         * @brief Apply the last packet received if it is a LINK_ADR command for this node:
+         * its TX power at once, and its spreading factor after the delay it carries, measured
+         * from when the packet arrived. Hearing it shows the gateway hears this node.
+         * 
+         * @param nodeAddress The short address of this node.
+         * @param sessionRequired Whether the command only counts if unprotectDownlink opened
+         * it with the session key of this node, as it must once the node has one.
+         * @return bool Whether the packet was a command for this node.
+         */
+        bool applyLinkCommand(uint16_t nodeAddress, bool sessionRequired = false) {
+            LinkCommand command;
+            if (
+                nodeAddress == 0
+                || (sessionRequired && this->receivedSender != nodeAddress)
+                || !decodeLinkCommand(this->receivedFrame, this->receivedLength, command)
+                || command.nodeAddress != nodeAddress
+            ) {
+                return false;
+            }
+            this->unansweredFrames = 0;
+            this->linkSwitchPending = false;
+            if (command.switchDelay == 0) {
+                if (command.spreadingFactor != this->spreadingFactor || command.txPower != this->txPower) {
+                    setLinkSettings(command.spreadingFactor, command.txPower);
+                }
+                return true;
             }
+            if (command.txPower != this->txPower) {
+                setLinkSettings(this->spreadingFactor, command.txPower);
+            }
+            if (command.spreadingFactor != this->spreadingFactor) {
+                this->linkSwitchPending = true;
+                this->pendingSpreadingFactor = command.spreadingFactor;
+                this->linkSwitchAt = this->receivedAt + command.switchDelay;
+            }
+            return true;
+        }
+
+        /**
+         * @brief Unpack the readings of the last packet received, if it is a batch.
+         * 
+         * @param readings The caller-owned array the readings are stored in.
+         * @param capacity The number of readings the array can hold.
+         * @return size_t The number of readings unpacked.
+         */
+        size_t parseBatch(MeterReading *readings, size_t capacity) {
+            return ReadingBatch::decode(
+                this->receivedFrame,
+                this->receivedLength,
+                readings,
+                capacity,
+                millis()
+            );
+        }
+
+        /**
+         * @brief Parse the last packet received as views into an internal buffer, without
+         * allocating. Encrypted frames must have been decrypted with unprotectPacket first. The
+         * views stay valid until the next packet is received.
+         * 
+         * @param slots The caller-owned array the received fields are stored in.
+         * @param capacity The number of slots available. Fields beyond it are dropped.
+         * @return size_t The number of fields received.
+         */
+        size_t parseFields(FieldView *slots, size_t capacity) {
+            const size_t frameLength = this->receivedLength;
+            if (frameLength == 0) {
+                return 0;
+            }
+            if (isBinaryFrame(this->receivedFrame[0])) {
+                return LoraDTO::parseBinaryInto(
+                    this->receivedFrame,
+                    frameLength,
+                    slots,
+                    capacity,
+                    this->receivedScratch,
+                    sizeof(this->receivedScratch)
+                );
+            }
+            return LoraDTO::parseInto((char *) this->receivedFrame, frameLength, slots, capacity);
         }
 
         /**
@@ -128,7 +1809,18 @@ class LoraInterface {
          * 
          */
         ~LoraInterface() {
+            awaitTransmit();
+            if (listener == this) {
+                LoRa.onReceive(nullptr);
+                listener = nullptr;
+            }
+            delete this->ring;
+            this->ring = nullptr;
             delete this->logger;
             this->logger = nullptr;
+            delete this->batch;
+            this->batch = nullptr;
+            delete this->dutyCycle;
+            this->dutyCycle = nullptr;
         }
 };
\ No newline at end of file
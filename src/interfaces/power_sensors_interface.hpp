@@ -89,7 +89,9 @@ class PowerSensorsInterface {
             // emon.calcVI(20,2000);         // Calculate all. No.of half wavelengths (crossings), time-out
             // emon.serialprint();
             double result = max(0.0, emon.calcIrms(1480));
-            logger->logSerial("Current: " + String(result) + "A", true);
+            if (logger->isVerbose()) {
+                logger->logSerial("Current: " + String(result) + "A", true);
+            }
             return result;
         }
 
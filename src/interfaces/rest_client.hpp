@@ -12,9 +12,14 @@
 #include<Arduino.h>
 
 #include "interfaces/wifi_handler.hpp"
+#include "models/field_view.hpp"
 #include "models/serializable_data.hpp"
 #include "services/logger.hpp"
 
+/// The longest HTTP request the REST client sends, request line and headers included, in
+/// characters. Requests that do not fit are dropped.
+#define REST_REQUEST_CAPACITY 512
+
 /**
  * @brief A simple REST Clients to send requests over the network to a cloud backend.
  * 
@@ -30,29 +35,145 @@ class RESTClient {
         /// The Client used to make HTTP requests
         WiFiHandler *wifi;
 
+        /// The HTTP request being formed, reused by every request so that uploads do not
+        /// touch the heap.
+        char request[REST_REQUEST_CAPACITY];
+
+        /// The number of characters formed in the request.
+        size_t requestLength;
+
         /**
-         * @brief Form the Get Request URL using the endpoint where data is to be sent,
+         * @brief Append characters to the request being formed, if they fit with its NUL.
+         * 
+         * @param text The characters to append.
+         * @param length The number of characters.
+         * @return bool Whether they fit.
+         */
+        bool append(const char *text, size_t length) {
+            if (this->requestLength + length >= sizeof(this->request)) {
+                return false;
+            }
+            memcpy(this->request + this->requestLength, text, length);
+            this->requestLength += length;
+            this->request[this->requestLength] = '\0';
+            return true;
+        }
+
+        /**
+         * @brief Append NUL-terminated characters to the request being formed, if they fit.
+         * 
+         */
+        bool append(const char *text) {
+            return append(text, strlen(text));
+        }
+
+        /**
+         * @brief Start forming a GET request, up to the query string of its URL.
+         * 
+         * @param urlEndpoint The endpoint where data is to be sent.
+         * @return bool Whether it fit.
+         */
+        bool beginGetRequest(const char *urlEndpoint) {
+            this->requestLength = 0;
+            return append("GET ") && append(urlEndpoint) && append("?");
+        }
+
+        /**
+         * @brief Finish forming a request, past its URL: the protocol and headers.
+         * 
+         * @return bool Whether they fit.
+         */
+        bool endRequest() {
+            return append(" HTTP/1.1\r\nHost: ")
+                && append(this->host.c_str(), this->host.length())
+                && append("\r\nConnection: close\r\n\r\n");
+        }
+
+        /**
+         * @brief Form the GET request for the data to be sent to an endpoint.
          * 
          * @param urlEndpoint The endpoint where data is to be sent.
          * @param data The data to be sent in the get request as a list of {SerializableData}.
          * @param dataLength The length of the data list.
-         * @return String The formed URL with the data encoded in it.
+         * @return bool Whether the request fit in REST_REQUEST_CAPACITY.
          */
-        String formGetRequestURL(
-            const String urlEndpoint,
-            SerializableData *data,
+        bool formGetRequest(
+            const char *urlEndpoint,
+            const SerializableData *data,
             const int dataLength
         ) {
-            String encodedURL = urlEndpoint + "?";
+            if (!beginGetRequest(urlEndpoint)) {
+                return false;
+            }
             for (int i = 0; i < dataLength; i++) {
-                encodedURL += data[i].toString();
-                if (i != dataLength - 1) {
-                    encodedURL += "&";
+                const size_t length = data[i].toText(
+                    this->request + this->requestLength,
+                    sizeof(this->request) - this->requestLength
+                );
+                if (length == 0) {
+                    return false;
+                }
+                this->requestLength += length;
+                if (i != dataLength - 1 && !append("&")) {
+                    return false;
+                }
+            }
+            return endRequest();
+        }
+
+        /**
+         * @brief Form the GET request for fields that point into a received buffer.
+         *
+         * @param urlEndpoint The endpoint where data is to be sent.
+         * @param data The data to be sent in the get request as a list of {FieldView}.
+         * @param dataLength The length of the data list.
+         * @return bool Whether the request fit in REST_REQUEST_CAPACITY.
+         */
+        bool formGetRequest(
+            const char *urlEndpoint,
+            const FieldView *data,
+            const size_t dataLength
+        ) {
+            if (!beginGetRequest(urlEndpoint)) {
+                return false;
+            }
+            for (size_t i = 0; i < dataLength; i++) {
+                if (
+                    !append(data[i].key, data[i].keyLength)
+                    || !append("=")
+                    || !append(data[i].val, data[i].valLength)
+                    || (i != dataLength - 1 && !append("&"))
+                ) {
+                    return false;
                 }
             }
-            logger->logSerial("Requesting URL: ");
-            logger->logSerial(encodedURL, true);
-            return encodedURL;
+            return endRequest();
+        }
+
+        /**
+         * @brief Send the request formed, if it fit.
+         *
+         * @param formed Whether the request fit in REST_REQUEST_CAPACITY.
+         * @return {size_t} The size of the response.
+         */
+        size_t sendRequest(bool formed) {
+            if (!formed) {
+                logger->logSerial("Request too long, dropped!", true);
+                return 0;
+            }
+            if (wifi->getStatus() == WL_CONNECTED) {
+                // This will send the request to the server
+                size_t res = wifi->sendRequest(this->host.c_str(), this->request);
+                if (res != 0) {
+                    logger->logSerial("Sent!", true);
+                    logger->logOLED("Uploaded " + String(res) + " bytes.");
+                }
+                return res;
+            } else {
+                logger->logSerial("Connection failed! Reconnecting...", true);
+                wifi->connectWiFi();
+                return 0;
+            }
         }
 
     public:
@@ -67,6 +188,8 @@ class RESTClient {
             this->host = host;
             this->logger = new Logger(verbose, "RESTClient");
             this->wifi = wifiHandler;
+            this->requestLength = 0;
+            this->request[0] = '\0';
         }
 
         /**
@@ -78,30 +201,30 @@ class RESTClient {
          * @return {size_t} The size of the response.
          */
         size_t makeGETRequest(
-            const String urlEndpoint,
-            SerializableData *data,
+            const char *urlEndpoint,
+            const SerializableData *data,
             const int dataLength
         ) {
             logger->logSerial("Sending GET request...");
-            const String encodedURL = formGetRequestURL(urlEndpoint, data, dataLength);
-            if (wifi->getStatus() == WL_CONNECTED) {
-                // This will send the request to the server
-                size_t res = wifi->sendRequest(
-                    host,
-                    "GET " + encodedURL + " HTTP/1.1\r\n" +
-                    "Host: " + host + "\r\n" + 
-                    "Connection: close\r\n\r\n"
-                );
-                if (res != 0) {
-                    logger->logSerial("Sent!", true);
-                    logger->logOLED("Uploaded " + String(res) + " bytes.");
-                }
-                return res;
-            } else {
-                logger->logSerial("Connection failed! Reconnecting...", true);
-                wifi->connectWiFi();
-                return 0;
-            }
+            return sendRequest(formGetRequest(urlEndpoint, data, dataLength));
+        }
+
+        /**
+         * @brief Send a GET request to the REST backend from fields that point into a received
+         * buffer.
+         * 
+         * @param urlEndpoint The base endpoint where data is to be sent.
+         * @param data The data to be sent in the get request as a list of {FieldView}.
+         * @param dataLength The length of the data list.
+         * @return {size_t} The size of the response.
+         */
+        size_t makeGETRequest(
+            const char *urlEndpoint,
+            const FieldView *data,
+            const size_t dataLength
+        ) {
+            logger->logSerial("Sending GET request...");
+            return sendRequest(formGetRequest(urlEndpoint, data, dataLength));
         }
 
         /**
@@ -65,23 +65,27 @@ class WiFiHandler {
         /**
          * @brief Create a client and make a request using the HTTP client.
          * 
-         * @param host The host to send the request to.
-         * @param request The full request to send.
+         * @param host The NUL-terminated host to send the request to.
+         * @param request The full NUL-terminated request to send.
          * @return size_t The size of the response.
          */
-        size_t sendRequest(String host, String request) {
+        size_t sendRequest(const char *host, const char *request) {
             /// Secure WiFi Client to make HTTP Requests with.
             WiFiClientSecure client = WiFiClientSecure();
 
             // Use WiFiClient class to create TCP connections
             const int httpPort = 443; // 80 is for HTTP / 443 is for HTTPS!
             client.setInsecure(); // this is the magical line that makes everything work
-            logger->logSerial("Connecting to " + host, true);
-            if (!client.connect(host.c_str(), httpPort)) {
+            if (logger->isVerbose()) {
+                logger->logSerial("Connecting to " + String(host), true);
+            }
+            if (!client.connect(host, httpPort)) {
                 logger->logSerial("Connection failed!", true);
                 return 0;
             }
-            logger->logSerial("Sending request: " + request, true);
+            if (logger->isVerbose()) {
+                logger->logSerial("Sending request: " + String(request), true);
+            }
             return client.print(request);
         }
 
@@ -20,6 +20,22 @@
 // Define Frequency Band
 const LoraBand loraBand = LoraBand::ASIA;
 
+// Define the format Nodes send LoRa messages in (Gateways accept every format)
+const WireFormat wireFormat = WireFormat::BINARY_TLV;
+
+// Define how many readings Nodes pack into one LoRa frame, and how long a reading may wait
+const size_t batchReadings = 8;
+const unsigned long batchLatency = 60000;
+
+// Define whether Nodes only sign readings, for public data, rather than encrypt them
+const bool integrityOnly = false;
+
+// Define whether the Gateway assigns joined Nodes their spreading factor and TX power from
+// the signal quality of their frames. Off until every Node and the Gateway are flashed with
+// it on together: Nodes without it stay at SF11, the default, and go unheard once the Gateway
+// moves off it
+const bool adaptiveDataRate = false;
+
 // Define Control Mode
 const ControlModes controlMode = ControlModes::NODE;
 
@@ -51,6 +67,11 @@ void setup() {
         2,
         encryptionKey,
         loraBand,
+        wireFormat,
+        batchReadings,
+        batchLatency,
+        integrityOnly,
+        adaptiveDataRate,
         false,
         false,
         false
@@ -63,6 +84,7 @@ void setup() {
         host,
         encryptionKey,
         loraBand,
+        adaptiveDataRate,
         false,
         false,
         true,
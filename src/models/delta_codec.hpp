@@ -0,0 +1,55 @@
+/**
+ * @file delta_codec.hpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Contains the zigzag and varint primitives used to delta encode consecutive readings.
+ * @version 0.1
+ * @date 2022-04-16
+ * 
+ * @copyright Copyright (c) 2022
+ * 
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// The most bytes a 32 bit varint takes.
+#define MAX_VARINT_LENGTH 5
+
+/**
+ * @brief Map a signed difference to an unsigned one so that small magnitudes of either sign
+ * become small numbers: 0, -1, 1, -2, 2... become 0, 1, 2, 3, 4...
+ * 
+ * @param value The signed difference.
+ * @return uint32_t The zigzag encoded difference.
+ */
+inline uint32_t zigzagEncode(int32_t value) {
+    return ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+}
+
+/**
+ * @brief Undo zigzagEncode.
+ * 
+ * @param value The zigzag encoded difference.
+ * @return int32_t The signed difference.
+ */
+inline int32_t zigzagDecode(uint32_t value) {
+    return (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+}
+
+/**
+ * @brief Get the number of bytes a value takes as a varint: 7 bits per byte, least
+ * significant group first, with the top bit set on every byte but the last.
+ * 
+ * @param value The value to measure.
+ * @return size_t The number of bytes, 1 to MAX_VARINT_LENGTH.
+ */
+inline size_t varintLength(uint32_t value) {
+    size_t length = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        length++;
+    }
+    return length;
+}
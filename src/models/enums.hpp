@@ -21,6 +21,30 @@ enum LoraBand {
     NORTHAMERICA
 };
 
+/**
+ * @brief The format that LoRa messages are serialized into before sending.
+ * 
+ */
+enum WireFormat {
+    /// "key=value&key=value" text, understood by every gateway.
+    LEGACY_TEXT,
+    /// Compact tag-length-value frames, see models/wire_format.hpp.
+    BINARY_TLV
+};
+
+/**
+ * @brief How an attempt to send a frame went.
+ * 
+ */
+enum SendResult {
+    /// The frame is on air.
+    FRAME_SENT,
+    /// The frame did not fit in one LoRa packet, and was not sent.
+    FRAME_TOO_LONG,
+    /// The frame would have broken the duty cycle of the band, and was not sent.
+    FRAME_DEFERRED
+};
+
 
 /// The Control Mode types available to be used by the Robot.
 enum ControlModes {
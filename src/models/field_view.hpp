@@ -0,0 +1,44 @@
+/**
+ * @file field_view.hpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Contains a non-owning view of a key value pair inside a received buffer.
+ * @version 0.1
+ * @date 2022-04-06
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @brief A key value pair that points into a buffer owned by someone else, so that received
+ * messages can be parsed without allocating. A view is only valid while that buffer is.
+ *
+ */
+struct FieldView {
+    /// The first character of the key. Not NUL-terminated.
+    const char *key;
+
+    /// The number of characters in the key.
+    uint8_t keyLength;
+
+    /// The first character of the value. Not NUL-terminated.
+    const char *val;
+
+    /// The number of characters in the value.
+    uint8_t valLength;
+
+    /**
+     * @brief Check whether the key of the view matches a NUL-terminated key.
+     *
+     * @param other The key to compare against.
+     */
+    bool keyEquals(const char *other) const {
+        return strncmp(key, other, keyLength) == 0 && other[keyLength] == '\0';
+    }
+};
@@ -0,0 +1,459 @@
+/**
+ * @file history_block.hpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Contains a Gorilla-style compressed block of timestamped samples, for nodes to keep
+ * hours of readings in a few kilobytes while the gateway is unreachable.
+ * @version 0.1
+ * @date 2022-04-22
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "models/wire_format.hpp"
+
+/// The bytes of one block, header included. Small enough to travel as one field of one frame.
+#define HISTORY_BLOCK_LENGTH 224
+
+/// The bytes at the start of a block: its sample count, little-endian, then its decimals.
+#define HISTORY_HEADER_LENGTH 3
+
+/// The decimals of a block keeping values exactly as appended.
+#define HISTORY_FULL_PRECISION 0xFF
+
+/// The most decimals a block rounds values to, the last of DECIMAL_SCALES.
+#define HISTORY_MAX_DECIMALS (sizeof(DECIMAL_SCALES) / sizeof(DECIMAL_SCALES[0]) - 1)
+
+/**
+ * @brief The timestamp buckets of the delta-of-delta encoding: a control prefix of prefixBits
+ * bits, then the delta of delta in valueBits bits of two's complement.
+ *
+ */
+struct HistoryBucket {
+    /// The control bits announcing the bucket, most significant first.
+    uint8_t prefix;
+
+    /// The number of control bits.
+    uint8_t prefixBits;
+
+    /// The number of bits the delta of delta takes.
+    uint8_t valueBits;
+};
+
+/// The buckets for non-zero deltas of delta, tried in order. A zero takes a single 0 bit.
+static constexpr HistoryBucket HISTORY_BUCKETS[] = {
+    { 0x2, 2, 7 },
+    { 0x6, 3, 9 },
+    { 0xE, 4, 12 },
+    { 0xF, 4, 32 },
+};
+
+/**
+ * @brief Appends samples to a fixed bit-packed buffer the way Facebook's Gorilla does.
+ *
+ * Timestamps are kept to the second. The first one is stored in 32 bits; every later one as
+ * the change of its delta from the previous delta, which is zero for a steady sampling period
+ * and so takes a single bit. Values are doubles XORed with the previous value: an unchanged
+ * value takes one bit, and otherwise only the bits between the leading and trailing zeros of
+ * the XOR are stored, reusing the previous window of bits when it fits.
+ *
+ * Sensor readings are noisy decimals whose doubles differ in nearly every mantissa bit, which
+ * XOR compresses poorly. A block can instead round values to some decimals and store them
+ * scaled to whole numbers, whose doubles differ in only a few bits.
+ *
+ */
+class HistoryBlock {
+    private:
+        /// The header followed by the bit stream, most significant bit first.
+        uint8_t data[HISTORY_BLOCK_LENGTH];
+
+        /// The decimals values are rounded to, or HISTORY_FULL_PRECISION.
+        uint8_t decimals;
+
+        /// The number of bits written past the sample count.
+        size_t bitLength;
+
+        /// The number of samples in the block.
+        uint16_t count;
+
+        /// The timestamp of the last sample, in seconds.
+        uint32_t lastTimestamp;
+
+        /// The delta between the last two timestamps, in seconds.
+        int64_t lastDelta;
+
+        /// The bits of the last value.
+        uint64_t lastBits;
+
+        /// The leading zeros of the window of meaningful bits last stored.
+        uint8_t lastLeading;
+
+        /// The trailing zeros of the window of meaningful bits last stored.
+        uint8_t lastTrailing;
+
+        /**
+         * @brief Append the low bits of a value, most significant first. Bits are set and
+         * cleared rather than ORed in, so a rolled back append leaves nothing behind.
+         *
+         * @return bool Whether the bits fit.
+         */
+        bool putBits(uint64_t value, uint8_t bits) {
+            if (bitLength + bits > 8 * (HISTORY_BLOCK_LENGTH - HISTORY_HEADER_LENGTH)) {
+                return false;
+            }
+            for (int8_t i = bits - 1; i >= 0; i--) {
+                uint8_t &byte = data[HISTORY_HEADER_LENGTH + bitLength / 8];
+                const uint8_t mask = 0x80 >> (bitLength % 8);
+                byte = (value >> i) & 1 ? byte | mask : byte & ~mask;
+                bitLength++;
+            }
+            return true;
+        }
+
+        /**
+         * @brief Append the delta of delta of a timestamp.
+         *
+         * @return bool Whether it fit.
+         */
+        bool putTimestamp(int64_t deltaOfDelta) {
+            if (deltaOfDelta == 0) {
+                return putBits(0, 1);
+            }
+            for (const HistoryBucket &bucket : HISTORY_BUCKETS) {
+                const int64_t limit = (int64_t) 1 << (bucket.valueBits - 1);
+                if (deltaOfDelta >= -limit && deltaOfDelta < limit) {
+                    return putBits(bucket.prefix, bucket.prefixBits)
+                        && putBits((uint64_t) deltaOfDelta, bucket.valueBits);
+                }
+            }
+            return false;
+        }
+
+        /**
+         * @brief Append a value XORed with the previous one.
+         *
+         * @return bool Whether it fit.
+         */
+        bool putValue(uint64_t bits) {
+            const uint64_t xored = bits ^ lastBits;
+            if (xored == 0) {
+                return putBits(0, 1);
+            }
+            uint8_t leading = __builtin_clzll(xored);
+            const uint8_t trailing = __builtin_ctzll(xored);
+            // Five bits hold the leading zeros, so longer runs are stored as meaningful bits.
+            leading = leading > 31 ? 31 : leading;
+            if (count > 1 && leading >= lastLeading && trailing >= lastTrailing) {
+                return putBits(0x2, 2)
+                    && putBits(xored >> lastTrailing, 64 - lastLeading - lastTrailing);
+            }
+            const uint8_t meaningful = 64 - leading - trailing;
+            lastLeading = leading;
+            lastTrailing = trailing;
+            // A window of all 64 bits is stored as 0, as six bits only count to 63.
+            return putBits(0x3, 2)
+                && putBits(leading, 5)
+                && putBits(meaningful & 0x3F, 6)
+                && putBits(xored >> trailing, meaningful);
+        }
+
+    public:
+        /**
+         * @brief Construct a new, empty History Block object
+         *
+         * @param decimals The decimals to round values to, more than HISTORY_MAX_DECIMALS
+         * being rounded to that many, or HISTORY_FULL_PRECISION to keep them exactly.
+         */
+        HistoryBlock(uint8_t decimals = HISTORY_FULL_PRECISION) {
+            this->decimals = decimals != HISTORY_FULL_PRECISION && decimals > HISTORY_MAX_DECIMALS
+                ? HISTORY_MAX_DECIMALS
+                : decimals;
+            clear();
+        }
+
+        /**
+         * @brief Append a sample to the block.
+         *
+         * @param timestamp When the sample was taken, in milliseconds. Must not be earlier
+         * than the previous sample.
+         * @param value The sample.
+         * @return bool Whether the sample fit. The block is left unchanged if not.
+         */
+        bool append(uint32_t timestamp, double value) {
+            if (decimals != HISTORY_FULL_PRECISION) {
+                value = round(value * DECIMAL_SCALES[decimals]);
+            }
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            const uint32_t seconds = timestamp / 1000;
+            const size_t previousLength = bitLength;
+            const uint8_t previousLeading = lastLeading;
+            const uint8_t previousTrailing = lastTrailing;
+            const int64_t delta = (int64_t) seconds - lastTimestamp;
+            const bool fit = count == 0
+                ? putBits(seconds, 32) && putBits(bits, 64)
+                : putTimestamp(delta - lastDelta) && putValue(bits);
+            if (!fit || count == UINT16_MAX) {
+                bitLength = previousLength;
+                lastLeading = previousLeading;
+                lastTrailing = previousTrailing;
+                return false;
+            }
+            lastDelta = count == 0 ? 0 : delta;
+            lastTimestamp = seconds;
+            lastBits = bits;
+            count++;
+            data[0] = (uint8_t) count;
+            data[1] = (uint8_t) (count >> 8);
+            return true;
+        }
+
+        /**
+         * @brief Get the number of samples in the block.
+         *
+         */
+        size_t size() {
+            return count;
+        }
+
+        /**
+         * @brief Get the number of bits the samples take, without the header.
+         *
+         */
+        size_t bitSize() {
+            return bitLength;
+        }
+
+        /**
+         * @brief Get the serialized block: its header, then its bit stream.
+         *
+         */
+        const uint8_t *bytes() {
+            return data;
+        }
+
+        /**
+         * @brief Get the number of bytes of the serialized block.
+         *
+         */
+        size_t byteSize() {
+            return HISTORY_HEADER_LENGTH + (bitLength + 7) / 8;
+        }
+
+        /**
+         * @brief Append the block to a frame as one HISTORY_TAG field, for instance after the
+         * fields of a LoraDTO or a MeterReading identifying the node. Decoders that do not
+         * know the tag skip it.
+         *
+         * @return bool Whether the block fit.
+         */
+        bool writeTo(FrameWriter &writer) {
+            return writer.putText(HISTORY_TAG, (const char *) data, byteSize());
+        }
+
+        /**
+         * @brief Empty the block, typically after it was sent.
+         *
+         */
+        void clear() {
+            memset(data, 0, sizeof(data));
+            data[2] = decimals;
+            bitLength = 0;
+            count = 0;
+            lastTimestamp = 0;
+            lastDelta = 0;
+            lastBits = 0;
+            lastLeading = 0;
+            lastTrailing = 0;
+        }
+};
+
+/**
+ * @brief Walks the samples of a serialized HistoryBlock without copying it, for instance the
+ * value of a received HISTORY_TAG field.
+ *
+ */
+class HistoryReader {
+    private:
+        /// The bit stream, past the sample count.
+        const uint8_t *bits;
+
+        /// The number of bits in the stream.
+        size_t bitLength;
+
+        /// The next bit to read.
+        size_t position;
+
+        /// The number of samples in the block.
+        uint16_t count;
+
+        /// The number of samples read so far.
+        uint16_t index;
+
+        /// The decimals values were rounded to, or HISTORY_FULL_PRECISION.
+        uint8_t decimals;
+
+        /// The timestamp of the last sample read, in seconds.
+        uint32_t lastTimestamp;
+
+        /// The delta between the last two timestamps read, in seconds.
+        int64_t lastDelta;
+
+        /// The bits of the last value read.
+        uint64_t lastBits;
+
+        /// The leading zeros of the current window of meaningful bits.
+        uint8_t lastLeading;
+
+        /// The trailing zeros of the current window of meaningful bits.
+        uint8_t lastTrailing;
+
+        /**
+         * @brief Read bits, most significant first.
+         *
+         * @return bool Whether enough bits were left.
+         */
+        bool getBits(uint8_t width, uint64_t &value) {
+            if (position + width > bitLength) {
+                return false;
+            }
+            value = 0;
+            for (uint8_t i = 0; i < width; i++) {
+                value = (value << 1) | ((bits[position / 8] >> (7 - position % 8)) & 1);
+                position++;
+            }
+            return true;
+        }
+
+        /**
+         * @brief Read the delta of delta of a timestamp.
+         *
+         * @return bool Whether a whole one was left.
+         */
+        bool getTimestamp(int64_t &deltaOfDelta) {
+            // The prefixes are runs of ones ended by a zero, except the longest.
+            uint8_t ones = 0;
+            uint64_t bit;
+            while (ones < sizeof(HISTORY_BUCKETS) / sizeof(HISTORY_BUCKETS[0])) {
+                if (!getBits(1, bit)) {
+                    return false;
+                }
+                if (bit == 0) {
+                    break;
+                }
+                ones++;
+            }
+            if (ones == 0) {
+                deltaOfDelta = 0;
+                return true;
+            }
+            const HistoryBucket &bucket = HISTORY_BUCKETS[ones - 1];
+            uint64_t raw;
+            if (!getBits(bucket.valueBits, raw)) {
+                return false;
+            }
+            const uint8_t shift = 64 - bucket.valueBits;
+            deltaOfDelta = (int64_t) (raw << shift) >> shift;
+            return true;
+        }
+
+        /**
+         * @brief Read a value XORed with the previous one.
+         *
+         * @return bool Whether a whole one was left.
+         */
+        bool getValue(uint64_t &value) {
+            uint64_t control;
+            if (!getBits(1, control)) {
+                return false;
+            }
+            if (control == 0) {
+                value = lastBits;
+                return true;
+            }
+            if (!getBits(1, control)) {
+                return false;
+            }
+            if (control == 1) {
+                uint64_t leading, meaningful;
+                if (!getBits(5, leading) || !getBits(6, meaningful)) {
+                    return false;
+                }
+                meaningful = meaningful == 0 ? 64 : meaningful;
+                lastLeading = leading;
+                lastTrailing = 64 - leading - meaningful;
+            }
+            uint64_t xored;
+            if (!getBits(64 - lastLeading - lastTrailing, xored)) {
+                return false;
+            }
+            value = lastBits ^ (xored << lastTrailing);
+            return true;
+        }
+
+    public:
+        /**
+         * @brief Construct a new History Reader object
+         *
+         * @param block The serialized block, as returned by HistoryBlock::bytes.
+         * @param blockLength The number of bytes of the serialized block.
+         */
+        HistoryReader(const uint8_t *block, size_t blockLength) {
+            const bool complete = blockLength >= HISTORY_HEADER_LENGTH
+                && (block[2] == HISTORY_FULL_PRECISION || block[2] <= HISTORY_MAX_DECIMALS);
+            this->bits = block + HISTORY_HEADER_LENGTH;
+            this->bitLength = complete ? 8 * (blockLength - HISTORY_HEADER_LENGTH) : 0;
+            this->count = complete ? block[0] | (block[1] << 8) : 0;
+            this->decimals = complete ? block[2] : HISTORY_FULL_PRECISION;
+            this->position = 0;
+            this->index = 0;
+            this->lastTimestamp = 0;
+            this->lastDelta = 0;
+            this->lastBits = 0;
+            this->lastLeading = 0;
+            this->lastTrailing = 0;
+        }
+
+        /**
+         * @brief Read the next sample.
+         *
+         * @param timestamp Set to when the sample was taken, in milliseconds, to the second.
+         * @param value Set to the sample.
+         * @return bool Whether a sample was read, false past the last one.
+         */
+        bool next(uint32_t &timestamp, double &value) {
+            if (index >= count) {
+                return false;
+            }
+            uint64_t bits;
+            if (index == 0) {
+                uint64_t seconds;
+                if (!getBits(32, seconds) || !getBits(64, bits)) {
+                    return false;
+                }
+                lastTimestamp = seconds;
+            } else {
+                int64_t deltaOfDelta;
+                if (!getTimestamp(deltaOfDelta) || !getValue(bits)) {
+                    return false;
+                }
+                lastDelta += deltaOfDelta;
+                lastTimestamp += lastDelta;
+            }
+            lastBits = bits;
+            index++;
+            timestamp = lastTimestamp * 1000;
+            memcpy(&value, &bits, sizeof(value));
+            if (decimals != HISTORY_FULL_PRECISION) {
+                value /= DECIMAL_SCALES[decimals];
+            }
+            return true;
+        }
+};
@@ -0,0 +1,116 @@
+/**
+ * @file join_message.hpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Contains the handshake a node uses to get a short address from the gateway.
+ * @version 0.1
+ * @date 2022-04-18
+ * 
+ * @copyright Copyright (c) 2022
+ * 
+ */
+
+#pragma once
+
+#include "models/meter_reading.hpp"
+#include "models/schema.hpp"
+#include "models/wire_format.hpp"
+
+/// The most nodes a gateway hands short addresses out to, and so the highest address. The
+/// session table and the NVS blobs of the registry are sized from it, see
+/// SESSION_TABLE_CAPACITY.
+#define NODE_REGISTRY_CAPACITY 64
+
+/**
+ * @brief The body of a JOIN_REQUEST or JOIN_ACCEPT CONTROL_FRAME.
+ * 
+ * A node sends a JOIN_REQUEST holding its Device ID and a random node nonce. The gateway
+ * answers with a JOIN_ACCEPT holding the same Device ID and node nonce, the short address it
+ * assigned, which the node then sends in place of its Device ID, and a random gateway nonce.
+ * Joining again returns the same address.
+ * 
+ * When both sides have the network key, they each derive the node's session key from the
+ * address and both nonces with Crypto::deriveSessionKey, so every join starts a fresh session.
+ * The gateway persists the node nonce of each node's last join and refuses a request that
+ * repeats it, unless it still holds that join, in which case it answers the same again, and
+ * keeps the node's previous key until a frame sealed with the new one opens. So neither a
+ * replayed request nor a lost JOIN_ACCEPT cuts the node off. Sessions live in the gateway's
+ * RAM, so a gateway receiving a frame sealed under a session it does not hold, as after a
+ * reboot, or repeated frames failing their MIC under one it does, answers with a REJOIN
+ * holding the Device ID and address of the node, which then joins again.
+ * 
+ */
+struct JoinMessage {
+    /// The NUL-terminated Device ID of the joining node.
+    char deviceID[MAX_DEVICE_ID_LENGTH + 1];
+
+    /// The short address assigned to the node, 0 in a JOIN_REQUEST.
+    uint16_t nodeAddress;
+
+    /// The random number the node picked for this join.
+    uint32_t nodeNonce;
+
+    /// The random number the gateway picked for this join, 0 in a JOIN_REQUEST.
+    uint32_t gatewayNonce;
+};
+
+/// The wire layout of a JoinMessage.
+typedef Schema<
+    JoinMessage,
+    SchemaField<JoinMessage, char[MAX_DEVICE_ID_LENGTH + 1], &JoinMessage::deviceID, DEVICE_ID_TAG>,
+    SchemaField<JoinMessage, uint16_t, &JoinMessage::nodeAddress, NODE_ADDRESS_TAG>,
+    SchemaField<JoinMessage, uint32_t, &JoinMessage::nodeNonce, NODE_NONCE_TAG>,
+    SchemaField<JoinMessage, uint32_t, &JoinMessage::gatewayNonce, GATEWAY_NONCE_TAG>
+> JoinMessageSchema;
+
+/**
+ * @brief Serialize a join message to a CONTROL_FRAME.
+ * 
+ * @param opcode JOIN_REQUEST, JOIN_ACCEPT or REJOIN.
+ * @param message The message to serialize.
+ * @param buffer The buffer to write the frame into.
+ * @param capacity The number of bytes the buffer can hold.
+ * @return size_t The length of the frame, or 0 if it did not fit.
+ */
+inline size_t encodeJoinMessage(
+    ControlOpcode opcode,
+    const JoinMessage &message,
+    uint8_t *buffer,
+    size_t capacity
+) {
+    FrameWriter writer(buffer, capacity);
+    writer.putByte(makeFrameHeader(CONTROL_FRAME));
+    writer.putByte(opcode);
+    JoinMessageSchema::writeFields(message, writer);
+    return writer.ok() ? writer.size() : 0;
+}
+
+/**
+ * @brief Deserialize a CONTROL_FRAME into a join message.
+ * 
+ * @param frame The received frame, starting with its header byte.
+ * @param frameLength The number of bytes in the frame.
+ * @param opcode The opcode the frame must carry.
+ * @param message The message to fill.
+ * @return bool Whether the frame was a join message with that opcode and a Device ID.
+ */
+inline bool decodeJoinMessage(
+    const uint8_t *frame,
+    size_t frameLength,
+    ControlOpcode opcode,
+    JoinMessage &message
+) {
+    if (
+        frameLength < 2
+        || !isBinaryFrame(frame[0])
+        || frameVersion(frame[0]) != WIRE_VERSION
+        || frameKind(frame[0]) != CONTROL_FRAME
+        || frameProtection(frame[0]) != UNPROTECTED
+        || frame[1] != opcode
+    ) {
+        return false;
+    }
+    message = JoinMessage {};
+    FrameReader reader(frame + 2, frameLength - 2);
+    JoinMessageSchema::readFields(reader, message);
+    return message.deviceID[0] != '\0';
+}
@@ -0,0 +1,90 @@
+/**
+ * @file link_command.hpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Contains the command the gateway sets the radio settings of a node with.
+ * @version 0.1
+ * @date 2022-05-06
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include "models/schema.hpp"
+#include "models/wire_format.hpp"
+
+/**
+ * @brief The body of a LINK_ADR CONTROL_FRAME, sent by the gateway to a node right after one
+ * of its frames, see services/adr_engine.hpp.
+ *
+ * The gateway listens on one spreading factor at a time, so the spreading factor is the same
+ * for every node, and every node is told to switch to a new one at the same moment, as a
+ * delay from when the command is sent. The TX power is the node's own, and applies at once.
+ *
+ */
+struct LinkCommand {
+    /// The short address of the node the command is for.
+    uint16_t nodeAddress;
+
+    /// The spreading factor to send with, from 7 to 12.
+    uint8_t spreadingFactor;
+
+    /// The TX power to send with, in dBm.
+    int8_t txPower;
+
+    /// How long after receiving the command to switch to the spreading factor, in
+    /// milliseconds.
+    uint32_t switchDelay;
+};
+
+/// The wire layout of a LinkCommand.
+typedef Schema<
+    LinkCommand,
+    SchemaField<LinkCommand, uint16_t, &LinkCommand::nodeAddress, NODE_ADDRESS_TAG>,
+    SchemaField<LinkCommand, uint8_t, &LinkCommand::spreadingFactor, SPREADING_FACTOR_TAG>,
+    SchemaField<LinkCommand, int8_t, &LinkCommand::txPower, TX_POWER_TAG>,
+    SchemaField<LinkCommand, uint32_t, &LinkCommand::switchDelay, SWITCH_DELAY_TAG>
+> LinkCommandSchema;
+
+/**
+ * @brief Serialize a link command to a LINK_ADR CONTROL_FRAME.
+ *
+ * @param command The command to serialize.
+ * @param buffer The buffer to write the frame into.
+ * @param capacity The number of bytes the buffer can hold.
+ * @return size_t The length of the frame, or 0 if it did not fit.
+ */
+inline size_t encodeLinkCommand(const LinkCommand &command, uint8_t *buffer, size_t capacity) {
+    FrameWriter writer(buffer, capacity);
+    writer.putByte(makeFrameHeader(CONTROL_FRAME));
+    writer.putByte(LINK_ADR);
+    LinkCommandSchema::writeFields(command, writer);
+    return writer.ok() ? writer.size() : 0;
+}
+
+/**
+ * @brief Deserialize a LINK_ADR CONTROL_FRAME into a link command.
+ *
+ * @param frame The received frame, starting with its header byte.
+ * @param frameLength The number of bytes in the frame.
+ * @param command The command to fill.
+ * @return bool Whether the frame was a link command for some node, with a spreading factor
+ * the radio supports.
+ */
+inline bool decodeLinkCommand(const uint8_t *frame, size_t frameLength, LinkCommand &command) {
+    if (
+        frameLength < 2
+        || !isBinaryFrame(frame[0])
+        || frameVersion(frame[0]) != WIRE_VERSION
+        || frameKind(frame[0]) != CONTROL_FRAME
+        || frameProtection(frame[0]) != UNPROTECTED
+        || frame[1] != LINK_ADR
+    ) {
+        return false;
+    }
+    command = LinkCommand {};
+    FrameReader reader(frame + 2, frameLength - 2);
+    LinkCommandSchema::readFields(reader, command);
+    return command.nodeAddress != 0 && command.spreadingFactor >= 7 && command.spreadingFactor <= 12;
+}
@@ -13,30 +13,97 @@
 
 #include <Arduino.h>
 
+#include "models/field_view.hpp"
 #include "models/serializable_data.hpp"
+#include "models/wire_format.hpp"
+
+/// The most fields a LoraDTO holds. Further fields are dropped, and the DTO marked as
+/// truncated.
+#define LORA_DTO_MAX_FIELDS 8
 
 /**
- * @brief Data model holding the Data to be sent or received from Lora.
+ * @brief Data model holding the Data to be sent or received from Lora. The fields are owned
+ * and kept inline, so a LoraDTO can be returned by value without touching the heap.
  * 
  */
 class LoraDTO {
     private:
         /// The list of Serializable data items in the Data Transfer.
-        SerializableData *dataList;
+        SerializableData dataList[LORA_DTO_MAX_FIELDS];
 
         /// The number of Serializable data items in the Data Transfer.
         int dataListSize;
 
+        /// Whether a data item was dropped, for want of room or for being truncated.
+        bool truncated;
+
+        /**
+         * @brief Replace the fields with those of another Lora Response, copying only the
+         * ones in use.
+         *
+         * @param other The Lora Response to copy from.
+         */
+        void copyFrom(const LoraDTO &other) {
+            for (int i = 0; i < other.dataListSize; i++) {
+                this->dataList[i] = other.dataList[i];
+            }
+            this->dataListSize = other.dataListSize;
+            this->truncated = other.truncated;
+        }
+
     public:
         /**
-         * @brief Construct a new Lora Response object
+         * @brief Construct a new empty Lora Response object
+         * 
+         */
+        LoraDTO() {
+            this->dataListSize = 0;
+            this->truncated = false;
+        }
+
+        /**
+         * @brief Construct a new Lora Response object, copying the data items.
          * 
          * @param dataList The list of Serializable data items in the Data Transfer.
-         * @param dataListSize The number of Serializable data in the Data Transfer.
+         * @param dataListSize The number of Serializable data in the Data Transfer. Items
+         * beyond LORA_DTO_MAX_FIELDS, or truncated, are dropped and the DTO marked as truncated.
+         */
+        LoraDTO(const SerializableData *dataList, int dataListSize) : LoraDTO() {
+            for (int i = 0; i < dataListSize; i++) {
+                add(dataList[i]);
+            }
+        }
+
+        /**
+         * @brief Construct a copy of a Lora Response object. The fields are inline, so only
+         * the ones in use are copied, and moving a Lora Response copies it the same way.
+         * 
+         */
+        LoraDTO(const LoraDTO &other) {
+            copyFrom(other);
+        }
+
+        LoraDTO &operator=(const LoraDTO &other) {
+            if (this != &other) {
+                copyFrom(other);
+            }
+            return *this;
+        }
+
+        /**
+         * @brief Append a data item to the Lora Response. Items that do not fit, or whose key
+         * or value was truncated, are dropped and the Lora Response marked as truncated.
+         * 
+         * @param data The data item to append.
+         * @return bool Whether the item was appended whole.
          */
-        LoraDTO(SerializableData *dataList, int dataListSize) {
-            this->dataList = dataList;
-            this->dataListSize = dataListSize;
+        bool add(const SerializableData &data) {
+            if (this->dataListSize == LORA_DTO_MAX_FIELDS || data.isTruncated()) {
+                this->truncated = true;
+                return false;
+            }
+            this->dataList[this->dataListSize++] = data;
+            return true;
         }
         
         /**
@@ -45,42 +112,192 @@ class LoraDTO {
          * @param data The String data to deserialize.
          * @return LoraDTO The deserialized LoraDTO object.
          */
-        static LoraDTO fromString(String data) {
-            int amps = 0;
-            for (int i = 0; i < data.length(); i++) {
-                amps += data.charAt(i) == '&';
-            }
-            SerializableData *dataList = new SerializableData[amps + 1];
-            int dataListSize = 0;
-            int index = 0;
-            while ((index < data.length()) && (dataListSize < amps + 1)) {
-                int keyEndIndex = data.indexOf("=", index);
-                String key = data.substring(index, keyEndIndex);
-                index = keyEndIndex + 1;
-                int valEndIndex = data.indexOf("&", index);
-                String val = data.substring(index, valEndIndex);
-                index = valEndIndex + 1;
-                dataList[dataListSize] = SerializableData(key, val);
-                dataListSize++;
+        static LoraDTO fromString(const String &data) {
+            return fromText(data.c_str(), data.length());
+        }
+
+        /**
+         * @brief Deserialize "key=value&key=value" characters into a LoraDTO object, without
+         * allocating. Segments without an "=" are skipped, and fields that do not fit are
+         * dropped, marking the DTO as truncated.
+         * 
+         * @param data The characters to deserialize, not necessarily NUL-terminated.
+         * @param length The number of characters.
+         * @return LoraDTO The deserialized LoraDTO object.
+         */
+        static LoraDTO fromText(const char *data, size_t length) {
+            LoraDTO dto;
+            // One view more than the DTO holds tells whether any field was left over.
+            FieldView views[LORA_DTO_MAX_FIELDS + 1];
+            const size_t count = parseInto(data, length, views, LORA_DTO_MAX_FIELDS + 1);
+            for (size_t i = 0; i < count; i++) {
+                dto.add(SerializableData(views[i].key, views[i].keyLength, views[i].val, views[i].valLength));
             }
-            return LoraDTO(dataList, dataListSize);
+            return dto;
         }
         
+        /**
+         * @brief Tokenize a "key=value&key=value" message in place, without allocating.
+         * Segments without an "=" are skipped.
+         * 
+         * @param data The received characters. Must outlive the views.
+         * @param length The number of characters received.
+         * @param slots The caller-owned array the views are stored in.
+         * @param capacity The number of slots available. Fields beyond it are dropped.
+         * @return size_t The number of views stored.
+         */
+        static size_t parseInto(const char *data, size_t length, FieldView *slots, size_t capacity) {
+            size_t count = 0;
+            size_t index = 0;
+            while (index < length && count < capacity) {
+                const char *segment = data + index;
+                const char *end = (const char *) memchr(segment, '&', length - index);
+                const size_t segmentLength = end != nullptr ? end - segment : length - index;
+                const char *equals = (const char *) memchr(segment, '=', segmentLength);
+                if (equals != nullptr) {
+                    FieldView &view = slots[count++];
+                    view.key = segment;
+                    view.keyLength = equals - segment;
+                    view.val = equals + 1;
+                    view.valLength = segmentLength - (view.keyLength + 1);
+                }
+                index += segmentLength + 1;
+            }
+            return count;
+        }
+
+        /**
+         * @brief Tokenize a binary frame in place, without allocating. Text values point into
+         * the frame, numeric values are rendered into the scratch buffer. Fields with unknown
+         * tags are skipped.
+         * 
+         * @param frame The received frame, starting with its header byte. Must outlive the views.
+         * @param frameLength The number of bytes in the frame.
+         * @param slots The caller-owned array the views are stored in.
+         * @param capacity The number of slots available. Fields beyond it are dropped.
+         * @param scratch The caller-owned buffer numeric values are rendered into.
+         * @param scratchCapacity The number of characters the scratch buffer can hold.
+         * @return size_t The number of views stored, 0 if the frame is not a supported record.
+         */
+        static size_t parseBinaryInto(
+            const uint8_t *frame,
+            size_t frameLength,
+            FieldView *slots,
+            size_t capacity,
+            char *scratch,
+            size_t scratchCapacity
+        ) {
+            if (
+                frameLength == 0
+                || !isBinaryFrame(frame[0])
+                || frameVersion(frame[0]) != WIRE_VERSION
+                || frameKind(frame[0]) != RECORD_FRAME
+                || frameProtection(frame[0]) != UNPROTECTED
+            ) {
+                return 0;
+            }
+            uint8_t tag;
+            const uint8_t *value;
+            uint8_t valueLength;
+            size_t count = 0;
+            size_t scratchUsed = 0;
+            FrameReader reader(frame + 1, frameLength - 1);
+            while (count < capacity && reader.next(tag, value, valueLength)) {
+                const char *text = (const char *) value;
+                const FieldSpec *spec = findFieldSpec(tag);
+                if (spec == nullptr) {
+                    const char *equals = (const char *) memchr(text, '=', valueLength);
+                    if (tag == KEY_VALUE_TAG && equals != nullptr) {
+                        FieldView &view = slots[count++];
+                        view.key = text;
+                        view.keyLength = equals - text;
+                        view.val = equals + 1;
+                        view.valLength = valueLength - (view.keyLength + 1);
+                    }
+                    continue;
+                }
+                FieldView &view = slots[count++];
+                view.key = spec->name;
+                view.keyLength = strlen(spec->name);
+                if (spec->type == TEXT_FIELD) {
+                    view.val = text;
+                    view.valLength = valueLength;
+                    continue;
+                }
+                const int32_t scaled = spec->type == FIXED_FIELD
+                    ? FrameReader::readFixed(value, valueLength)
+                    : lround(FrameReader::readFloat(value) * 100);
+                const uint8_t decimals = spec->type == FIXED_FIELD ? spec->decimals : 2;
+                view.val = scratch + scratchUsed;
+                view.valLength = formatFixed(
+                    scaled, decimals, scratch + scratchUsed, scratchCapacity - scratchUsed
+                );
+                scratchUsed += view.valLength;
+            }
+            return count;
+        }
+
+        /**
+         * @brief Deserialize a binary frame into a LoraDTO object. Fields with unknown tags
+         * are skipped, and fields that do not fit are dropped, marking the DTO as truncated.
+         *
+         * @param frame The received frame, starting with its header byte.
+         * @param frameLength The number of bytes in the frame.
+         * @return LoraDTO The deserialized LoraDTO object, empty if the frame is not a
+         * supported binary record.
+         */
+        static LoraDTO fromBinary(const uint8_t *frame, size_t frameLength) {
+            LoraDTO dto;
+            if (
+                frameLength == 0
+                || !isBinaryFrame(frame[0])
+                || frameVersion(frame[0]) != WIRE_VERSION
+                || frameKind(frame[0]) != RECORD_FRAME
+                || frameProtection(frame[0]) != UNPROTECTED
+            ) {
+                return dto;
+            }
+            uint8_t tag;
+            const uint8_t *value;
+            uint8_t valueLength;
+            FrameReader reader(frame + 1, frameLength - 1);
+            while (reader.next(tag, value, valueLength)) {
+                if (SerializableData::isKnownField(tag)) {
+                    dto.add(SerializableData::fromField(tag, value, valueLength));
+                }
+            }
+            return dto;
+        }
+
         /**
          * @brief Get the Data List of the Lora Response.
          * 
-         * @return SerializableData* The list of Serializable data items received.
+         * @return SerializableData* The list of Serializable data items received, owned by
+         * and valid as long as the Lora Response.
          */
         SerializableData *getDataList() {
             return this->dataList;
         }
 
+        const SerializableData *getDataList() const {
+            return this->dataList;
+        }
+
+        /**
+         * @brief Check whether a data item was dropped rather than added, for want of room
+         * or for a key or value too long to hold whole.
+         * 
+         */
+        bool isTruncated() const {
+            return this->truncated;
+        }
+
         /**
          * @brief Get the Data List Size.
          * 
          * @return int the number of Serializable data items received.
          */
-        int getDataListSize() {
+        int getDataListSize() const {
             return this->dataListSize;
         }
         
@@ -89,7 +306,7 @@ class LoraDTO {
          * 
          * @return String The serialized Lora Response.
          */
-        String toString() {
+        String toString() const {
             String serializedData = "";
             for (int i = 0; i < this->dataListSize; i++) {
                 serializedData += this->dataList[i].toString();
@@ -99,4 +316,32 @@ class LoraDTO {
             }
             return serializedData;
         }
+
+        /**
+         * @brief Serialize the Lora Response to a binary frame.
+         *
+         * @param buffer The buffer to write the frame into.
+         * @param capacity The number of bytes the buffer can hold.
+         * @return size_t The length of the frame, or 0 if it did not fit.
+         */
+        size_t toBinary(uint8_t *buffer, size_t capacity) const {
+            FrameWriter writer(buffer, capacity);
+            writer.putByte(makeFrameHeader(RECORD_FRAME));
+            writeFields(writer);
+            return writer.ok() ? writer.size() : 0;
+        }
+
+        /**
+         * @brief Append the fields of the Lora Response to the body of a RECORD_FRAME, which
+         * may be streamed straight into the radio.
+         *
+         * @param writer The writer to append to, past the frame header.
+         * @return bool Whether every field fit.
+         */
+        bool writeFields(FrameWriter &writer) const {
+            for (int i = 0; i < this->dataListSize; i++) {
+                this->dataList[i].writeTo(writer);
+            }
+            return writer.ok();
+        }
 };
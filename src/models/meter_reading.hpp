@@ -0,0 +1,51 @@
+/**
+ * @file meter_reading.hpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Contains the reading that a Node reports on each iteration, and its schema.
+ * @version 0.1
+ * @date 2022-04-09
+ * 
+ * @copyright Copyright (c) 2022
+ * 
+ */
+
+#pragma once
+
+#include "models/schema.hpp"
+#include "models/wire_format.hpp"
+
+/// The longest Device ID a reading can carry.
+#define MAX_DEVICE_ID_LENGTH 24
+
+/**
+ * @brief One electrometer reading, held without any String or heap allocation.
+ * 
+ */
+struct MeterReading {
+    /// The NUL-terminated Device ID of the node that took the reading. Left empty once the
+    /// node has a short address, which the gateway expands back to the Device ID.
+    char deviceID[MAX_DEVICE_ID_LENGTH + 1];
+
+    /// The RMS current in Amperes.
+    float current;
+
+    /// The RMS voltage in Volts.
+    float voltage;
+
+    /// When the reading was taken, in milliseconds of uptime of the device holding it. Not
+    /// part of the schema, as the clocks of nodes and gateways are unrelated; batch frames
+    /// carry the age of each reading instead.
+    uint32_t timestamp;
+
+    /// The short address the gateway assigned to the node that took the reading, 0 if none.
+    uint16_t nodeAddress;
+};
+
+/// The wire and REST layout of a MeterReading, generated at compile time.
+typedef Schema<
+    MeterReading,
+    SchemaField<MeterReading, char[MAX_DEVICE_ID_LENGTH + 1], &MeterReading::deviceID, DEVICE_ID_TAG>,
+    SchemaField<MeterReading, uint16_t, &MeterReading::nodeAddress, NODE_ADDRESS_TAG>,
+    SchemaField<MeterReading, float, &MeterReading::current, CURRENT_TAG>,
+    SchemaField<MeterReading, float, &MeterReading::voltage, VOLTAGE_TAG>
+> MeterReadingSchema;
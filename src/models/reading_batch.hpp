@@ -0,0 +1,285 @@
+/**
+ * @file reading_batch.hpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Contains a batch of readings packed into a single LoRa frame.
+ * @version 0.1
+ * @date 2022-04-13
+ * 
+ * @copyright Copyright (c) 2022
+ * 
+ */
+
+#pragma once
+
+#include "models/meter_reading.hpp"
+#include "models/wire_format.hpp"
+
+/// The most readings a batch holds. Enough to fill a frame with delta encoded MeterReadings
+/// of a steady load.
+#define BATCH_MAX_READINGS 80
+
+/// The bytes taken by the age of each packed reading.
+#define BATCH_AGE_WIDTH 2
+
+/// The largest age in seconds a packed reading can carry, the rest saturate to it.
+#define BATCH_MAX_AGE 32767
+
+/**
+ * @brief Accumulates readings of one node to send them as one BATCH_FRAME, so that the
+ * preamble, header and Device ID are paid once per frame instead of once per reading.
+ * 
+ * A BATCH_FRAME body holds the text fields of the first reading as tag-length-value fields
+ * terminated by an END_TAG, then the number of readings, then one packed record per reading:
+ * its age in seconds followed by its numeric fields at their fixed packed widths.
+ * 
+ * A DELTA_FRAME has the same layout, except that only the first packed record is written at
+ * fixed widths. Every later record holds how much younger it is than the previous one, then
+ * the change of each numeric field, all as zigzag varints. Slowly changing loads then take a
+ * byte or two per field instead of their full packed width.
+ * 
+ */
+class ReadingBatch {
+    private:
+        /// The readings waiting to be sent.
+        MeterReading readings[BATCH_MAX_READINGS];
+
+        /// The number of readings waiting to be sent.
+        size_t count;
+
+        /// The most readings to hold before the batch counts as full.
+        size_t maxReadings;
+
+        /// Whether readings after the first are sent as changes from the previous one.
+        bool deltaEncoding;
+
+        /// The most bytes the encoded frame may take.
+        size_t maxFrameLength;
+
+        /// The most bytes the frame holding the readings so far can take.
+        size_t frameLength;
+
+        /**
+         * @brief Get the age of a reading in whole seconds, saturated to BATCH_MAX_AGE.
+         * 
+         */
+        static int32_t ageOf(const MeterReading &reading, uint32_t now) {
+            const uint32_t age = (now - reading.timestamp) / 1000;
+            return age > BATCH_MAX_AGE ? BATCH_MAX_AGE : (int32_t) age;
+        }
+
+        /**
+         * @brief Get the most bytes the record of a reading can take after the readings
+         * already in the batch. Ages are only known once the batch is encoded, so the change in
+         * age is bounded by the gap between the timestamps plus one second of rounding.
+         * 
+         */
+        size_t recordLength(const MeterReading &reading) {
+            if (!deltaEncoding || count == 0) {
+                return BATCH_AGE_WIDTH + MeterReadingSchema::PACKED_SIZE;
+            }
+            const MeterReading &previous = readings[count - 1];
+            const uint32_t gap = (reading.timestamp - previous.timestamp) / 1000 + 1;
+            return varintLength(zigzagEncode(gap > BATCH_MAX_AGE ? BATCH_MAX_AGE : (int32_t) gap))
+                + MeterReadingSchema::deltaSize(reading, previous);
+        }
+
+    public:
+        /**
+         * @brief Construct a new, empty Reading Batch object
+         * 
+         * @param maxReadings The most readings to hold before the batch counts as full, capped
+         * at BATCH_MAX_READINGS. The batch is also full once another reading would not fit in
+         * one frame.
+         * @param deltaEncoding Whether to send a DELTA_FRAME rather than a BATCH_FRAME.
+         * @param maxFrameLength The longest the encoded frame may be, less than
+         * WIRE_MAX_FRAME_LENGTH when it must leave room for protection.
+         */
+        ReadingBatch(
+            size_t maxReadings = BATCH_MAX_READINGS,
+            bool deltaEncoding = false,
+            size_t maxFrameLength = WIRE_MAX_FRAME_LENGTH
+        ) {
+            this->maxReadings = maxReadings < BATCH_MAX_READINGS ? maxReadings : BATCH_MAX_READINGS;
+            this->deltaEncoding = deltaEncoding;
+            this->maxFrameLength = maxFrameLength < WIRE_MAX_FRAME_LENGTH ? maxFrameLength : WIRE_MAX_FRAME_LENGTH;
+            this->count = 0;
+            this->frameLength = 0;
+        }
+
+        /**
+         * @brief Add a reading to the batch.
+         * 
+         * @param reading The reading to add. Its text fields must match the ones of the
+         * readings already in the batch.
+         * @param overflow Whether the reading may go beyond maxReadings, up to what one frame
+         * holds, as while the batch waits for airtime.
+         * @return bool Whether the reading fit.
+         */
+        bool add(const MeterReading &reading, bool overflow = false) {
+            if (count == 0) {
+                uint8_t shared[WIRE_MAX_FRAME_LENGTH];
+                FrameWriter writer(shared, sizeof(shared));
+                MeterReadingSchema::writeShared(reading, writer);
+                frameLength = 1 + writer.size() + 1;
+            }
+            const size_t length = recordLength(reading);
+            if (count >= (overflow ? BATCH_MAX_READINGS : maxReadings) || frameLength + length > maxFrameLength) {
+                return false;
+            }
+            readings[count++] = reading;
+            frameLength += length;
+            return true;
+        }
+
+        /**
+         * @brief Check whether another reading might not fit in the batch. With delta
+         * encoding a reading that changed little may still be added to a full batch.
+         * 
+         */
+        bool isFull() {
+            return count >= maxReadings
+                || frameLength + BATCH_AGE_WIDTH + MeterReadingSchema::PACKED_SIZE > maxFrameLength;
+        }
+
+        /**
+         * @brief Get the number of readings in the batch.
+         * 
+         */
+        size_t size() {
+            return count;
+        }
+
+        /**
+         * @brief Get the most bytes the frame holding the readings so far can take, before
+         * any protection.
+         * 
+         */
+        size_t maxEncodedLength() {
+            return count > 0 ? frameLength : 0;
+        }
+
+        /**
+         * @brief Get the timestamp of the oldest reading in the batch. The batch must not be
+         * empty.
+         * 
+         */
+        uint32_t oldestTimestamp() {
+            return readings[0].timestamp;
+        }
+
+        /**
+         * @brief Empty the batch, typically after it was sent.
+         * 
+         */
+        void clear() {
+            count = 0;
+        }
+
+        /**
+         * @brief Get the kind of frame the batch is sent as.
+         * 
+         */
+        FrameKind kind() {
+            return deltaEncoding ? DELTA_FRAME : BATCH_FRAME;
+        }
+
+        /**
+         * @brief Serialize the batch to a BATCH_FRAME, or a DELTA_FRAME with delta encoding.
+         * 
+         * @param buffer The buffer to write the frame into.
+         * @param capacity The number of bytes the buffer can hold.
+         * @param now The current uptime in milliseconds, that ages are measured against.
+         * @return size_t The length of the frame, or 0 if it did not fit or the batch is empty.
+         */
+        size_t encode(uint8_t *buffer, size_t capacity, uint32_t now) {
+            FrameWriter writer(buffer, capacity);
+            writer.putByte(makeFrameHeader(kind()));
+            return writeBody(writer, now) ? writer.size() : 0;
+        }
+
+        /**
+         * @brief Append the body of the frame of the batch, which may be streamed straight
+         * into the radio.
+         * 
+         * @param writer The writer to append to, past the frame header.
+         * @param now The current uptime in milliseconds, that ages are measured against.
+         * @return bool Whether the batch is not empty and fit.
+         */
+        bool writeBody(FrameWriter &writer, uint32_t now) {
+            if (count == 0) {
+                return false;
+            }
+            MeterReadingSchema::writeShared(readings[0], writer);
+            writer.putByte((uint8_t) count);
+            for (size_t i = 0; i < count; i++) {
+                if (deltaEncoding && i > 0) {
+                    writer.putVarint(zigzagEncode(ageOf(readings[i - 1], now) - ageOf(readings[i], now)));
+                    MeterReadingSchema::writeDelta(readings[i], readings[i - 1], writer);
+                } else {
+                    writer.putFixedWidth(ageOf(readings[i], now), BATCH_AGE_WIDTH);
+                    MeterReadingSchema::writePacked(readings[i], writer);
+                }
+            }
+            return writer.ok();
+        }
+
+        /**
+         * @brief Deserialize a BATCH_FRAME or DELTA_FRAME into readings.
+         * 
+         * @param frame The received frame, starting with its header byte.
+         * @param frameLength The number of bytes in the frame.
+         * @param out The array to store the readings in.
+         * @param capacity The number of readings the array can hold.
+         * @param now The current uptime in milliseconds, that the timestamps of the readings
+         * are reconstructed against.
+         * @return size_t The number of readings stored, 0 if the frame is not a supported batch.
+         */
+        static size_t decode(
+            const uint8_t *frame,
+            size_t frameLength,
+            MeterReading *out,
+            size_t capacity,
+            uint32_t now
+        ) {
+            if (
+                frameLength == 0
+                || !isBinaryFrame(frame[0])
+                || frameVersion(frame[0]) != WIRE_VERSION
+                || (frameKind(frame[0]) != BATCH_FRAME && frameKind(frame[0]) != DELTA_FRAME)
+                || frameProtection(frame[0]) != UNPROTECTED
+            ) {
+                return 0;
+            }
+            FrameReader reader(frame + 1, frameLength - 1);
+            MeterReading shared = {};
+            MeterReadingSchema::readFields(reader, shared);
+            uint8_t readingCount;
+            if (!reader.readByte(readingCount)) {
+                return 0;
+            }
+            const bool deltaEncoded = frameKind(frame[0]) == DELTA_FRAME;
+            size_t decoded = 0;
+            int32_t age = 0;
+            while (decoded < readingCount && decoded < capacity) {
+                out[decoded] = shared;
+                if (deltaEncoded && decoded > 0) {
+                    uint32_t ageChange;
+                    if (
+                        !reader.readVarint(ageChange)
+                        || !MeterReadingSchema::readDelta(reader, out[decoded - 1], out[decoded])
+                    ) {
+                        break;
+                    }
+                    age -= zigzagDecode(ageChange);
+                } else if (
+                    !reader.readFixedWidth(BATCH_AGE_WIDTH, age)
+                    || !MeterReadingSchema::readPacked(reader, out[decoded])
+                ) {
+                    break;
+                }
+                out[decoded].timestamp = now - (uint32_t) age * 1000;
+                decoded++;
+            }
+            return decoded;
+        }
+};
@@ -0,0 +1,158 @@
+/**
+ * @file reading_columns.hpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Contains the columnar decode stage a gateway turns queued frames of readings into.
+ * @version 0.1
+ * @date 2022-04-24
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include "models/meter_reading.hpp"
+#include "models/reading_batch.hpp"
+#include "models/wire_format.hpp"
+
+/// The most readings a ReadingColumns holds. At least one full batch always fits.
+#define READING_COLUMNS_CAPACITY 256
+
+/**
+ * @brief A frame waiting in the gateway's receive queue, with what the radio measured when
+ * it arrived.
+ *
+ */
+struct ReceivedFrame {
+    /// The bytes of the frame, starting with its header byte and already decrypted.
+    uint8_t bytes[WIRE_MAX_FRAME_LENGTH];
+
+    /// The number of bytes in the frame.
+    size_t length;
+
+    /// The signal strength the frame arrived with, in dBm.
+    int16_t rssi;
+
+    /// The signal to noise ratio the frame arrived with, in dB.
+    float snr;
+
+    /// The uptime in milliseconds the frame arrived at, that ages in it count back from.
+    uint32_t receivedAt;
+
+    /// The short address of the node whose session key opened the frame, 0 if it was sealed
+    /// with the network key or sent in the clear.
+    uint16_t senderAddress;
+};
+
+/**
+ * @brief Readings decoded from many frames, kept as one contiguous array per field so that
+ * upload, aggregation and deduplication can run tight loops over them. Row i of every column
+ * belongs to the same reading.
+ *
+ */
+class ReadingColumns {
+    private:
+        /// The number of rows in use.
+        size_t count;
+
+        /// The readings of the frame being decoded, before they are spread over the columns.
+        MeterReading unpacked[BATCH_MAX_READINGS];
+
+    public:
+        /// The short address of the node each reading came from.
+        uint16_t nodeAddress[READING_COLUMNS_CAPACITY];
+
+        /// The gateway uptime in milliseconds each reading was taken at.
+        uint32_t timestamp[READING_COLUMNS_CAPACITY];
+
+        /// The current of each reading.
+        float current[READING_COLUMNS_CAPACITY];
+
+        /// The voltage of each reading.
+        float voltage[READING_COLUMNS_CAPACITY];
+
+        /// The signal strength of the frame each reading arrived in, in dBm.
+        int16_t rssi[READING_COLUMNS_CAPACITY];
+
+        /// The signal to noise ratio of the frame each reading arrived in, in dB.
+        float snr[READING_COLUMNS_CAPACITY];
+
+        /// The gateway uptime in milliseconds the frame each reading arrived in was received
+        /// at, shared by the readings of one frame.
+        uint32_t receivedAt[READING_COLUMNS_CAPACITY];
+
+        /**
+         * @brief Construct a new empty Reading Columns object
+         *
+         */
+        ReadingColumns() {
+            this->count = 0;
+        }
+
+        /**
+         * @brief Get the number of readings held.
+         *
+         */
+        size_t size() const {
+            return this->count;
+        }
+
+        /**
+         * @brief Forget every reading held.
+         *
+         */
+        void clear() {
+            this->count = 0;
+        }
+
+        /**
+         * @brief Decode queued frames of readings into the columns, in order, stopping at the
+         * first frame whose readings do not fit. RECORD_FRAMEs, BATCH_FRAMEs and DELTA_FRAMEs
+         * are understood; any other frame is consumed without adding rows.
+         *
+         * @param frames The queued frames.
+         * @param frameCount The number of queued frames.
+         * @param resolveNode Called with each decoded reading and the senderAddress of its
+         * frame, returns the short address of the node it came from, or 0 to drop the reading.
+         * @return size_t The number of frames consumed.
+         */
+        template <typename ResolveNode>
+        size_t decodeFrames(const ReceivedFrame *frames, size_t frameCount, ResolveNode resolveNode) {
+            size_t consumed = 0;
+            for (; consumed < frameCount; consumed++) {
+                const ReceivedFrame &frame = frames[consumed];
+                size_t decoded = 0;
+                if (frame.length > 0 && isBinaryFrame(frame.bytes[0]) && frameKind(frame.bytes[0]) == RECORD_FRAME) {
+                    this->unpacked[0] = {};
+                    this->unpacked[0].timestamp = frame.receivedAt;
+                    decoded = MeterReadingSchema::decode(frame.bytes, frame.length, this->unpacked[0]);
+                } else {
+                    decoded = ReadingBatch::decode(
+                        frame.bytes,
+                        frame.length,
+                        this->unpacked,
+                        BATCH_MAX_READINGS,
+                        frame.receivedAt
+                    );
+                }
+                if (decoded > READING_COLUMNS_CAPACITY - this->count) {
+                    break;
+                }
+                for (size_t i = 0; i < decoded; i++) {
+                    const uint16_t node = resolveNode(this->unpacked[i], frame.senderAddress);
+                    if (node == 0) {
+                        continue;
+                    }
+                    this->nodeAddress[this->count] = node;
+                    this->timestamp[this->count] = this->unpacked[i].timestamp;
+                    this->current[this->count] = this->unpacked[i].current;
+                    this->voltage[this->count] = this->unpacked[i].voltage;
+                    this->rssi[this->count] = frame.rssi;
+                    this->snr[this->count] = frame.snr;
+                    this->receivedAt[this->count] = frame.receivedAt;
+                    this->count++;
+                }
+            }
+            return consumed;
+        }
+};
@@ -0,0 +1,490 @@
+/**
+ * @file schema.hpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Contains a compile-time schema facility that generates wire encoders, decoders and
+ * REST field mappings for plain structs.
+ * @version 0.1
+ * @date 2022-04-09
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <type_traits>
+
+#include "models/delta_codec.hpp"
+#include "models/field_view.hpp"
+#include "models/wire_format.hpp"
+
+/**
+ * @brief Binds one member of a struct to a wire tag. The name, wire type and scaling of the
+ * field come from the tag's entry in FIELD_SPECS, so every schema agrees with the generic
+ * decoders by construction.
+ *
+ * Supported members are arithmetic (for FIXED_FIELD and FLOAT_FIELD tags) and char arrays (for
+ * TEXT_FIELD tags). Fields without a packed width identify the sender: they are sent once per
+ * frame, and left out entirely while unset, that is empty or zero.
+ *
+ * @tparam Record The struct holding the field.
+ * @tparam Value The type of the member.
+ * @tparam Member The member holding the field.
+ * @tparam Tag The tag of the field on the wire.
+ */
+template <typename Record, typename Value, Value Record::*Member, uint8_t Tag>
+class SchemaField {
+    private:
+        static_assert(findFieldSpec(Tag) != nullptr, "Schema fields need a tag in FIELD_SPECS");
+
+        /// The wire specification of the field.
+        static constexpr const FieldSpec &SPEC = *findFieldSpec(Tag);
+
+        /// Whether the member holds text.
+        static constexpr bool IS_TEXT = std::is_array<Value>::value;
+
+        /// Whether the field is sent once per frame rather than in every packed record.
+        static constexpr bool IS_SHARED = IS_TEXT || SPEC.packedWidth == 0;
+
+        /// Whether the member is an integer sent unscaled, and so kept exact rather than going
+        /// through float.
+        static constexpr bool IS_EXACT = std::is_integral<Value>::value && SPEC.type == FIXED_FIELD && SPEC.decimals == 0;
+
+        static_assert(
+            (SPEC.type == TEXT_FIELD) == IS_TEXT,
+            "Text tags need char array members and numeric tags need arithmetic members"
+        );
+
+        static_assert(
+            IS_SHARED || SPEC.packedWidth == 4 || SPEC.type == FIXED_FIELD,
+            "Packed float fields need four bytes"
+        );
+
+        /**
+         * @brief Scale a numeric member to its fixed-point wire value.
+         *
+         */
+        static int32_t scaled(const Record &record) {
+            if constexpr (IS_EXACT) {
+                return (int32_t) (record.*Member);
+            } else {
+                return lround((float) (record.*Member) * DECIMAL_SCALES[SPEC.decimals]);
+            }
+        }
+
+        /**
+         * @brief Get the integer a numeric member is packed as: its fixed-point value, or the
+         * bits of a FLOAT_FIELD.
+         *
+         */
+        static int32_t packedValue(const Record &record) {
+            if constexpr (SPEC.type == FLOAT_FIELD) {
+                int32_t bits;
+                const float value = record.*Member;
+                memcpy(&bits, &value, sizeof(bits));
+                return bits;
+            } else {
+                return scaled(record);
+            }
+        }
+
+        /**
+         * @brief Get the change of the packed value of a numeric member, wrapping like unsigned
+         * arithmetic so float bit patterns cannot overflow.
+         *
+         */
+        static int32_t delta(const Record &record, const Record &previous) {
+            return (int32_t) ((uint32_t) packedValue(record) - (uint32_t) packedValue(previous));
+        }
+
+        /**
+         * @brief Set a numeric member from the integer it is packed as.
+         *
+         */
+        static void setPackedValue(Record &record, int32_t value) {
+            if constexpr (SPEC.type == FLOAT_FIELD) {
+                float result;
+                memcpy(&result, &value, sizeof(result));
+                record.*Member = result;
+            } else if constexpr (IS_EXACT) {
+                record.*Member = (Value) value;
+            } else {
+                record.*Member = (float) value / DECIMAL_SCALES[SPEC.decimals];
+            }
+        }
+
+    public:
+        /// The tag of the field on the wire.
+        static constexpr uint8_t TAG = Tag;
+
+        /// The key of the field in REST requests.
+        static constexpr const char *NAME = SPEC.name;
+
+        /// The bytes the field takes in a packed batch record. Shared fields are not packed.
+        static constexpr size_t PACKED_WIDTH = IS_SHARED ? 0 : SPEC.packedWidth;
+
+        /**
+         * @brief Check whether the field of a record is sent. Only shared fields can be unset.
+         *
+         */
+        static bool isSet(const Record &record) {
+            if constexpr (IS_TEXT) {
+                return ((const char *) &(record.*Member))[0] != '\0';
+            } else if constexpr (IS_SHARED) {
+                return record.*Member != 0;
+            } else {
+                return true;
+            }
+        }
+
+        /**
+         * @brief Append the field of a record to a frame, unless it is unset.
+         *
+         * @return bool Whether the field fit.
+         */
+        static bool write(const Record &record, FrameWriter &writer) {
+            if (!isSet(record)) {
+                return true;
+            }
+            if constexpr (IS_TEXT) {
+                const char *text = (const char *) &(record.*Member);
+                return writer.putText(Tag, text, strnlen(text, sizeof(Value)));
+            } else if constexpr (SPEC.type == FLOAT_FIELD) {
+                return writer.putFloat(Tag, record.*Member);
+            } else {
+                return writer.putFixed(Tag, scaled(record));
+            }
+        }
+
+        /**
+         * @brief Append the field of a record to the shared section of a batch frame, if it
+         * is a shared field.
+         *
+         * @return bool Whether the field fit.
+         */
+        static bool writeShared(const Record &record, FrameWriter &writer) {
+            if constexpr (IS_SHARED) {
+                return write(record, writer);
+            } else {
+                return true;
+            }
+        }
+
+        /**
+         * @brief Append the field of a record to a packed batch record, at its fixed width.
+         *
+         * @return bool Whether the field fit.
+         */
+        static bool writePacked(const Record &record, FrameWriter &writer) {
+            if constexpr (IS_SHARED) {
+                return true;
+            } else {
+                return writer.putFixedWidth(packedValue(record), PACKED_WIDTH);
+            }
+        }
+
+        /**
+         * @brief Read the field of a packed batch record into a record.
+         *
+         * @return bool Whether enough bytes were left to read.
+         */
+        static bool readPacked(FrameReader &reader, Record &record) {
+            if constexpr (IS_SHARED) {
+                return true;
+            } else {
+                int32_t value;
+                if (!reader.readFixedWidth(PACKED_WIDTH, value)) {
+                    return false;
+                }
+                setPackedValue(record, value);
+                return true;
+            }
+        }
+
+        /**
+         * @brief Get the number of bytes writeDelta takes for the field of a record.
+         *
+         */
+        static size_t deltaSize(const Record &record, const Record &previous) {
+            if constexpr (IS_SHARED) {
+                return 0;
+            } else {
+                return varintLength(zigzagEncode(delta(record, previous)));
+            }
+        }
+
+        /**
+         * @brief Append the change of the field since the previous record as a zigzag varint.
+         *
+         * @return bool Whether the field fit.
+         */
+        static bool writeDelta(const Record &record, const Record &previous, FrameWriter &writer) {
+            if constexpr (IS_SHARED) {
+                return true;
+            } else {
+                return writer.putVarint(zigzagEncode(delta(record, previous)));
+            }
+        }
+
+        /**
+         * @brief Read the change of the field since the previous record into a record.
+         *
+         * @return bool Whether a whole varint was left to read.
+         */
+        static bool readDelta(FrameReader &reader, const Record &previous, Record &record) {
+            if constexpr (IS_SHARED) {
+                return true;
+            } else {
+                uint32_t encoded;
+                if (!reader.readVarint(encoded)) {
+                    return false;
+                }
+                setPackedValue(record, (int32_t) ((uint32_t) packedValue(previous) + (uint32_t) zigzagDecode(encoded)));
+                return true;
+            }
+        }
+
+        /**
+         * @brief Store a field read from a frame into a record, if it is this field.
+         *
+         * @return bool Whether the field was this one.
+         */
+        static bool read(uint8_t tag, const uint8_t *value, uint8_t valueLength, Record &record) {
+            if (tag != Tag) {
+                return false;
+            }
+            if constexpr (IS_TEXT) {
+                char *text = (char *) &(record.*Member);
+                const size_t length = valueLength < sizeof(Value) - 1 ? valueLength : sizeof(Value) - 1;
+                memcpy(text, value, length);
+                text[length] = '\0';
+            } else if constexpr (SPEC.type == FLOAT_FIELD) {
+                record.*Member = FrameReader::readFloat(value);
+            } else if constexpr (IS_EXACT) {
+                record.*Member = (Value) FrameReader::readFixed(value, valueLength);
+            } else {
+                record.*Member = (float) FrameReader::readFixed(value, valueLength) / DECIMAL_SCALES[SPEC.decimals];
+            }
+            return true;
+        }
+
+        /**
+         * @brief Point a view at the REST key and value of the field of a record.
+         *
+         * @param record The record holding the field. Must outlive the view.
+         * @param view The view to fill.
+         * @param scratch The buffer numeric values are rendered into.
+         * @param scratchCapacity The number of characters the scratch buffer can hold.
+         * @return size_t The number of scratch characters used.
+         */
+        static size_t view(const Record &record, FieldView &view, char *scratch, size_t scratchCapacity) {
+            view.key = NAME;
+            view.keyLength = strlen(NAME);
+            if constexpr (IS_TEXT) {
+                view.val = (const char *) &(record.*Member);
+                view.valLength = strnlen(view.val, sizeof(Value));
+                return 0;
+            } else {
+                const uint8_t decimals = SPEC.type == FLOAT_FIELD ? 2 : SPEC.decimals;
+                view.val = scratch;
+                view.valLength = formatFixed(
+                    lround((float) (record.*Member) * DECIMAL_SCALES[decimals]),
+                    decimals,
+                    scratch,
+                    scratchCapacity
+                );
+                return view.valLength;
+            }
+        }
+};
+
+/**
+ * @brief A struct whose fields are described at compile time, generating its binary and text
+ * encoders, its decoder and its REST field mapping.
+ *
+ * @tparam Record The struct being described.
+ * @tparam Fields The SchemaField of each member, in wire order.
+ */
+template <typename Record, typename... Fields>
+class Schema {
+    public:
+        /// The number of fields in the schema.
+        static constexpr size_t FIELD_COUNT = sizeof...(Fields);
+
+        /// The bytes the unshared fields of one record take in a packed batch record.
+        static constexpr size_t PACKED_SIZE = (Fields::PACKED_WIDTH + ... + 0);
+
+        /**
+         * @brief Append the shared fields of a record, common to every reading of a batch, to
+         * a frame, terminated by an END_TAG.
+         *
+         * @return bool Whether every field fit.
+         */
+        static bool writeShared(const Record &record, FrameWriter &writer) {
+            return (Fields::writeShared(record, writer) && ...) && writer.putByte(END_TAG);
+        }
+
+        /**
+         * @brief Append the numeric fields of a record to a frame as one packed record.
+         *
+         * @return bool Whether every field fit.
+         */
+        static bool writePacked(const Record &record, FrameWriter &writer) {
+            return (Fields::writePacked(record, writer) && ...);
+        }
+
+        /**
+         * @brief Read one packed record into the numeric fields of a record.
+         *
+         * @return bool Whether the whole record was read.
+         */
+        static bool readPacked(FrameReader &reader, Record &record) {
+            return (Fields::readPacked(reader, record) && ...);
+        }
+
+        /**
+         * @brief Get the number of bytes writeDelta takes for a record.
+         *
+         */
+        static size_t deltaSize(const Record &record, const Record &previous) {
+            return (Fields::deltaSize(record, previous) + ... + 0);
+        }
+
+        /**
+         * @brief Append the changes of the numeric fields of a record since the previous one,
+         * as zigzag varints.
+         *
+         * @return bool Whether every field fit.
+         */
+        static bool writeDelta(const Record &record, const Record &previous, FrameWriter &writer) {
+            return (Fields::writeDelta(record, previous, writer) && ...);
+        }
+
+        /**
+         * @brief Read the changes of the numeric fields of a record since the previous one.
+         *
+         * @return bool Whether the whole record was read.
+         */
+        static bool readDelta(FrameReader &reader, const Record &previous, Record &record) {
+            return (Fields::readDelta(reader, previous, record) && ...);
+        }
+
+        /**
+         * @brief Append every field of a record to a frame.
+         *
+         * @return bool Whether every field fit.
+         */
+        static bool writeFields(const Record &record, FrameWriter &writer) {
+            return (Fields::write(record, writer) && ...);
+        }
+
+        /**
+         * @brief Serialize a record to a binary RECORD_FRAME.
+         *
+         * @param record The record to serialize.
+         * @param buffer The buffer to write the frame into.
+         * @param capacity The number of bytes the buffer can hold.
+         * @return size_t The length of the frame, or 0 if it did not fit.
+         */
+        static size_t encode(const Record &record, uint8_t *buffer, size_t capacity) {
+            FrameWriter writer(buffer, capacity);
+            writer.putByte(makeFrameHeader(RECORD_FRAME));
+            writeFields(record, writer);
+            return writer.ok() ? writer.size() : 0;
+        }
+
+        /**
+         * @brief Read the fields of a frame body into a record. Unknown fields are skipped and
+         * missing ones are left untouched.
+         *
+         * @param reader The reader positioned at the first field.
+         * @param record The record to fill.
+         * @return size_t The number of schema fields read.
+         */
+        static size_t readFields(FrameReader &reader, Record &record) {
+            uint8_t tag;
+            const uint8_t *value;
+            uint8_t valueLength;
+            size_t count = 0;
+            while (reader.next(tag, value, valueLength)) {
+                count += (Fields::read(tag, value, valueLength, record) || ...);
+            }
+            return count;
+        }
+
+        /**
+         * @brief Deserialize a binary RECORD_FRAME into a record.
+         *
+         * @param frame The received frame, starting with its header byte.
+         * @param frameLength The number of bytes in the frame.
+         * @param record The record to fill.
+         * @return bool Whether the frame was a supported record holding at least one field.
+         */
+        static bool decode(const uint8_t *frame, size_t frameLength, Record &record) {
+            if (
+                frameLength == 0
+                || !isBinaryFrame(frame[0])
+                || frameVersion(frame[0]) != WIRE_VERSION
+                || frameKind(frame[0]) != RECORD_FRAME
+                || frameProtection(frame[0]) != UNPROTECTED
+            ) {
+                return false;
+            }
+            FrameReader reader(frame + 1, frameLength - 1);
+            return readFields(reader, record) > 0;
+        }
+
+        /**
+         * @brief Point views at the REST key and value of every set field of a record.
+         *
+         * @param record The record to map. Must outlive the views.
+         * @param slots The array to store the views in. Must hold FIELD_COUNT views.
+         * @param scratch The buffer numeric values are rendered into.
+         * @param scratchCapacity The number of characters the scratch buffer can hold.
+         * @return size_t The number of views stored.
+         */
+        static size_t toFields(const Record &record, FieldView *slots, char *scratch, size_t scratchCapacity) {
+            size_t index = 0;
+            size_t used = 0;
+            ((Fields::isSet(record)
+                ? (void) (used += Fields::view(record, slots[index++], scratch + used, scratchCapacity - used))
+                : (void) 0), ...);
+            return index;
+        }
+
+        /**
+         * @brief Serialize a record to a legacy "key=value&key=value" text message.
+         *
+         * @param record The record to serialize.
+         * @param buffer The buffer to write the NUL-terminated text into.
+         * @param capacity The number of characters the buffer can hold.
+         * @return size_t The length of the text, or 0 if it did not fit.
+         */
+        static size_t toText(const Record &record, char *buffer, size_t capacity) {
+            FieldView views[FIELD_COUNT];
+            char scratch[12 * FIELD_COUNT];
+            const size_t viewCount = toFields(record, views, scratch, sizeof(scratch));
+            size_t length = 0;
+            for (size_t i = 0; i < viewCount; i++) {
+                const size_t needed = views[i].keyLength + 1 + views[i].valLength + (i > 0);
+                if (length + needed + 1 > capacity) {
+                    return 0;
+                }
+                if (i > 0) {
+                    buffer[length++] = '&';
+                }
+                memcpy(buffer + length, views[i].key, views[i].keyLength);
+                length += views[i].keyLength;
+                buffer[length++] = '=';
+                memcpy(buffer + length, views[i].val, views[i].valLength);
+                length += views[i].valLength;
+            }
+            buffer[length] = '\0';
+            return length;
+        }
+};
@@ -10,28 +10,90 @@
  */
 #pragma once
 
+#include "models/wire_format.hpp"
+
+/// The longest key a SerializableData holds. Longer keys are truncated, and the data marked
+/// as such.
+#define SERIALIZABLE_MAX_KEY_LENGTH 15
+
+/// The longest value a SerializableData holds. Longer values are truncated, and the data
+/// marked as such.
+#define SERIALIZABLE_MAX_VAL_LENGTH 31
+
 /**
  * @brief Holds particular data to be sent in RESTful request or LoRA Communiation as key value pairs.
+ * The key and value are kept inline, so the data can be copied around without touching the heap.
  * 
  */
 class SerializableData {
     private:
-        /// The key of the data.
-        String key;
+        /// The NUL-terminated key of the data.
+        char key[SERIALIZABLE_MAX_KEY_LENGTH + 1];
+
+        /// The NUL-terminated value of the data.
+        char val[SERIALIZABLE_MAX_VAL_LENGTH + 1];
 
-        /// The value of the data.
-        String val;
+        /// Whether the key or value given was too long, and cut short.
+        bool truncated;
+
+        /**
+         * @brief Copy characters into an inline buffer, truncating them to fit.
+         *
+         * @param out The buffer to copy into.
+         * @param capacity The number of characters the buffer holds, including the NUL.
+         * @param text The characters to copy.
+         * @param length The number of characters to copy.
+         * @return bool Whether every character fit.
+         */
+        static bool copyText(char *out, size_t capacity, const char *text, size_t length) {
+            const bool fits = length < capacity;
+            length = fits ? length : capacity - 1;
+            memcpy(out, text, length);
+            out[length] = '\0';
+            return fits;
+        }
 
     public:
+        /**
+         * @brief Construct a new Rest Data object
+         * 
+         * @param key The NUL-terminated key of the data.
+         * @param val The NUL-terminated value of the data.
+         */
+        SerializableData(const char *key = "", const char *val = "")
+            : SerializableData(key, strlen(key), val, strlen(val)) { }
+
         /**
          * @brief Construct a new Rest Data object
          * 
          * @param key The key of the data.
          * @param val The value of the data.
          */
-        SerializableData(String key="", String val="") {
-            this->key = key;
-            this->val = val;
+        SerializableData(const String &key, const String &val)
+            : SerializableData(key.c_str(), val.c_str()) { }
+
+        /**
+         * @brief Construct a new Rest Data object from characters that are not NUL-terminated,
+         * such as those of a received frame.
+         * 
+         * @param key The characters of the key.
+         * @param keyLength The number of characters in the key.
+         * @param val The characters of the value.
+         * @param valLength The number of characters in the value.
+         */
+        SerializableData(const char *key, size_t keyLength, const char *val, size_t valLength) {
+            const bool keyFits = copyText(this->key, sizeof(this->key), key, keyLength);
+            const bool valFits = copyText(this->val, sizeof(this->val), val, valLength);
+            this->truncated = !keyFits || !valFits;
+        }
+
+        /**
+         * @brief Check whether the key or value given was longer than
+         * SERIALIZABLE_MAX_KEY_LENGTH or SERIALIZABLE_MAX_VAL_LENGTH, and so was cut short.
+         * 
+         */
+        bool isTruncated() const {
+            return this->truncated;
         }
 
         /**
@@ -39,8 +101,8 @@ class SerializableData {
          * 
          * @return String The key of the data.
          */
-        String getKey() {
-            return this->key;
+        String getKey() const {
+            return String(this->key);
         }
 
         /**
@@ -48,7 +110,25 @@ class SerializableData {
          * 
          * @return String The value of the data.
          */
-        String getVal() {
+        String getVal() const {
+            return String(this->val);
+        }
+
+        /**
+         * @brief Get the Key of the data without copying it.
+         * 
+         * @return const char* The NUL-terminated key, valid as long as the data.
+         */
+        const char *keyText() const {
+            return this->key;
+        }
+
+        /**
+         * @brief Get the Value of the data without copying it.
+         * 
+         * @return const char* The NUL-terminated value, valid as long as the data.
+         */
+        const char *valText() const {
             return this->val;
         }
 
@@ -56,23 +136,112 @@ class SerializableData {
          * @brief Convert the RestData object to a String.
          * 
          */
-        String toString() {
+        String toString() const {
             return String(this->key) + "=" + this->val;
         }
 
+        /**
+         * @brief Render the RestData object as "key=value" into a caller-owned buffer.
+         *
+         * @param out The buffer to render into. It is NUL-terminated.
+         * @param capacity The number of characters the buffer can hold.
+         * @return size_t The number of characters rendered, or 0 if they did not fit.
+         */
+        size_t toText(char *out, size_t capacity) const {
+            const size_t keyLength = strlen(this->key);
+            const size_t valLength = strlen(this->val);
+            if (keyLength + 1 + valLength >= capacity) {
+                return 0;
+            }
+            memcpy(out, this->key, keyLength);
+            out[keyLength] = '=';
+            memcpy(out + keyLength + 1, this->val, valLength + 1);
+            return keyLength + 1 + valLength;
+        }
+
         /**
          * @brief Convert serialized String to RestData object.
          * 
          */
-        static SerializableData fromString(String serialized) {
-            String key = serialized.substring(0, serialized.indexOf("="));
-            String val = serialized.substring(serialized.indexOf("=") + 1);
-            return SerializableData(key, val);
+        static SerializableData fromString(const String &serialized) {
+            return fromText(serialized.c_str(), serialized.length());
         }
 
         /**
-         * @brief Destroy the Rest Data object
-         * 
+         * @brief Convert serialized "key=value" characters to RestData object. Without an "="
+         * every character is taken as the key.
+         *
+         * @param serialized The characters to convert, not necessarily NUL-terminated.
+         * @param length The number of characters.
          */
-        ~SerializableData() { }
-};
\ No newline at end of file
+        static SerializableData fromText(const char *serialized, size_t length) {
+            const char *equals = (const char *) memchr(serialized, '=', length);
+            if (equals == nullptr) {
+                return SerializableData(serialized, length, "", 0);
+            }
+            const size_t keyLength = equals - serialized;
+            return SerializableData(serialized, keyLength, equals + 1, length - keyLength - 1);
+        }
+
+        /**
+         * @brief Append the data to a binary frame as a tagged field. Keys without a tag of
+         * their own are sent as a KEY_VALUE_TAG text pair.
+         *
+         * @param writer The writer of the frame being built.
+         * @return bool Whether the field fit in the frame.
+         */
+        bool writeTo(FrameWriter &writer) const {
+            const FieldSpec *spec = findFieldSpec(this->key);
+            if (spec == nullptr) {
+                char pair[sizeof(this->key) + sizeof(this->val)];
+                const size_t pairLength = toText(pair, sizeof(pair));
+                return writer.putText(KEY_VALUE_TAG, pair, pairLength);
+            }
+            switch (spec->type) {
+                case FIXED_FIELD:
+                    return writer.putFixed(
+                        spec->tag,
+                        lround(strtod(this->val, nullptr) * DECIMAL_SCALES[spec->decimals])
+                    );
+                case FLOAT_FIELD:
+                    return writer.putFloat(spec->tag, strtof(this->val, nullptr));
+                default:
+                    return writer.putText(spec->tag, this->val, strlen(this->val));
+            }
+        }
+
+        /**
+         * @brief Check whether a field read from a binary frame can be converted back.
+         *
+         * @param tag The tag of the field.
+         */
+        static bool isKnownField(uint8_t tag) {
+            return tag == KEY_VALUE_TAG || findFieldSpec(tag) != nullptr;
+        }
+
+        /**
+         * @brief Convert a tagged field read from a binary frame to RestData object, without
+         * allocating.
+         *
+         * @param tag The tag of the field. Must satisfy isKnownField.
+         * @param value The value bytes of the field.
+         * @param valueLength The number of value bytes.
+         */
+        static SerializableData fromField(uint8_t tag, const uint8_t *value, uint8_t valueLength) {
+            const char *text = (const char *) value;
+            const FieldSpec *spec = findFieldSpec(tag);
+            if (spec == nullptr) {
+                return SerializableData::fromText(text, valueLength);
+            } else if (spec->type == TEXT_FIELD) {
+                return SerializableData(spec->name, strlen(spec->name), text, valueLength);
+            }
+            const int32_t scaled = spec->type == FIXED_FIELD
+                ? FrameReader::readFixed(value, valueLength)
+                : lround(FrameReader::readFloat(value) * 100);
+            char rendered[SERIALIZABLE_MAX_VAL_LENGTH + 1];
+            const size_t renderedLength = formatFixed(
+                scaled, spec->type == FIXED_FIELD ? spec->decimals : 2, rendered, sizeof(rendered)
+            );
+            return SerializableData(spec->name, strlen(spec->name), rendered, renderedLength);
+        }
+};
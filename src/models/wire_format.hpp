@@ -0,0 +1,626 @@
+/**
+ * @file wire_format.hpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Contains the compact binary type-length-value wire format for LoRa frames.
+ * @version 0.1
+ * @date 2022-04-02
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <Print.h>
+
+#include "models/delta_codec.hpp"
+
+/// The largest payload the SX127x FIFO can hold in one packet (MAX_PKT_LENGTH in LoRa.cpp).
+#define WIRE_MAX_FRAME_LENGTH 255
+
+/// Set in the first byte of every binary frame. ASCII text never sets it, which is how a
+/// receiver tells binary frames apart from legacy text ones.
+#define WIRE_BINARY_MARKER 0x80
+
+/// The version of the binary wire format written by this firmware.
+#define WIRE_VERSION 1
+
+/**
+ * @brief The kind of body that follows the frame header (bits 3-2 of the header).
+ *
+ */
+enum FrameKind {
+    /// A single record of tag-length-value fields.
+    RECORD_FRAME = 0,
+    /// Many readings sharing their text fields, see models/reading_batch.hpp.
+    BATCH_FRAME = 1,
+    /// A BATCH_FRAME whose readings after the first are sent as changes from the previous one.
+    DELTA_FRAME = 2,
+    /// A ControlOpcode byte followed by tag-length-value fields, managing the network rather
+    /// than carrying readings.
+    CONTROL_FRAME = 3
+};
+
+/**
+ * @brief The protection applied to the frame body (bits 1-0 of the header).
+ *
+ */
+enum FrameProtection {
+    /// The body is sent in the clear.
+    UNPROTECTED = 0,
+    /// The body is encrypted with AES-CTR and follows a little endian nonce. It carries no
+    /// MIC, so it is no longer sent and receivers reject it.
+    ENCRYPTED = 1,
+    /// The body is encrypted with AES-CCM, follows a key ID and a little endian nonce, and is
+    /// followed by a MIC over the header, key ID and body, see services/cipher_stream.hpp. The
+    /// header, key ID and nonce stay in the clear.
+    AUTHENTICATED = 2,
+    /// The body is sent in the clear, laid out like an AUTHENTICATED one, and followed by a
+    /// truncated AES-CMAC tag over the whole frame, see services/signing_stream.hpp. For data
+    /// that may be read by anyone but must not be tampered with.
+    SIGNED = 3
+};
+
+/**
+ * @brief The first byte of the body of a CONTROL_FRAME.
+ *
+ */
+enum ControlOpcode {
+    /// Sent by a node to ask for a short address, see models/join_message.hpp.
+    JOIN_REQUEST = 0x01,
+    /// Sent by the gateway to assign a short address to a node.
+    JOIN_ACCEPT = 0x02,
+    /// Sent by the gateway to set the spreading factor and TX power of a node, see
+    /// models/link_command.hpp.
+    LINK_ADR = 0x03,
+    /// Sent by the gateway to a node whose session it does not hold, to have it join again.
+    REJOIN = 0x04
+};
+
+/**
+ * @brief One-byte tags identifying each field on the wire.
+ *
+ */
+enum FieldTag {
+    /// Terminates a record early; also lets block ciphers zero-pad a body.
+    END_TAG = 0x00,
+    DEVICE_ID_TAG = 0x01,
+    CURRENT_TAG = 0x02,
+    VOLTAGE_TAG = 0x03,
+    POWER_TAG = 0x04,
+    /// Seconds between a reading being taken and the frame carrying it being sent.
+    AGE_TAG = 0x05,
+    /// The short address a gateway assigned to a node, sent in place of its Device ID.
+    NODE_ADDRESS_TAG = 0x06,
+    /// A compressed block of past samples, see models/history_block.hpp.
+    HISTORY_TAG = 0x07,
+    /// The random numbers a node and the gateway each contribute to a session key when the
+    /// node joins, see models/join_message.hpp.
+    NODE_NONCE_TAG = 0x08,
+    GATEWAY_NONCE_TAG = 0x09,
+    /// The radio settings the gateway assigns a node, and how long from now to switch to
+    /// them, see models/link_command.hpp.
+    SPREADING_FACTOR_TAG = 0x0A,
+    TX_POWER_TAG = 0x0B,
+    SWITCH_DELAY_TAG = 0x0C,
+    /// Carries a "key=value" pair whose key has no tag of its own.
+    KEY_VALUE_TAG = 0x7F
+};
+
+/**
+ * @brief How the value of a field is laid out on the wire.
+ *
+ */
+enum FieldType {
+    /// Raw characters, not NUL-terminated.
+    TEXT_FIELD,
+    /// A little-endian two's complement integer of 1, 2 or 4 bytes, scaled by 10^decimals.
+    FIXED_FIELD,
+    /// A little-endian IEEE-754 single precision float.
+    FLOAT_FIELD
+};
+
+/**
+ * @brief Describes how a tagged field is named in REST requests and encoded on the wire.
+ *
+ */
+struct FieldSpec {
+    /// The tag of the field on the wire.
+    FieldTag tag;
+
+    /// The key of the field in REST requests and legacy text frames.
+    const char *name;
+
+    /// How the value is laid out on the wire.
+    FieldType type;
+
+    /// The number of decimal places kept by FIXED_FIELD values.
+    uint8_t decimals;
+
+    /// The fixed number of bytes the value takes in a packed batch record, 0 for fields that
+    /// identify the sender and are sent once per frame instead.
+    uint8_t packedWidth;
+};
+
+/// The fields that have a tag of their own.
+static constexpr FieldSpec FIELD_SPECS[] = {
+    { DEVICE_ID_TAG, "deviceID", TEXT_FIELD, 0, 0 },
+    { CURRENT_TAG, "current", FIXED_FIELD, 2, 2 },
+    { VOLTAGE_TAG, "voltage", FIXED_FIELD, 1, 2 },
+    { POWER_TAG, "power", FIXED_FIELD, 1, 4 },
+    { AGE_TAG, "age", FIXED_FIELD, 0, 2 },
+    { NODE_ADDRESS_TAG, "nodeAddress", FIXED_FIELD, 0, 0 },
+    { NODE_NONCE_TAG, "nodeNonce", FIXED_FIELD, 0, 0 },
+    { GATEWAY_NONCE_TAG, "gatewayNonce", FIXED_FIELD, 0, 0 },
+    { SPREADING_FACTOR_TAG, "spreadingFactor", FIXED_FIELD, 0, 0 },
+    { TX_POWER_TAG, "txPower", FIXED_FIELD, 0, 0 },
+    { SWITCH_DELAY_TAG, "switchDelay", FIXED_FIELD, 0, 0 },
+};
+
+/// Powers of ten used to scale FIXED_FIELD values.
+static constexpr int32_t DECIMAL_SCALES[] = { 1, 10, 100, 1000, 10000 };
+
+/**
+ * @brief Find the specification of a tagged field.
+ *
+ * @param tag The tag to look up.
+ * @return const FieldSpec* The specification, or null if the tag is unknown.
+ */
+constexpr const FieldSpec *findFieldSpec(uint8_t tag) {
+    for (size_t i = 0; i < sizeof(FIELD_SPECS) / sizeof(FIELD_SPECS[0]); i++) {
+        if (FIELD_SPECS[i].tag == tag) {
+            return &FIELD_SPECS[i];
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Find the specification of a field by its REST key.
+ *
+ * @param name The NUL-terminated key to look up.
+ * @return const FieldSpec* The specification, or null if the key has no tag.
+ */
+inline const FieldSpec *findFieldSpec(const char *name) {
+    for (size_t i = 0; i < sizeof(FIELD_SPECS) / sizeof(FIELD_SPECS[0]); i++) {
+        if (strcmp(FIELD_SPECS[i].name, name) == 0) {
+            return &FIELD_SPECS[i];
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Render a scaled FIXED_FIELD value as decimal text without going through floating
+ * point formatting, which may allocate on newlib.
+ *
+ * @param scaled The value multiplied by 10^decimals.
+ * @param decimals The number of decimal places to render.
+ * @param out The buffer to render into. Not NUL-terminated.
+ * @param capacity The number of characters the buffer can hold.
+ * @return size_t The number of characters rendered, or 0 if they did not fit.
+ */
+inline size_t formatFixed(int32_t scaled, uint8_t decimals, char *out, size_t capacity) {
+    char digits[12];
+    size_t count = 0;
+    uint32_t magnitude = scaled < 0 ? 0u - (uint32_t) scaled : (uint32_t) scaled;
+    // Emit digits least significant first, with at least one before the decimal point.
+    do {
+        digits[count++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude > 0 || count <= decimals);
+    const size_t length = count + (scaled < 0) + (decimals > 0);
+    if (length > capacity) {
+        return 0;
+    }
+    size_t position = 0;
+    if (scaled < 0) {
+        out[position++] = '-';
+    }
+    while (count > 0) {
+        if (count == decimals) {
+            out[position++] = '.';
+        }
+        out[position++] = digits[--count];
+    }
+    return position;
+}
+
+/**
+ * @brief Build the one-byte header that starts every binary frame.
+ *
+ * @param kind The kind of body that follows.
+ * @param protection The protection applied to the body.
+ * @return uint8_t The header byte.
+ */
+inline uint8_t makeFrameHeader(FrameKind kind, FrameProtection protection = UNPROTECTED) {
+    return WIRE_BINARY_MARKER | (WIRE_VERSION << 4) | ((kind & 0x03) << 2) | (protection & 0x03);
+}
+
+/**
+ * @brief Check whether a received payload is a binary frame rather than legacy text.
+ *
+ * @param firstByte The first byte of the payload.
+ */
+inline bool isBinaryFrame(uint8_t firstByte) {
+    return (firstByte & WIRE_BINARY_MARKER) != 0;
+}
+
+/// The wire format version a frame header was written with.
+inline uint8_t frameVersion(uint8_t header) {
+    return (header >> 4) & 0x07;
+}
+
+/// The kind of body that follows a frame header.
+inline FrameKind frameKind(uint8_t header) {
+    return (FrameKind) ((header >> 2) & 0x03);
+}
+
+/// The protection applied to the body that follows a frame header.
+inline FrameProtection frameProtection(uint8_t header) {
+    return (FrameProtection) (header & 0x03);
+}
+
+/**
+ * @brief Appends tag-length-value fields to a caller-owned frame buffer, or streams them
+ * straight into a Print sink such as the LoRa radio, without buffering the frame at all.
+ *
+ */
+class FrameWriter {
+    private:
+        /// The buffer the frame is written into, null when streaming.
+        uint8_t *buffer;
+
+        /// The sink the frame is streamed into, null when buffering.
+        Print *sink;
+
+        /// The most bytes the frame can take.
+        size_t capacity;
+
+        /// The number of bytes written so far.
+        size_t length;
+
+        /// Whether a write did not fit in the frame.
+        bool overflowed;
+
+        /**
+         * @brief Check that a number of bytes still fit in the frame, failing every later
+         * write if they do not.
+         *
+         */
+        bool reserve(size_t count) {
+            if (overflowed || length + count > capacity) {
+                overflowed = true;
+                return false;
+            }
+            return true;
+        }
+
+        /**
+         * @brief Append bytes already reserved to the buffer or the sink.
+         *
+         */
+        void emit(const uint8_t *bytes, size_t count) {
+            if (sink != nullptr) {
+                sink->write(bytes, count);
+            } else if (buffer != nullptr) {
+                memcpy(buffer + length, bytes, count);
+            }
+            length += count;
+        }
+
+        /**
+         * @brief Append a field whose value is a little-endian integer of some width.
+         *
+         * @return bool Whether the field fit.
+         */
+        bool putInteger(uint8_t tag, uint32_t value, uint8_t width) {
+            if (!reserve(2 + width)) {
+                return false;
+            }
+            uint8_t field[2 + sizeof(value)] = { tag, width };
+            for (uint8_t i = 0; i < width; i++) {
+                field[2 + i] = (uint8_t) (value >> (8 * i));
+            }
+            emit(field, 2 + width);
+            return true;
+        }
+
+    public:
+        /**
+         * @brief Construct a new Frame Writer object writing into a buffer.
+         *
+         * @param buffer The buffer the frame is written into, or null to only measure how
+         * long the frame would be.
+         * @param capacity The number of bytes the buffer can hold.
+         */
+        FrameWriter(uint8_t *buffer, size_t capacity) {
+            this->buffer = buffer;
+            this->sink = nullptr;
+            this->capacity = capacity;
+            this->length = 0;
+            this->overflowed = false;
+        }
+
+        /**
+         * @brief Construct a new Frame Writer object streaming into a sink. Each field is
+         * checked against the capacity before any of it is written, but fields written before
+         * an overflow have already reached the sink.
+         *
+         * @param sink The sink the frame is streamed into.
+         * @param capacity The most bytes the frame can take.
+         */
+        FrameWriter(Print &sink, size_t capacity) {
+            this->buffer = nullptr;
+            this->sink = &sink;
+            this->capacity = capacity;
+            this->length = 0;
+            this->overflowed = false;
+        }
+
+        /**
+         * @brief Append a raw byte, such as the frame header.
+         *
+         * @return bool Whether the byte fit.
+         */
+        bool putByte(uint8_t value) {
+            if (!reserve(1)) {
+                return false;
+            }
+            emit(&value, 1);
+            return true;
+        }
+
+        /**
+         * @brief Append a text field.
+         *
+         * @param tag The tag of the field.
+         * @param text The characters of the value.
+         * @param textLength The number of characters in the value.
+         * @return bool Whether the field fit.
+         */
+        bool putText(uint8_t tag, const char *text, size_t textLength) {
+            if (textLength > 0xFF) {
+                overflowed = true;
+            }
+            if (!reserve(2 + textLength)) {
+                return false;
+            }
+            const uint8_t header[2] = { tag, (uint8_t) textLength };
+            emit(header, sizeof(header));
+            emit((const uint8_t *) text, textLength);
+            return true;
+        }
+
+        /**
+         * @brief Append an integer field using the fewest little-endian bytes that hold it.
+         *
+         * @param tag The tag of the field.
+         * @param value The (already scaled) value of the field.
+         * @return bool Whether the field fit.
+         */
+        bool putFixed(uint8_t tag, int32_t value) {
+            const uint8_t width = (value >= INT8_MIN && value <= INT8_MAX) ? 1
+                : (value >= INT16_MIN && value <= INT16_MAX) ? 2 : 4;
+            return putInteger(tag, (uint32_t) value, width);
+        }
+
+        /**
+         * @brief Append a bare little-endian integer of a fixed width, as used by packed
+         * records. Values outside the range of the width saturate.
+         *
+         * @param value The (already scaled) value.
+         * @param width The number of bytes to write (1, 2 or 4).
+         * @return bool Whether the value fit.
+         */
+        bool putFixedWidth(int32_t value, uint8_t width) {
+            if (!reserve(width)) {
+                return false;
+            }
+            if (width < 4) {
+                const int32_t limit = (int32_t) 1 << (8 * width - 1);
+                value = value < -limit ? -limit : value > limit - 1 ? limit - 1 : value;
+            }
+            uint8_t bytes[sizeof(value)];
+            for (uint8_t i = 0; i < width; i++) {
+                bytes[i] = (uint8_t) ((uint32_t) value >> (8 * i));
+            }
+            emit(bytes, width);
+            return true;
+        }
+
+        /**
+         * @brief Append a bare unsigned varint, see varintLength.
+         *
+         * @param value The value to append.
+         * @return bool Whether the value fit.
+         */
+        bool putVarint(uint32_t value) {
+            if (!reserve(varintLength(value))) {
+                return false;
+            }
+            uint8_t bytes[MAX_VARINT_LENGTH];
+            uint8_t count = 0;
+            while (value >= 0x80) {
+                bytes[count++] = (uint8_t) (value | 0x80);
+                value >>= 7;
+            }
+            bytes[count++] = (uint8_t) value;
+            emit(bytes, count);
+            return true;
+        }
+
+        /**
+         * @brief Append a single precision float field.
+         *
+         * @param tag The tag of the field.
+         * @param value The value of the field.
+         * @return bool Whether the field fit.
+         */
+        bool putFloat(uint8_t tag, float value) {
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            return putInteger(tag, bits, sizeof(bits));
+        }
+
+        /**
+         * @brief Get the number of bytes written so far.
+         *
+         */
+        size_t size() {
+            return this->length;
+        }
+
+        /**
+         * @brief Check whether every write so far fit in the frame.
+         *
+         */
+        bool ok() {
+            return !this->overflowed;
+        }
+};
+
+/**
+ * @brief Walks the tag-length-value fields of a received frame body without copying them.
+ *
+ */
+class FrameReader {
+    private:
+        /// The frame body being read.
+        const uint8_t *buffer;
+
+        /// The number of bytes in the frame body.
+        size_t length;
+
+        /// The offset of the next field.
+        size_t position;
+
+    public:
+        /**
+         * @brief Construct a new Frame Reader object
+         *
+         * @param buffer The frame body, starting after the header byte.
+         * @param length The number of bytes in the frame body.
+         */
+        FrameReader(const uint8_t *buffer, size_t length) {
+            this->buffer = buffer;
+            this->length = length;
+            this->position = 0;
+        }
+
+        /**
+         * @brief Read the next field.
+         *
+         * @param tag Set to the tag of the field.
+         * @param value Set to point at the value of the field inside the frame.
+         * @param valueLength Set to the number of bytes in the value.
+         * @return bool Whether a field was read. False at the end of the body, at an END_TAG
+         * (which is consumed), or if the remaining bytes are truncated.
+         */
+        bool next(uint8_t &tag, const uint8_t *&value, uint8_t &valueLength) {
+            if (position < length && buffer[position] == END_TAG) {
+                position++;
+                return false;
+            }
+            if (position + 2 > length) {
+                return false;
+            }
+            const uint8_t fieldLength = buffer[position + 1];
+            if (position + 2 + fieldLength > length) {
+                return false;
+            }
+            tag = buffer[position];
+            valueLength = fieldLength;
+            value = buffer + position + 2;
+            position += 2 + fieldLength;
+            return true;
+        }
+
+        /**
+         * @brief Read a bare byte, such as the reading count of a batch.
+         *
+         * @param value Set to the byte read.
+         * @return bool Whether a byte was left to read.
+         */
+        bool readByte(uint8_t &value) {
+            if (position >= length) {
+                return false;
+            }
+            value = buffer[position++];
+            return true;
+        }
+
+        /**
+         * @brief Read a bare little-endian integer of a fixed width, as used by packed records.
+         *
+         * @param width The number of bytes to read (1, 2 or 4).
+         * @param value Set to the sign-extended (still scaled) value.
+         * @return bool Whether enough bytes were left to read.
+         */
+        bool readFixedWidth(uint8_t width, int32_t &value) {
+            if (position + width > length) {
+                return false;
+            }
+            value = readFixed(buffer + position, width);
+            position += width;
+            return true;
+        }
+
+        /**
+         * @brief Read a bare unsigned varint, see varintLength.
+         *
+         * @param value Set to the value read.
+         * @return bool Whether a whole varint of at most MAX_VARINT_LENGTH bytes was read.
+         */
+        bool readVarint(uint32_t &value) {
+            value = 0;
+            for (size_t i = 0; i < MAX_VARINT_LENGTH && position < length; i++) {
+                const uint8_t byte = buffer[position++];
+                value |= (uint32_t) (byte & 0x7F) << (7 * i);
+                if ((byte & 0x80) == 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * @brief Decode the value of a FIXED_FIELD.
+         *
+         * @param value The value bytes.
+         * @param valueLength The number of value bytes (1, 2 or 4).
+         * @return int32_t The sign-extended (still scaled) value.
+         */
+        static int32_t readFixed(const uint8_t *value, uint8_t valueLength) {
+            uint32_t bits = 0;
+            for (uint8_t i = 0; i < valueLength && i < 4; i++) {
+                bits |= (uint32_t) value[i] << (8 * i);
+            }
+            if (valueLength == 1) {
+                return (int8_t) bits;
+            } else if (valueLength == 2) {
+                return (int16_t) bits;
+            }
+            return (int32_t) bits;
+        }
+
+        /**
+         * @brief Decode the value of a FLOAT_FIELD.
+         *
+         * @param value The four value bytes.
+         * @return float The decoded value.
+         */
+        static float readFloat(const uint8_t *value) {
+            uint32_t bits = 0;
+            for (uint8_t i = 0; i < sizeof(bits); i++) {
+                bits |= (uint32_t) value[i] << (8 * i);
+            }
+            float result;
+            memcpy(&result, &bits, sizeof(result));
+            return result;
+        }
+};
@@ -0,0 +1,495 @@
+/**
+ * @file adr_engine.hpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Contains the adaptive data rate engine a gateway picks the radio settings of its
+ * nodes with, from the signal quality of their frames.
+ * @version 0.1
+ * @date 2022-05-06
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "models/link_command.hpp"
+
+/// The nodes the engine tracks, one per short address the NodeRegistry hands out.
+#define ADR_ENGINE_CAPACITY 64
+
+/// The frames of each node whose signal to noise ratio is remembered. Settings are only made
+/// faster once every node has this many.
+#define ADR_HISTORY_LENGTH 16
+
+/// The spreading factors the radio supports, and the one LoRaClass::begin starts at, which
+/// every node uses until it is told otherwise and falls back to when the gateway is lost. The
+/// network only runs slower than the default once the gateway misses frames of a node there.
+#define ADR_MIN_SPREADING_FACTOR 7
+#define ADR_MAX_SPREADING_FACTOR 12
+#define ADR_DEFAULT_SPREADING_FACTOR 11
+
+/// The TX powers assigned, in dBm. Nodes start at the highest, which is LORA_TX_POWER.
+#define ADR_MIN_TX_POWER 2
+#define ADR_MAX_TX_POWER 14
+
+/// The dB a link must have above the demodulation floor of its spreading factor, for fading
+/// and interference, until its history is complete, as LoRaWAN network servers keep.
+#define ADR_INSTALLATION_MARGIN 10
+
+/// The dB a link with a complete history must have above the demodulation floor instead: a
+/// fixed part, plus as many standard deviations of the signal to noise ratio of its latest
+/// frames, so that a steady link is not held to the margin of one that fades.
+#define ADR_MIN_MARGIN 2
+#define ADR_MARGIN_DEVIATIONS 1.5f
+
+/// The dB the TX power is lowered by for each step of spare margin.
+#define ADR_TX_POWER_STEP 3
+
+/// The frames after which a node is sent its settings again even if they did not change, so
+/// that it knows the gateway still hears it. Below LORA_LINK_CHECK_LIMIT.
+#define ADR_KEEPALIVE_INTERVAL 8
+
+/// The frames a node may miss in a row before it is taken for lost: it is forgotten, and the
+/// network falls back to ADR_DEFAULT_SPREADING_FACTOR for it to be found again. Above
+/// LORA_LINK_CHECK_LIMIT + LORA_LINK_SCAN_DWELL, so that the node first tried full power at
+/// the spreading factor of the network.
+#define ADR_SILENT_FRAMES 40
+
+/// How long a node whose interval between frames is not known yet may go unheard before it is
+/// taken for lost, in milliseconds.
+#define ADR_NODE_TIMEOUT 600000
+
+/// The frames a node may miss in a row and still be assumed to send at the TX power it was
+/// told. Below LORA_LINK_CHECK_LIMIT: beyond it, the node may have raised its power to find
+/// the gateway, so its history starts over.
+#define ADR_RESTART_FRAMES 16
+
+/// The bounds of how long the gateway gives its nodes to hear about a new spreading factor
+/// before everyone switches, in milliseconds.
+#define ADR_MIN_SWITCH_DELAY 10000
+#define ADR_MAX_SWITCH_DELAY 600000
+
+/**
+ * @brief What the engine knows about the link of one node.
+ *
+ */
+struct NodeLink {
+    /// Whether the node was heard since it was last forgotten.
+    bool active;
+
+    /// The signal to noise ratio of its latest frames in dB, as if sent at ADR_MAX_TX_POWER,
+    /// in a ring indexed by the number of frames seen.
+    float snr[ADR_HISTORY_LENGTH];
+
+    /// The number of frames the gateway missed right before each of the latest frames, in
+    /// the same ring.
+    uint8_t missed[ADR_HISTORY_LENGTH];
+
+    /// The number of frames recorded.
+    uint32_t frames;
+
+    /// The signal strength of the last frame, in dBm.
+    int16_t rssi;
+
+    /// The gateway uptime the last frame was received at, and the time between frames the
+    /// node sends, in milliseconds.
+    uint32_t lastHeard;
+    uint32_t interval;
+
+    /// The TX power the node was last told to send with, in dBm.
+    int8_t txPower;
+
+    /// The spreading factor the node was last told to switch to, 0 if it never was.
+    uint8_t spreadingFactor;
+
+    /// The frames heard since the node was last sent a command.
+    uint16_t framesSinceCommand;
+};
+
+/**
+ * @brief Picks the fastest spreading factor and lowest TX power each node can be heard with,
+ * from the signal to noise ratio of its latest frames, the way LoRaWAN ADR does: the margin
+ * above the demodulation floor of a spreading factor, less an installation margin, is spent
+ * first on a faster spreading factor, 2.5 dB per step, then on lower power. The margin is
+ * taken from the average of the history rather than its best, as LoRaWAN servers do, since a
+ * meter has no retransmissions to make up for the frames fading then loses. The installation
+ * margin of each node grows with how much its signal to noise ratio varies, and no node moves
+ * the network slower than ADR_DEFAULT_SPREADING_FACTOR unless the gateway misses its frames.
+ *
+ * An SX127x gateway demodulates one spreading factor at a time, so rather than each node
+ * getting its own, the network runs at the fastest one the weakest node can use, and only the
+ * TX power is set per node. When that spreading factor changes, every node is told on its
+ * next frame to switch at the same moment as the gateway, a delay long enough for all of them
+ * to have sent a frame. Nodes that miss it, or lose the gateway otherwise, raise their power
+ * and scan the spreading factors until they are heard again, see LoraInterface.
+ *
+ */
+class AdrEngine {
+    private:
+        /// The links, indexed by short address less one.
+        NodeLink links[ADR_ENGINE_CAPACITY];
+
+        /// The spreading factor the network runs at.
+        uint8_t currentSpreadingFactor;
+
+        /// Whether the network is switching to another spreading factor, which one, and the
+        /// gateway uptime it switches at, in milliseconds.
+        bool switching;
+        uint8_t nextSpreadingFactor;
+        uint32_t switchAt;
+
+        /// The gateway uptime until which the network stays at the spreading factor it fell
+        /// back to, for a lost node to find it, in milliseconds.
+        uint32_t holdUntil;
+
+        /**
+         * @brief Find the link of a node.
+         *
+         * @return NodeLink* The link, or null if the address is out of range.
+         */
+        NodeLink *linkOf(uint16_t nodeAddress) {
+            return nodeAddress == 0 || nodeAddress > ADR_ENGINE_CAPACITY ? nullptr : &this->links[nodeAddress - 1];
+        }
+
+        /**
+         * @brief Get the average signal to noise ratio of a node over its latest frames, as if
+         * sent at ADR_MAX_TX_POWER.
+         *
+         */
+        static float averageSnr(const NodeLink &link) {
+            const uint32_t count = link.frames < ADR_HISTORY_LENGTH ? link.frames : ADR_HISTORY_LENGTH;
+            float sum = 0;
+            for (uint32_t i = 0; i < count; i++) {
+                sum += link.snr[i];
+            }
+            return count > 0 ? sum / count : 0;
+        }
+
+        /**
+         * @brief Get the installation margin of a node, in dB: ADR_INSTALLATION_MARGIN until
+         * its history is complete, then ADR_MIN_MARGIN plus ADR_MARGIN_DEVIATIONS standard
+         * deviations of its history.
+         *
+         */
+        static float installationMargin(const NodeLink &link) {
+            if (link.frames < ADR_HISTORY_LENGTH) {
+                return ADR_INSTALLATION_MARGIN;
+            }
+            const float average = averageSnr(link);
+            float squares = 0;
+            for (uint32_t i = 0; i < ADR_HISTORY_LENGTH; i++) {
+                squares += (link.snr[i] - average) * (link.snr[i] - average);
+            }
+            return ADR_MIN_MARGIN + ADR_MARGIN_DEVIATIONS * sqrtf(squares / (ADR_HISTORY_LENGTH - 1));
+        }
+
+        /**
+         * @brief Get the number of frames of a node the gateway missed among its latest ones.
+         *
+         */
+        static uint32_t missedFrames(const NodeLink &link) {
+            const uint32_t count = link.frames < ADR_HISTORY_LENGTH ? link.frames : ADR_HISTORY_LENGTH;
+            uint32_t missed = 0;
+            for (uint32_t i = 0; i < count; i++) {
+                missed += link.missed[i];
+            }
+            return missed;
+        }
+
+        /**
+         * @brief Get the dB a node would have to spare at full power and a spreading factor,
+         * after its installation margin.
+         *
+         */
+        static float headroom(const NodeLink &link, uint8_t spreadingFactor) {
+            return averageSnr(link) - requiredSnr(spreadingFactor) - installationMargin(link);
+        }
+
+        /**
+         * @brief Get the fastest spreading factor a node can be heard at, at full power. A
+         * spreading factor slower than ADR_DEFAULT_SPREADING_FACTOR is only taken if the
+         * gateway missed frames of the node, or the network already runs that slow.
+         *
+         */
+        uint8_t fastestSpreadingFactor(const NodeLink &link) {
+            uint8_t spreadingFactor = ADR_MIN_SPREADING_FACTOR;
+            while (spreadingFactor < ADR_MAX_SPREADING_FACTOR && headroom(link, spreadingFactor) < 0) {
+                spreadingFactor++;
+            }
+            const bool slowerAllowed = this->currentSpreadingFactor > ADR_DEFAULT_SPREADING_FACTOR || missedFrames(link) > 0;
+            return spreadingFactor > ADR_DEFAULT_SPREADING_FACTOR && !slowerAllowed ? ADR_DEFAULT_SPREADING_FACTOR : spreadingFactor;
+        }
+
+        /**
+         * @brief Get the lowest TX power a node can be heard at, at a spreading factor. Full
+         * power until its history is complete.
+         *
+         */
+        static int8_t lowestTxPower(const NodeLink &link, uint8_t spreadingFactor) {
+            if (link.frames < ADR_HISTORY_LENGTH) {
+                return ADR_MAX_TX_POWER;
+            }
+            const float spare = headroom(link, spreadingFactor);
+            const int steps = spare > 0 ? (int) (spare / ADR_TX_POWER_STEP) : 0;
+            const int power = ADR_MAX_TX_POWER - steps * ADR_TX_POWER_STEP;
+            return (int8_t) (power < ADR_MIN_TX_POWER ? ADR_MIN_TX_POWER : power);
+        }
+
+        /**
+         * @brief Get how long a node may go unheard before it is taken for lost, in
+         * milliseconds.
+         *
+         */
+        static uint32_t silenceLimit(const NodeLink &link) {
+            return link.interval > 0 ? ADR_SILENT_FRAMES * link.interval : ADR_NODE_TIMEOUT;
+        }
+
+        /**
+         * @brief Get the spreading factor the network should run at: the slowest any active
+         * node needs, and no faster than now while any node's history is incomplete, or the
+         * network holds a fallback. Nodes only count once heard twice, so that the switch
+         * delay covers how often they send.
+         *
+         */
+        uint8_t targetSpreadingFactor(uint32_t now) {
+            uint8_t target = ADR_MIN_SPREADING_FACTOR;
+            bool complete = true, any = false;
+            for (const NodeLink &link : this->links) {
+                if (!link.active || link.interval == 0) {
+                    continue;
+                }
+                any = true;
+                complete = complete && link.frames >= ADR_HISTORY_LENGTH;
+                const uint8_t needed = fastestSpreadingFactor(link);
+                target = needed > target ? needed : target;
+            }
+            const bool holding = (int32_t) (now - this->holdUntil) < 0;
+            if (!any || ((!complete || holding) && target < this->currentSpreadingFactor)) {
+                return this->currentSpreadingFactor;
+            }
+            return target;
+        }
+
+        /**
+         * @brief Plan a switch of the network to another spreading factor, giving every
+         * active node twice the longest gap between its frames to hear about it.
+         *
+         */
+        void planSwitch(uint8_t spreadingFactor, uint32_t now) {
+            uint32_t delay = ADR_MIN_SWITCH_DELAY;
+            for (const NodeLink &link : this->links) {
+                if (link.active && link.interval > delay / 2) {
+                    delay = link.interval * 2;
+                }
+            }
+            this->switching = true;
+            this->nextSpreadingFactor = spreadingFactor;
+            this->switchAt = now + (delay < ADR_MAX_SWITCH_DELAY ? delay : ADR_MAX_SWITCH_DELAY);
+        }
+
+    public:
+        /**
+         * @brief Construct a new Adr Engine object, knowing no node yet.
+         *
+         * @param spreadingFactor The spreading factor the network runs at now.
+         */
+        AdrEngine(uint8_t spreadingFactor = ADR_DEFAULT_SPREADING_FACTOR) {
+            memset(this->links, 0, sizeof(this->links));
+            this->currentSpreadingFactor = spreadingFactor;
+            this->switching = false;
+            this->nextSpreadingFactor = spreadingFactor;
+            this->switchAt = 0;
+            this->holdUntil = 0;
+        }
+
+        /**
+         * @brief Get the signal to noise ratio the SX127x needs to demodulate a spreading
+         * factor, in dB, from its datasheet.
+         *
+         */
+        static float requiredSnr(uint8_t spreadingFactor) {
+            return -7.5f - 2.5f * (spreadingFactor - ADR_MIN_SPREADING_FACTOR);
+        }
+
+        /**
+         * @brief Record the signal quality of a frame from a node. A frame carrying many
+         * readings is recorded once, however many times it is passed in.
+         *
+         * @param nodeAddress The short address of the node.
+         * @param snr The signal to noise ratio the frame arrived with, in dB.
+         * @param rssi The signal strength the frame arrived with, in dBm.
+         * @param receivedAt The gateway uptime the frame was received at, in milliseconds.
+         */
+        void record(uint16_t nodeAddress, float snr, int16_t rssi, uint32_t receivedAt) {
+            NodeLink *link = linkOf(nodeAddress);
+            if (link == nullptr || (link->active && link->lastHeard == receivedAt)) {
+                return;
+            }
+            if (link->active && link->interval > 0 && receivedAt - link->lastHeard > ADR_RESTART_FRAMES * link->interval) {
+                const uint32_t interval = link->interval;
+                memset(link, 0, sizeof(NodeLink));
+                link->interval = interval;
+            }
+            uint32_t missed = 0;
+            if (!link->active) {
+                link->active = true;
+                link->txPower = ADR_MAX_TX_POWER;
+            } else if (link->interval == 0) {
+                link->interval = receivedAt - link->lastHeard;
+            } else {
+                // A gap of n intervals means n - 1 frames were missed; the interval is only
+                // learnt again from gaps without one.
+                const uint32_t gap = receivedAt - link->lastHeard;
+                missed = (gap + link->interval / 2) / link->interval;
+                missed = missed > 1 ? missed - 1 : 0;
+                if (missed == 0) {
+                    link->interval = gap;
+                }
+            }
+            link->snr[link->frames % ADR_HISTORY_LENGTH] = snr + (ADR_MAX_TX_POWER - link->txPower);
+            link->missed[link->frames % ADR_HISTORY_LENGTH] = missed < UINT8_MAX ? missed : UINT8_MAX;
+            link->frames++;
+            link->rssi = rssi;
+            link->lastHeard = receivedAt;
+            link->framesSinceCommand++;
+        }
+
+        /**
+         * @brief Forget what is known about a node, as when it joins again and starts over at
+         * full power. A node heard again after missing ADR_RESTART_FRAMES frames starts over
+         * the same way.
+         *
+         * @param nodeAddress The short address of the node.
+         */
+        void forget(uint16_t nodeAddress) {
+            NodeLink *link = linkOf(nodeAddress);
+            if (link != nullptr) {
+                memset(link, 0, sizeof(NodeLink));
+            }
+        }
+
+        /**
+         * @brief Forget nodes gone silent, falling back to ADR_DEFAULT_SPREADING_FACTOR for a
+         * while if the network is faster, plan a switch when the network should run at another spreading
+         * factor, and carry out a planned switch when it is due. Called regularly.
+         *
+         * @param now The gateway uptime, in milliseconds.
+         * @return bool Whether the network just switched to spreadingFactor(), which the
+         * gateway must now listen at.
+         */
+        bool update(uint32_t now) {
+            bool lost = false;
+            for (NodeLink &link : this->links) {
+                const uint32_t limit = silenceLimit(link);
+                if (link.active && now - link.lastHeard > limit) {
+                    memset(&link, 0, sizeof(NodeLink));
+                    this->holdUntil = now + 2 * limit;
+                    lost = true;
+                }
+            }
+            if (this->switching) {
+                if ((int32_t) (now - this->switchAt) < 0) {
+                    return false;
+                }
+                this->switching = false;
+                this->currentSpreadingFactor = this->nextSpreadingFactor;
+                return true;
+            }
+            if (lost && this->currentSpreadingFactor < ADR_DEFAULT_SPREADING_FACTOR) {
+                planSwitch(ADR_DEFAULT_SPREADING_FACTOR, now);
+                return false;
+            }
+            const uint8_t target = targetSpreadingFactor(now);
+            if (target != this->currentSpreadingFactor) {
+                planSwitch(target, now);
+            }
+            return false;
+        }
+
+        /**
+         * @brief Get the command to send a node that was just heard, if it should be sent
+         * one: when its settings changed, a switch is planned that it was not told about, or
+         * it was not sent one for ADR_KEEPALIVE_INTERVAL frames. Once it is sent, commandSent
+         * notes it.
+         *
+         * @param nodeAddress The short address of the node.
+         * @param now The gateway uptime, in milliseconds.
+         * @param command The command to fill.
+         * @return bool Whether the command should be sent.
+         */
+        bool command(uint16_t nodeAddress, uint32_t now, LinkCommand &command) {
+            NodeLink *link = linkOf(nodeAddress);
+            if (link == nullptr || !link->active) {
+                return false;
+            }
+            // Until the switch, the power must also carry the current spreading factor.
+            const uint8_t spreadingFactor = spreadingFactorAhead();
+            int8_t txPower = lowestTxPower(*link, spreadingFactor);
+            if (this->switching) {
+                const int8_t currentPower = lowestTxPower(*link, this->currentSpreadingFactor);
+                txPower = currentPower > txPower ? currentPower : txPower;
+            }
+            if (
+                link->spreadingFactor == spreadingFactor
+                && link->txPower == txPower
+                && link->framesSinceCommand < ADR_KEEPALIVE_INTERVAL
+            ) {
+                return false;
+            }
+            command.nodeAddress = nodeAddress;
+            command.spreadingFactor = spreadingFactor;
+            command.txPower = txPower;
+            command.switchDelay = this->switching && (int32_t) (this->switchAt - now) > 0 ? this->switchAt - now : 0;
+            return true;
+        }
+
+        /**
+         * @brief Note that a command was sent, after which the node is assumed to follow it.
+         * A command the duty cycle kept from being sent is asked for again with the next
+         * frame of the node.
+         *
+         * @param command The command sent.
+         */
+        void commandSent(const LinkCommand &command) {
+            NodeLink *link = linkOf(command.nodeAddress);
+            if (link == nullptr || !link->active) {
+                return;
+            }
+            link->spreadingFactor = command.spreadingFactor;
+            link->txPower = command.txPower;
+            link->framesSinceCommand = 0;
+        }
+
+        /**
+         * @brief Get the spreading factor the network runs at, which the gateway listens at.
+         *
+         */
+        uint8_t spreadingFactor() const {
+            return this->currentSpreadingFactor;
+        }
+
+        /**
+         * @brief Get the spreading factor the network is switching to, or runs at if it is
+         * not switching.
+         *
+         */
+        uint8_t spreadingFactorAhead() const {
+            return this->switching ? this->nextSpreadingFactor : this->currentSpreadingFactor;
+        }
+
+        /**
+         * @brief Get what is known about the link of a node.
+         *
+         * @param nodeAddress The short address of the node.
+         * @return const NodeLink* The link, or null if the node was not heard since it was
+         * last forgotten.
+         */
+        const NodeLink *link(uint16_t nodeAddress) {
+            const NodeLink *link = linkOf(nodeAddress);
+            return link != nullptr && link->active ? link : nullptr;
+        }
+};
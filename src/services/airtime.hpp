@@ -0,0 +1,89 @@
+/**
+ * @file airtime.hpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Contains the time on air calculator of LoRa packets, from the radio settings they
+ * are sent with.
+ * @version 0.1
+ * @date 2022-05-07
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// The longest a symbol may last before the SX127x datasheet asks for low data rate
+/// optimization, in microseconds.
+#define AIRTIME_LONG_SYMBOL 16000
+
+/**
+ * @brief The settings of the radio that decide how long a packet is on air.
+ *
+ */
+struct RadioSettings {
+    /// The spreading factor, from 6 to 12.
+    uint8_t spreadingFactor;
+
+    /// The signal bandwidth, in Hz.
+    uint32_t bandwidth;
+
+    /// The denominator of the coding rate, from 5 for 4/5 to 8 for 4/8.
+    uint8_t codingRate;
+
+    /// The number of preamble symbols programmed, without the 4.25 sync symbols.
+    uint16_t preambleLength;
+
+    /// Whether the packet goes without a header, its length and coding rate known to both
+    /// ends.
+    bool implicitHeader;
+
+    /// Whether a CRC of the payload is sent.
+    bool crc;
+
+    /// Whether the low data rate optimization bit is set.
+    bool lowDataRateOptimize;
+};
+
+/**
+ * @brief Get the duration of one symbol, in microseconds.
+ *
+ * @param spreadingFactor The spreading factor, from 6 to 12.
+ * @param bandwidth The signal bandwidth, in Hz.
+ */
+inline uint32_t symbolTime(uint8_t spreadingFactor, uint32_t bandwidth) {
+    return (uint32_t) (((uint64_t) 1000000 << spreadingFactor) / bandwidth);
+}
+
+/**
+ * @brief Check whether the symbols of the settings are long enough that the datasheet asks
+ * for low data rate optimization, as for SF11 and SF12 at 125 kHz.
+ *
+ * @param spreadingFactor The spreading factor, from 6 to 12.
+ * @param bandwidth The signal bandwidth, in Hz.
+ */
+inline bool needsLowDataRateOptimize(uint8_t spreadingFactor, uint32_t bandwidth) {
+    return symbolTime(spreadingFactor, bandwidth) > AIRTIME_LONG_SYMBOL;
+}
+
+/**
+ * @brief Get how long a packet is on air, preamble included, following the formula of the
+ * SX127x datasheet. Symbols are counted in quarters, as the preamble ends with 4.25 sync
+ * symbols, so the result is exact to the microsecond.
+ *
+ * @param radio The settings the packet is sent with.
+ * @param payloadLength The number of bytes in the packet.
+ * @return uint32_t The time on air, in microseconds.
+ */
+inline uint32_t timeOnAir(const RadioSettings &radio, size_t payloadLength) {
+    const int32_t sf = radio.spreadingFactor;
+    const int32_t bits = 8 * (int32_t) payloadLength - 4 * sf + 28
+        + (radio.crc ? 16 : 0)
+        - (radio.implicitHeader ? 20 : 0);
+    const int32_t bitsPerBlock = 4 * (sf - (radio.lowDataRateOptimize ? 2 : 0));
+    const int32_t blocks = bits > 0 ? (bits + bitsPerBlock - 1) / bitsPerBlock : 0;
+    const uint64_t quarterSymbols = 4 * ((uint64_t) radio.preambleLength + 8 + (uint64_t) blocks * radio.codingRate) + 17;
+    return (uint32_t) (((quarterSymbols * 1000000) << sf) / (4 * (uint64_t) radio.bandwidth));
+}
@@ -0,0 +1,376 @@
+/**
+ * @file bitsliced_aes.hpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Contains a bitsliced AES block cipher that encrypts many blocks at once in constant
+ * time.
+ * @version 0.1
+ * @date 2022-04-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <type_traits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include <aes.hpp>
+
+/// The rounds of the AES variant tiny-AES is built for.
+#define BITSLICED_AES_ROUNDS (AES_keyExpSize / AES_BLOCKLEN - 1)
+
+/// The bits of one AES block, and so the words a bitsliced state takes.
+#define BITSLICED_AES_SLICES (AES_BLOCKLEN * 8)
+
+#if defined(__SSE2__)
+/**
+ * @brief A 128 bit SSE2 register, usable as a word of BitslicedAES.
+ *
+ */
+struct SseWord {
+    /// The bits of the word.
+    __m128i bits;
+
+    SseWord() : bits(_mm_setzero_si128()) {}
+
+    SseWord(__m128i bits) : bits(bits) {}
+
+    SseWord operator^(SseWord other) const { return _mm_xor_si128(bits, other.bits); }
+
+    SseWord operator&(SseWord other) const { return _mm_and_si128(bits, other.bits); }
+
+    SseWord operator~() const { return _mm_xor_si128(bits, _mm_set1_epi32(-1)); }
+
+    SseWord &operator^=(SseWord other) { bits = _mm_xor_si128(bits, other.bits); return *this; }
+};
+#endif
+
+#if defined(__AVX2__)
+/**
+ * @brief A 256 bit AVX2 register, usable as a word of BitslicedAES.
+ *
+ */
+struct Avx2Word {
+    /// The bits of the word.
+    __m256i bits;
+
+    Avx2Word() : bits(_mm256_setzero_si256()) {}
+
+    Avx2Word(__m256i bits) : bits(bits) {}
+
+    Avx2Word operator^(Avx2Word other) const { return _mm256_xor_si256(bits, other.bits); }
+
+    Avx2Word operator&(Avx2Word other) const { return _mm256_and_si256(bits, other.bits); }
+
+    Avx2Word operator~() const { return _mm256_xor_si256(bits, _mm256_set1_epi32(-1)); }
+
+    Avx2Word &operator^=(Avx2Word other) { bits = _mm256_xor_si256(bits, other.bits); return *this; }
+};
+#endif
+
+/**
+ * @brief Encrypts as many AES blocks at once as its word has bits, each bit of a word being
+ * one block. The state is kept as one word per bit of a block, so that SubBytes runs as a fixed
+ * circuit of logic gates and ShiftRows and MixColumns as XORs. No table is indexed by secret
+ * data and no branch depends on it, so the time taken does not leak the key or the data.
+ *
+ * Only the forward cipher is provided, which is all CTR and CCM need.
+ *
+ * @tparam Word An unsigned integer or SIMD word supporting ^, & and ~.
+ */
+template <typename Word>
+class BitslicedAES {
+    public:
+        /// The number of blocks encrypted at once.
+        static const size_t LANES = 8 * sizeof(Word);
+
+    private:
+        /// The round keys, one word per bit of each, every lane set to the bit.
+        Word roundKeys[(BITSLICED_AES_ROUNDS + 1) * BITSLICED_AES_SLICES];
+
+        /// The integer a block is cut into while it is transposed, no wider than a word.
+        typedef typename std::conditional<sizeof(Word) < 8, uint32_t, uint64_t>::type Chunk;
+
+        /// The bits of a Chunk, and so the lanes transposed together.
+        static const size_t CHUNK_BITS = 8 * sizeof(Chunk);
+
+        /// The chunks in a word.
+        static const size_t WORD_CHUNKS = sizeof(Word) / sizeof(Chunk);
+
+        /**
+         * @brief Transpose a square bit matrix in place, so that bit c of row r swaps with
+         * bit r of row c, by swapping ever smaller off-diagonal blocks.
+         *
+         * @param rows The CHUNK_BITS rows of the matrix.
+         */
+        static void transpose(Chunk *rows) {
+            Chunk mask = ~(Chunk) 0 >> (CHUNK_BITS / 2);
+            for (size_t width = CHUNK_BITS / 2; width != 0; width >>= 1, mask ^= mask << width) {
+                for (size_t k = 0; k < CHUNK_BITS; k = (k + width + 1) & ~width) {
+                    const Chunk t = ((rows[k] >> width) ^ rows[k + width]) & mask;
+                    rows[k] ^= t << width;
+                    rows[k + width] ^= t;
+                }
+            }
+        }
+
+        /**
+         * @brief Spread blocks over the bits of a state, block i in lane i. Lanes past the
+         * last block are zero. Blocks are read as little endian chunks, so bit b of byte i is
+         * slice i * 8 + b.
+         *
+         */
+        static void load(const uint8_t *blocks, size_t count, Word *state) {
+            Chunk slices[BITSLICED_AES_SLICES][WORD_CHUNKS];
+            Chunk square[CHUNK_BITS];
+            for (size_t chunk = 0; chunk < WORD_CHUNKS; chunk++) {
+                for (size_t part = 0; part < BITSLICED_AES_SLICES / CHUNK_BITS; part++) {
+                    for (size_t lane = 0; lane < CHUNK_BITS; lane++) {
+                        const size_t block = chunk * CHUNK_BITS + lane;
+                        square[lane] = 0;
+                        if (block < count) {
+                            memcpy(square + lane, blocks + block * AES_BLOCKLEN + part * sizeof(Chunk), sizeof(Chunk));
+                        }
+                    }
+                    transpose(square);
+                    for (size_t bit = 0; bit < CHUNK_BITS; bit++) {
+                        slices[part * CHUNK_BITS + bit][chunk] = square[bit];
+                    }
+                }
+            }
+            memcpy(state, slices, sizeof(slices));
+        }
+
+        /**
+         * @brief Gather the blocks of the first lanes of a state back, undoing load.
+         *
+         */
+        static void store(const Word *state, uint8_t *blocks, size_t count) {
+            Chunk slices[BITSLICED_AES_SLICES][WORD_CHUNKS];
+            Chunk square[CHUNK_BITS];
+            memcpy(slices, state, sizeof(slices));
+            for (size_t chunk = 0; chunk * CHUNK_BITS < count; chunk++) {
+                for (size_t part = 0; part < BITSLICED_AES_SLICES / CHUNK_BITS; part++) {
+                    for (size_t bit = 0; bit < CHUNK_BITS; bit++) {
+                        square[bit] = slices[part * CHUNK_BITS + bit][chunk];
+                    }
+                    transpose(square);
+                    for (size_t lane = 0; lane < CHUNK_BITS && chunk * CHUNK_BITS + lane < count; lane++) {
+                        const size_t block = chunk * CHUNK_BITS + lane;
+                        memcpy(blocks + block * AES_BLOCKLEN + part * sizeof(Chunk), square + lane, sizeof(Chunk));
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief Run the S-box over one byte of every lane, as the 113 gate circuit of Boyar
+         * and Peralta.
+         *
+         * @param q The 8 words of the byte, least significant bit first.
+         */
+        static void substitute(Word *q) {
+            const Word x0 = q[7], x1 = q[6], x2 = q[5], x3 = q[4];
+            const Word x4 = q[3], x5 = q[2], x6 = q[1], x7 = q[0];
+
+            // Top linear transformation.
+            const Word y14 = x3 ^ x5, y13 = x0 ^ x6, y9 = x0 ^ x3, y8 = x0 ^ x5;
+            const Word t0 = x1 ^ x2, y1 = t0 ^ x7, y4 = y1 ^ x3, y12 = y13 ^ y14;
+            const Word y2 = y1 ^ x0, y5 = y1 ^ x6, y3 = y5 ^ y8, t1 = x4 ^ y12;
+            const Word y15 = t1 ^ x5, y20 = t1 ^ x1, y6 = y15 ^ x7, y10 = y15 ^ t0;
+            const Word y11 = y20 ^ y9, y7 = x7 ^ y11, y17 = y10 ^ y11, y19 = y10 ^ y8;
+            const Word y16 = t0 ^ y11, y21 = y13 ^ y16, y18 = x0 ^ y16;
+
+            // Non-linear section, the inversion in GF(2^8).
+            const Word t2 = y12 & y15, t3 = y3 & y6, t4 = t3 ^ t2, t5 = y4 & x7;
+            const Word t6 = t5 ^ t2, t7 = y13 & y16, t8 = y5 & y1, t9 = t8 ^ t7;
+            const Word t10 = y2 & y7, t11 = t10 ^ t7, t12 = y9 & y11, t13 = y14 & y17;
+            const Word t14 = t13 ^ t12, t15 = y8 & y10, t16 = t15 ^ t12, t17 = t4 ^ t14;
+            const Word t18 = t6 ^ t16, t19 = t9 ^ t14, t20 = t11 ^ t16, t21 = t17 ^ y20;
+            const Word t22 = t18 ^ y19, t23 = t19 ^ y21, t24 = t20 ^ y18;
+            const Word t25 = t21 ^ t22, t26 = t21 & t23, t27 = t24 ^ t26, t28 = t25 & t27;
+            const Word t29 = t28 ^ t22, t30 = t23 ^ t24, t31 = t22 ^ t26, t32 = t31 & t30;
+            const Word t33 = t32 ^ t24, t34 = t23 ^ t33, t35 = t27 ^ t33, t36 = t24 & t35;
+            const Word t37 = t36 ^ t34, t38 = t27 ^ t36, t39 = t29 & t38, t40 = t25 ^ t39;
+            const Word t41 = t40 ^ t37, t42 = t29 ^ t33, t43 = t29 ^ t40, t44 = t33 ^ t37;
+            const Word t45 = t42 ^ t41;
+            const Word z0 = t44 & y15, z1 = t37 & y6, z2 = t33 & x7, z3 = t43 & y16;
+            const Word z4 = t40 & y1, z5 = t29 & y7, z6 = t42 & y11, z7 = t45 & y17;
+            const Word z8 = t41 & y10, z9 = t44 & y12, z10 = t37 & y3, z11 = t33 & y4;
+            const Word z12 = t43 & y13, z13 = t40 & y5, z14 = t29 & y2, z15 = t42 & y9;
+            const Word z16 = t45 & y14, z17 = t41 & y8;
+
+            // Bottom linear transformation.
+            const Word t46 = z15 ^ z16, t47 = z10 ^ z11, t48 = z5 ^ z13, t49 = z9 ^ z10;
+            const Word t50 = z2 ^ z12, t51 = z2 ^ z5, t52 = z7 ^ z8, t53 = z0 ^ z3;
+            const Word t54 = z6 ^ z7, t55 = z16 ^ z17, t56 = z12 ^ t48, t57 = t50 ^ t53;
+            const Word t58 = z4 ^ t46, t59 = z3 ^ t54, t60 = t46 ^ t57, t61 = z14 ^ t57;
+            const Word t62 = t52 ^ t58, t63 = t49 ^ t58, t64 = z4 ^ t59, t65 = t61 ^ t62;
+            const Word t66 = z1 ^ t63, t67 = t64 ^ t65;
+            const Word s3 = t53 ^ t66;
+            q[7] = t59 ^ t63;
+            q[6] = t64 ^ ~s3;
+            q[5] = t55 ^ ~t67;
+            q[4] = s3;
+            q[3] = t51 ^ t66;
+            q[2] = t47 ^ t65;
+            q[1] = t56 ^ ~t62;
+            q[0] = t48 ^ ~t60;
+        }
+
+        /**
+         * @brief Get where ShiftRows takes a byte of the state from, rotating row r left by r
+         * columns. Byte c * 4 + r of a block is in row r and column c.
+         *
+         */
+        static const Word *shifted(const Word *state, uint8_t column, uint8_t row) {
+            return state + ((((column + row) & 3) * 4 + row) * 8);
+        }
+
+        /**
+         * @brief Run ShiftRows alone, for the last round.
+         *
+         */
+        static void shiftRows(const Word *from, Word *to) {
+            for (uint8_t column = 0; column < 4; column++) {
+                for (uint8_t row = 0; row < 4; row++) {
+                    const Word *byte = shifted(from, column, row);
+                    for (uint8_t bit = 0; bit < 8; bit++) {
+                        to[(column * 4 + row) * 8 + bit] = byte[bit];
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief Run ShiftRows, then mix every column: each of its bytes becomes
+         * a ^ t ^ xtime(a ^ b), with b the byte below a and t all four bytes XORed.
+         *
+         */
+        static void shiftMixColumns(const Word *from, Word *to) {
+            for (uint8_t column = 0; column < 4; column++) {
+                const Word *a[4] = {
+                    shifted(from, column, 0), shifted(from, column, 1),
+                    shifted(from, column, 2), shifted(from, column, 3)
+                };
+                Word sum[8];
+                for (uint8_t bit = 0; bit < 8; bit++) {
+                    sum[bit] = a[0][bit] ^ a[1][bit] ^ a[2][bit] ^ a[3][bit];
+                }
+                for (uint8_t row = 0; row < 4; row++) {
+                    const Word *byte = a[row], *below = a[(row + 1) & 3];
+                    Word d[8];
+                    for (uint8_t bit = 0; bit < 8; bit++) {
+                        d[bit] = byte[bit] ^ below[bit];
+                    }
+                    // xtime multiplies by x, reducing by x^8 = x^4 + x^3 + x + 1.
+                    const Word doubled[8] = { d[7], d[0] ^ d[7], d[1], d[2] ^ d[7], d[3] ^ d[7], d[4], d[5], d[6] };
+                    Word *mixed = to + (column * 4 + row) * 8;
+                    for (uint8_t bit = 0; bit < 8; bit++) {
+                        mixed[bit] = byte[bit] ^ sum[bit] ^ doubled[bit];
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief XOR a round key into the state.
+         *
+         */
+        void addRoundKey(Word *state, uint8_t round) {
+            const Word *key = roundKeys + round * BITSLICED_AES_SLICES;
+            for (uint8_t i = 0; i < BITSLICED_AES_SLICES; i++) {
+                state[i] ^= key[i];
+            }
+        }
+
+        /**
+         * @brief Encrypt up to LANES blocks.
+         *
+         */
+        void encryptLanes(uint8_t *blocks, size_t count) {
+            // Rounds alternate between the two states, ShiftRows moving bytes across.
+            Word first[BITSLICED_AES_SLICES], second[BITSLICED_AES_SLICES];
+            Word *state = first, *next = second;
+            load(blocks, count, state);
+            addRoundKey(state, 0);
+            for (uint8_t round = 1; round < BITSLICED_AES_ROUNDS; round++) {
+                for (uint8_t byte = 0; byte < AES_BLOCKLEN; byte++) {
+                    substitute(state + byte * 8);
+                }
+                shiftMixColumns(state, next);
+                addRoundKey(next, round);
+                Word *done = state;
+                state = next;
+                next = done;
+            }
+            for (uint8_t byte = 0; byte < AES_BLOCKLEN; byte++) {
+                substitute(state + byte * 8);
+            }
+            shiftRows(state, next);
+            addRoundKey(next, BITSLICED_AES_ROUNDS);
+            store(next, blocks, count);
+        }
+
+    public:
+        /**
+         * @brief Construct a new Bitsliced AES object
+         *
+         * @param expandedKey The round keys, as AES_init_ctx expands them into RoundKey.
+         */
+        explicit BitslicedAES(const uint8_t *expandedKey) {
+            setKey(expandedKey);
+        }
+
+        /**
+         * @brief Change the key every block is encrypted with.
+         *
+         * @param expandedKey The round keys, as AES_init_ctx expands them into RoundKey.
+         */
+        void setKey(const uint8_t *expandedKey) {
+            const Word ones = ~Word();
+            for (size_t i = 0; i < (BITSLICED_AES_ROUNDS + 1) * BITSLICED_AES_SLICES; i++) {
+                const uint8_t bit = (expandedKey[i / 8] >> (i % 8)) & 1;
+                roundKeys[i] = bit ? ones : Word();
+            }
+        }
+
+        /**
+         * @brief Encrypt independent blocks in place, LANES at a time. A batch that is not
+         * full costs as much as a full one.
+         *
+         * @param blocks The blocks, AES_BLOCKLEN bytes each, one after the other.
+         * @param count The number of blocks.
+         */
+        void encrypt(uint8_t *blocks, size_t count) {
+            for (size_t done = 0; done < count; done += LANES) {
+                encryptLanes(blocks + done * AES_BLOCKLEN, count - done < LANES ? count - done : LANES);
+            }
+        }
+};
+
+/// The general purpose register of the target, that small batches run on.
+#if UINTPTR_MAX > 0xffffffff
+typedef uint64_t ScalarBitslicedWord;
+#else
+typedef uint32_t ScalarBitslicedWord;
+#endif
+
+/// The widest word the target has, that large batches run on.
+#if defined(__AVX2__)
+typedef Avx2Word NativeBitslicedWord;
+#elif defined(__SSE2__)
+typedef SseWord NativeBitslicedWord;
+#else
+typedef ScalarBitslicedWord NativeBitslicedWord;
+#endif
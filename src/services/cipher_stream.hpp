@@ -0,0 +1,148 @@
+/**
+ * @file cipher_stream.hpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Contains a Print stage that encrypts bytes block by block on their way to a sink.
+ * @version 0.1
+ * @date 2022-04-20
+ * 
+ * @copyright Copyright (c) 2022
+ * 
+ */
+
+#pragma once
+
+#include <Print.h>
+
+#include "models/wire_format.hpp"
+#include "services/crypto.hpp"
+
+/**
+ * @brief Encrypts everything written to it with AES-CCM one block at a time and passes each
+ * block on to a sink, such as the LoRa radio, followed by the MIC. Only one block and the
+ * CBC-MAC state are ever held, so a frame can be serialized, sealed and sent without a buffer
+ * of its own, and nothing is padded. CCM needs the length of the message up front, so callers
+ * measure it first, for instance with a FrameWriter over no buffer.
+ * 
+ */
+class CipherStream : public Print {
+    private:
+        /// The service encrypting each block.
+        Crypto *crypto;
+
+        /// The sink encrypted blocks are written to.
+        Print *sink;
+
+        /// The nonce of the message.
+        uint32_t nonce;
+
+        /// The counter of the next block, from 1.
+        size_t counter;
+
+        /// The CBC-MAC of the message so far.
+        uint8_t mac[AES_BLOCKLEN];
+
+        /// The number of bytes the message was declared to have.
+        size_t expectedLength;
+
+        /// The number of message bytes written so far.
+        size_t messageLength;
+
+        /// The block being filled.
+        uint8_t block[AES_BLOCKLEN];
+
+        /// The number of bytes in the block being filled.
+        uint8_t blockLength;
+
+        /// The number of encrypted bytes written to the sink.
+        size_t written;
+
+        /**
+         * @brief Authenticate and encrypt the bytes of the block, and pass them on to the sink.
+         * The keystream comes from the keystream pool of the service if it was precomputed.
+         * 
+         */
+        void flushBlock() {
+            this->crypto->feedMAC(this->mac, this->block, this->blockLength);
+            this->messageLength += this->blockLength;
+            uint8_t keystream[AES_BLOCKLEN];
+            this->crypto->sealingKeystream(this->nonce, this->counter++, keystream);
+            for (uint8_t i = 0; i < this->blockLength; i++) {
+                this->block[i] ^= keystream[i];
+            }
+            this->written += this->sink->write(this->block, this->blockLength);
+            this->blockLength = 0;
+        }
+
+    public:
+        /**
+         * @brief Construct a new Cipher Stream object
+         * 
+         * @param crypto The service encrypting each block. Must be ready.
+         * @param sink The sink encrypted blocks are written to.
+         * @param nonce The nonce of the message. Must never be reused with the same key.
+         * @param associated The data authenticated along with the message but sent in the
+         * clear by the caller, such as the frame header.
+         * @param associatedLength The number of associated bytes.
+         * @param messageLength The number of bytes that will be written.
+         */
+        CipherStream(
+            Crypto &crypto,
+            Print &sink,
+            uint32_t nonce,
+            const uint8_t *associated,
+            size_t associatedLength,
+            size_t messageLength
+        ) {
+            this->crypto = &crypto;
+            this->sink = &sink;
+            this->nonce = nonce;
+            this->counter = 1;
+            crypto.beginMAC(this->mac, nonce, messageLength, associated, associatedLength);
+            this->expectedLength = messageLength;
+            this->messageLength = 0;
+            this->blockLength = 0;
+            this->written = 0;
+        }
+
+        size_t write(uint8_t value) override {
+            this->block[this->blockLength++] = value;
+            if (this->blockLength == AES_BLOCKLEN) {
+                flushBlock();
+            }
+            return 1;
+        }
+
+        size_t write(const uint8_t *buffer, size_t size) override {
+            size_t consumed = 0;
+            while (consumed < size) {
+                size_t chunk = AES_BLOCKLEN - this->blockLength;
+                chunk = chunk < size - consumed ? chunk : size - consumed;
+                memcpy(this->block + this->blockLength, buffer + consumed, chunk);
+                this->blockLength += chunk;
+                consumed += chunk;
+                if (this->blockLength == AES_BLOCKLEN) {
+                    flushBlock();
+                }
+            }
+            return size;
+        }
+
+        /**
+         * @brief Pass on the last partial block, then the MIC.
+         * 
+         * @return size_t The number of bytes written to the sink in total, MIC included, or 0
+         * if the message was not as long as declared and so cannot be verified.
+         */
+        size_t finish() {
+            if (this->blockLength > 0) {
+                flushBlock();
+            }
+            if (this->messageLength != this->expectedLength) {
+                return 0;
+            }
+            uint8_t keystream[AES_BLOCKLEN], mic[CRYPTO_MIC_LENGTH];
+            this->crypto->sealingKeystream(this->nonce, 0, keystream);
+            Crypto::maskMAC(this->mac, keystream, mic);
+            return this->written + this->sink->write(mic, CRYPTO_MIC_LENGTH);
+        }
+};
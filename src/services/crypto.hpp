@@ -11,12 +11,69 @@
 
 #pragma once
 
+#include <Arduino.h>
 #include <WString.h>
 
 #include <aes.hpp>
 
+#include "services/bitsliced_aes.hpp"
+#include "services/key_schedule_cache.hpp"
+#include "services/keystream_pool.hpp"
+
+/// The bytes of the nonce that an encrypted frame carries in the clear, ahead of its body.
+#define CRYPTO_NONCE_LENGTH 4
+
+/// The bytes of the message integrity code that ends an authenticated frame.
+#define CRYPTO_MIC_LENGTH 4
+
+/// The bytes of the key ID that an authenticated frame carries in the clear, ahead of its
+/// nonce: the short address of the node whose session key sealed it, or 0 for the network key.
+#define CRYPTO_KEY_ID_LENGTH 2
+
+/// The bytes an authenticated frame carries in the clear between its header and its body.
+#define CRYPTO_PREFIX_LENGTH (CRYPTO_KEY_ID_LENGTH + CRYPTO_NONCE_LENGTH)
+
+/// The bytes an authenticated frame takes beyond its body in the clear.
+#define CRYPTO_FRAME_OVERHEAD (CRYPTO_PREFIX_LENGTH + CRYPTO_MIC_LENGTH)
+
+/// The fewest messages Crypto::decryptAuthenticatedBatch opens together on the bitsliced
+/// cipher: one per lane of the native word. Every bitsliced pass costs as much as a full one,
+/// so fewer open faster one by one, see bitsliced_aes_benchmark.
+#define CRYPTO_BATCH_MIN_MESSAGES (BitslicedAES<NativeBitslicedWord>::LANES)
+
+/**
+ * @brief A message sealed with Crypto::encryptAuthenticated, to be opened along with others by
+ * Crypto::decryptAuthenticatedBatch.
+ * 
+ */
+struct SealedMessage {
+    /// The bytes to decrypt in place.
+    uint8_t *data;
+
+    /// The number of bytes.
+    size_t length;
+
+    /// The nonce the message was encrypted with.
+    uint32_t nonce;
+
+    /// The data authenticated along with the message.
+    const uint8_t *associated;
+
+    /// The number of associated bytes.
+    size_t associatedLength;
+
+    /// The CRYPTO_MIC_LENGTH bytes of the received MIC.
+    const uint8_t *mic;
+
+    /// Whether the MIC matched, and so the message was decrypted. Set once opened.
+    bool authentic;
+};
+
 /**
- * @brief A utility class to easily handle encryption/decryption of String for security.
+ * @brief A utility class to easily handle encryption/decryption of String and binary buffers
+ * for security. The buffer methods work in place or into caller-owned output, and never
+ * allocate. Every mode, AES-CCM included, runs off the one key schedule expanded per key,
+ * except AES-CMAC signatures, which run off a signing key derived from it on first use.
  * 
  */
 class Crypto {
@@ -27,16 +84,72 @@ class Crypto {
         /// Whether encryption context has been initialized.
         bool initialized;
 
+        /// The context of the signing key, which AES-CMAC tags are computed with, or null
+        /// until a message is first signed or verified.
+        AES_ctx *signingCtx;
+
+        /// The two CMAC subkeys of the signing key, K1 then K2.
+        uint8_t signingSubkeys[2 * AES_BLOCKLEN];
+
+        /// Whether the signing key and subkeys belong to the current key.
+        bool signingReady;
+
+        /// The key the context was expanded from, zero padded.
+        uint8_t key[AES_KEYLEN];
+
+        /// The bitsliced ciphers that small and large batches run on, each built from the
+        /// same key schedule the first time a batch of its size is asked for.
+        BitslicedAES<ScalarBitslicedWord> *scalarCipher;
+        BitslicedAES<NativeBitslicedWord> *batchCipher;
+
+        /// The schedules of the keys used last, by key ID, or null to expand every new key.
+        KeyScheduleCache *keyCache;
+
+        /// The keystream precomputed for the nonces sealed with next, or null to compute it
+        /// while sealing.
+        KeystreamPool *keystreamPool;
+
+        /// The ID frames sealed with the key carry in the clear, see CRYPTO_KEY_ID_LENGTH.
+        uint16_t keyID;
+
+        /// The nonce the next frame sealed with the key is sent with. Starts at a random value
+        /// for the network key, so that nodes sharing it are unlikely to reuse one another's
+        /// nonces, and at 0 for a session key, making it the frame counter of the session.
+        uint32_t nextNonce;
+
         /**
-         * @brief Initializes the AES context.
+         * @brief Initializes the AES context, expanding the key schedule only if the key
+         * changed.
          * 
-         * @param key The key to use for encryption. If the key is null,
-         * the context will not be initialized.
+         * @param key The key to use for encryption. Only its first AES_KEYLEN characters are
+         * used. If the key is null, the context will not be initialized.
          */
         void initCtx(String key = "") {
             if (key != nullptr && key != "") {
-                AES_init_ctx_iv(ctx, (uint8_t*)key.c_str(), (uint8_t*)"1234567890ABCDEF1234567890ABCDEF");
-                initialized = true;
+                uint8_t keyBytes[AES_KEYLEN] = {0};
+                memcpy(keyBytes, key.c_str(), key.length() < AES_KEYLEN ? key.length() : AES_KEYLEN);
+                setKey(keyBytes);
+            }
+        }
+
+        /**
+         * @brief Record the key the context now holds, and slice it for the batch ciphers
+         * that were built.
+         * 
+         * @param key The AES_KEYLEN bytes of the key.
+         */
+        void keyChanged(const uint8_t *key) {
+            memcpy(this->key, key, AES_KEYLEN);
+            initialized = true;
+            signingReady = false;
+            if (keystreamPool != nullptr) {
+                keystreamPool->clear();
+            }
+            if (scalarCipher != nullptr) {
+                scalarCipher->setKey(ctx->RoundKey);
+            }
+            if (batchCipher != nullptr) {
+                batchCipher->setKey(ctx->RoundKey);
             }
         }
 
@@ -48,12 +161,176 @@ class Crypto {
          */
         Crypto(String key="") {
             initialized = false;
+            scalarCipher = nullptr;
+            batchCipher = nullptr;
+            keyCache = nullptr;
+            keystreamPool = nullptr;
+            signingCtx = nullptr;
+            signingReady = false;
+            keyID = 0;
+            nextNonce = esp_random();
             ctx = new AES_ctx();
             initCtx(key);
         }
 
         /**
-         * @brief Encrypts the given string.
+         * @brief Use a binary key, expanding the key schedule only if the key changed.
+         * 
+         * @param key The AES_KEYLEN bytes of the key.
+         */
+        void setKey(const uint8_t *key) {
+            if (initialized && memcmp(key, this->key, AES_KEYLEN) == 0) {
+                return;
+            }
+            AES_init_ctx(ctx, key);
+            keyChanged(key);
+        }
+
+        /**
+         * @brief Use one of many binary keys, copying its schedule from the key cache if it
+         * was expanded recently. Without a key cache, the same as setKey(key).
+         * 
+         * @param key The AES_KEYLEN bytes of the key.
+         * @param keyID The ID the key is cached under, such as the address of the node it
+         * belongs to.
+         */
+        void setKey(const uint8_t *key, uint16_t keyID) {
+            if (keyCache == nullptr) {
+                setKey(key);
+                return;
+            }
+            if (initialized && memcmp(key, this->key, AES_KEYLEN) == 0) {
+                return;
+            }
+            memcpy(ctx->RoundKey, keyCache->schedule(keyID, key).RoundKey, sizeof(ctx->RoundKey));
+            keyChanged(key);
+        }
+
+        /**
+         * @brief Keep the schedules of the keys used last, for contexts that switch between
+         * many keys with setKey(key, keyID).
+         * 
+         * @param length The number of schedules to keep, from 1 to 255.
+         */
+        void enableKeyCache(size_t length = KEY_SCHEDULE_CACHE_LENGTH) {
+            delete keyCache;
+            keyCache = new KeyScheduleCache(length);
+        }
+
+        /**
+         * @brief Get the key cache, to read its hit and miss counters.
+         * 
+         * @return KeyScheduleCache* The cache, or null if it is not enabled.
+         */
+        KeyScheduleCache *getKeyCache() {
+            return keyCache;
+        }
+
+        /**
+         * @brief Precompute the keystream of the nonces this context seals with next, so that
+         * sealing them only XORs. Precomputed blocks are dropped when the key changes.
+         * 
+         * @param length The number of nonces to precompute keystream for.
+         */
+        void enableKeystreamPool(size_t length = KEYSTREAM_POOL_LENGTH) {
+            delete keystreamPool;
+            keystreamPool = new KeystreamPool(length);
+        }
+
+        /**
+         * @brief Get the keystream pool, to read its hit rate and the time it saved.
+         * 
+         * @return KeystreamPool* The pool, or null if it is not enabled.
+         */
+        KeystreamPool *getKeystreamPool() {
+            return keystreamPool;
+        }
+
+        /**
+         * @brief Fill the keystream pool for the next nonces, in idle time such as between
+         * sensor readings.
+         * 
+         * @param budget The most AES blocks to compute before returning.
+         * @return size_t The number of blocks computed, 0 if the pool is full, not enabled or
+         * there is no key yet.
+         */
+        size_t precomputeKeystream(size_t budget = (size_t) -1) {
+            if (keystreamPool == nullptr || !initialized) {
+                return 0;
+            }
+            return keystreamPool->refill(nextNonce, budget, [&](uint32_t nonce, size_t counter, uint8_t *block) {
+                makeCounterBlock(nonce, counter, block);
+                AES_ECB_encrypt(ctx, block);
+            });
+        }
+
+        /**
+         * @brief Derive the session key of a node that joined, by encrypting its address and
+         * both join nonces under this, the network key. Node and gateway derive the same key
+         * without it ever being sent.
+         * 
+         * @param nodeAddress The short address the gateway assigned to the node.
+         * @param nodeNonce The random number the node sent in its JOIN_REQUEST.
+         * @param gatewayNonce The random number the gateway sent in its JOIN_ACCEPT.
+         * @param sessionKey The AES_KEYLEN bytes to fill.
+         * @throws Error if the context is not initialized, i.e. key was never provided to class.
+         */
+        void deriveSessionKey(uint16_t nodeAddress, uint32_t nodeNonce, uint32_t gatewayNonce, uint8_t *sessionKey) {
+            memset(sessionKey, 0, AES_KEYLEN);
+            sessionKey[0] = 0x01;
+            for (uint8_t i = 0; i < 4; i++) {
+                sessionKey[1 + i] = (uint8_t) (nodeNonce >> (8 * i));
+                sessionKey[5 + i] = (uint8_t) (gatewayNonce >> (8 * i));
+            }
+            sessionKey[9] = (uint8_t) nodeAddress;
+            sessionKey[10] = (uint8_t) (nodeAddress >> 8);
+            encryptBlock(sessionKey);
+        }
+
+        /**
+         * @brief Switch to the session key of a node, restarting the frame counter.
+         * 
+         * @param sessionKey The AES_KEYLEN bytes of the key, from deriveSessionKey.
+         * @param nodeAddress The short address of the node, sent as the key ID.
+         */
+        void startSession(const uint8_t *sessionKey, uint16_t nodeAddress) {
+            setKey(sessionKey);
+            keyID = nodeAddress;
+            nextNonce = 0;
+        }
+
+        /**
+         * @brief Seal the next frames under the key ID of a session whose key is already set,
+         * taking nonces from a given one on, as the gateway does for the frames it sends a node.
+         * 
+         * @param nodeAddress The short address of the node, sent as the key ID.
+         * @param firstNonce The nonce to seal the next frame with.
+         */
+        void resumeSession(uint16_t nodeAddress, uint32_t firstNonce) {
+            keyID = nodeAddress;
+            nextNonce = firstNonce;
+        }
+
+        /**
+         * @brief Get the ID that frames sealed with the key carry, 0 for the network key.
+         * 
+         */
+        uint16_t getKeyID() {
+            return keyID;
+        }
+
+        /**
+         * @brief Take the nonce to seal the next frame with. Nonces are never handed out twice
+         * for the same key.
+         * 
+         */
+        uint32_t takeNonce() {
+            return nextNonce++;
+        }
+
+        /**
+         * @brief Encrypts the first block of the given string. Kept for legacy callers; the
+         * result is not binary safe, so prefer the buffer overloads.
          * 
          * @param plainText The string to encrypt.
          * @param key The key to use for encryption (if needed to be overriden)
@@ -66,8 +343,10 @@ class Crypto {
             if (!initialized) {
                 throw "Crypto context not initialized";
             }
-            // Extract plainText to char*
-            char textChar[plainText.length() + 1] = {'\0'};
+            // Extract plainText to char*, with room for a whole block however short it is
+            const size_t capacity = plainText.length() + AES_BLOCKLEN + 1;
+            char textChar[capacity];
+            memset(textChar, 0, capacity);
             plainText.toCharArray(textChar, plainText.length());
             // Encrypt
             AES_ECB_encrypt(ctx, (uint8_t*)textChar);
@@ -76,10 +355,11 @@ class Crypto {
         }
 
         /**
-         * @brief Encrypts the given string.
+         * @brief Decrypts the first block of the given string. Kept for legacy callers; prefer
+         * the buffer overloads.
          * 
-         * @param plainText The string to encrypt.
-         * @param key The key to use for encryption (if needed to be overriden)
+         * @param cipherText The string to decrypt.
+         * @param key The key to use for decryption (if needed to be overriden)
          * @return String The decrypted string.
          * @throws Error if the context is not initialized, i.e. key was never provided to class.
          */
@@ -89,8 +369,10 @@ class Crypto {
             if (!initialized) {
                 throw "Crypto context not initialized";
             }
-            // Extract cipherText to char*
-            char textChar[cipherText.length() + 1] = {'\0'};
+            // Extract cipherText to char*, with room for a whole block however short it is
+            const size_t capacity = cipherText.length() + AES_BLOCKLEN + 1;
+            char textChar[capacity];
+            memset(textChar, 0, capacity);
             cipherText.toCharArray(textChar, cipherText.length());
             // Decrypt
             AES_ECB_decrypt(ctx, (uint8_t*)textChar);
@@ -98,6 +380,613 @@ class Crypto {
             return String(textChar);
         }
 
+        /**
+         * @brief Encrypts one block in place, for callers streaming binary data.
+         * 
+         * @param block The AES_BLOCKLEN bytes to encrypt.
+         * @throws Error if the context is not initialized, i.e. key was never provided to class.
+         */
+        void encryptBlock(uint8_t *block) {
+            if (!initialized) {
+                throw "Crypto context not initialized";
+            }
+            AES_ECB_encrypt(ctx, block);
+        }
+
+        /**
+         * @brief Decrypts one block in place, for callers receiving binary data.
+         * 
+         * @param block The AES_BLOCKLEN bytes to decrypt.
+         * @throws Error if the context is not initialized, i.e. key was never provided to class.
+         */
+        void decryptBlock(uint8_t *block) {
+            if (!initialized) {
+                throw "Crypto context not initialized";
+            }
+            AES_ECB_decrypt(ctx, block);
+        }
+
+        /**
+         * @brief Encrypts or decrypts a buffer of any length in place with AES-CTR, which XORs
+         * it with a keystream, so the same call undoes itself and nothing is padded. Zero
+         * bytes are fine on either side.
+         * 
+         * @param data The bytes to encrypt or decrypt.
+         * @param length The number of bytes.
+         * @param counterBlock The AES_BLOCKLEN initial counter block, incremented big endian
+         * for every block. A counter block must never be reused with the same key.
+         * @throws Error if the context is not initialized, i.e. key was never provided to class.
+         */
+        void xcryptCTR(uint8_t *data, size_t length, const uint8_t *counterBlock) {
+            if (!initialized) {
+                throw "Crypto context not initialized";
+            }
+            AES_ctx_set_iv(ctx, counterBlock);
+            AES_CTR_xcrypt_buffer(ctx, data, length);
+        }
+
+        /**
+         * @brief Build the initial counter block for a message: a flags byte, the nonce little
+         * endian, zeros, and a big endian block counter starting at 1 in the last two bytes.
+         * 
+         * @param nonce The nonce of the message. Must never be reused with the same key.
+         * @param counterBlock The AES_BLOCKLEN bytes to fill.
+         */
+        static void makeCounterBlock(uint32_t nonce, uint8_t *counterBlock) {
+            makeCounterBlock(nonce, 1, counterBlock);
+        }
+
+        /**
+         * @brief Build the counter block of one block of a message, as makeCounterBlock lays
+         * it out.
+         * 
+         * @param nonce The nonce of the message.
+         * @param counter The block counter: 0 for the block encrypting the MIC, then 1 up.
+         * @param counterBlock The AES_BLOCKLEN bytes to fill.
+         */
+        static void makeCounterBlock(uint32_t nonce, size_t counter, uint8_t *counterBlock) {
+            memset(counterBlock, 0, AES_BLOCKLEN);
+            counterBlock[0] = 0x01;
+            for (uint8_t i = 0; i < CRYPTO_NONCE_LENGTH; i++) {
+                counterBlock[1 + i] = (uint8_t) (nonce >> (8 * i));
+            }
+            counterBlock[AES_BLOCKLEN - 2] = (uint8_t) (counter >> 8);
+            counterBlock[AES_BLOCKLEN - 1] = (uint8_t) counter;
+        }
+
+        /**
+         * @brief Get one keystream block of a message being sealed, from the keystream pool if
+         * it was precomputed there.
+         * 
+         * @param nonce The nonce of the message.
+         * @param counter The block counter: 0 for the block encrypting the MIC, then 1 up.
+         * @param block The AES_BLOCKLEN bytes to fill.
+         * @throws Error if the context is not initialized, i.e. key was never provided to class.
+         */
+        void sealingKeystream(uint32_t nonce, size_t counter, uint8_t *block) {
+            if (keystreamPool != nullptr && keystreamPool->take(nonce, counter, block)) {
+                return;
+            }
+            makeCounterBlock(nonce, counter, block);
+            encryptBlock(block);
+        }
+
+        /**
+         * @brief Encrypts a binary buffer of any length in place with AES-CTR.
+         * 
+         * @param data The bytes to encrypt.
+         * @param length The number of bytes.
+         * @param nonce The nonce of the message. Must never be reused with the same key.
+         * @throws Error if the context is not initialized, i.e. key was never provided to class.
+         */
+        void encrypt(uint8_t *data, size_t length, uint32_t nonce) {
+            uint8_t counterBlock[AES_BLOCKLEN];
+            makeCounterBlock(nonce, counterBlock);
+            xcryptCTR(data, length, counterBlock);
+        }
+
+        /**
+         * @brief Encrypts a binary buffer of any length into a caller-owned one with AES-CTR.
+         * 
+         * @param input The bytes to encrypt.
+         * @param length The number of bytes.
+         * @param output The buffer to write the encrypted bytes to. May be the input.
+         * @param nonce The nonce of the message. Must never be reused with the same key.
+         * @throws Error if the context is not initialized, i.e. key was never provided to class.
+         */
+        void encrypt(const uint8_t *input, size_t length, uint8_t *output, uint32_t nonce) {
+            if (output != input) {
+                memcpy(output, input, length);
+            }
+            encrypt(output, length, nonce);
+        }
+
+        /**
+         * @brief Decrypts a binary buffer encrypted with encrypt, in place.
+         * 
+         * @param data The bytes to decrypt.
+         * @param length The number of bytes.
+         * @param nonce The nonce the message was encrypted with.
+         * @throws Error if the context is not initialized, i.e. key was never provided to class.
+         */
+        void decrypt(uint8_t *data, size_t length, uint32_t nonce) {
+            encrypt(data, length, nonce);
+        }
+
+        /**
+         * @brief Decrypts a binary buffer encrypted with encrypt into a caller-owned one.
+         * 
+         * @param input The bytes to decrypt.
+         * @param length The number of bytes.
+         * @param output The buffer to write the decrypted bytes to. May be the input.
+         * @param nonce The nonce the message was encrypted with.
+         * @throws Error if the context is not initialized, i.e. key was never provided to class.
+         */
+        void decrypt(const uint8_t *input, size_t length, uint8_t *output, uint32_t nonce) {
+            encrypt(input, length, output, nonce);
+        }
+
+        /**
+         * @brief Get the number of CBC-MAC blocks that come ahead of a message: B0, then the
+         * associated data after its two byte length, zero padded to whole blocks.
+         * 
+         * @param associatedLength The number of associated bytes.
+         */
+        static size_t headerBlocks(size_t associatedLength) {
+            return 1 + (associatedLength > 0 ? (2 + associatedLength + AES_BLOCKLEN - 1) / AES_BLOCKLEN : 0);
+        }
+
+        /**
+         * @brief Build one of the CBC-MAC blocks that come ahead of a message. CCM runs with a
+         * CRYPTO_MIC_LENGTH byte MIC, a two byte length field and the nonce laid out as in
+         * makeCounterBlock.
+         * 
+         * @param block The AES_BLOCKLEN bytes to fill.
+         * @param index Which block, below headerBlocks.
+         * @param nonce The nonce of the message.
+         * @param length The number of bytes in the message, at most 65535.
+         * @param associated The data authenticated along with the message but not encrypted.
+         * @param associatedLength The number of associated bytes, at most 65279.
+         */
+        static void headerBlock(
+            uint8_t *block,
+            size_t index,
+            uint32_t nonce,
+            size_t length,
+            const uint8_t *associated,
+            size_t associatedLength
+        ) {
+            if (index == 0) {
+                makeCounterBlock(nonce, block);
+                block[0] = (associatedLength > 0 ? 0x40 : 0) | (((CRYPTO_MIC_LENGTH - 2) / 2) << 3) | 0x01;
+                block[AES_BLOCKLEN - 2] = (uint8_t) (length >> 8);
+                block[AES_BLOCKLEN - 1] = (uint8_t) length;
+                return;
+            }
+            memset(block, 0, AES_BLOCKLEN);
+            for (size_t i = 0; i < AES_BLOCKLEN; i++) {
+                const size_t position = (index - 1) * AES_BLOCKLEN + i;
+                if (position == 0) {
+                    block[i] = (uint8_t) (associatedLength >> 8);
+                } else if (position == 1) {
+                    block[i] = (uint8_t) associatedLength;
+                } else if (position - 2 < associatedLength) {
+                    block[i] = associated[position - 2];
+                }
+            }
+        }
+
+        /**
+         * @brief Start the AES-CCM CBC-MAC of a message, over its B0 block and associated
+         * data.
+         * 
+         * @param mac The AES_BLOCKLEN byte MAC state to start.
+         * @param nonce The nonce of the message.
+         * @param length The number of bytes in the message, at most 65535.
+         * @param associated The data authenticated along with the message but not encrypted.
+         * @param associatedLength The number of associated bytes, at most 65279.
+         * @throws Error if the context is not initialized, i.e. key was never provided to class.
+         */
+        void beginMAC(uint8_t *mac, uint32_t nonce, size_t length, const uint8_t *associated, size_t associatedLength) {
+            memset(mac, 0, AES_BLOCKLEN);
+            uint8_t block[AES_BLOCKLEN];
+            for (size_t i = 0; i < headerBlocks(associatedLength); i++) {
+                headerBlock(block, i, nonce, length, associated, associatedLength);
+                feedMAC(mac, block, AES_BLOCKLEN);
+            }
+        }
+
+        /**
+         * @brief Feed up to one block of the message into a CBC-MAC, zero padding it.
+         * 
+         * @param mac The MAC state started with beginMAC.
+         * @param data The bytes of the message.
+         * @param length The number of bytes, at most AES_BLOCKLEN.
+         * @throws Error if the context is not initialized, i.e. key was never provided to class.
+         */
+        void feedMAC(uint8_t *mac, const uint8_t *data, size_t length) {
+            for (size_t i = 0; i < length; i++) {
+                mac[i] ^= data[i];
+            }
+            encryptBlock(mac);
+        }
+
+        /**
+         * @brief Turn a CBC-MAC fed the whole message into its MIC, encrypted with the
+         * keystream block of counter 0.
+         * 
+         * @param mac The MAC state fed the whole message.
+         * @param nonce The nonce of the message.
+         * @param mic The CRYPTO_MIC_LENGTH bytes to fill.
+         * @throws Error if the context is not initialized, i.e. key was never provided to class.
+         */
+        void finishMAC(const uint8_t *mac, uint32_t nonce, uint8_t *mic) {
+            uint8_t keystream[AES_BLOCKLEN];
+            makeCounterBlock(nonce, 0, keystream);
+            encryptBlock(keystream);
+            maskMAC(mac, keystream, mic);
+        }
+
+        /**
+         * @brief Turn a CBC-MAC fed the whole message into its MIC, given the keystream block
+         * of counter 0.
+         * 
+         * @param mac The MAC state fed the whole message.
+         * @param keystream The keystream block of counter 0.
+         * @param mic The CRYPTO_MIC_LENGTH bytes to fill.
+         */
+        static void maskMAC(const uint8_t *mac, const uint8_t *keystream, uint8_t *mic) {
+            for (uint8_t i = 0; i < CRYPTO_MIC_LENGTH; i++) {
+                mic[i] = mac[i] ^ keystream[i];
+            }
+        }
+
+        /**
+         * @brief Encrypts a binary buffer in place with AES-CCM, and computes its MIC.
+         * 
+         * @param data The bytes to encrypt, at most 65535.
+         * @param length The number of bytes.
+         * @param nonce The nonce of the message. Must never be reused with the same key.
+         * @param associated The data authenticated along with the message but not encrypted,
+         * such as a frame header.
+         * @param associatedLength The number of associated bytes.
+         * @param mic The CRYPTO_MIC_LENGTH bytes to write the MIC to.
+         * @throws Error if the context is not initialized, i.e. key was never provided to class.
+         */
+        void encryptAuthenticated(
+            uint8_t *data,
+            size_t length,
+            uint32_t nonce,
+            const uint8_t *associated,
+            size_t associatedLength,
+            uint8_t *mic
+        ) {
+            uint8_t mac[AES_BLOCKLEN];
+            beginMAC(mac, nonce, length, associated, associatedLength);
+            for (size_t i = 0; i < length; i += AES_BLOCKLEN) {
+                feedMAC(mac, data + i, length - i < AES_BLOCKLEN ? length - i : AES_BLOCKLEN);
+            }
+            // The keystream does not depend on the message, so it may have been precomputed.
+            uint8_t keystream[AES_BLOCKLEN];
+            sealingKeystream(nonce, 0, keystream);
+            maskMAC(mac, keystream, mic);
+            for (size_t i = 0; i < length; i += AES_BLOCKLEN) {
+                sealingKeystream(nonce, i / AES_BLOCKLEN + 1, keystream);
+                for (size_t j = 0; j < AES_BLOCKLEN && i + j < length; j++) {
+                    data[i + j] ^= keystream[j];
+                }
+            }
+        }
+
+        /**
+         * @brief Decrypts a binary buffer encrypted with encryptAuthenticated in place, if its
+         * MIC matches. Otherwise the buffer is zeroed, so that nothing forged is ever parsed.
+         * 
+         * @param data The bytes to decrypt.
+         * @param length The number of bytes.
+         * @param nonce The nonce the message was encrypted with.
+         * @param associated The data authenticated along with the message.
+         * @param associatedLength The number of associated bytes.
+         * @param mic The CRYPTO_MIC_LENGTH bytes of the received MIC.
+         * @return bool Whether the MIC matched, and so the buffer was decrypted.
+         * @throws Error if the context is not initialized, i.e. key was never provided to class.
+         */
+        bool decryptAuthenticated(
+            uint8_t *data,
+            size_t length,
+            uint32_t nonce,
+            const uint8_t *associated,
+            size_t associatedLength,
+            const uint8_t *mic
+        ) {
+            decrypt(data, length, nonce);
+            uint8_t mac[AES_BLOCKLEN];
+            beginMAC(mac, nonce, length, associated, associatedLength);
+            for (size_t i = 0; i < length; i += AES_BLOCKLEN) {
+                feedMAC(mac, data + i, length - i < AES_BLOCKLEN ? length - i : AES_BLOCKLEN);
+            }
+            uint8_t expected[CRYPTO_MIC_LENGTH];
+            finishMAC(mac, nonce, expected);
+            // Compare every byte, so that the time taken does not tell how much matched.
+            uint8_t difference = 0;
+            for (uint8_t i = 0; i < CRYPTO_MIC_LENGTH; i++) {
+                difference |= expected[i] ^ mic[i];
+            }
+            if (difference != 0) {
+                memset(data, 0, length);
+                return false;
+            }
+            return true;
+        }
+
+        /**
+         * @brief Use a signing key of its own for AES-CMAC signatures, rather than the one
+         * derived from the key, until the key changes.
+         * 
+         * @param signingKey The AES_KEYLEN bytes of the signing key.
+         */
+        void setSigningKey(const uint8_t *signingKey) {
+            if (signingCtx == nullptr) {
+                signingCtx = new AES_ctx();
+            }
+            AES_init_ctx(signingCtx, signingKey);
+            // The subkeys double L = AES(0) in GF(2^128), as RFC 4493 generates them.
+            uint8_t doubled[AES_BLOCKLEN] = {0};
+            AES_ECB_encrypt(signingCtx, doubled);
+            for (uint8_t subkey = 0; subkey < 2; subkey++) {
+                const uint8_t carry = doubled[0] >> 7;
+                for (uint8_t i = 0; i < AES_BLOCKLEN - 1; i++) {
+                    doubled[i] = (uint8_t) ((doubled[i] << 1) | (doubled[i + 1] >> 7));
+                }
+                doubled[AES_BLOCKLEN - 1] = (uint8_t) ((doubled[AES_BLOCKLEN - 1] << 1) ^ (carry ? 0x87 : 0));
+                memcpy(signingSubkeys + subkey * AES_BLOCKLEN, doubled, AES_BLOCKLEN);
+            }
+            memset(doubled, 0, sizeof(doubled));
+            signingReady = true;
+        }
+
+        /**
+         * @brief Start the AES-CMAC of a message. The signing key is derived from the key the
+         * first time it is needed, by encrypting a block distinct from those deriveSessionKey
+         * encrypts, so that tags and CCM never share a key.
+         * 
+         * @param mac The AES_BLOCKLEN byte MAC state to start.
+         * @throws Error if the context is not initialized, i.e. key was never provided to class.
+         */
+        void beginSignature(uint8_t *mac) {
+            if (!signingReady) {
+                uint8_t signingKey[AES_BLOCKLEN] = { 0x02 };
+                encryptBlock(signingKey);
+                setSigningKey(signingKey);
+                memset(signingKey, 0, sizeof(signingKey));
+            }
+            memset(mac, 0, AES_BLOCKLEN);
+        }
+
+        /**
+         * @brief Feed a whole block of the message into an AES-CMAC, as long as more of the
+         * message follows it.
+         * 
+         * @param mac The MAC state started with beginSignature.
+         * @param block The AES_BLOCKLEN bytes of the message.
+         */
+        void feedSignature(uint8_t *mac, const uint8_t *block) {
+            for (uint8_t i = 0; i < AES_BLOCKLEN; i++) {
+                mac[i] ^= block[i];
+            }
+            AES_ECB_encrypt(signingCtx, mac);
+        }
+
+        /**
+         * @brief Feed the last, possibly partial or empty, block of the message into an
+         * AES-CMAC, and truncate it to its tag.
+         * 
+         * @param mac The MAC state fed the rest of the message.
+         * @param block The last bytes of the message.
+         * @param length The number of bytes, at most AES_BLOCKLEN; 0 only if the message is
+         * empty.
+         * @param tag The CRYPTO_MIC_LENGTH bytes to fill.
+         */
+        void finishSignature(uint8_t *mac, const uint8_t *block, size_t length, uint8_t *tag) {
+            const uint8_t *subkey = signingSubkeys + (length == AES_BLOCKLEN ? 0 : AES_BLOCKLEN);
+            for (uint8_t i = 0; i < AES_BLOCKLEN; i++) {
+                const uint8_t padded = i < length ? block[i] : (i == length ? 0x80 : 0);
+                mac[i] ^= padded ^ subkey[i];
+            }
+            AES_ECB_encrypt(signingCtx, mac);
+            memcpy(tag, mac, CRYPTO_MIC_LENGTH);
+        }
+
+        /**
+         * @brief Compute the AES-CMAC tag of a binary buffer, truncated to CRYPTO_MIC_LENGTH
+         * bytes. The buffer is left in the clear, so this protects integrity only, at about
+         * half the AES blocks of encryptAuthenticated.
+         * 
+         * @param data The bytes to sign, such as a whole frame.
+         * @param length The number of bytes.
+         * @param tag The CRYPTO_MIC_LENGTH bytes to write the tag to.
+         * @throws Error if the context is not initialized, i.e. key was never provided to class.
+         */
+        void sign(const uint8_t *data, size_t length, uint8_t *tag) {
+            uint8_t mac[AES_BLOCKLEN];
+            beginSignature(mac);
+            size_t position = 0;
+            for (; length - position > AES_BLOCKLEN; position += AES_BLOCKLEN) {
+                feedSignature(mac, data + position);
+            }
+            finishSignature(mac, data + position, length - position, tag);
+        }
+
+        /**
+         * @brief Check the AES-CMAC tag of a binary buffer, in time independent of where it
+         * differs.
+         * 
+         * @param data The signed bytes.
+         * @param length The number of bytes.
+         * @param tag The CRYPTO_MIC_LENGTH bytes of the received tag.
+         * @return bool Whether the tag matched.
+         * @throws Error if the context is not initialized, i.e. key was never provided to class.
+         */
+        bool verifySignature(const uint8_t *data, size_t length, const uint8_t *tag) {
+            uint8_t expected[CRYPTO_MIC_LENGTH];
+            sign(data, length, expected);
+            uint8_t difference = 0;
+            for (uint8_t i = 0; i < CRYPTO_MIC_LENGTH; i++) {
+                difference |= expected[i] ^ tag[i];
+            }
+            return difference == 0;
+        }
+
+        /**
+         * @brief Encrypts independent blocks in place on a bitsliced cipher, in constant time.
+         * A pass costs the same however few of its lanes are used, so batches that fit a
+         * general purpose register run on it, and only larger ones on SIMD words.
+         * 
+         * @param blocks The blocks, AES_BLOCKLEN bytes each, one after the other.
+         * @param count The number of blocks.
+         * @throws Error if the context is not initialized, i.e. key was never provided to class.
+         */
+        void encryptBlocks(uint8_t *blocks, size_t count) {
+            if (!initialized) {
+                throw "Crypto context not initialized";
+            }
+            if (count <= BitslicedAES<ScalarBitslicedWord>::LANES || std::is_same<ScalarBitslicedWord, NativeBitslicedWord>::value) {
+                if (scalarCipher == nullptr) {
+                    scalarCipher = new BitslicedAES<ScalarBitslicedWord>(ctx->RoundKey);
+                }
+                scalarCipher->encrypt(blocks, count);
+                return;
+            }
+            if (batchCipher == nullptr) {
+                batchCipher = new BitslicedAES<NativeBitslicedWord>(ctx->RoundKey);
+            }
+            batchCipher->encrypt(blocks, count);
+        }
+
+        /**
+         * @brief Decrypts many messages encrypted with encryptAuthenticated at once, each in
+         * place if its MIC matches and zeroed otherwise. Keystream blocks of all messages are
+         * encrypted together, and their CBC-MACs run in lockstep one lane each, so every AES
+         * block goes through the bitsliced cipher in constant time. Groups of fewer than
+         * CRYPTO_BATCH_MIN_MESSAGES, such as a short batch or the tail of a long one, are
+         * opened one by one with decryptAuthenticated instead, as they open faster that way.
+         * 
+         * @param messages The messages to open, each marked authentic or not.
+         * @param count The number of messages.
+         * @return size_t The number of messages whose MIC matched.
+         * @throws Error if the context is not initialized, i.e. key was never provided to class.
+         */
+        size_t decryptAuthenticatedBatch(SealedMessage *messages, size_t count) {
+            const size_t lanes = BitslicedAES<NativeBitslicedWord>::LANES;
+            uint8_t blocks[lanes][AES_BLOCKLEN];
+            size_t authentic = 0;
+            for (size_t first = 0; first < count; first += lanes) {
+                SealedMessage *group = messages + first;
+                const size_t groupSize = count - first < lanes ? count - first : lanes;
+                if (groupSize < CRYPTO_BATCH_MIN_MESSAGES) {
+                    for (size_t i = 0; i < groupSize; i++) {
+                        group[i].authentic = decryptAuthenticated(
+                            group[i].data,
+                            group[i].length,
+                            group[i].nonce,
+                            group[i].associated,
+                            group[i].associatedLength,
+                            group[i].mic
+                        );
+                        authentic += group[i].authentic;
+                    }
+                    continue;
+                }
+
+                // Decrypt every message, with the keystream of counters 1 onwards.
+                SealedMessage *owner[lanes];
+                size_t offset[lanes];
+                size_t used = 0;
+                const auto applyKeystream = [&]() {
+                    encryptBlocks(blocks[0], used);
+                    for (size_t lane = 0; lane < used; lane++) {
+                        const size_t remaining = owner[lane]->length - offset[lane];
+                        for (size_t j = 0; j < AES_BLOCKLEN && j < remaining; j++) {
+                            owner[lane]->data[offset[lane] + j] ^= blocks[lane][j];
+                        }
+                    }
+                    used = 0;
+                };
+                for (size_t i = 0; i < groupSize; i++) {
+                    for (size_t position = 0; position < group[i].length; position += AES_BLOCKLEN) {
+                        const size_t counter = position / AES_BLOCKLEN + 1;
+                        makeCounterBlock(group[i].nonce, blocks[used]);
+                        blocks[used][AES_BLOCKLEN - 2] = (uint8_t) (counter >> 8);
+                        blocks[used][AES_BLOCKLEN - 1] = (uint8_t) counter;
+                        owner[used] = group + i;
+                        offset[used++] = position;
+                        if (used == lanes) {
+                            applyKeystream();
+                        }
+                    }
+                }
+                if (used > 0) {
+                    applyKeystream();
+                }
+
+                // Run the CBC-MACs side by side, keeping each MIC once its message ends.
+                uint8_t expected[lanes][CRYPTO_MIC_LENGTH];
+                size_t steps[lanes];
+                size_t longest = 0;
+                memset(blocks, 0, sizeof(blocks));
+                for (size_t i = 0; i < groupSize; i++) {
+                    steps[i] = headerBlocks(group[i].associatedLength) + (group[i].length + AES_BLOCKLEN - 1) / AES_BLOCKLEN;
+                    longest = steps[i] > longest ? steps[i] : longest;
+                }
+                for (size_t step = 0; step < longest; step++) {
+                    for (size_t i = 0; i < groupSize; i++) {
+                        if (step >= steps[i]) {
+                            continue;
+                        }
+                        const SealedMessage &message = group[i];
+                        const size_t header = headerBlocks(message.associatedLength);
+                        uint8_t input[AES_BLOCKLEN] = {0};
+                        if (step < header) {
+                            headerBlock(input, step, message.nonce, message.length, message.associated, message.associatedLength);
+                        } else {
+                            const size_t position = (step - header) * AES_BLOCKLEN;
+                            const size_t length = message.length - position;
+                            memcpy(input, message.data + position, length < AES_BLOCKLEN ? length : AES_BLOCKLEN);
+                        }
+                        for (uint8_t j = 0; j < AES_BLOCKLEN; j++) {
+                            blocks[i][j] ^= input[j];
+                        }
+                    }
+                    encryptBlocks(blocks[0], groupSize);
+                    for (size_t i = 0; i < groupSize; i++) {
+                        if (step + 1 == steps[i]) {
+                            memcpy(expected[i], blocks[i], CRYPTO_MIC_LENGTH);
+                        }
+                    }
+                }
+
+                // Encrypt the MICs with the keystream of counter 0, and compare them in full.
+                for (size_t i = 0; i < groupSize; i++) {
+                    makeCounterBlock(group[i].nonce, blocks[i]);
+                    blocks[i][AES_BLOCKLEN - 1] = 0;
+                }
+                encryptBlocks(blocks[0], groupSize);
+                for (size_t i = 0; i < groupSize; i++) {
+                    uint8_t difference = 0;
+                    for (uint8_t j = 0; j < CRYPTO_MIC_LENGTH; j++) {
+                        difference |= expected[i][j] ^ blocks[i][j] ^ group[i].mic[j];
+                    }
+                    group[i].authentic = difference == 0;
+                    if (group[i].authentic) {
+                        authentic++;
+                    } else {
+                        memset(group[i].data, 0, group[i].length);
+                    }
+                }
+            }
+            return authentic;
+        }
+
         /**
          * @brief Check if the service is ready.
          * 
@@ -112,6 +1001,11 @@ class Crypto {
          * 
          */
         ~Crypto() {
+            delete scalarCipher;
+            delete batchCipher;
+            delete keyCache;
+            delete keystreamPool;
+            delete signingCtx;
             delete ctx;
         }
 };
\ No newline at end of file
@@ -0,0 +1,228 @@
+/**
+ * @file duty_cycle.hpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Contains the token bucket that keeps the airtime of a radio within the duty cycle
+ * of the sub-band it sends on.
+ * @version 0.1
+ * @date 2022-05-07
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/// The window duty cycles are measured over, in milliseconds: an hour, as ETSI EN 300 220
+/// does.
+#define DUTY_CYCLE_WINDOW 3600000
+
+/// The bucket holds this share of the airtime a window allows, 1 / DUTY_CYCLE_BURST_SHARE,
+/// and refills at the rest of the duty cycle, so that a full bucket and a window of refill
+/// together never exceed the allowance. A quarter holds a full length frame at SF12 and 1%,
+/// as LoraInterface sends it.
+#define DUTY_CYCLE_BURST_SHARE 4
+
+/**
+ * @brief A range of frequencies sharing one duty cycle limit.
+ *
+ */
+struct SubBand {
+    /// The lowest and highest frequencies of the sub-band, in Hz.
+    uint32_t lowFrequency;
+    uint32_t highFrequency;
+
+    /// The divisor of the duty cycle, 100 for 1%, or 0 when airtime is not limited.
+    uint16_t dutyCycleDivisor;
+};
+
+/// The sub-bands of ERC Recommendation 70-03 that nodes may send on, with their duty
+/// cycles. Frequencies outside of them are not limited, as elsewhere, such as the US 915 MHz
+/// band, the rules are dwell times rather than duty cycles.
+static const SubBand SUB_BANDS[] = {
+    { 433050000, 434790000, 10 },
+    { 863000000, 865000000, 1000 },
+    { 865000000, 868000000, 100 },
+    { 868000000, 868600000, 100 },
+    { 868700000, 869200000, 1000 },
+    { 869400000, 869650000, 10 },
+    { 869700000, 870000000, 100 }
+};
+
+/**
+ * @brief Keeps the airtime of a radio within the duty cycle of its sub-band, as a token
+ * bucket of airtime: each frame takes its time on air out of the bucket, and the bucket
+ * refills with time. Frames it holds no airtime for must wait, and are counted as deferred.
+ *
+ * Airtime is counted in units of 1 / (DUTY_CYCLE_BURST_SHARE * divisor) microseconds, so
+ * that the bucket holds DUTY_CYCLE_WINDOW * 1000 units whatever the duty cycle, and refills
+ * by a whole number of units every millisecond.
+ *
+ */
+class DutyCycleBudget {
+    private:
+        /// The divisor of the duty cycle, or 0 when airtime is not limited.
+        uint16_t divisor;
+
+        /// The airtime in the bucket, in units. Negative after a frame longer than the whole
+        /// bucket overdrew it.
+        int64_t tokens;
+
+        /// The uptime in milliseconds the bucket was last refilled at.
+        uint32_t refilledAt;
+
+        /// The airtime of every frame sent, in microseconds.
+        uint64_t spent;
+
+        /// The frames that had to wait for airtime.
+        uint32_t deferred;
+
+        /**
+         * @brief Get the airtime the bucket holds when full, in units.
+         *
+         */
+        static int64_t capacity() {
+            return (int64_t) DUTY_CYCLE_WINDOW * 1000;
+        }
+
+        /**
+         * @brief Get an airtime in units.
+         *
+         */
+        int64_t unitsOf(uint32_t airtime) const {
+            return (int64_t) airtime * DUTY_CYCLE_BURST_SHARE * this->divisor;
+        }
+
+        /**
+         * @brief Add the airtime earned since the last refill to the bucket.
+         *
+         */
+        void refill(uint32_t now) {
+            const uint32_t elapsed = now - this->refilledAt;
+            this->refilledAt = now;
+            this->tokens += (int64_t) elapsed * 1000 * (DUTY_CYCLE_BURST_SHARE - 1);
+            if (this->tokens > capacity()) {
+                this->tokens = capacity();
+            }
+        }
+
+    public:
+        /**
+         * @brief Construct a new, full Duty Cycle Budget object.
+         *
+         * @param dutyCycleDivisor The divisor of the duty cycle, 100 for 1%, or 0 to not
+         * limit airtime.
+         * @param now The uptime, in milliseconds.
+         */
+        DutyCycleBudget(uint16_t dutyCycleDivisor, uint32_t now) {
+            this->divisor = dutyCycleDivisor;
+            this->tokens = capacity();
+            this->refilledAt = now;
+            this->spent = 0;
+            this->deferred = 0;
+        }
+
+        /**
+         * @brief Get the divisor of the duty cycle of the sub-band a frequency falls in.
+         *
+         * @param frequency The frequency sent on, in Hz.
+         * @return uint16_t The divisor, or 0 if airtime is not limited there.
+         */
+        static uint16_t dutyCycleDivisorOf(uint32_t frequency) {
+            for (const SubBand &subBand : SUB_BANDS) {
+                if (frequency >= subBand.lowFrequency && frequency < subBand.highFrequency) {
+                    return subBand.dutyCycleDivisor;
+                }
+            }
+            return 0;
+        }
+
+        /**
+         * @brief Check whether airtime is limited at all.
+         *
+         */
+        bool isLimited() const {
+            return this->divisor != 0;
+        }
+
+        /**
+         * @brief Check whether a frame can be sent now, without taking its airtime. A frame
+         * longer than the whole bucket can be sent once the bucket is full.
+         *
+         * @param airtime The time on air of the frame, in microseconds.
+         * @param now The uptime, in milliseconds.
+         */
+        bool allows(uint32_t airtime, uint32_t now) {
+            if (!isLimited()) {
+                return true;
+            }
+            refill(now);
+            return this->tokens >= unitsOf(airtime) || this->tokens == capacity();
+        }
+
+        /**
+         * @brief Take the airtime of a frame out of the bucket if it allows it, or count the
+         * frame as deferred.
+         *
+         * @param airtime The time on air of the frame, in microseconds.
+         * @param now The uptime, in milliseconds.
+         * @return bool Whether the frame may be sent now.
+         */
+        bool spend(uint32_t airtime, uint32_t now) {
+            if (!allows(airtime, now)) {
+                this->deferred++;
+                return false;
+            }
+            if (isLimited()) {
+                this->tokens -= unitsOf(airtime);
+            }
+            this->spent += airtime;
+            return true;
+        }
+
+        /**
+         * @brief Get how long until a frame can be sent, in milliseconds.
+         *
+         * @param airtime The time on air of the frame, in microseconds.
+         * @param now The uptime, in milliseconds.
+         */
+        uint32_t waitFor(uint32_t airtime, uint32_t now) {
+            if (allows(airtime, now)) {
+                return 0;
+            }
+            const int64_t needed = unitsOf(airtime) < capacity() ? unitsOf(airtime) : capacity();
+            const int64_t perMillisecond = (int64_t) 1000 * (DUTY_CYCLE_BURST_SHARE - 1);
+            return (uint32_t) ((needed - this->tokens + perMillisecond - 1) / perMillisecond);
+        }
+
+        /**
+         * @brief Get the share of the bucket in use, the budget usage reported as a metric:
+         * 0 when full, 1 when empty, and above 1 while overdrawn.
+         *
+         * @param now The uptime, in milliseconds.
+         */
+        float usage(uint32_t now) {
+            if (!isLimited()) {
+                return 0;
+            }
+            refill(now);
+            return (float) (capacity() - this->tokens) / (float) capacity();
+        }
+
+        /**
+         * @brief Get the airtime of every frame sent, in microseconds.
+         *
+         */
+        uint64_t spentAirtime() const {
+            return this->spent;
+        }
+
+        /**
+         * @brief Get the number of frames that had to wait for airtime.
+         *
+         */
+        uint32_t deferredFrames() const {
+            return this->deferred;
+        }
+};
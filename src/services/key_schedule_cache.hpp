@@ -0,0 +1,182 @@
+/**
+ * @file key_schedule_cache.hpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Contains a small LRU cache of expanded AES key schedules, for Crypto contexts that
+ * switch between many keys.
+ * @version 0.1
+ * @date 2022-04-29
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <aes.hpp>
+
+/// The schedules a cache keeps by default, as many as a gateway registers nodes.
+#define KEY_SCHEDULE_CACHE_LENGTH 64
+
+/**
+ * @brief Keeps the expanded schedules of the keys used last, each under the ID of its key, so
+ * that switching back to a key copies its schedule instead of expanding it again. Entries are
+ * found by scanning their IDs, which sit together in one small array, and are chained from the
+ * most to the least recently used, which is replaced on a miss. SessionTable does without
+ * one, as expanding a key costs about as much as finding and copying its entry.
+ *
+ */
+class KeyScheduleCache {
+    private:
+        /// The ID of the key in each entry.
+        uint16_t *keyIDs;
+
+        /// The key each entry was expanded from, AES_KEYLEN bytes per entry.
+        uint8_t *keys;
+
+        /// The expanded schedule of each entry.
+        AES_ctx *schedules;
+
+        /// The entry used just after each entry, or the length if it is the newest.
+        uint8_t *newer;
+
+        /// The entry used just before each entry, or the length if it is the oldest.
+        uint8_t *older;
+
+        /// The number of entries the cache holds, at most 255.
+        size_t length;
+
+        /// The number of entries filled.
+        size_t used;
+
+        /// The most and least recently used entries.
+        uint8_t newest, oldest;
+
+        /// The lookups that found the schedule, and those that expanded it.
+        unsigned long hitCount, missCount;
+
+        /**
+         * @brief Take an entry out of the recency chain.
+         *
+         */
+        void unlink(uint8_t entry) {
+            if (this->newer[entry] < this->length) {
+                this->older[this->newer[entry]] = this->older[entry];
+            } else {
+                this->newest = this->older[entry];
+            }
+            if (this->older[entry] < this->length) {
+                this->newer[this->older[entry]] = this->newer[entry];
+            } else {
+                this->oldest = this->newer[entry];
+            }
+        }
+
+        /**
+         * @brief Put an entry at the most recently used end of the chain.
+         *
+         */
+        void pushNewest(uint8_t entry) {
+            this->older[entry] = this->newest;
+            this->newer[entry] = this->length;
+            if (this->newest < this->length) {
+                this->newer[this->newest] = entry;
+            } else {
+                this->oldest = entry;
+            }
+            this->newest = entry;
+        }
+
+    public:
+        /**
+         * @brief Construct a new, empty Key Schedule Cache object.
+         *
+         * @param length The number of schedules to keep, from 1 to 255.
+         */
+        KeyScheduleCache(size_t length = KEY_SCHEDULE_CACHE_LENGTH) {
+            this->length = length < 1 ? 1 : length > 255 ? 255 : length;
+            this->keyIDs = new uint16_t[this->length];
+            this->keys = new uint8_t[this->length * AES_KEYLEN];
+            this->schedules = new AES_ctx[this->length];
+            this->newer = new uint8_t[this->length];
+            this->older = new uint8_t[this->length];
+            this->used = 0;
+            this->newest = this->oldest = this->length;
+            this->hitCount = this->missCount = 0;
+        }
+
+        /**
+         * @brief Get the expanded schedule of a key, expanding it into the least recently
+         * used entry if it is not cached. An entry whose ID now names a different key, as
+         * after a node joins again, is expanded afresh.
+         *
+         * @param keyID The ID of the key.
+         * @param key The AES_KEYLEN bytes of the key.
+         * @return const AES_ctx& The schedule, valid until the entry is replaced.
+         */
+        const AES_ctx &schedule(uint16_t keyID, const uint8_t *key) {
+            size_t entry = 0;
+            while (entry < this->used && this->keyIDs[entry] != keyID) {
+                entry++;
+            }
+            if (entry < this->used) {
+                this->unlink(entry);
+                if (memcmp(this->keys + entry * AES_KEYLEN, key, AES_KEYLEN) == 0) {
+                    this->hitCount++;
+                    this->pushNewest(entry);
+                    return this->schedules[entry];
+                }
+            } else if (this->used < this->length) {
+                entry = this->used++;
+            } else {
+                entry = this->oldest;
+                this->unlink(entry);
+            }
+            this->missCount++;
+            this->keyIDs[entry] = keyID;
+            memcpy(this->keys + entry * AES_KEYLEN, key, AES_KEYLEN);
+            AES_init_ctx(&this->schedules[entry], key);
+            this->pushNewest(entry);
+            return this->schedules[entry];
+        }
+
+        /**
+         * @brief Get the number of lookups that found the schedule cached.
+         *
+         */
+        unsigned long hits() const {
+            return this->hitCount;
+        }
+
+        /**
+         * @brief Get the number of lookups that had to expand the schedule.
+         *
+         */
+        unsigned long misses() const {
+            return this->missCount;
+        }
+
+        /**
+         * @brief Start counting hits and misses from zero again.
+         *
+         */
+        void resetCounters() {
+            this->hitCount = this->missCount = 0;
+        }
+
+        /**
+         * @brief Destroy the Key Schedule Cache object, wiping the keys it held.
+         *
+         */
+        ~KeyScheduleCache() {
+            memset(this->keys, 0, this->length * AES_KEYLEN);
+            memset((void *) this->schedules, 0, this->length * sizeof(AES_ctx));
+            delete[] this->keyIDs;
+            delete[] this->keys;
+            delete[] this->schedules;
+            delete[] this->newer;
+            delete[] this->older;
+        }
+};
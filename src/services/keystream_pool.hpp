@@ -0,0 +1,199 @@
+/**
+ * @file keystream_pool.hpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Contains a small ring of CTR keystream blocks precomputed for the nonces a Crypto
+ * context seals with next.
+ * @version 0.1
+ * @date 2022-04-30
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <aes.hpp>
+
+/// The nonces a pool precomputes keystream for by default, ahead of the next one to be taken.
+#define KEYSTREAM_POOL_LENGTH 4
+
+/// The message blocks precomputed per nonce, enough for the body of the largest LoRa frame.
+/// Block 0, which encrypts the MIC, is kept on top of them.
+#define KEYSTREAM_POOL_BLOCKS 16
+
+/**
+ * @brief Holds CTR keystream blocks computed ahead of time for the nonces that will be taken
+ * next, so that sealing a frame with one of them only XORs. Each nonce has an entry of the
+ * ring, at the nonce modulo its length, filled from block 0 up. Entries of nonces already
+ * taken are simply refilled for later ones. Keystream only depends on the key and nonce, so
+ * the owner clears the pool whenever the key changes.
+ *
+ */
+class KeystreamPool {
+    private:
+        /// The nonce the keystream of each entry belongs to.
+        uint32_t *nonces;
+
+        /// The number of blocks precomputed in each entry, from block 0.
+        uint8_t *ready;
+
+        /// The keystream of each entry, KEYSTREAM_POOL_BLOCKS + 1 blocks per entry.
+        uint8_t *blocks;
+
+        /// The number of entries, and so of nonces precomputed ahead.
+        size_t length;
+
+        /// The blocks found precomputed when sealing, and those computed then.
+        unsigned long hitCount, missCount;
+
+        /// The blocks precomputed, and the microseconds spent precomputing them.
+        unsigned long precomputedCount, precomputeMicros;
+
+        /**
+         * @brief Get the keystream block of an entry.
+         *
+         */
+        uint8_t *blockOf(size_t entry, size_t counter) {
+            return this->blocks + (entry * (KEYSTREAM_POOL_BLOCKS + 1) + counter) * AES_BLOCKLEN;
+        }
+
+    public:
+        /**
+         * @brief Construct a new, empty Keystream Pool object.
+         *
+         * @param length The number of nonces to precompute keystream for, at least 1.
+         */
+        KeystreamPool(size_t length = KEYSTREAM_POOL_LENGTH) {
+            this->length = length < 1 ? 1 : length;
+            this->nonces = new uint32_t[this->length];
+            this->ready = new uint8_t[this->length];
+            this->blocks = new uint8_t[this->length * (KEYSTREAM_POOL_BLOCKS + 1) * AES_BLOCKLEN];
+            this->hitCount = this->missCount = 0;
+            this->precomputedCount = this->precomputeMicros = 0;
+            clear();
+        }
+
+        /**
+         * @brief Precompute keystream blocks for the nonces from the next one to be taken,
+         * nearest nonce and lowest block first, until the pool is full or the budget is spent.
+         *
+         * @param nextNonce The nonce the owner will seal its next message with.
+         * @param budget The most blocks to compute.
+         * @param fill Fills the keystream block of a nonce and block counter, given as
+         * (uint32_t nonce, size_t counter, uint8_t *block).
+         * @return size_t The number of blocks computed, 0 once the pool is full.
+         */
+        template <typename BlockFiller>
+        size_t refill(uint32_t nextNonce, size_t budget, BlockFiller fill) {
+            const unsigned long start = micros();
+            size_t computed = 0;
+            for (size_t ahead = 0; ahead < this->length && computed < budget; ahead++) {
+                const uint32_t nonce = nextNonce + (uint32_t) ahead;
+                const size_t entry = nonce % this->length;
+                if (this->nonces[entry] != nonce) {
+                    this->nonces[entry] = nonce;
+                    this->ready[entry] = 0;
+                }
+                while (this->ready[entry] <= KEYSTREAM_POOL_BLOCKS && computed < budget) {
+                    fill(nonce, (size_t) this->ready[entry], blockOf(entry, this->ready[entry]));
+                    this->ready[entry]++;
+                    computed++;
+                }
+            }
+            if (computed > 0) {
+                this->precomputedCount += computed;
+                this->precomputeMicros += micros() - start;
+            }
+            return computed;
+        }
+
+        /**
+         * @brief Copy out a precomputed keystream block, counting a hit if it was there and a
+         * miss if the caller has to compute it.
+         *
+         * @param nonce The nonce of the message being sealed.
+         * @param counter The block counter, 0 for the block encrypting the MIC.
+         * @param block The AES_BLOCKLEN bytes to fill.
+         * @return bool Whether the block was precomputed and copied.
+         */
+        bool take(uint32_t nonce, size_t counter, uint8_t *block) {
+            const size_t entry = nonce % this->length;
+            if (this->nonces[entry] != nonce || counter >= this->ready[entry]) {
+                this->missCount++;
+                return false;
+            }
+            memcpy(block, blockOf(entry, counter), AES_BLOCKLEN);
+            this->hitCount++;
+            return true;
+        }
+
+        /**
+         * @brief Forget every precomputed block, as when the key changes.
+         *
+         */
+        void clear() {
+            memset(this->nonces, 0, this->length * sizeof(uint32_t));
+            memset(this->ready, 0, this->length);
+            memset(this->blocks, 0, this->length * (KEYSTREAM_POOL_BLOCKS + 1) * AES_BLOCKLEN);
+        }
+
+        /**
+         * @brief Get the number of keystream blocks found precomputed when sealing.
+         *
+         */
+        unsigned long hits() const {
+            return this->hitCount;
+        }
+
+        /**
+         * @brief Get the number of keystream blocks computed while sealing.
+         *
+         */
+        unsigned long misses() const {
+            return this->missCount;
+        }
+
+        /**
+         * @brief Get the number of keystream blocks precomputed in idle time.
+         *
+         */
+        unsigned long precomputed() const {
+            return this->precomputedCount;
+        }
+
+        /**
+         * @brief Estimate the microseconds taken off the sealing path: the blocks found
+         * precomputed, at the average cost of precomputing a block.
+         *
+         */
+        unsigned long savedMicros() const {
+            if (this->precomputedCount == 0) {
+                return 0;
+            }
+            return (unsigned long) ((double) this->precomputeMicros * this->hitCount / this->precomputedCount);
+        }
+
+        /**
+         * @brief Start counting from zero again.
+         *
+         */
+        void resetCounters() {
+            this->hitCount = this->missCount = 0;
+            this->precomputedCount = this->precomputeMicros = 0;
+        }
+
+        /**
+         * @brief Destroy the Keystream Pool object, wiping the keystream it held.
+         *
+         */
+        ~KeystreamPool() {
+            memset(this->blocks, 0, this->length * (KEYSTREAM_POOL_BLOCKS + 1) * AES_BLOCKLEN);
+            delete[] this->nonces;
+            delete[] this->ready;
+            delete[] this->blocks;
+        }
+};
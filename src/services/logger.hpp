@@ -37,6 +37,16 @@ class Logger {
             this->interface = interface;
         }
 
+        /**
+         * @brief Check whether messages are being logged, so that callers on hot paths can
+         * skip building them.
+         * 
+         * @return bool Whether verbose logging is enabled.
+         */
+        bool isVerbose() {
+            return verbose;
+        }
+
         /**
          * @brief Log a message if verbose is true.
          * 
@@ -74,6 +84,19 @@ class Logger {
             }
         }
 
+        /**
+         * @brief Log a literal message if verbose is true. Unlike the String overload, this
+         * does not allocate when logging is disabled.
+         * 
+         * @param msg The message to log.
+         * @param newline Whether or not to add a newline to the end of the message.
+        */
+        void logSerial(const char *msg, bool newline=false, int serial_port=0) {
+            if (verbose) {
+                logSerial(String(msg), newline, serial_port);
+            }
+        }
+
         /**
          * @brief Log into the display OLED if enabled and available
          * 
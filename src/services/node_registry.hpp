@@ -0,0 +1,163 @@
+/**
+ * @file node_registry.hpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Contains the table of short addresses a gateway assigned to nodes, and the nonces of
+ * their last joins, persisted in NVS.
+ * @version 0.1
+ * @date 2022-04-18
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <Preferences.h>
+
+#include "models/join_message.hpp"
+#include "models/meter_reading.hpp"
+#include "services/logger.hpp"
+
+/// The NVS namespace the table is persisted in.
+#define NODE_REGISTRY_NAMESPACE "nodeRegistry"
+
+/// The NVS key the Device IDs are persisted under, in address order.
+#define NODE_REGISTRY_KEY "deviceIDs"
+
+/// The NVS key the node nonce of the last join of each node is persisted under, in address
+/// order.
+#define NODE_REGISTRY_NONCES_KEY "nodeNonces"
+
+/**
+ * @brief Maps the short addresses a gateway assigned to the Device IDs of its nodes. Address
+ * n belongs to the nth node that joined, so the table is persisted as one blob of Device IDs
+ * and survives reboots; addresses are never reused. The node nonce of the last join of each
+ * node is persisted alongside, so that a replayed join request is refused even after a reboot.
+ *
+ */
+class NodeRegistry {
+    private:
+        /// The logger to use for logging.
+        Logger *logger;
+
+        /// The NVS handle the table is persisted through.
+        Preferences preferences;
+
+        /// The Device ID of the node with each address, starting with address 1.
+        char deviceIDs[NODE_REGISTRY_CAPACITY][MAX_DEVICE_ID_LENGTH + 1];
+
+        /// The number of addresses assigned.
+        size_t count;
+
+        /// The node nonce of the last join of the node with each address, 0 if none was
+        /// recorded.
+        uint32_t nodeNonces[NODE_REGISTRY_CAPACITY];
+
+    public:
+        /**
+         * @brief Construct a new Node Registry object, loading the table persisted by
+         * earlier boots.
+         *
+         * @param verbose Whether or not to print verbose logs.
+         */
+        NodeRegistry(bool verbose = false) {
+            this->logger = new Logger(verbose, "NodeRegistry");
+            this->preferences.begin(NODE_REGISTRY_NAMESPACE, false);
+            const size_t storedLength = this->preferences.getBytesLength(NODE_REGISTRY_KEY);
+            this->count = storedLength <= sizeof(this->deviceIDs) ? storedLength / sizeof(this->deviceIDs[0]) : 0;
+            this->preferences.getBytes(NODE_REGISTRY_KEY, this->deviceIDs, this->count * sizeof(this->deviceIDs[0]));
+            memset(this->nodeNonces, 0, sizeof(this->nodeNonces));
+            if (this->preferences.getBytesLength(NODE_REGISTRY_NONCES_KEY) <= sizeof(this->nodeNonces)) {
+                this->preferences.getBytes(NODE_REGISTRY_NONCES_KEY, this->nodeNonces, sizeof(this->nodeNonces));
+            }
+            this->logger->logSerial("Loaded " + String(this->count) + " nodes.", true);
+        }
+
+        /**
+         * @brief Get the short address assigned to a node, without assigning one.
+         *
+         * @param deviceID The NUL-terminated Device ID of the node.
+         * @return uint16_t The address of the node, or 0 if it never joined.
+         */
+        uint16_t find(const char *deviceID) {
+            for (size_t i = 0; i < this->count; i++) {
+                if (strncmp(this->deviceIDs[i], deviceID, MAX_DEVICE_ID_LENGTH) == 0) {
+                    return i + 1;
+                }
+            }
+            return 0;
+        }
+
+        /**
+         * @brief Get the short address of a node, assigning and persisting a new one if it
+         * never joined before.
+         *
+         * @param deviceID The NUL-terminated Device ID of the node.
+         * @return uint16_t The address of the node, or 0 if the table is full.
+         */
+        uint16_t join(const char *deviceID) {
+            const uint16_t known = find(deviceID);
+            if (known != 0) {
+                return known;
+            }
+            if (this->count == NODE_REGISTRY_CAPACITY) {
+                this->logger->logSerial("Registry full, rejecting join.", true);
+                return 0;
+            }
+            strncpy(this->deviceIDs[this->count], deviceID, MAX_DEVICE_ID_LENGTH);
+            this->deviceIDs[this->count][MAX_DEVICE_ID_LENGTH] = '\0';
+            this->count++;
+            this->preferences.putBytes(NODE_REGISTRY_KEY, this->deviceIDs, this->count * sizeof(this->deviceIDs[0]));
+            this->logger->logSerial("Assigned address " + String(this->count) + " to " + deviceID, true);
+            return this->count;
+        }
+
+        /**
+         * @brief Get the Device ID of the node with a short address.
+         *
+         * @param nodeAddress The short address to look up.
+         * @return const char* The NUL-terminated Device ID, or null if the address was never
+         * assigned.
+         */
+        const char *lookup(uint16_t nodeAddress) {
+            if (nodeAddress == 0 || nodeAddress > this->count) {
+                return nullptr;
+            }
+            return this->deviceIDs[nodeAddress - 1];
+        }
+
+        /**
+         * @brief Get the node nonce of the last join of a node.
+         *
+         * @param nodeAddress The short address of the node.
+         * @return uint32_t The node nonce, or 0 if none was recorded.
+         */
+        uint32_t lastNonce(uint16_t nodeAddress) {
+            return nodeAddress == 0 || nodeAddress > this->count ? 0 : this->nodeNonces[nodeAddress - 1];
+        }
+
+        /**
+         * @brief Record and persist the node nonce of a join that was accepted, so that a
+         * request carrying it again is known as a repeat.
+         *
+         * @param nodeAddress The short address of the node.
+         * @param nodeNonce The node nonce of the join.
+         */
+        void recordNonce(uint16_t nodeAddress, uint32_t nodeNonce) {
+            if (nodeAddress == 0 || nodeAddress > this->count) {
+                return;
+            }
+            this->nodeNonces[nodeAddress - 1] = nodeNonce;
+            this->preferences.putBytes(NODE_REGISTRY_NONCES_KEY, this->nodeNonces, this->count * sizeof(this->nodeNonces[0]));
+        }
+
+        /**
+         * @brief Destroy the Node Registry object
+         *
+         */
+        ~NodeRegistry() {
+            this->preferences.end();
+            delete this->logger;
+            this->logger = nullptr;
+        }
+};
@@ -0,0 +1,119 @@
+/**
+ * @file packet_ring.hpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Contains the lock-free ring that received packets wait in between the radio FIFO and
+ * the gateway loop.
+ * @version 0.1
+ * @date 2022-05-02
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include "models/reading_columns.hpp"
+
+/// The packets the ring holds, a power of two. Eight full frames cover a gateway blocked in
+/// an upload for a few seconds at the rate a busy network sends.
+#define PACKET_RING_LENGTH 8
+
+/**
+ * @brief Holds received packets, with the signal quality and time they arrived at, in fixed
+ * slots shared by exactly one producer, the radio task copying packets out of the radio
+ * FIFO, and one consumer, the gateway loop. Each side only writes its own index, and
+ * publishes it with release ordering after the slot it covers is written or read, so
+ * neither ever waits for the other. When the ring is full, the newest packet is dropped and
+ * counted, and those already queued are kept.
+ *
+ */
+class PacketRing {
+    private:
+        /// The slots, indexed by the low bits of the free-running indices.
+        ReceivedFrame slots[PACKET_RING_LENGTH];
+
+        /// The number of packets ever published, written by the producer only.
+        std::atomic<uint32_t> head;
+
+        /// The number of packets ever released, written by the consumer only.
+        std::atomic<uint32_t> tail;
+
+        /// The packets dropped because the ring was full, written by the producer only.
+        std::atomic<uint32_t> droppedCount;
+
+    public:
+        /**
+         * @brief Construct a new, empty Packet Ring object.
+         *
+         */
+        PacketRing() : head(0), tail(0), droppedCount(0) {
+            static_assert((PACKET_RING_LENGTH & (PACKET_RING_LENGTH - 1)) == 0, "PACKET_RING_LENGTH must be a power of two");
+        }
+
+        /**
+         * @brief Get the free slot the producer fills next. Producer only.
+         *
+         * @return ReceivedFrame* The slot, to be published with publish(), or null if the
+         * ring is full, in which case the packet is counted as dropped.
+         */
+        ReceivedFrame *claim() {
+            const uint32_t produced = this->head.load(std::memory_order_relaxed);
+            if (produced - this->tail.load(std::memory_order_acquire) == PACKET_RING_LENGTH) {
+                this->droppedCount.store(this->droppedCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            return &this->slots[produced & (PACKET_RING_LENGTH - 1)];
+        }
+
+        /**
+         * @brief Hand the slot returned by claim() over to the consumer. Producer only.
+         *
+         */
+        void publish() {
+            this->head.store(this->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        /**
+         * @brief Get the oldest packet waiting. Consumer only.
+         *
+         * @return ReceivedFrame* The packet, valid until release(), or null if the ring is
+         * empty.
+         */
+        ReceivedFrame *peek() {
+            const uint32_t consumed = this->tail.load(std::memory_order_relaxed);
+            if (consumed == this->head.load(std::memory_order_acquire)) {
+                return nullptr;
+            }
+            return &this->slots[consumed & (PACKET_RING_LENGTH - 1)];
+        }
+
+        /**
+         * @brief Give the slot returned by peek() back to the producer. Consumer only.
+         *
+         */
+        void release() {
+            this->tail.store(this->tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        /**
+         * @brief Get the number of packets waiting. Exact from the consumer, a snapshot from
+         * anywhere else.
+         *
+         */
+        size_t size() const {
+            return this->head.load(std::memory_order_acquire) - this->tail.load(std::memory_order_acquire);
+        }
+
+        /**
+         * @brief Get the number of packets dropped because the ring was full.
+         *
+         */
+        uint32_t dropped() const {
+            return this->droppedCount.load(std::memory_order_relaxed);
+        }
+};
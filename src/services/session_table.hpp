@@ -0,0 +1,287 @@
+/**
+ * @file session_table.hpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Contains the session keys and replay windows a gateway keeps for the nodes that joined.
+ * @version 0.1
+ * @date 2022-04-28
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include "models/join_message.hpp"
+#include "services/crypto.hpp"
+
+/**
+ * @brief Round a table size up to the next power of two.
+ *
+ */
+constexpr size_t nextPowerOfTwo(size_t size) {
+    return size <= 1 ? 1 : 2 * nextPowerOfTwo((size + 1) / 2);
+}
+
+/// The slots of the session table, a power of two. Every node the registry can hold has a
+/// session in at most half of them, so that a lookup rarely probes more than a couple of
+/// slots. Sized for the NODE_REGISTRY_CAPACITY nodes of one gateway rather than thousands: a
+/// single-channel SX127x gateway carries a few hundred frames an hour at SF11, the default
+/// NVS partition cannot hold a registry of thousands of Device IDs, and thousands of sessions
+/// would take most of the ESP32's RAM. A larger registry only needs a larger capacity here.
+#define SESSION_TABLE_CAPACITY nextPowerOfTwo(2 * NODE_REGISTRY_CAPACITY)
+
+/// The most sessions the table holds.
+#define SESSION_TABLE_MAX_SESSIONS (SESSION_TABLE_CAPACITY / 4 * 3)
+
+/// How far behind the highest frame counter seen a frame may arrive, and still be accepted
+/// once. The bits of a NodeSession::seen mask.
+#define SESSION_REPLAY_WINDOW 32
+
+/// Set in the nonces of the frames the gateway seals for a node, so that they never repeat a
+/// frame counter the node sealed its own frames with under the same session key.
+#define SESSION_DOWNLINK_NONCE 0x80000000
+
+/**
+ * @brief The session of one node: its key, which of its latest frame counters were seen, and
+ * the key of the join it was last accepted with, until that key takes over.
+ *
+ */
+struct NodeSession {
+    /// The short address of the node, 0 in an empty slot.
+    uint16_t nodeAddress;
+
+    /// The highest frame counter accepted.
+    uint32_t highestCounter;
+
+    /// Bit i is set if frame counter highestCounter - i was accepted. 0 until the first frame.
+    uint32_t seen;
+
+    /// The number of frames the gateway sealed for the node, their nonces counted from
+    /// SESSION_DOWNLINK_NONCE.
+    uint32_t downlinkCounter;
+
+    /// The session key of the node.
+    uint8_t key[AES_KEYLEN];
+
+    /// The key of the node's last join, waiting for a frame sealed with it to open before it
+    /// replaces key. Until then frames sealed with key still open, so that a replayed join
+    /// request, or a JOIN_ACCEPT the node never heard, does not cut the node off.
+    uint8_t pendingKey[AES_KEYLEN];
+
+    /// Whether pendingKey waits to take over.
+    bool pending;
+
+    /// The gateway nonce of the node's last join, sent again should the node repeat its
+    /// request.
+    uint32_t gatewayNonce;
+
+    /// The frames claiming the session that failed their MIC since one last opened.
+    uint8_t failures;
+};
+
+/**
+ * @brief Holds the session of every joined node in a fixed open-addressing table, so that
+ * finding the key and replay window of a frame is O(1) with no allocation. Short addresses are
+ * handed out in order, so their low bits spread them over the slots with almost no collisions.
+ * Sessions live in RAM only: after a reboot, nodes are unknown until they join again.
+ *
+ */
+class SessionTable {
+    private:
+        /// The slots, indexed by the low bits of the address and probed linearly.
+        NodeSession slots[SESSION_TABLE_CAPACITY];
+
+        /// The number of slots in use.
+        size_t count;
+
+        /// The cipher frames of every session are opened with. Its key schedule is expanded
+        /// whenever the session changes: copying one from a KeyScheduleCache costs as much on
+        /// a 176 byte AES_ctx, see key_schedule_cache_benchmark.
+        Crypto *cipher;
+
+        /**
+         * @brief Find the slot of a node, or the empty slot it would go in.
+         *
+         * @param nodeAddress The short address of the node, not 0.
+         */
+        NodeSession &slotOf(uint16_t nodeAddress) {
+            size_t index = nodeAddress & (SESSION_TABLE_CAPACITY - 1);
+            while (this->slots[index].nodeAddress != 0 && this->slots[index].nodeAddress != nodeAddress) {
+                index = (index + 1) & (SESSION_TABLE_CAPACITY - 1);
+            }
+            return this->slots[index];
+        }
+
+    public:
+        /**
+         * @brief Construct a new, empty Session Table object.
+         *
+         */
+        SessionTable() {
+            static_assert(SESSION_TABLE_MAX_SESSIONS >= NODE_REGISTRY_CAPACITY, "every registered node needs a session");
+            memset(this->slots, 0, sizeof(this->slots));
+            this->count = 0;
+            this->cipher = new Crypto();
+        }
+
+        /**
+         * @brief Find the session of a node.
+         *
+         * @param nodeAddress The short address of the node.
+         * @return NodeSession* The session, or null if the node has none.
+         */
+        NodeSession *find(uint16_t nodeAddress) {
+            if (nodeAddress == 0) {
+                return nullptr;
+            }
+            NodeSession &slot = slotOf(nodeAddress);
+            return slot.nodeAddress == nodeAddress ? &slot : nullptr;
+        }
+
+        /**
+         * @brief Start a new session for a node that joined. A node without one starts using
+         * it at once; otherwise it waits as the pending key of the node, replacing the one it
+         * had once promote is called.
+         *
+         * @param nodeAddress The short address of the node, not 0.
+         * @param key The AES_KEYLEN bytes of its session key.
+         * @param gatewayNonce The gateway nonce the key was derived with.
+         * @return NodeSession* The session, or null if the table is full.
+         */
+        NodeSession *open(uint16_t nodeAddress, const uint8_t *key, uint32_t gatewayNonce = 0) {
+            NodeSession &slot = slotOf(nodeAddress);
+            slot.gatewayNonce = gatewayNonce;
+            if (slot.nodeAddress != 0) {
+                memcpy(slot.pendingKey, key, AES_KEYLEN);
+                slot.pending = true;
+                return &slot;
+            }
+            if (nodeAddress == 0 || this->count == SESSION_TABLE_MAX_SESSIONS) {
+                return nullptr;
+            }
+            slot.nodeAddress = nodeAddress;
+            this->count++;
+            memcpy(slot.pendingKey, key, AES_KEYLEN);
+            promote(slot);
+            return &slot;
+        }
+
+        /**
+         * @brief Replace the key of a session with its pending key, once a frame sealed with
+         * it opened, and start counting frames over.
+         *
+         * @param session The session, with a pending key.
+         */
+        static void promote(NodeSession &session) {
+            memcpy(session.key, session.pendingKey, AES_KEYLEN);
+            memset(session.pendingKey, 0, AES_KEYLEN);
+            session.pending = false;
+            session.highestCounter = 0;
+            session.seen = 0;
+            session.downlinkCounter = 0;
+            session.failures = 0;
+        }
+
+        /**
+         * @brief Check that a frame counter was not accepted before in a session, and is
+         * recent enough to tell. Counters of downlinks, sent back at the gateway, never are.
+         *
+         * @param session The session the frame claims to belong to.
+         * @param counter The frame counter, the nonce the frame was sealed with.
+         */
+        static bool isFresh(const NodeSession &session, uint32_t counter) {
+            if ((counter & SESSION_DOWNLINK_NONCE) != 0) {
+                return false;
+            }
+            if (session.seen == 0 || counter > session.highestCounter) {
+                return true;
+            }
+            const uint32_t age = session.highestCounter - counter;
+            return age < SESSION_REPLAY_WINDOW && ((session.seen >> age) & 1) == 0;
+        }
+
+        /**
+         * @brief Record that a fresh frame counter was accepted, once the frame is
+         * authenticated, so that it is refused from then on.
+         *
+         * @param session The session the frame belongs to.
+         * @param counter The frame counter, checked with isFresh.
+         */
+        static void markSeen(NodeSession &session, uint32_t counter) {
+            session.failures = 0;
+            if (session.seen == 0) {
+                session.highestCounter = counter;
+                session.seen = 1;
+            } else if (counter > session.highestCounter) {
+                const uint32_t shift = counter - session.highestCounter;
+                session.seen = shift < SESSION_REPLAY_WINDOW ? (session.seen << shift) | 1 : 1;
+                session.highestCounter = counter;
+            } else {
+                session.seen |= (uint32_t) 1 << (session.highestCounter - counter);
+            }
+        }
+
+        /**
+         * @brief Get the cipher to open the frames of a session with. Its key schedule is
+         * only expanded again when the last frame was of another session.
+         *
+         * @param session The session.
+         * @return Crypto* The cipher, valid until the next call.
+         */
+        Crypto *cipherFor(const NodeSession &session) {
+            this->cipher->setKey(session.key);
+            return this->cipher;
+        }
+
+        /**
+         * @brief Record that a frame claiming a session failed its MIC check.
+         *
+         * @param session The session the frame claimed.
+         */
+        static void markFailed(NodeSession &session) {
+            if (session.failures < UINT8_MAX) {
+                session.failures++;
+            }
+        }
+
+        /**
+         * @brief Get the cipher to open the frames sealed with the pending key of a session.
+         *
+         * @param session The session, with a pending key.
+         * @return Crypto* The cipher, valid until the next call.
+         */
+        Crypto *pendingCipherFor(const NodeSession &session) {
+            this->cipher->setKey(session.pendingKey);
+            return this->cipher;
+        }
+
+        /**
+         * @brief Get the cipher to seal the next frame sent to a node with: its session key,
+         * with the next nonce of its downlinks.
+         *
+         * @param session The session of the node.
+         * @return Crypto* The shared cipher, keyed for the node until the next call.
+         */
+        Crypto *downlinkCipherFor(NodeSession &session) {
+            Crypto *cipher = cipherFor(session);
+            cipher->resumeSession(session.nodeAddress, SESSION_DOWNLINK_NONCE | session.downlinkCounter++);
+            return cipher;
+        }
+
+        /**
+         * @brief Get the number of sessions held.
+         *
+         */
+        size_t size() {
+            return this->count;
+        }
+
+        /**
+         * @brief Destroy the Session Table object
+         *
+         */
+        ~SessionTable() {
+            delete this->cipher;
+            this->cipher = nullptr;
+        }
+};
@@ -0,0 +1,110 @@
+/**
+ * @file signing_stream.hpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Contains a Print stage that signs bytes with AES-CMAC on their way to a sink.
+ * @version 0.1
+ * @date 2022-05-01
+ * 
+ * @copyright Copyright (c) 2022
+ * 
+ */
+
+#pragma once
+
+#include <Print.h>
+
+#include "services/crypto.hpp"
+
+/**
+ * @brief Passes everything written to it on to a sink unchanged, such as the LoRa radio, while
+ * computing its AES-CMAC, and follows it with the truncated tag. Like CipherStream, only one
+ * block and the MAC state are held, but CMAC does not need the length of the message up front:
+ * the last block is held back until more bytes arrive or the stream finishes.
+ * 
+ */
+class SigningStream : public Print {
+    private:
+        /// The service signing each block.
+        Crypto *crypto;
+
+        /// The sink bytes are passed on to.
+        Print *sink;
+
+        /// The CMAC of the message so far, not counting the block held back.
+        uint8_t mac[AES_BLOCKLEN];
+
+        /// The block being filled, fed into the MAC once more bytes follow it.
+        uint8_t block[AES_BLOCKLEN];
+
+        /// The number of bytes in the block being filled.
+        uint8_t blockLength;
+
+        /// The number of bytes written to the sink.
+        size_t written;
+
+        /**
+         * @brief Make room for more bytes by feeding the full block into the MAC.
+         * 
+         */
+        void feedFullBlock() {
+            if (this->blockLength == AES_BLOCKLEN) {
+                this->crypto->feedSignature(this->mac, this->block);
+                this->blockLength = 0;
+            }
+        }
+
+    public:
+        /**
+         * @brief Construct a new Signing Stream object
+         * 
+         * @param crypto The service signing the message. Must be ready.
+         * @param sink The sink bytes are passed on to.
+         * @param prefix The bytes signed ahead of the message but sent by the caller, such as
+         * the frame header, key ID and nonce.
+         * @param prefixLength The number of prefix bytes.
+         */
+        SigningStream(Crypto &crypto, Print &sink, const uint8_t *prefix, size_t prefixLength) {
+            this->crypto = &crypto;
+            this->sink = &sink;
+            this->blockLength = 0;
+            this->written = 0;
+            crypto.beginSignature(this->mac);
+            for (size_t i = 0; i < prefixLength; i++) {
+                feedFullBlock();
+                this->block[this->blockLength++] = prefix[i];
+            }
+        }
+
+        size_t write(uint8_t value) override {
+            feedFullBlock();
+            this->block[this->blockLength++] = value;
+            const size_t passed = this->sink->write(value);
+            this->written += passed;
+            return passed;
+        }
+
+        size_t write(const uint8_t *buffer, size_t size) override {
+            for (size_t consumed = 0; consumed < size; ) {
+                feedFullBlock();
+                size_t chunk = AES_BLOCKLEN - this->blockLength;
+                chunk = chunk < size - consumed ? chunk : size - consumed;
+                memcpy(this->block + this->blockLength, buffer + consumed, chunk);
+                this->blockLength += chunk;
+                consumed += chunk;
+            }
+            const size_t passed = this->sink->write(buffer, size);
+            this->written += passed;
+            return passed;
+        }
+
+        /**
+         * @brief Sign the block held back, and pass on the tag.
+         * 
+         * @return size_t The number of bytes written to the sink in total, tag included.
+         */
+        size_t finish() {
+            uint8_t tag[CRYPTO_MIC_LENGTH];
+            this->crypto->finishSignature(this->mac, this->block, this->blockLength, tag);
+            return this->written + this->sink->write(tag, CRYPTO_MIC_LENGTH);
+        }
+};
@@ -0,0 +1,210 @@
+/**
+ * @file benchmark.hpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Contains a tiny timing and allocation counting harness shared by the host benchmarks.
+ * Include it from exactly one translation unit per benchmark, as it replaces operator new.
+ * Results are printed, and appended as JSON lines to the file named by the BENCHMARK_RESULTS
+ * environment variable when it is set, see test/run_benchmarks.sh.
+ * @version 0.1
+ * @date 2022-04-02
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <new>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/// The number of heap allocations made through operator new since the program started.
+static long heapAllocations = 0;
+
+/// The number of heap blocks handed back through operator delete since the program started.
+static long heapReleases = 0;
+
+void *operator new(size_t size) {
+    heapAllocations++;
+    void *memory = malloc(size == 0 ? 1 : size);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+/**
+ * @brief Hand a block back to the heap, counting it.
+ *
+ * @param memory The block to free, or null.
+ */
+static inline void releaseHeap(void *memory) {
+    heapReleases += memory != nullptr;
+    free(memory);
+}
+
+void operator delete(void *memory) noexcept {
+    releaseHeap(memory);
+}
+
+void operator delete[](void *memory) noexcept {
+    releaseHeap(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+    releaseHeap(memory);
+}
+
+void operator delete[](void *memory, size_t) noexcept {
+    releaseHeap(memory);
+}
+
+/**
+ * @brief Read the CPU cycle counter, where the host has one that user code may read.
+ *
+ * @return uint64_t The cycles elapsed since an arbitrary point, or 0 without a counter.
+ */
+inline uint64_t readCycleCounter() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief The cost of one benchmarked operation.
+ *
+ */
+struct Measurement {
+    /// The mean nanoseconds per operation.
+    double nanosPerOp;
+
+    /// The mean heap allocations per operation.
+    double allocationsPerOp;
+
+    /// The mean CPU cycles per operation, or 0 if the host has no cycle counter.
+    double cyclesPerOp;
+};
+
+/**
+ * @brief Keeps the optimizer from discarding a benchmarked result.
+ *
+ * @param value The value to keep alive.
+ */
+template <typename T>
+inline void doNotOptimize(const T &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * @brief Time a callable over a number of iterations, counting its heap allocations.
+ *
+ * @param iterations How many times to call the operation.
+ * @param operation The operation to benchmark.
+ * @return Measurement The mean cost per call.
+ */
+template <typename Operation>
+inline Measurement measure(long iterations, Operation operation) {
+    const long allocationsBefore = heapAllocations;
+    const auto start = std::chrono::steady_clock::now();
+    const uint64_t cyclesBefore = readCycleCounter();
+    for (long i = 0; i < iterations; i++) {
+        operation();
+    }
+    const uint64_t cycles = readCycleCounter() - cyclesBefore;
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return Measurement {
+        std::chrono::duration<double, std::nano>(elapsed).count() / iterations,
+        (double) (heapAllocations - allocationsBefore) / iterations,
+        (double) cycles / iterations
+    };
+}
+
+/**
+ * @brief Get the name of the benchmark running, that of its source file without the
+ * directory or extension.
+ *
+ */
+inline const char *benchmarkSuite() {
+#if defined(__BASE_FILE__)
+    static char suite[64] = "";
+    if (suite[0] == '\0') {
+        const char *path = __BASE_FILE__;
+        const char *base = strrchr(path, '/') != nullptr ? strrchr(path, '/') + 1 : path;
+        const char *dot = strrchr(base, '.');
+        const size_t length = dot != nullptr ? (size_t) (dot - base) : strlen(base);
+        snprintf(suite, sizeof(suite), "%.*s", (int) length, base);
+    }
+    return suite;
+#else
+    return "benchmark";
+#endif
+}
+
+/**
+ * @brief Append one result as a JSON line to the file named by the BENCHMARK_RESULTS
+ * environment variable, if it is set, so that runs can be compared by a script.
+ *
+ * @param name The name of the benchmarked operation, unique within the benchmark.
+ * @param measurement The mean cost per operation.
+ * @param bytesPerOp The bytes produced or consumed per operation.
+ */
+inline void recordResult(const char *name, Measurement measurement, double bytesPerOp) {
+    static FILE *results = nullptr;
+    static bool opened = false;
+    if (!opened) {
+        opened = true;
+        const char *path = getenv("BENCHMARK_RESULTS");
+        results = path != nullptr && path[0] != '\0' ? fopen(path, "a") : nullptr;
+    }
+    if (results == nullptr) {
+        return;
+    }
+    fprintf(results, "{\"suite\":\"%s\",\"name\":\"", benchmarkSuite());
+    for (const char *c = name; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', results);
+        }
+        fputc(*c, results);
+    }
+    fprintf(
+        results,
+        "\",\"ns_per_op\":%.1f,\"bytes_per_op\":%.1f,\"allocs_per_op\":%.2f,\"cycles_per_op\":%.1f}\n",
+        measurement.nanosPerOp,
+        bytesPerOp,
+        measurement.allocationsPerOp,
+        measurement.cyclesPerOp
+    );
+    fflush(results);
+}
+
+/**
+ * @brief Print one benchmark result row, and record it.
+ *
+ * @param name The name of the benchmarked operation.
+ * @param measurement The mean cost per operation.
+ * @param bytesPerOp The bytes produced or consumed per operation.
+ */
+inline void reportResult(const char *name, Measurement measurement, double bytesPerOp) {
+    printf(
+        "%-40s %12.1f ns/op %10.1f bytes/op %8.2f allocs/op\n",
+        name,
+        measurement.nanosPerOp,
+        bytesPerOp,
+        measurement.allocationsPerOp
+    );
+    recordResult(name, measurement, bytesPerOp);
+}
@@ -0,0 +1,136 @@
+/**
+ * @file delta_codec_benchmark.cpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Compares how many bytes fixed width BATCH_FRAMEs and delta encoded DELTA_FRAMEs take to
+ * send a trace of meter readings, and what encoding and decoding them costs, on the host.
+ * @version 0.1
+ * @date 2022-04-16
+ *
+ * Build and run from the repository root:
+ *   g++ -std=gnu++17 -O2 -Isrc -Itest/shims -Itest test/models/delta_codec_benchmark.cpp -o delta_codec_benchmark
+ *   ./delta_codec_benchmark [trace.csv]
+ *
+ * Without a trace a day of synthetic household load sampled every 15 seconds is used. A trace
+ * is a CSV file of "timestamp_ms,current,voltage" lines, with increasing timestamps.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <assert.h>
+
+#include "benchmark.hpp"
+#include "models/reading_batch.hpp"
+#include "traces.hpp"
+
+/**
+ * @brief Convert a trace to the readings a node would take.
+ *
+ */
+static std::vector<MeterReading> toReadings(const std::vector<TraceSample> &samples) {
+    std::vector<MeterReading> trace;
+    for (const TraceSample &sample : samples) {
+        MeterReading reading = { "QB5ckYt0CS7Yc7swMKPu", 0, 0, 0, 0 };
+        reading.current = sample.current;
+        reading.voltage = sample.voltage;
+        reading.timestamp = sample.timestamp;
+        trace.push_back(reading);
+    }
+    return trace;
+}
+
+/**
+ * @brief Split a trace into as few full batches as it takes, the way a node would, and encode
+ * each into a frame. Every frame is sent right after its last reading.
+ *
+ * @return size_t The total number of bytes sent.
+ */
+static size_t encodeTrace(
+    const std::vector<MeterReading> &trace,
+    bool deltaEncoding,
+    std::vector<std::vector<uint8_t>> &frames,
+    std::vector<uint32_t> &sentAt
+) {
+    size_t total = 0;
+    ReadingBatch batch(BATCH_MAX_READINGS, deltaEncoding);
+    uint8_t frame[WIRE_MAX_FRAME_LENGTH];
+    for (size_t i = 0; i < trace.size(); i++) {
+        const bool added = batch.add(trace[i]);
+        assert(added);
+        if (batch.isFull() || i + 1 == trace.size()) {
+            const uint32_t now = trace[i].timestamp;
+            const size_t length = batch.encode(frame, sizeof(frame), now);
+            assert(length > 0);
+            frames.emplace_back(frame, frame + length);
+            sentAt.push_back(now);
+            total += length;
+            batch.clear();
+        }
+    }
+    return total;
+}
+
+int main(int argc, char **argv) {
+    const std::vector<MeterReading> trace = toReadings(traceFromArguments(argc, argv));
+    assert(!trace.empty());
+
+    std::vector<std::vector<uint8_t>> fixedFrames, deltaFrames;
+    std::vector<uint32_t> fixedSentAt, deltaSentAt;
+    const size_t fixedBytes = encodeTrace(trace, false, fixedFrames, fixedSentAt);
+    const size_t deltaBytes = encodeTrace(trace, true, deltaFrames, deltaSentAt);
+
+    // Every delta frame must decode to the same readings as its fixed width equivalent would.
+    size_t decodedCount = 0;
+    MeterReading unpacked[BATCH_MAX_READINGS];
+    for (size_t i = 0; i < deltaFrames.size(); i++) {
+        const size_t count = ReadingBatch::decode(
+            deltaFrames[i].data(),
+            deltaFrames[i].size(),
+            unpacked,
+            BATCH_MAX_READINGS,
+            deltaSentAt[i]
+        );
+        for (size_t j = 0; j < count; j++) {
+            const MeterReading &original = trace[decodedCount + j];
+            assert(unpacked[j].timestamp / 1000 == original.timestamp / 1000);
+            assert(fabsf(unpacked[j].current - original.current) < 0.006f);
+            assert(fabsf(unpacked[j].voltage - original.voltage) < 0.06f);
+        }
+        decodedCount += count;
+    }
+    assert(decodedCount == trace.size());
+
+    char text[WIRE_MAX_FRAME_LENGTH + 1];
+    const size_t textBytes = trace.size() * MeterReadingSchema::toText(trace[0], text, sizeof(text));
+    printf("%zu readings\n", trace.size());
+    printf("%-40s %8zu bytes %6.2f bytes/reading\n", "text, one frame each", textBytes,
+        (double) textBytes / trace.size());
+    printf("%-40s %8zu bytes %6.2f bytes/reading %5zu frames\n", "fixed width batches", fixedBytes,
+        (double) fixedBytes / trace.size(), fixedFrames.size());
+    printf("%-40s %8zu bytes %6.2f bytes/reading %5zu frames %.2fx smaller\n", "delta batches",
+        deltaBytes, (double) deltaBytes / trace.size(), deltaFrames.size(),
+        (double) fixedBytes / deltaBytes);
+
+    const long iterations = 200000;
+    ReadingBatch fixedBatch(BATCH_MAX_READINGS, false), deltaBatch(BATCH_MAX_READINGS, true);
+    for (size_t i = 0; i < trace.size() && deltaBatch.add(trace[i]); i++) {
+        fixedBatch.add(trace[i]);
+    }
+    const uint32_t now = trace[deltaBatch.size() - 1].timestamp;
+    uint8_t fixedFrame[WIRE_MAX_FRAME_LENGTH], deltaFrame[WIRE_MAX_FRAME_LENGTH];
+    const size_t fixedLength = fixedBatch.encode(fixedFrame, sizeof(fixedFrame), now);
+    const size_t deltaLength = deltaBatch.encode(deltaFrame, sizeof(deltaFrame), now);
+    reportResult("fixed width batch encode (per frame)", measure(iterations, [&]() {
+        doNotOptimize(fixedBatch.encode(fixedFrame, sizeof(fixedFrame), now));
+    }), fixedLength);
+    reportResult("delta batch encode (per frame)", measure(iterations, [&]() {
+        doNotOptimize(deltaBatch.encode(deltaFrame, sizeof(deltaFrame), now));
+    }), deltaLength);
+    reportResult("fixed width batch decode (per frame)", measure(iterations, [&]() {
+        doNotOptimize(ReadingBatch::decode(fixedFrame, fixedLength, unpacked, BATCH_MAX_READINGS, now));
+    }), fixedLength);
+    reportResult("delta batch decode (per frame)", measure(iterations, [&]() {
+        doNotOptimize(ReadingBatch::decode(deltaFrame, deltaLength, unpacked, BATCH_MAX_READINGS, now));
+    }), deltaLength);
+    return 0;
+}
@@ -0,0 +1,125 @@
+/**
+ * @file history_block_benchmark.cpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Measures how many bits per sample Gorilla-style HistoryBlocks take to keep a load
+ * trace, and what appending and iterating costs, on the host.
+ * @version 0.1
+ * @date 2022-04-22
+ *
+ * Build and run from the repository root:
+ *   g++ -std=gnu++17 -O2 -Isrc -Itest/shims -Itest test/models/history_block_benchmark.cpp -o history_block_benchmark
+ *   ./history_block_benchmark [trace.csv]
+ *
+ * Without a trace a day of synthetic household load sampled every 15 seconds is used. A trace
+ * is a CSV file of "timestamp_ms,current,voltage" lines, with increasing timestamps.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <assert.h>
+
+#include "benchmark.hpp"
+#include "models/history_block.hpp"
+#include "traces.hpp"
+
+/**
+ * @brief Compress a series into as many blocks as it takes, checking that each block reads
+ * back exactly, and print how much room it took.
+ *
+ * @param name The name of the series.
+ * @param trace The trace the timestamps come from.
+ * @param values The value of each sample, already rounded to the decimals if any.
+ * @param decimals The decimals the blocks round values to.
+ */
+static void compressSeries(
+    const char *name,
+    const std::vector<TraceSample> &trace,
+    const std::vector<double> &values,
+    uint8_t decimals
+) {
+    std::vector<HistoryBlock> blocks(1, HistoryBlock(decimals));
+    for (size_t i = 0; i < trace.size(); i++) {
+        if (!blocks.back().append(trace[i].timestamp, values[i])) {
+            blocks.emplace_back(decimals);
+            const bool appended = blocks.back().append(trace[i].timestamp, values[i]);
+            assert(appended);
+        }
+    }
+    size_t bytes = 0;
+    size_t sample = 0;
+    for (HistoryBlock &block : blocks) {
+        bytes += block.byteSize();
+        HistoryReader reader(block.bytes(), block.byteSize());
+        uint32_t timestamp;
+        double value;
+        while (reader.next(timestamp, value)) {
+            assert(timestamp == trace[sample].timestamp / 1000 * 1000);
+            assert(value == values[sample]);
+            sample++;
+        }
+    }
+    assert(sample == trace.size());
+    const double periodSeconds = (trace.back().timestamp - trace.front().timestamp) / 1000.0 / (trace.size() - 1);
+    printf(
+        "%-32s %6.2f bits/sample %6.1f samples/block %6.1f hours/KiB\n",
+        name,
+        8.0 * bytes / trace.size(),
+        (double) trace.size() / blocks.size(),
+        1024.0 * trace.size() / bytes * periodSeconds / 3600
+    );
+}
+
+int main(int argc, char **argv) {
+    const std::vector<TraceSample> trace = traceFromArguments(argc, argv);
+    assert(trace.size() > 1);
+    std::vector<double> current, currentCentiamps, voltage, voltageDecivolts;
+    for (const TraceSample &sample : trace) {
+        current.push_back(sample.current);
+        currentCentiamps.push_back(round(sample.current * 100) / 100);
+        voltage.push_back(sample.voltage);
+        voltageDecivolts.push_back(round(sample.voltage * 10) / 10);
+    }
+    printf("%zu samples, uncompressed %d bits/sample\n", trace.size(), 32 + 64);
+    compressSeries("current, as sensed", trace, current, HISTORY_FULL_PRECISION);
+    compressSeries("current, rounded doubles", trace, currentCentiamps, HISTORY_FULL_PRECISION);
+    compressSeries("current, 2 decimals", trace, currentCentiamps, 2);
+    compressSeries("voltage, as sensed", trace, voltage, HISTORY_FULL_PRECISION);
+    compressSeries("voltage, rounded doubles", trace, voltageDecivolts, HISTORY_FULL_PRECISION);
+    compressSeries("voltage, 1 decimal", trace, voltageDecivolts, 1);
+
+    // More decimals than DECIMAL_SCALES holds are rounded to the most it does.
+    HistoryBlock precise(HISTORY_MAX_DECIMALS + 5);
+    const bool appended = precise.append(trace[0].timestamp, 1.234567);
+    assert(appended && precise.bytes()[2] == HISTORY_MAX_DECIMALS);
+    HistoryReader preciseReader(precise.bytes(), precise.byteSize());
+    uint32_t preciseTimestamp;
+    double preciseValue;
+    const bool read = preciseReader.next(preciseTimestamp, preciseValue);
+    assert(read && preciseValue == 1.2346);
+
+    const long iterations = 20000;
+    HistoryBlock block(2);
+    size_t blockSamples = 0;
+    while (blockSamples < trace.size() && block.append(trace[blockSamples].timestamp, currentCentiamps[blockSamples])) {
+        blockSamples++;
+    }
+    reportResult("append (per block of current)", measure(iterations, [&]() {
+        HistoryBlock filled(2);
+        for (size_t i = 0; i < blockSamples; i++) {
+            filled.append(trace[i].timestamp, currentCentiamps[i]);
+        }
+        doNotOptimize(filled.size());
+    }), block.byteSize());
+    reportResult("iterate (per block of current)", measure(iterations, [&]() {
+        HistoryReader reader(block.bytes(), block.byteSize());
+        uint32_t timestamp;
+        double value, sum = 0;
+        while (reader.next(timestamp, value)) {
+            sum += value;
+        }
+        doNotOptimize(sum);
+    }), block.byteSize());
+    printf("%zu samples per block\n", blockSamples);
+    return 0;
+}
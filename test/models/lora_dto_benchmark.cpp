@@ -0,0 +1,171 @@
+/**
+ * @file lora_dto_benchmark.cpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Compares the legacy text and binary TLV LoraDTO wire formats, the allocating and
+ * in-place parsers, the compile-time MeterReading schema and batch frames, and the
+ * SerializableData fields they are built from, on the host.
+ * @version 0.1
+ * @date 2022-04-02
+ *
+ * Build and run from the repository root:
+ *   g++ -std=gnu++17 -O2 -Isrc -Itest/shims -Itest test/models/lora_dto_benchmark.cpp -o lora_dto_benchmark
+ *   ./lora_dto_benchmark
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <assert.h>
+
+#include "benchmark.hpp"
+#include "models/join_message.hpp"
+#include "models/lora_dto.hpp"
+#include "models/meter_reading.hpp"
+#include "models/reading_batch.hpp"
+
+int main() {
+    const long iterations = 200000;
+    SerializableData dataList[] = {
+        SerializableData("deviceID", "QB5ckYt0CS7Yc7swMKPu"),
+        SerializableData("current", String(0.42)),
+        SerializableData("voltage", String(244)),
+    };
+    LoraDTO dto = LoraDTO(dataList, 3);
+
+    // Both formats must round trip the reading.
+    const String text = dto.toString();
+    uint8_t frame[WIRE_MAX_FRAME_LENGTH];
+    const size_t frameLength = dto.toBinary(frame, sizeof(frame));
+    LoraDTO decoded = LoraDTO::fromBinary(frame, frameLength);
+    assert(decoded.getDataListSize() == 3);
+    assert(decoded.getDataList()[0].getVal() == "QB5ckYt0CS7Yc7swMKPu");
+    assert(decoded.getDataList()[1].getVal() == "0.42");
+    assert(decoded.getDataList()[2].getVal() == "244.0");
+
+    // The in-place parsers must agree with the allocating ones.
+    FieldView slots[8];
+    char scratch[64];
+    assert(LoraDTO::parseInto(text.c_str(), text.length(), slots, 8) == 3);
+    assert(slots[0].keyEquals("deviceID") && slots[2].valLength == 3);
+    assert(LoraDTO::parseBinaryInto(frame, frameLength, slots, 8, scratch, sizeof(scratch)) == 3);
+    assert(slots[1].keyEquals("current") && strncmp(slots[1].val, "0.42", 4) == 0);
+    assert(slots[2].keyEquals("voltage") && strncmp(slots[2].val, "244.0", 5) == 0);
+
+    // The compile-time schema must produce the same frame and text as the generic path.
+    MeterReading reading = { "QB5ckYt0CS7Yc7swMKPu", 0.42f, 244, 0, 0 };
+    uint8_t schemaFrame[WIRE_MAX_FRAME_LENGTH];
+    char schemaText[WIRE_MAX_FRAME_LENGTH + 1];
+    assert(MeterReadingSchema::encode(reading, schemaFrame, sizeof(schemaFrame)) == frameLength);
+    assert(memcmp(schemaFrame, frame, frameLength) == 0);
+    assert(MeterReadingSchema::toText(reading, schemaText, sizeof(schemaText)) > 0);
+    assert(strcmp(schemaText, "deviceID=QB5ckYt0CS7Yc7swMKPu&current=0.42&voltage=244.0") == 0);
+    MeterReading decodedReading = {};
+    assert(MeterReadingSchema::decode(frame, frameLength, decodedReading));
+    assert(strcmp(decodedReading.deviceID, reading.deviceID) == 0 && decodedReading.voltage == 244);
+
+    // A full batch must round trip every reading, with its age.
+    ReadingBatch batch;
+    for (uint32_t i = 0; !batch.isFull(); i++) {
+        MeterReading sample = reading;
+        sample.current += i * 0.01f;
+        sample.timestamp = i * 15000;
+        batch.add(sample);
+    }
+    const uint32_t sentAt = batch.size() * 15000;
+    uint8_t batchFrame[WIRE_MAX_FRAME_LENGTH];
+    const size_t batchLength = batch.encode(batchFrame, sizeof(batchFrame), sentAt);
+    MeterReading unpacked[BATCH_MAX_READINGS];
+    assert(batchLength > 0 && batchLength <= WIRE_MAX_FRAME_LENGTH);
+    assert(ReadingBatch::decode(batchFrame, batchLength, unpacked, BATCH_MAX_READINGS, sentAt) == batch.size());
+    assert(strcmp(unpacked[3].deviceID, reading.deviceID) == 0);
+    assert(unpacked[3].timestamp == 3 * 15000 && fabsf(unpacked[3].current - 0.45f) < 0.001f);
+    // Joined nodes send their short address in place of their Device ID, once per frame.
+    MeterReading addressed = unpacked[3];
+    addressed.deviceID[0] = '\0';
+    addressed.nodeAddress = 7;
+    ReadingBatch addressedBatch;
+    addressedBatch.add(addressed);
+    addressedBatch.add(addressed);
+    const size_t addressedLength = addressedBatch.encode(batchFrame, sizeof(batchFrame), sentAt);
+    assert(addressedLength == 1 + 4 + 1 + 2 * (BATCH_AGE_WIDTH + MeterReadingSchema::PACKED_SIZE));
+    assert(ReadingBatch::decode(batchFrame, addressedLength, unpacked, BATCH_MAX_READINGS, sentAt) == 2);
+    assert(unpacked[1].nodeAddress == 7 && unpacked[1].deviceID[0] == '\0');
+    assert(MeterReadingSchema::toText(addressed, schemaText, sizeof(schemaText)) > 0);
+    assert(strcmp(schemaText, "nodeAddress=7&current=0.45&voltage=244.0") == 0);
+    JoinMessage join = { "QB5ckYt0CS7Yc7swMKPu", 7, 0, 0 }, accepted;
+    const size_t joinLength = encodeJoinMessage(JOIN_ACCEPT, join, batchFrame, sizeof(batchFrame));
+    assert(!decodeJoinMessage(batchFrame, joinLength, JOIN_REQUEST, accepted));
+    assert(decodeJoinMessage(batchFrame, joinLength, JOIN_ACCEPT, accepted) && accepted.nodeAddress == 7);
+    assert(strcmp(accepted.deviceID, join.deviceID) == 0);
+
+    printf("batch of %zu readings: %zu bytes, %.1f bytes/reading\n", batch.size(), batchLength,
+        (double) batchLength / batch.size());
+
+    // A field must survive its text form, and be written as the tag its key names.
+    const SerializableData &field = dataList[1];
+    char pair[64];
+    const size_t pairLength = field.toText(pair, sizeof(pair));
+    assert(pairLength == 12 && strcmp(pair, "current=0.42") == 0 && field.toString() == pair);
+    const SerializableData parsedField = SerializableData::fromText(pair, pairLength);
+    assert(strcmp(parsedField.keyText(), "current") == 0 && strcmp(parsedField.valText(), "0.42") == 0);
+    uint8_t fieldFrame[WIRE_MAX_FRAME_LENGTH];
+    FrameWriter fieldWriter(fieldFrame, sizeof(fieldFrame));
+    assert(field.writeTo(fieldWriter));
+    const size_t fieldLength = fieldWriter.size();
+
+    reportResult("field construct (String)", measure(iterations, [&]() {
+        SerializableData built("current", String(0.42));
+        doNotOptimize(built.valText()[0]);
+    }), pairLength);
+    reportResult("field text encode (toString)", measure(iterations, [&]() {
+        doNotOptimize(field.toString().length());
+    }), pairLength);
+    reportResult("field text encode in place (toText)", measure(iterations, [&]() {
+        doNotOptimize(field.toText(pair, sizeof(pair)));
+    }), pairLength);
+    reportResult("field text decode (fromText)", measure(iterations, [&]() {
+        SerializableData parsed = SerializableData::fromText(pair, pairLength);
+        doNotOptimize(parsed.valText()[0]);
+    }), pairLength);
+    reportResult("field binary encode (writeTo)", measure(iterations, [&]() {
+        FrameWriter writer(fieldFrame, sizeof(fieldFrame));
+        doNotOptimize(field.writeTo(writer));
+    }), fieldLength);
+    reportResult("text encode (toString)", measure(iterations, [&]() {
+        doNotOptimize(dto.toString().length());
+    }), text.length());
+    reportResult("binary encode (toBinary)", measure(iterations, [&]() {
+        doNotOptimize(dto.toBinary(frame, sizeof(frame)));
+    }), frameLength);
+    const size_t schemaTextLength = MeterReadingSchema::toText(reading, schemaText, sizeof(schemaText));
+    reportResult("schema text encode (toText)", measure(iterations, [&]() {
+        doNotOptimize(MeterReadingSchema::toText(reading, schemaText, sizeof(schemaText)));
+    }), schemaTextLength);
+    reportResult("schema binary encode (encode)", measure(iterations, [&]() {
+        doNotOptimize(MeterReadingSchema::encode(reading, schemaFrame, sizeof(schemaFrame)));
+    }), frameLength);
+    reportResult("text decode (fromString)", measure(iterations, [&]() {
+        LoraDTO received = LoraDTO::fromString(text);
+        doNotOptimize(received.getDataListSize());
+    }), text.length());
+    reportResult("binary decode (fromBinary)", measure(iterations, [&]() {
+        LoraDTO received = LoraDTO::fromBinary(frame, frameLength);
+        doNotOptimize(received.getDataListSize());
+    }), frameLength);
+    reportResult("text decode in place (parseInto)", measure(iterations, [&]() {
+        doNotOptimize(LoraDTO::parseInto(text.c_str(), text.length(), slots, 8));
+    }), text.length());
+    reportResult("binary decode in place (parseBinaryInto)", measure(iterations, [&]() {
+        doNotOptimize(LoraDTO::parseBinaryInto(frame, frameLength, slots, 8, scratch, sizeof(scratch)));
+    }), frameLength);
+    reportResult("schema binary decode (decode)", measure(iterations, [&]() {
+        doNotOptimize(MeterReadingSchema::decode(frame, frameLength, decodedReading));
+    }), frameLength);
+    reportResult("batch encode (per frame)", measure(iterations, [&]() {
+        doNotOptimize(batch.encode(batchFrame, sizeof(batchFrame), sentAt));
+    }), batchLength);
+    reportResult("batch decode (per frame)", measure(iterations, [&]() {
+        doNotOptimize(ReadingBatch::decode(batchFrame, batchLength, unpacked, BATCH_MAX_READINGS, sentAt));
+    }), batchLength);
+    return 0;
+}
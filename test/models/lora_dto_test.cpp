@@ -0,0 +1,117 @@
+/**
+ * @file lora_dto_test.cpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Checks that LoraDTO owns its fields: decoding, copying, moving and returning it by
+ * value neither allocate nor leak, and fields it cannot hold whole are refused, on the host.
+ * @version 0.1
+ * @date 2022-04-23
+ *
+ * Build and run from the repository root:
+ *   g++ -std=gnu++17 -O2 -Isrc -Itest/shims -Itest test/models/lora_dto_test.cpp -o lora_dto_test
+ *   ./lora_dto_test
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <assert.h>
+
+#include "benchmark.hpp"
+#include "models/lora_dto.hpp"
+
+/**
+ * @brief Stands in for LoraInterface::receiveLoraMessage, returning a decoded DTO by value.
+ *
+ */
+static LoraDTO receive(const uint8_t *frame, size_t frameLength) {
+    return LoraDTO::fromBinary(frame, frameLength);
+}
+
+/**
+ * @brief Check that an operation makes no heap allocation at all.
+ *
+ */
+template <typename Operation>
+static void assertAllocationFree(const char *name, Operation operation) {
+    const long allocationsBefore = heapAllocations;
+    operation();
+    assert(heapAllocations == allocationsBefore);
+    printf("%-40s 0 allocations\n", name);
+}
+
+int main() {
+    const char text[] = "deviceID=QB5ckYt0CS7Yc7swMKPu&current=0.42&voltage=244.0";
+    uint8_t frame[WIRE_MAX_FRAME_LENGTH];
+    size_t frameLength = 0;
+    LoraDTO sent;
+
+    assertAllocationFree("building from literals", [&]() {
+        const bool added = sent.add(SerializableData("deviceID", "QB5ckYt0CS7Yc7swMKPu"))
+            && sent.add(SerializableData("current", "0.42"))
+            && sent.add(SerializableData("voltage", "244"));
+        assert(added && !sent.isTruncated());
+    });
+    assertAllocationFree("binary encode (toBinary)", [&]() {
+        frameLength = sent.toBinary(frame, sizeof(frame));
+        assert(frameLength > 0);
+    });
+    assertAllocationFree("text decode (fromText)", [&]() {
+        LoraDTO received = LoraDTO::fromText(text, strlen(text));
+        assert(received.getDataListSize() == 3);
+        assert(strcmp(received.getDataList()[2].valText(), "244.0") == 0);
+    });
+    assertAllocationFree("binary decode returned by value", [&]() {
+        LoraDTO received = receive(frame, frameLength);
+        assert(received.getDataListSize() == 3);
+        assert(strcmp(received.getDataList()[0].valText(), "QB5ckYt0CS7Yc7swMKPu") == 0);
+        assert(strcmp(received.getDataList()[1].valText(), "0.42") == 0);
+    });
+    assertAllocationFree("copy and move", [&]() {
+        LoraDTO original = receive(frame, frameLength);
+        LoraDTO copy = original;
+        LoraDTO moved = static_cast<LoraDTO &&>(original);
+        assert(copy.getDataListSize() == 3 && moved.getDataListSize() == 3);
+        copy = LoraDTO::fromText("key=value", 9);
+        assert(copy.getDataListSize() == 1 && strcmp(copy.getDataList()[0].keyText(), "key") == 0);
+        // The copy must not share fields with the DTO it was copied from.
+        assert(moved.getDataList() != copy.getDataList());
+    });
+
+    // Fields beyond the capacity are dropped rather than overflowing, and say so.
+    LoraDTO full = LoraDTO::fromText("a=1&b=2&c=3&d=4&e=5&f=6&g=7&h=8", 31);
+    assert(full.getDataListSize() == LORA_DTO_MAX_FIELDS && !full.isTruncated());
+    LoraDTO crowded = LoraDTO::fromText("a=1&b=2&c=3&d=4&e=5&f=6&g=7&h=8&i=9", 35);
+    assert(crowded.getDataListSize() == LORA_DTO_MAX_FIELDS && crowded.isTruncated());
+    const bool crowdedAdded = full.add(SerializableData("i", "9"));
+    assert(!crowdedAdded && full.isTruncated());
+
+    // Keys and values too long to hold whole are refused rather than cut short.
+    const SerializableData longKey("a key of sixteen", "1");
+    const SerializableData longVal("key", "a value of thirty-two characters");
+    const SerializableData longest("key of fifteen!", "a value of thirty-one character");
+    assert(longKey.isTruncated() && longVal.isTruncated() && !longest.isTruncated());
+    LoraDTO checked;
+    const bool longAdded = checked.add(longKey) || checked.add(longVal);
+    assert(!longAdded && checked.getDataListSize() == 0 && checked.isTruncated());
+    const bool longestAdded = checked.add(longest);
+    assert(longestAdded && strcmp(checked.getDataList()[0].keyText(), "key of fifteen!") == 0);
+
+    // The String conveniences may allocate, but must give every block back.
+    const long liveBefore = heapAllocations - heapReleases;
+    for (int i = 0; i < 1000; i++) {
+        const LoraDTO received = LoraDTO::fromString(sent.toString());
+        assert(received.getDataList()[0].getVal() == "QB5ckYt0CS7Yc7swMKPu");
+    }
+    assert(heapAllocations - heapReleases == liveBefore);
+    printf("%-40s no leaks\n", "String round trips");
+
+    reportResult("binary decode returned by value", measure(200000, [&]() {
+        LoraDTO received = receive(frame, frameLength);
+        doNotOptimize(received.getDataListSize());
+    }), frameLength);
+    reportResult("text decode (fromText)", measure(200000, [&]() {
+        LoraDTO received = LoraDTO::fromText(text, sizeof(text) - 1);
+        doNotOptimize(received.getDataListSize());
+    }), sizeof(text) - 1);
+    return 0;
+}
@@ -0,0 +1,190 @@
+/**
+ * @file reading_columns_benchmark.cpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Compares decoding 100k received frames one LoraDTO at a time with decoding them into
+ * ReadingColumns, and aggregating the readings afterwards, on the host.
+ * @version 0.1
+ * @date 2022-04-24
+ *
+ * Build and run from the repository root:
+ *   g++ -std=gnu++17 -O2 -Isrc -Itest/shims -Itest test/models/reading_columns_benchmark.cpp -o reading_columns_benchmark
+ *   ./reading_columns_benchmark
+ *
+ * Fifty joined nodes report from a day of synthetic household load. Every fourth frame is a
+ * DELTA_FRAME of 16 readings, the rest are RECORD_FRAMEs of one.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <assert.h>
+
+#include "benchmark.hpp"
+#include "models/lora_dto.hpp"
+#include "models/reading_columns.hpp"
+#include "traces.hpp"
+
+/// The number of frames decoded per pass.
+#define FRAME_COUNT 100000
+
+/// The number of nodes reporting.
+#define NODE_COUNT 50
+
+/// The number of readings in every batch frame.
+#define READINGS_PER_BATCH 16
+
+/**
+ * @brief Build the receive queue a gateway would see, counting the readings in it.
+ *
+ */
+static std::vector<ReceivedFrame> syntheticFrames(size_t &readingCount) {
+    const std::vector<TraceSample> trace = syntheticTrace();
+    std::vector<ReceivedFrame> frames(FRAME_COUNT);
+    readingCount = 0;
+    for (size_t i = 0; i < FRAME_COUNT; i++) {
+        const uint16_t node = i % NODE_COUNT + 1;
+        ReceivedFrame &frame = frames[i];
+        frame.rssi = -60 - node;
+        frame.snr = 9.5f - node * 0.25f;
+        frame.receivedAt = 86400000 + i * 300;
+        frame.senderAddress = node;
+        const bool batched = i % 4 == 3;
+        ReadingBatch batch(READINGS_PER_BATCH, true);
+        MeterReading reading = {};
+        for (size_t j = 0; j < (batched ? READINGS_PER_BATCH : 1); j++) {
+            const TraceSample &sample = trace[(i / NODE_COUNT + node * 97 + j) % trace.size()];
+            reading.nodeAddress = node;
+            reading.current = sample.current;
+            reading.voltage = sample.voltage;
+            reading.timestamp = frame.receivedAt - (READINGS_PER_BATCH - j) * 15000;
+            batch.add(reading);
+        }
+        frame.length = batched
+            ? batch.encode(frame.bytes, sizeof(frame.bytes), frame.receivedAt)
+            : MeterReadingSchema::encode(reading, frame.bytes, sizeof(frame.bytes));
+        assert(frame.length > 0);
+        readingCount += batch.size();
+    }
+    return frames;
+}
+
+/**
+ * @brief Decode every frame on its own, the way the gateway handled packets before, summing
+ * the current reported by each node.
+ *
+ * @return size_t The number of readings decoded.
+ */
+static size_t decodePerPacket(const std::vector<ReceivedFrame> &frames, double *sums) {
+    size_t readings = 0;
+    MeterReading unpacked[BATCH_MAX_READINGS];
+    for (const ReceivedFrame &frame : frames) {
+        if (frameKind(frame.bytes[0]) != RECORD_FRAME) {
+            const size_t count = ReadingBatch::decode(frame.bytes, frame.length, unpacked, BATCH_MAX_READINGS, frame.receivedAt);
+            for (size_t i = 0; i < count; i++) {
+                sums[unpacked[i].nodeAddress] += unpacked[i].current;
+            }
+            readings += count;
+            continue;
+        }
+        const LoraDTO dto = LoraDTO::fromBinary(frame.bytes, frame.length);
+        uint16_t node = 0;
+        float current = 0;
+        for (int i = 0; i < dto.getDataListSize(); i++) {
+            const SerializableData &field = dto.getDataList()[i];
+            if (strcmp(field.keyText(), "nodeAddress") == 0) {
+                node = atoi(field.valText());
+            } else if (strcmp(field.keyText(), "current") == 0) {
+                current = strtof(field.valText(), nullptr);
+            }
+        }
+        sums[node] += current;
+        readings++;
+    }
+    return readings;
+}
+
+int main() {
+    size_t readingCount;
+    const std::vector<ReceivedFrame> frames = syntheticFrames(readingCount);
+    ReadingColumns *columns = new ReadingColumns();
+    const auto resolveNode = [](const MeterReading &reading, uint16_t) { return reading.nodeAddress; };
+
+    // Both paths must see every reading, with the same current per node.
+    double perPacketSums[NODE_COUNT + 1] = {}, columnarSums[NODE_COUNT + 1] = {};
+    assert(decodePerPacket(frames, perPacketSums) == readingCount);
+    size_t rows = 0;
+    for (size_t next = 0; next < frames.size(); rows += columns->size()) {
+        columns->clear();
+        next += columns->decodeFrames(frames.data() + next, frames.size() - next, resolveNode);
+        for (size_t i = 0; i < columns->size(); i++) {
+            columnarSums[columns->nodeAddress[i]] += columns->current[i];
+        }
+        assert(columns->rssi[0] == -60 - columns->nodeAddress[0]);
+    }
+    assert(rows == readingCount);
+    for (int node = 1; node <= NODE_COUNT; node++) {
+        assert(fabs(perPacketSums[node] - columnarSums[node]) < 0.01 * readingCount / NODE_COUNT);
+    }
+    // Each reading is resolved with the node whose session opened its frame.
+    columns->clear();
+    const size_t consumed = columns->decodeFrames(frames.data(), frames.size(), [](const MeterReading &reading, uint16_t senderAddress) {
+        return reading.nodeAddress == senderAddress ? senderAddress : (uint16_t) 0;
+    });
+    const size_t bound = columns->size();
+    columns->clear();
+    columns->decodeFrames(frames.data(), consumed, resolveNode);
+    assert(bound > 0 && bound == columns->size());
+    printf("%d frames, %zu readings, %.1f readings/frame\n", FRAME_COUNT, readingCount,
+        (double) readingCount / FRAME_COUNT);
+
+    const long passes = 5;
+    const Measurement perPacket = measure(passes, [&]() {
+        double sums[NODE_COUNT + 1] = {};
+        doNotOptimize(decodePerPacket(frames, sums));
+        doNotOptimize(sums[1]);
+    });
+    const Measurement decodeOnly = measure(passes, [&]() {
+        for (size_t next = 0; next < frames.size();) {
+            columns->clear();
+            next += columns->decodeFrames(frames.data() + next, frames.size() - next, resolveNode);
+            doNotOptimize(columns->size());
+        }
+    });
+    const Measurement columnar = measure(passes, [&]() {
+        double sums[NODE_COUNT + 1] = {};
+        for (size_t next = 0; next < frames.size();) {
+            columns->clear();
+            next += columns->decodeFrames(frames.data() + next, frames.size() - next, resolveNode);
+            for (size_t i = 0; i < columns->size(); i++) {
+                sums[columns->nodeAddress[i]] += columns->current[i];
+            }
+        }
+        doNotOptimize(sums[1]);
+    });
+    columns->clear();
+    columns->decodeFrames(frames.data(), frames.size(), resolveNode);
+    const Measurement aggregate = measure(passes * 100, [&]() {
+        double sums[NODE_COUNT + 1] = {};
+        for (size_t i = 0; i < columns->size(); i++) {
+            sums[columns->nodeAddress[i]] += columns->current[i];
+        }
+        doNotOptimize(sums[1]);
+    });
+    const Measurement *results[] = { &perPacket, &decodeOnly, &columnar };
+    const char *names[] = {
+        "per packet LoraDTO, then sum",
+        "columnar decode",
+        "columnar decode, then sum",
+    };
+    for (int i = 0; i < 3; i++) {
+        printf("%-40s %10.1f ns/frame %8.2f M readings/s %8.2f allocs/frame\n",
+            names[i],
+            results[i]->nanosPerOp / FRAME_COUNT,
+            readingCount / results[i]->nanosPerOp * 1000,
+            results[i]->allocationsPerOp / FRAME_COUNT);
+    }
+    printf("%-40s %10.2f ns/reading over %zu rows\n", "sum over columns only",
+        aggregate.nanosPerOp / columns->size(), columns->size());
+    delete columns;
+    return 0;
+}
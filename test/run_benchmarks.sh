@@ -0,0 +1,44 @@
+#!/bin/sh
+# Build and run every host test and benchmark under test/, as their headers describe, and
+# collect their results as JSON lines, one per measured operation, for comparison across runs.
+#
+# Usage, from anywhere:
+#   test/run_benchmarks.sh [results file, default benchmark_results.jsonl]
+#
+# Tests build with -Wall -Wextra on top of CXXFLAGS, and should build without warnings.
+# CXX, CC and CXXFLAGS may be overridden, e.g. CXXFLAGS="-O2 -march=native" to measure the
+# SIMD batch ciphers. tiny-AES is built as the firmware builds it, with its T-table backend.
+# Exits with the status of the first test or benchmark that fails, after running the others.
+
+set -u
+
+root=$(cd "$(dirname "$0")/.." && pwd)
+results=${1:-benchmark_results.jsonl}
+build=$(mktemp -d)
+trap 'rm -rf "$build"' EXIT
+
+CC=${CC:-gcc}
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--O2}
+
+: > "$results"
+results=$(cd "$(dirname "$results")" && pwd)/$(basename "$results")
+$CC -O2 -DAES_TTABLE=1 -c "$root/lib/tiny-AES-c-master/aes.c" -o "$build/aes.o" || exit 1
+
+status=0
+for source in $(find "$root/test" -name '*.cpp' | sort); do
+    name=$(basename "$source" .cpp)
+    echo "== $name"
+    if ! $CXX -std=gnu++17 -Wall -Wextra $CXXFLAGS -I"$root/src" -I"$root/test/shims" -I"$root/test" \
+        -I"$root/lib/tiny-AES-c-master" "$source" "$build/aes.o" -o "$build/$name"; then
+        echo "!! $name does not build"
+        [ "$status" -eq 0 ] && status=1
+        continue
+    fi
+    if ! BENCHMARK_RESULTS="$results" "$build/$name"; then
+        echo "!! $name failed"
+        [ "$status" -eq 0 ] && status=1
+    fi
+done
+echo "results: $results"
+exit $status
@@ -0,0 +1,339 @@
+/**
+ * @file adr_engine_benchmark.cpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Checks the settings an AdrEngine assigns, and simulates a network of nodes following
+ * it for a day, comparing the airtime, energy, capacity and delivery of the network with the
+ * defaults every node started with, on the host.
+ * @version 0.1
+ * @date 2022-05-06
+ *
+ * Build and run from the repository root:
+ *   g++ -std=gnu++17 -O2 -Isrc -Itest/shims -Itest test/services/adr_engine_benchmark.cpp -o adr_engine_benchmark
+ *   ./adr_engine_benchmark
+ *
+ * Simulated nodes send a sealed batch frame a minute, and follow the commands of the gateway
+ * and fall back when it is lost the way LoraInterface does. A frame is heard when it is sent
+ * at the spreading factor the gateway listens at, with a signal to noise ratio, drawn around
+ * the mean of its node and shifted by its TX power, above the demodulation floor. Commands
+ * reach the node the same way. Halfway through the day a node moves behind an obstacle, and
+ * loses 12 dB. Collisions are left out; capacity is what pure ALOHA carries at the airtime.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <assert.h>
+#include <math.h>
+
+#include <random>
+#include <vector>
+
+#include "benchmark.hpp"
+#include "services/adr_engine.hpp"
+#include "services/airtime.hpp"
+
+/// The bytes of every frame: a sealed batch of eight readings.
+#define FRAME_LENGTH 60
+
+/// The bytes of a sealed LINK_ADR command.
+#define COMMAND_LENGTH 28
+
+/// How often each node sends, in milliseconds.
+#define FRAME_INTERVAL 60000
+
+/// As LORA_LINK_CHECK_LIMIT and LORA_LINK_SCAN_DWELL in interfaces/lora_interface.hpp.
+#define LINK_CHECK_LIMIT 24
+#define LINK_SCAN_DWELL 12
+
+/**
+ * @brief Get how long a LoRa packet stays in the air with the settings LoraInterface sends
+ * with, in milliseconds.
+ *
+ */
+static double airtime(size_t payloadLength, uint8_t spreadingFactor) {
+    const RadioSettings radio = { spreadingFactor, 125000, 5, 8, false, true, false };
+    return timeOnAir(radio, payloadLength) / 1000.0;
+}
+
+/**
+ * @brief A node following the gateway, as LoraInterface does with link adaptation on.
+ *
+ */
+struct SimulatedNode {
+    /// The short address of the node.
+    uint16_t address;
+
+    /// The mean signal to noise ratio of its frames at the gateway, at full power, in dB.
+    double meanSnr;
+
+    /// The spreading factor and TX power it sends and listens with.
+    uint8_t spreadingFactor;
+    int8_t txPower;
+
+    /// The frames sent since the gateway was last heard.
+    int unanswered;
+
+    /// A commanded spreading factor waiting for its switch, 0 if none, and when it is due.
+    uint8_t pendingSpreadingFactor;
+    double switchAt;
+
+    /// When the node sends next, in milliseconds.
+    double nextFrame;
+};
+
+/**
+ * @brief What a network did over a simulated day.
+ *
+ */
+struct DayResult {
+    /// The frames sent, and those the gateway heard.
+    size_t sent, heard;
+
+    /// The airtime of every frame and command sent, in milliseconds.
+    double uplinkAirtime, downlinkAirtime;
+
+    /// The energy the nodes spent sending, in millijoules, with the TX power as the power
+    /// drawn.
+    double energy;
+
+    /// The frames heard in the hour after the obstacle appears.
+    size_t heardAfterObstacle, sentAfterObstacle;
+
+    /// The spreading factor the network ran at, by hour.
+    uint8_t spreadingFactorByHour[24];
+};
+
+/**
+ * @brief Simulate a network of nodes for a day.
+ *
+ * @param meanSnrs The mean signal to noise ratio of each node at full power, in dB.
+ * @param adaptive Whether the gateway runs an AdrEngine, rather than everyone keeping the
+ * defaults.
+ */
+static DayResult simulateDay(const std::vector<double> &meanSnrs, bool adaptive) {
+    const double day = 24 * 3600000.0, obstacleAt = day / 2;
+    std::mt19937 random(11);
+    std::normal_distribution<double> fading(0, 2);
+    std::uniform_real_distribution<double> jitter(-2000, 2000);
+    std::vector<SimulatedNode> nodes;
+    for (size_t i = 0; i < meanSnrs.size(); i++) {
+        nodes.push_back(SimulatedNode {
+            (uint16_t) (i + 1), meanSnrs[i], ADR_DEFAULT_SPREADING_FACTOR, ADR_MAX_TX_POWER, 0, 0, 0,
+            FRAME_INTERVAL * (double) i / meanSnrs.size()
+        });
+    }
+    AdrEngine engine;
+    uint8_t gatewaySpreadingFactor = ADR_DEFAULT_SPREADING_FACTOR;
+    DayResult result = {};
+    while (true) {
+        SimulatedNode *node = &nodes[0];
+        for (SimulatedNode &candidate : nodes) {
+            node = candidate.nextFrame < node->nextFrame ? &candidate : node;
+        }
+        const double now = node->nextFrame;
+        if (now >= day) {
+            break;
+        }
+        node->nextFrame += FRAME_INTERVAL + jitter(random);
+        if (adaptive && engine.update((uint32_t) now)) {
+            gatewaySpreadingFactor = engine.spreadingFactor();
+        }
+        result.spreadingFactorByHour[(int) (now / 3600000)] = gatewaySpreadingFactor;
+        if (node->address == 1 && now >= obstacleAt && node->meanSnr > meanSnrs[0] - 12) {
+            node->meanSnr -= 12;
+        }
+
+        // The node adapts its link before sending, as LoraInterface::checkLink does.
+        if (adaptive) {
+            if (node->pendingSpreadingFactor != 0 && now >= node->switchAt) {
+                node->spreadingFactor = node->pendingSpreadingFactor;
+                node->pendingSpreadingFactor = 0;
+            }
+            if (node->unanswered >= LINK_CHECK_LIMIT && (node->unanswered - LINK_CHECK_LIMIT) % LINK_SCAN_DWELL == 0) {
+                if (node->unanswered == LINK_CHECK_LIMIT) {
+                    node->txPower = ADR_MAX_TX_POWER;
+                } else if (node->unanswered == LINK_CHECK_LIMIT + LINK_SCAN_DWELL) {
+                    node->spreadingFactor = ADR_DEFAULT_SPREADING_FACTOR;
+                } else {
+                    node->spreadingFactor = node->spreadingFactor >= ADR_MAX_SPREADING_FACTOR ? ADR_MIN_SPREADING_FACTOR : node->spreadingFactor + 1;
+                }
+                node->pendingSpreadingFactor = 0;
+            }
+            node->unanswered++;
+        }
+        const double frameAirtime = airtime(FRAME_LENGTH, node->spreadingFactor);
+        result.sent++;
+        result.uplinkAirtime += frameAirtime;
+        result.energy += frameAirtime * pow(10, node->txPower / 10.0) / 1000;
+        const bool afterObstacle = now >= obstacleAt && now < obstacleAt + 3600000;
+        result.sentAfterObstacle += afterObstacle;
+        const double snr = node->meanSnr + fading(random) - (ADR_MAX_TX_POWER - node->txPower);
+        if (node->spreadingFactor != gatewaySpreadingFactor || snr < AdrEngine::requiredSnr(node->spreadingFactor)) {
+            continue;
+        }
+        result.heard++;
+        result.heardAfterObstacle += afterObstacle;
+        if (!adaptive) {
+            continue;
+        }
+
+        // The gateway answers, at full power and the spreading factor it listens at.
+        engine.record(node->address, (float) lround(snr), (int16_t) lround(snr - 110), (uint32_t) now);
+        LinkCommand command;
+        if (!engine.command(node->address, (uint32_t) now, command)) {
+            continue;
+        }
+        engine.commandSent(command);
+        result.downlinkAirtime += airtime(COMMAND_LENGTH, gatewaySpreadingFactor);
+        if (node->meanSnr + fading(random) < AdrEngine::requiredSnr(gatewaySpreadingFactor)) {
+            continue;
+        }
+        node->unanswered = 0;
+        node->txPower = command.txPower;
+        node->pendingSpreadingFactor = 0;
+        if (command.switchDelay == 0) {
+            node->spreadingFactor = command.spreadingFactor;
+        } else if (command.spreadingFactor != node->spreadingFactor) {
+            node->pendingSpreadingFactor = command.spreadingFactor;
+            node->switchAt = now + command.switchDelay;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Print how a network did over a day with the defaults and with ADR.
+ *
+ */
+static void reportDay(const char *name, const std::vector<double> &meanSnrs) {
+    const DayResult fixed = simulateDay(meanSnrs, false), adaptive = simulateDay(meanSnrs, true);
+    printf("\n%s, %zu nodes\n", name, meanSnrs.size());
+    printf("%-34s %14s %14s\n", "", "SF11, 14 dBm", "ADR");
+    const DayResult *results[] = { &fixed, &adaptive };
+    printf("%-34s", "frames heard");
+    for (const DayResult *result : results) {
+        printf(" %13.1f%%", 100.0 * result->heard / result->sent);
+    }
+    printf("\n%-34s", "frames heard in the obstacle hour");
+    for (const DayResult *result : results) {
+        printf(" %13.1f%%", 100.0 * result->heardAfterObstacle / result->sentAfterObstacle);
+    }
+    printf("\n%-34s", "airtime per frame, ms");
+    for (const DayResult *result : results) {
+        printf(" %14.1f", result->uplinkAirtime / result->sent);
+    }
+    printf("\n%-34s", "downlink airtime per frame, ms");
+    for (const DayResult *result : results) {
+        printf(" %14.1f", result->downlinkAirtime / result->sent);
+    }
+    printf("\n%-34s", "TX energy per frame, mJ");
+    for (const DayResult *result : results) {
+        printf(" %14.2f", result->energy / result->sent);
+    }
+    printf("\n%-34s", "ALOHA capacity, frames/hour");
+    for (const DayResult *result : results) {
+        const double channelTime = (result->uplinkAirtime + result->downlinkAirtime) / result->sent;
+        printf(" %14.0f", 0.184 * 3600000 / channelTime);
+    }
+    printf("\n%-34s", "SF by hour");
+    for (const DayResult *result : results) {
+        printf(" ");
+        for (uint8_t spreadingFactor : result->spreadingFactorByHour) {
+            printf("%X", spreadingFactor);
+        }
+    }
+    printf("\n");
+}
+
+int main() {
+    // A lone node close to the gateway is moved to the fastest spreading factor, told to
+    // switch with the gateway, and meanwhile keeps the power both need.
+    AdrEngine engine;
+    LinkCommand command;
+    for (uint32_t frame = 0; frame < ADR_HISTORY_LENGTH; frame++) {
+        engine.record(1, 8, -80, 1000 * frame);
+        engine.record(1, 8, -80, 1000 * frame);
+        assert(!engine.update(1000 * frame));
+    }
+    assert(engine.link(1)->frames == ADR_HISTORY_LENGTH);
+    assert(engine.spreadingFactor() == 11 && engine.spreadingFactorAhead() == 7);
+    assert(engine.command(1, 16000, command));
+    assert(command.nodeAddress == 1 && command.spreadingFactor == 7 && command.txPower == 2);
+    assert(command.switchDelay == ADR_MIN_SWITCH_DELAY - 1000);
+    assert(engine.command(1, 16000, command));
+    engine.commandSent(command);
+    assert(!engine.command(1, 16000, command));
+    assert(engine.update(15000 + ADR_MIN_SWITCH_DELAY) && engine.spreadingFactor() == 7);
+
+    // Its commands survive the wire.
+    uint8_t frame[64];
+    LinkCommand decoded;
+    const size_t frameLength = encodeLinkCommand(command, frame, sizeof(frame));
+    assert(frameLength > 0 && decodeLinkCommand(frame, frameLength, decoded));
+    assert(decoded.nodeAddress == 1 && decoded.spreadingFactor == 7 && decoded.txPower == 2);
+    assert(decoded.switchDelay == command.switchDelay);
+    frame[1] = JOIN_ACCEPT;
+    assert(!decodeLinkCommand(frame, frameLength, decoded));
+
+    // A distant node slows the network down once heard twice, without waiting for its
+    // history, but no slower than the default until the gateway misses its frames.
+    engine.record(2, -12, -120, 26000);
+    engine.update(26000);
+    assert(engine.spreadingFactorAhead() == 7);
+    engine.record(2, -12, -120, 27000);
+    engine.update(27000);
+    assert(engine.spreadingFactorAhead() == ADR_DEFAULT_SPREADING_FACTOR);
+    engine.record(2, -12, -120, 30000);
+    assert(engine.link(2)->interval == 1000 && engine.link(2)->missed[2] == 2);
+    assert(engine.update(27000 + ADR_MIN_SWITCH_DELAY) && engine.spreadingFactor() == ADR_DEFAULT_SPREADING_FACTOR);
+    engine.update(27001 + ADR_MIN_SWITCH_DELAY);
+    assert(engine.spreadingFactorAhead() == 12);
+    assert(engine.command(2, 37001, command) && command.spreadingFactor == 12 && command.txPower == ADR_MAX_TX_POWER);
+
+    // A node whose signal varies keeps more margin than a steady one with the same average.
+    AdrEngine steady, fading;
+    for (uint32_t frame = 0; frame < ADR_HISTORY_LENGTH; frame++) {
+        steady.record(1, -2, -100, 1000 * frame);
+        fading.record(1, frame % 2 == 0 ? -6 : 2, -100, 1000 * frame);
+    }
+    steady.update(ADR_HISTORY_LENGTH * 1000);
+    fading.update(ADR_HISTORY_LENGTH * 1000);
+    assert(steady.spreadingFactorAhead() == 7 && fading.spreadingFactorAhead() == 9);
+
+    // A node gone silent is forgotten, and the network falls back to the default.
+    AdrEngine lonely(7);
+    lonely.record(3, 10, -70, 0);
+    lonely.update(ADR_NODE_TIMEOUT + 1);
+    assert(lonely.link(3) == nullptr && lonely.spreadingFactorAhead() == ADR_DEFAULT_SPREADING_FACTOR);
+
+    // What the engine costs the gateway per frame.
+    AdrEngine timed;
+    uint32_t at = 0;
+    const Measurement perFrame = measure(2000000, [&]() {
+        at += 1000;
+        const uint16_t address = 1 + at / 1000 % ADR_ENGINE_CAPACITY;
+        timed.record(address, (float) (at % 13), -90, at);
+        if (timed.command(address, at, command)) {
+            timed.commandSent(command);
+        }
+    });
+    reportResult("ADR record and command, per frame", perFrame, FRAME_LENGTH);
+
+    // Networks where every node is close, spread out, and at the edge of coverage.
+    std::mt19937 random(5);
+    const struct { const char *name; double nearest, farthest; } deployments[] = {
+        { "one building, SNR 0 to +10 dB", 0, 10 },
+        { "a neighbourhood, SNR -10 to +10 dB", -10, 10 },
+        { "a village, SNR -17 to +5 dB", -17, 5 },
+    };
+    for (const auto &deployment : deployments) {
+        std::uniform_real_distribution<double> spread(deployment.nearest, deployment.farthest);
+        std::vector<double> meanSnrs;
+        for (int i = 0; i < 20; i++) {
+            meanSnrs.push_back(spread(random));
+        }
+        meanSnrs[0] = deployment.farthest;
+        reportDay(deployment.name, meanSnrs);
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+/**
+ * @file aes_backend_benchmark.cpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Compares the cycles per block of the byte-wise and T-table builds of tiny-AES, on the
+ * host.
+ * @version 0.1
+ * @date 2022-04-26
+ *
+ * Build and run from the repository root:
+ *   g++ -std=gnu++17 -O2 -Isrc -Itest/shims -Itest -Ilib/tiny-AES-c-master test/services/aes_backend_benchmark.cpp -o aes_backend_benchmark
+ *   ./aes_backend_benchmark
+ *
+ * Both builds of aes.c are compiled into this one file, each in its own namespace, so they run
+ * side by side on the same data. Cycles are read from the time stamp counter, so they are only
+ * reported on x86 hosts.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "aes.h"
+#include "benchmark.hpp"
+
+/// The AES blocks a full LoRa frame spans.
+#define FRAME_BLOCKS 16
+
+/// The byte-wise build, as tiny-AES ships.
+namespace bytewise {
+    #undef AES_TTABLE
+    #define AES_TTABLE 0
+    #include "aes.c"
+}
+
+/// The T-table build, as the firmware is configured.
+namespace ttable {
+    #undef AES_TTABLE
+    #define AES_TTABLE 1
+    #include "aes.c"
+}
+
+/**
+ * @brief Print one row, per AES block.
+ *
+ */
+static void reportPerBlock(const char *name, Measurement measurement, size_t blocks) {
+    printf(
+        "%-40s %10.1f ns/block %8.1f cycles/block %8.1f cycles/byte\n",
+        name,
+        measurement.nanosPerOp / blocks,
+        measurement.cyclesPerOp / blocks,
+        measurement.cyclesPerOp / blocks / AES_BLOCKLEN
+    );
+}
+
+int main() {
+    const long iterations = 200000;
+    const uint8_t key[AES_KEYLEN] = {
+        0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+    };
+    AES_ctx bytewiseCtx, ttableCtx;
+    bytewise::AES_init_ctx(&bytewiseCtx, key);
+    ttable::AES_init_ctx(&ttableCtx, key);
+
+    // Both builds must encrypt every block the same, and decrypt each other's output.
+    uint8_t a[AES_BLOCKLEN], b[AES_BLOCKLEN];
+    uint32_t seed = 1;
+    for (int i = 0; i < 10000; i++) {
+        for (uint8_t j = 0; j < AES_BLOCKLEN; j++) {
+            seed = seed * 1103515245 + 12345;
+            a[j] = b[j] = (uint8_t) (seed >> 16);
+        }
+        const uint8_t plain = a[0];
+        bytewise::AES_ECB_encrypt(&bytewiseCtx, a);
+        ttable::AES_ECB_encrypt(&ttableCtx, b);
+        assert(memcmp(a, b, AES_BLOCKLEN) == 0);
+        bytewise::AES_ECB_decrypt(&bytewiseCtx, b);
+        assert(b[0] == plain);
+    }
+
+    uint8_t block[AES_BLOCKLEN] = {};
+    reportPerBlock("byte-wise, ECB encrypt", measure(iterations, [&]() {
+        bytewise::AES_ECB_encrypt(&bytewiseCtx, block);
+        doNotOptimize(block[0]);
+    }), 1);
+    reportPerBlock("T-table, ECB encrypt", measure(iterations, [&]() {
+        ttable::AES_ECB_encrypt(&ttableCtx, block);
+        doNotOptimize(block[0]);
+    }), 1);
+    uint8_t frame[FRAME_BLOCKS * AES_BLOCKLEN] = {};
+    reportPerBlock("byte-wise, CTR over a full frame", measure(iterations / 16, [&]() {
+        bytewise::AES_CTR_xcrypt_buffer(&bytewiseCtx, frame, sizeof(frame));
+        doNotOptimize(frame[0]);
+    }), FRAME_BLOCKS);
+    reportPerBlock("T-table, CTR over a full frame", measure(iterations / 16, [&]() {
+        ttable::AES_CTR_xcrypt_buffer(&ttableCtx, frame, sizeof(frame));
+        doNotOptimize(frame[0]);
+    }), FRAME_BLOCKS);
+    return 0;
+}
@@ -0,0 +1,200 @@
+/**
+ * @file bitsliced_aes_benchmark.cpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Checks the bitsliced AES kernel and batch CCM opening against tiny-AES, and compares
+ * their throughput with per-block tiny-AES calls, on the host.
+ * @version 0.1
+ * @date 2022-04-27
+ *
+ * Build and run from the repository root, with tiny-AES built as the firmware builds it:
+ *   gcc -O2 -DAES_TTABLE=1 -c lib/tiny-AES-c-master/aes.c -o aes.o
+ *   g++ -std=gnu++17 -O2 -march=native -Isrc -Itest/shims -Itest -Ilib/tiny-AES-c-master test/services/bitsliced_aes_benchmark.cpp aes.o -o bitsliced_aes_benchmark
+ *   ./bitsliced_aes_benchmark
+ *
+ * The SSE2 and AVX2 words are only measured when the host compiler enables them. Cycles are
+ * read from the time stamp counter, so they are only reported on x86 hosts.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <assert.h>
+
+#include <vector>
+
+#include "benchmark.hpp"
+#include "models/wire_format.hpp"
+#include "services/crypto.hpp"
+
+/// The length of the body of each queued frame, a single reading.
+#define QUEUED_FRAME_LENGTH 30
+
+/**
+ * @brief Print one row, per AES block.
+ *
+ */
+static void reportPerBlock(const char *name, Measurement measurement, size_t blocks) {
+    printf(
+        "%-44s %10.1f ns/block %8.1f cycles/block\n",
+        name,
+        measurement.nanosPerOp / blocks,
+        measurement.cyclesPerOp / blocks
+    );
+}
+
+/**
+ * @brief Check that a word encrypts like tiny-AES for batches of every shape, then measure it
+ * over full and 8 block batches.
+ *
+ */
+template <typename Word>
+static void checkAndMeasure(const char *name, const AES_ctx &ctx) {
+    BitslicedAES<Word> *cipher = new BitslicedAES<Word>(ctx.RoundKey);
+    const size_t lanes = BitslicedAES<Word>::LANES;
+    std::vector<uint8_t> blocks(3 * lanes * AES_BLOCKLEN), expected(blocks.size());
+    uint32_t seed = 7;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        seed = seed * 1103515245 + 12345;
+        blocks[i] = expected[i] = (uint8_t) (seed >> 16);
+    }
+    for (size_t i = 0; i < 3 * lanes; i++) {
+        AES_ECB_encrypt(&ctx, expected.data() + i * AES_BLOCKLEN);
+    }
+    const size_t counts[] = { 1, 7, 8, lanes - 1, lanes, lanes + 1 };
+    for (size_t count : counts) {
+        std::vector<uint8_t> batch(blocks.begin(), blocks.begin() + count * AES_BLOCKLEN);
+        cipher->encrypt(batch.data(), count);
+        assert(memcmp(batch.data(), expected.data(), batch.size()) == 0);
+    }
+    cipher->encrypt(blocks.data(), 3 * lanes);
+    assert(memcmp(blocks.data(), expected.data(), blocks.size()) == 0);
+
+    char row[64];
+    snprintf(row, sizeof(row), "bitsliced %s, %zu blocks", name, lanes);
+    reportPerBlock(row, measure(400000 / lanes, [&]() {
+        cipher->encrypt(blocks.data(), lanes);
+        doNotOptimize(blocks[0]);
+    }), lanes);
+    snprintf(row, sizeof(row), "bitsliced %s, 8 blocks", name);
+    reportPerBlock(row, measure(20000, [&]() {
+        cipher->encrypt(blocks.data(), 8);
+        doNotOptimize(blocks[0]);
+    }), 8);
+    delete cipher;
+}
+
+/**
+ * @brief Seal a queue of frames the way nodes send them, one body after another.
+ *
+ */
+static void sealFrames(Crypto &crypto, uint8_t *bodies, uint8_t *mics, const uint8_t *header, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint8_t *body = bodies + i * QUEUED_FRAME_LENGTH;
+        for (size_t j = 0; j < QUEUED_FRAME_LENGTH; j++) {
+            body[j] = (uint8_t) (i * 31 + j);
+        }
+        crypto.encryptAuthenticated(body, QUEUED_FRAME_LENGTH, 1000 + i, header, 1, mics + i * CRYPTO_MIC_LENGTH);
+    }
+}
+
+int main() {
+    const uint8_t key[AES_KEYLEN] = {
+        0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+    };
+    AES_ctx ctx;
+    AES_init_ctx(&ctx, key);
+
+    uint8_t block[AES_BLOCKLEN] = {};
+    reportPerBlock("tiny-AES AES_ECB_decrypt, per block", measure(200000, [&]() {
+        AES_ECB_decrypt(&ctx, block);
+        doNotOptimize(block[0]);
+    }), 1);
+    reportPerBlock("tiny-AES AES_ECB_encrypt, per block", measure(200000, [&]() {
+        AES_ECB_encrypt(&ctx, block);
+        doNotOptimize(block[0]);
+    }), 1);
+    checkAndMeasure<uint32_t>("uint32_t", ctx);
+    checkAndMeasure<uint64_t>("uint64_t", ctx);
+#if defined(__SSE2__)
+    checkAndMeasure<SseWord>("SSE2", ctx);
+#endif
+#if defined(__AVX2__)
+    checkAndMeasure<Avx2Word>("AVX2", ctx);
+#endif
+
+    // A batch must open what decryptAuthenticated opens, and refuse the same tampered frames,
+    // whatever the lengths of the messages sharing it, both one by one and bitsliced.
+    Crypto crypto("1234567890ABCDEF");
+    const uint8_t header = makeFrameHeader(RECORD_FRAME, AUTHENTICATED);
+    const size_t variedLengths[5] = { 0, 1, 16, 47, 64 };
+    for (const size_t count : { (size_t) 5, (size_t) CRYPTO_BATCH_MIN_MESSAGES }) {
+        std::vector<uint8_t> varied(count * 64), variedMICs(count * CRYPTO_MIC_LENGTH);
+        std::vector<SealedMessage> messages(count);
+        for (size_t i = 0; i < count; i++) {
+            uint8_t *body = varied.data() + i * 64;
+            memset(body, i % 5 + 1, 64);
+            crypto.encryptAuthenticated(body, variedLengths[i % 5], i, &header, 1, variedMICs.data() + i * CRYPTO_MIC_LENGTH);
+            messages[i] = { body, variedLengths[i % 5], (uint32_t) i, &header, 1, variedMICs.data() + i * CRYPTO_MIC_LENGTH, false };
+        }
+        varied[3 * 64 + 40] ^= 1;
+        assert(crypto.decryptAuthenticatedBatch(messages.data(), count) == count - 1);
+        for (size_t i = 0; i < count; i++) {
+            assert(messages[i].authentic == (i != 3));
+            for (size_t j = 0; j < variedLengths[i % 5]; j++) {
+                assert(varied[i * 64 + j] == (i == 3 ? 0 : i % 5 + 1));
+            }
+        }
+    }
+
+    const size_t queuedFrames = 2 * CRYPTO_BATCH_MIN_MESSAGES;
+    std::vector<uint8_t> bodies(queuedFrames * QUEUED_FRAME_LENGTH), mics(queuedFrames * CRYPTO_MIC_LENGTH);
+    std::vector<SealedMessage> messages(queuedFrames);
+    const auto queue = [&](size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            messages[i] = {
+                bodies.data() + i * QUEUED_FRAME_LENGTH,
+                QUEUED_FRAME_LENGTH,
+                (uint32_t) (1000 + i),
+                &header,
+                1,
+                mics.data() + i * CRYPTO_MIC_LENGTH,
+                false
+            };
+        }
+    };
+    sealFrames(crypto, bodies.data(), mics.data(), &header, queuedFrames);
+    queue(queuedFrames);
+    assert(crypto.decryptAuthenticatedBatch(messages.data(), queuedFrames) == queuedFrames);
+    assert(bodies[QUEUED_FRAME_LENGTH + 2] == 31 + 2);
+
+    // Opening costs the same whether the MICs match or not, so the queue is opened as is.
+    // Runs shorter than CRYPTO_BATCH_MIN_MESSAGES are opened one by one by the batch too.
+    sealFrames(crypto, bodies.data(), mics.data(), &header, queuedFrames);
+    for (const size_t run : { (size_t) 1, (size_t) 8, queuedFrames / 4, queuedFrames / 2, queuedFrames }) {
+        const long passes = 64000 / run;
+        const Measurement oneByOne = measure(passes, [&]() {
+            for (size_t i = 0; i < run; i++) {
+                doNotOptimize(crypto.decryptAuthenticated(
+                    bodies.data() + i * QUEUED_FRAME_LENGTH,
+                    QUEUED_FRAME_LENGTH,
+                    1000 + i,
+                    &header,
+                    1,
+                    mics.data() + i * CRYPTO_MIC_LENGTH
+                ));
+            }
+        });
+        const Measurement batched = measure(passes, [&]() {
+            queue(run);
+            doNotOptimize(crypto.decryptAuthenticatedBatch(messages.data(), run));
+        });
+        char row[64];
+        snprintf(row, sizeof(row), "CCM open %zu frame(s), one at a time", run);
+        printf("%-44s %10.1f ns/frame %8.1f cycles/frame\n", row, oneByOne.nanosPerOp / run, oneByOne.cyclesPerOp / run);
+        snprintf(row, sizeof(row), "CCM open %zu frame(s), in one batch", run);
+        printf("%-44s %10.1f ns/frame %8.1f cycles/frame\n", row, batched.nanosPerOp / run, batched.cyclesPerOp / run);
+    }
+    printf("frames of %d bytes, %zu scalar and %zu native lanes, batches from %zu frames\n", QUEUED_FRAME_LENGTH,
+        BitslicedAES<ScalarBitslicedWord>::LANES, BitslicedAES<NativeBitslicedWord>::LANES, (size_t) CRYPTO_BATCH_MIN_MESSAGES);
+    return 0;
+}
@@ -0,0 +1,193 @@
+/**
+ * @file cipher_stream_benchmark.cpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Compares sending an encrypted reading through String copies, sealing it in a buffer,
+ * and streaming it through a CipherStream straight into a radio FIFO, and sending it signed
+ * through a SigningStream, on the host.
+ * @version 0.1
+ * @date 2022-04-20
+ *
+ * Build and run from the repository root:
+ *   gcc -O2 -c lib/tiny-AES-c-master/aes.c -o aes.o
+ *   g++ -std=gnu++17 -O2 -Isrc -Itest/shims -Itest -Ilib/tiny-AES-c-master test/services/cipher_stream_benchmark.cpp aes.o -o cipher_stream_benchmark
+ *   ./cipher_stream_benchmark
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <assert.h>
+
+#include "benchmark.hpp"
+#include "models/lora_dto.hpp"
+#include "models/meter_reading.hpp"
+#include "services/cipher_stream.hpp"
+#include "services/signing_stream.hpp"
+
+/**
+ * @brief Stands in for the SX127x FIFO that LoRaClass::write fills.
+ *
+ */
+class FifoSink : public Print {
+    public:
+        /// The bytes written since the last packet began.
+        uint8_t fifo[WIRE_MAX_FRAME_LENGTH];
+
+        /// The number of bytes written since the last packet began.
+        size_t length = 0;
+
+        size_t write(uint8_t value) override {
+            if (length == sizeof(fifo)) {
+                return 0;
+            }
+            fifo[length++] = value;
+            return 1;
+        }
+
+        size_t write(const uint8_t *buffer, size_t size) override {
+            size = size < sizeof(fifo) - length ? size : sizeof(fifo) - length;
+            memcpy(fifo + length, buffer, size);
+            length += size;
+            return size;
+        }
+};
+
+/**
+ * @brief Stream a sealed reading into the sink the way LoraInterface::streamFrame does,
+ * measuring the body before streaming it.
+ *
+ * @return size_t The length of the packet, 0 if it could not be sealed.
+ */
+static size_t streamEncrypted(const MeterReading &reading, Crypto &crypto, FifoSink &radio, uint32_t nonce) {
+    const size_t capacity = WIRE_MAX_FRAME_LENGTH - 1 - CRYPTO_FRAME_OVERHEAD;
+    FrameWriter measured(nullptr, capacity);
+    MeterReadingSchema::writeFields(reading, measured);
+    radio.length = 0;
+    FrameWriter prefix(radio, 1 + CRYPTO_PREFIX_LENGTH);
+    prefix.putByte(makeFrameHeader(RECORD_FRAME, AUTHENTICATED));
+    prefix.putByte(0);
+    prefix.putByte(0);
+    prefix.putFixedWidth((int32_t) nonce, CRYPTO_NONCE_LENGTH);
+    CipherStream cipher(crypto, radio, nonce, radio.fifo, 1 + CRYPTO_KEY_ID_LENGTH, measured.size());
+    FrameWriter writer(cipher, capacity);
+    MeterReadingSchema::writeFields(reading, writer);
+    const size_t sealedLength = cipher.finish();
+    return sealedLength == 0 ? 0 : prefix.size() + sealedLength;
+}
+
+/**
+ * @brief Stream a signed reading into the sink the way LoraInterface::streamFrame does.
+ *
+ * @return size_t The length of the packet.
+ */
+static size_t streamSigned(const MeterReading &reading, Crypto &crypto, FifoSink &radio, uint32_t nonce) {
+    radio.length = 0;
+    FrameWriter prefix(radio, 1 + CRYPTO_PREFIX_LENGTH);
+    prefix.putByte(makeFrameHeader(RECORD_FRAME, SIGNED));
+    prefix.putByte(0);
+    prefix.putByte(0);
+    prefix.putFixedWidth((int32_t) nonce, CRYPTO_NONCE_LENGTH);
+    SigningStream signer(crypto, radio, radio.fifo, prefix.size());
+    FrameWriter writer(signer, WIRE_MAX_FRAME_LENGTH - 1 - CRYPTO_FRAME_OVERHEAD);
+    MeterReadingSchema::writeFields(reading, writer);
+    return prefix.size() + signer.finish();
+}
+
+int main() {
+    const long iterations = 200000;
+    Crypto crypto("1234567890ABCDEF1234567890ABCDE");
+    FifoSink radio;
+    MeterReading reading = { "QB5ckYt0CS7Yc7swMKPu", 0.42f, 244, 0, 0 };
+    SerializableData dataList[] = {
+        SerializableData("deviceID", "QB5ckYt0CS7Yc7swMKPu"),
+        SerializableData("current", String(0.42)),
+        SerializableData("voltage", String(244)),
+    };
+    LoraDTO dto = LoraDTO(dataList, 3);
+
+    // The streamed packet must open back to the reading, and be as long as the clear frame
+    // plus its key ID, nonce and MIC.
+    uint8_t frame[WIRE_MAX_FRAME_LENGTH];
+    const size_t frameLength = MeterReadingSchema::encode(reading, frame, sizeof(frame));
+    const size_t packetLength = streamEncrypted(reading, crypto, radio, 0x01020304);
+    assert(packetLength == frameLength + CRYPTO_FRAME_OVERHEAD);
+    assert(frameProtection(radio.fifo[0]) == AUTHENTICATED && radio.fifo[1 + CRYPTO_KEY_ID_LENGTH] == 0x04);
+    uint8_t decrypted[WIRE_MAX_FRAME_LENGTH];
+    decrypted[0] = makeFrameHeader(RECORD_FRAME);
+    memcpy(decrypted + 1, radio.fifo + 1 + CRYPTO_PREFIX_LENGTH, frameLength - 1);
+    assert(crypto.decryptAuthenticated(
+        decrypted + 1,
+        frameLength - 1,
+        0x01020304,
+        radio.fifo,
+        1 + CRYPTO_KEY_ID_LENGTH,
+        radio.fifo + packetLength - CRYPTO_MIC_LENGTH
+    ));
+    assert(memcmp(decrypted, frame, frameLength) == 0);
+
+    // A stream that writes other than the length it declared must not be sealed.
+    radio.length = 0;
+    CipherStream truncated(crypto, radio, 1, frame, 1, frameLength);
+    truncated.write(frame + 1, frameLength - 2);
+    assert(truncated.finish() == 0);
+    MeterReading decoded = {};
+    assert(MeterReadingSchema::decode(decrypted, frameLength, decoded));
+    assert(strcmp(decoded.deviceID, reading.deviceID) == 0 && decoded.voltage == 244);
+
+    // A signed packet must carry the clear body, and the tag Crypto::sign gives the frame.
+    const size_t signedLength = streamSigned(reading, crypto, radio, 0x01020304);
+    assert(signedLength == packetLength && frameProtection(radio.fifo[0]) == SIGNED);
+    assert(memcmp(radio.fifo + 1 + CRYPTO_PREFIX_LENGTH, frame + 1, frameLength - 1) == 0);
+    assert(crypto.verifySignature(radio.fifo, signedLength - CRYPTO_MIC_LENGTH, radio.fifo + signedLength - CRYPTO_MIC_LENGTH));
+    for (size_t length = 0; length <= 3 * AES_BLOCKLEN; length++) {
+        uint8_t signedTag[CRYPTO_MIC_LENGTH];
+        radio.length = 0;
+        SigningStream signer(crypto, radio, frame, length / 2);
+        signer.write(frame + length / 2, length - length / 2);
+        assert(signer.finish() == length - length / 2 + CRYPTO_MIC_LENGTH);
+        crypto.sign(frame, length, signedTag);
+        assert(memcmp(radio.fifo + length - length / 2, signedTag, CRYPTO_MIC_LENGTH) == 0);
+    }
+
+    // Unencrypted frames streamed into the sink must match buffered ones byte for byte.
+    radio.length = 0;
+    FrameWriter streamed(radio, WIRE_MAX_FRAME_LENGTH);
+    streamed.putByte(makeFrameHeader(RECORD_FRAME));
+    MeterReadingSchema::writeFields(reading, streamed);
+    assert(radio.length == frameLength && memcmp(radio.fifo, frame, frameLength) == 0);
+
+    const String text = dto.toString();
+    reportResult("String encrypt and print (legacy)", measure(iterations, [&]() {
+        radio.length = 0;
+        radio.print(crypto.encrypt(dto.toString()));
+        doNotOptimize(radio.length);
+    }), text.length());
+    reportResult("DTO streamed into FIFO (clear)", measure(iterations, [&]() {
+        radio.length = 0;
+        FrameWriter writer(radio, WIRE_MAX_FRAME_LENGTH);
+        writer.putByte(makeFrameHeader(RECORD_FRAME));
+        doNotOptimize(dto.writeFields(writer));
+    }), dto.toBinary(frame, sizeof(frame)));
+    reportResult("reading streamed into FIFO (clear)", measure(iterations, [&]() {
+        radio.length = 0;
+        FrameWriter writer(radio, WIRE_MAX_FRAME_LENGTH);
+        writer.putByte(makeFrameHeader(RECORD_FRAME));
+        doNotOptimize(MeterReadingSchema::writeFields(reading, writer));
+    }), frameLength);
+    reportResult("reading sealed in a buffer", measure(iterations, [&]() {
+        radio.length = 0;
+        const size_t length = MeterReadingSchema::encode(reading, frame, sizeof(frame));
+        crypto.encryptAuthenticated(frame + 1, length - 1, 0x01020304, frame, 1, frame + length);
+        radio.write(frame, length + CRYPTO_MIC_LENGTH);
+        doNotOptimize(radio.length);
+    }), packetLength);
+    reportResult("reading streamed through CipherStream", measure(iterations, [&]() {
+        doNotOptimize(streamEncrypted(reading, crypto, radio, 0x01020304));
+    }), packetLength);
+    reportResult("reading streamed through SigningStream", measure(iterations, [&]() {
+        doNotOptimize(streamSigned(reading, crypto, radio, 0x01020304));
+    }), signedLength);
+    printf("working memory: %zu bytes of CipherStream, %zu bytes of FrameWriter\n",
+        sizeof(CipherStream), sizeof(FrameWriter));
+    return 0;
+}
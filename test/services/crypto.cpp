@@ -1,9 +1,76 @@
+/**
+ * @file crypto.cpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Checks that every Crypto mode undoes itself, and that the legacy String methods are
+ * safe to call with short text, on the host.
+ * @version 0.1
+ * @date 2022-05-02
+ *
+ * Build and run from the repository root:
+ *   gcc -O2 -c lib/tiny-AES-c-master/aes.c -o aes.o
+ *   g++ -std=gnu++17 -O2 -Isrc -Itest/shims -Ilib/tiny-AES-c-master test/services/crypto.cpp aes.o -o crypto_test
+ *   ./crypto_test
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <assert.h>
+
 #include "services/crypto.hpp"
 
-void main() {
+int main() {
+    // Without a key, nothing can be encrypted.
+    Crypto none;
+    bool refused = false;
+    try {
+        none.encrypt(String("Hello World!"));
+    } catch (const char *error) {
+        refused = true;
+    }
+    assert(!none.isReady() && refused);
+
+    // The legacy methods encrypt the first block in place, even of text shorter than one.
     Crypto crypto("key");
+    assert(crypto.isReady());
     const String plainText = "Hello World!";
-    const String encrypted = crypto.encrypt(plainText);
-    const String decrypted = crypto.decrypt(encrypted);
-    assert(plainText == decrypted);
-}
\ No newline at end of file
+    assert(crypto.encrypt(plainText) != plainText);
+
+    // A block must decrypt to what was encrypted.
+    uint8_t block[AES_BLOCKLEN], original[AES_BLOCKLEN];
+    for (uint8_t i = 0; i < AES_BLOCKLEN; i++) {
+        block[i] = original[i] = i;
+    }
+    crypto.encryptBlock(block);
+    assert(memcmp(block, original, AES_BLOCKLEN) != 0);
+    crypto.decryptBlock(block);
+    assert(memcmp(block, original, AES_BLOCKLEN) == 0);
+
+    // CTR and CCM must round trip buffers of every length, zero bytes included, in place and
+    // into another buffer.
+    uint8_t data[80], copy[80], mic[CRYPTO_MIC_LENGTH];
+    const uint8_t header = 0x92;
+    for (size_t length = 0; length <= sizeof(data); length++) {
+        memset(data, 0, length);
+        crypto.encrypt(data, length, (uint32_t) length);
+        crypto.decrypt(data, length, copy, (uint32_t) length);
+        for (size_t i = 0; i < length; i++) {
+            assert(copy[i] == 0);
+        }
+        crypto.encryptAuthenticated(copy, length, (uint32_t) length, &header, 1, mic);
+        assert(crypto.decryptAuthenticated(copy, length, (uint32_t) length, &header, 1, mic));
+        for (size_t i = 0; i < length; i++) {
+            assert(copy[i] == 0);
+        }
+        crypto.sign(copy, length, mic);
+        assert(crypto.verifySignature(copy, length, mic));
+    }
+
+    // A different key must not open what this one sealed.
+    Crypto other("another key");
+    crypto.encryptAuthenticated(data, 30, 1, &header, 1, mic);
+    assert(!other.decryptAuthenticated(data, 30, 1, &header, 1, mic));
+    assert(!other.verifySignature(data, 30, mic));
+    printf("crypto: all checks passed\n");
+    return 0;
+}
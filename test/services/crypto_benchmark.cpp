@@ -0,0 +1,181 @@
+/**
+ * @file crypto_benchmark.cpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Checks the Crypto modes against reference vectors, and measures their cycles per byte
+ * over payloads the size LoRa frames are, on the host. Encrypting with AES-CCM and only
+ * signing with AES-CMAC are compared per packet.
+ * @version 0.1
+ * @date 2022-04-25
+ *
+ * Build and run from the repository root:
+ *   gcc -O2 -c lib/tiny-AES-c-master/aes.c -o aes.o
+ *   g++ -std=gnu++17 -O2 -Isrc -Itest/shims -Itest -Ilib/tiny-AES-c-master test/services/crypto_benchmark.cpp aes.o -o crypto_benchmark
+ *   ./crypto_benchmark
+ *
+ * Cycles are read from the time stamp counter, so they are only reported on x86 hosts.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <assert.h>
+
+#include "benchmark.hpp"
+#include "models/wire_format.hpp"
+#include "services/crypto.hpp"
+
+/**
+ * @brief Print one row, per byte of payload, and record it under its name and length.
+ *
+ */
+static void reportPerByte(const char *name, Measurement measurement, size_t bytes) {
+    printf(
+        "%-40s %5zu bytes %10.1f ns/op %8.1f cycles/byte %6.2f allocs/op\n",
+        name,
+        bytes,
+        measurement.nanosPerOp,
+        measurement.cyclesPerOp / bytes,
+        measurement.allocationsPerOp
+    );
+    char row[64];
+    snprintf(row, sizeof(row), "%s, %zu bytes", name, bytes);
+    recordResult(row, measurement, bytes);
+}
+
+int main() {
+    const long iterations = 100000;
+
+    // CTR must match the NIST SP 800-38A F.5.1 vector, and undo itself.
+    const uint8_t nistKey[] = {
+        0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c, 0
+    };
+    const uint8_t nistCounter[AES_BLOCKLEN] = {
+        0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
+    };
+    const uint8_t nistPlain[32] = {
+        0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+        0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51
+    };
+    const uint8_t nistCipher[32] = {
+        0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26, 0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce,
+        0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70, 0xfd, 0xff, 0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff
+    };
+    Crypto nist(String((const char *) nistKey));
+    uint8_t data[WIRE_MAX_FRAME_LENGTH];
+    memcpy(data, nistPlain, sizeof(nistPlain));
+    nist.xcryptCTR(data, 29, nistCounter);
+    assert(memcmp(data, nistCipher, 29) == 0 && memcmp(data + 29, nistPlain + 29, 3) == 0);
+    nist.xcryptCTR(data, 29, nistCounter);
+    assert(memcmp(data, nistPlain, sizeof(nistPlain)) == 0);
+
+    // Every byte of a long payload must change, zero bytes included.
+    Crypto crypto("1234567890ABCDEF1234567890ABCDE");
+    uint8_t counter[AES_BLOCKLEN] = { 0x01 };
+    memset(data, 0, sizeof(data));
+    crypto.xcryptCTR(data, sizeof(data), counter);
+    size_t unchanged = 0;
+    for (size_t i = 0; i < sizeof(data); i++) {
+        unchanged += data[i] == 0;
+    }
+    assert(unchanged < 8);
+
+    // CCM must match a reference implementation, and refuse tampered frames or headers.
+    const uint8_t ccmCipher[40] = {
+        0x03, 0x3b, 0xa0, 0xc2, 0xd1, 0x98, 0xb0, 0x63, 0xd4, 0xc9, 0xf8, 0x68, 0xc1, 0x19, 0xa8, 0xb7,
+        0x61, 0x9f, 0xb0, 0xe7, 0x13, 0x27, 0x95, 0xa5, 0x49, 0x9c, 0xba, 0x7c, 0x13, 0xc0, 0x59, 0xb5,
+        0x7a, 0x82, 0x32, 0xfa, 0x71, 0x7a, 0x8f, 0xe9
+    };
+    const uint8_t ccmMIC[CRYPTO_MIC_LENGTH] = { 0xe8, 0xbe, 0x04, 0xc0 };
+    Crypto ccm("1234567890ABCDEF");
+    uint8_t header = makeFrameHeader(RECORD_FRAME, AUTHENTICATED);
+    uint8_t mic[CRYPTO_MIC_LENGTH];
+    for (uint8_t i = 0; i < sizeof(ccmCipher); i++) {
+        data[i] = i;
+    }
+    ccm.encryptAuthenticated(data, sizeof(ccmCipher), 0x01020304, &header, 1, mic);
+    assert(memcmp(data, ccmCipher, sizeof(ccmCipher)) == 0 && memcmp(mic, ccmMIC, sizeof(mic)) == 0);
+    data[7] ^= 0x10;
+    assert(!ccm.decryptAuthenticated(data, sizeof(ccmCipher), 0x01020304, &header, 1, mic));
+    assert(data[0] == 0 && data[7] == 0);
+    memcpy(data, ccmCipher, sizeof(ccmCipher));
+    header = makeFrameHeader(DELTA_FRAME, AUTHENTICATED);
+    assert(!ccm.decryptAuthenticated(data, sizeof(ccmCipher), 0x01020304, &header, 1, mic));
+    memcpy(data, ccmCipher, sizeof(ccmCipher));
+    header = makeFrameHeader(RECORD_FRAME, AUTHENTICATED);
+    assert(ccm.decryptAuthenticated(data, sizeof(ccmCipher), 0x01020304, &header, 1, mic));
+    for (uint8_t i = 0; i < sizeof(ccmCipher); i++) {
+        assert(data[i] == i);
+    }
+
+    // CMAC must match the RFC 4493 vectors under a signing key of its own, truncated to its
+    // first bytes, and refuse tampered messages.
+    const uint8_t rfcMessage[64] = {
+        0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+        0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+        0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+        0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10
+    };
+    const size_t rfcLengths[4] = { 0, 16, 40, 64 };
+    const uint8_t rfcTags[4][CRYPTO_MIC_LENGTH] = {
+        { 0xbb, 0x1d, 0x69, 0x29 }, { 0x07, 0x0a, 0x16, 0xb4 }, { 0xdf, 0xa6, 0x67, 0x47 }, { 0x51, 0xf0, 0xbe, 0xbf }
+    };
+    Crypto cmac("1234567890ABCDEF");
+    cmac.setSigningKey(nistKey);
+    uint8_t tag[CRYPTO_MIC_LENGTH];
+    for (int i = 0; i < 4; i++) {
+        cmac.sign(rfcMessage, rfcLengths[i], tag);
+        assert(memcmp(tag, rfcTags[i], sizeof(tag)) == 0);
+        assert(cmac.verifySignature(rfcMessage, rfcLengths[i], tag));
+    }
+    memcpy(data, rfcMessage, sizeof(rfcMessage));
+    data[39] ^= 0x01;
+    assert(!cmac.verifySignature(data, 40, rfcTags[2]));
+    // Without one, the signing key is derived from the key, so it is not the key itself.
+    Crypto derived(String((const char *) nistKey));
+    derived.sign(rfcMessage, 64, tag);
+    assert(memcmp(tag, rfcTags[3], sizeof(tag)) != 0);
+
+    const String text = "deviceID=QB5ckYt0CS7Yc7swMKPu&current=0.42&voltage=244.0";
+    reportPerByte("String encrypt, first block (legacy)", measure(iterations, [&]() {
+        doNotOptimize(crypto.encrypt(text).length());
+    }), text.length());
+    reportPerByte("ECB, one block", measure(iterations, [&]() {
+        crypto.encryptBlock(data);
+        doNotOptimize(data[0]);
+    }), AES_BLOCKLEN);
+    reportPerByte("ECB decrypt, one block", measure(iterations, [&]() {
+        crypto.decryptBlock(data);
+        doNotOptimize(data[0]);
+    }), AES_BLOCKLEN);
+    const size_t lengths[] = { 16, 64, WIRE_MAX_FRAME_LENGTH };
+    for (size_t length : lengths) {
+        reportPerByte("CTR in place", measure(iterations, [&]() {
+            crypto.xcryptCTR(data, length, counter);
+            doNotOptimize(data[0]);
+        }), length);
+    }
+    // Per packet, the cost of CCM is paid by the node sealing and the gateway opening, and
+    // that of CMAC by the node signing and the gateway verifying the whole frame.
+    const size_t packetLengths[] = { 30, 64, WIRE_MAX_FRAME_LENGTH - 1 - CRYPTO_FRAME_OVERHEAD };
+    header = makeFrameHeader(RECORD_FRAME, AUTHENTICATED);
+    for (size_t length : packetLengths) {
+        reportPerByte("CCM seal", measure(iterations, [&]() {
+            crypto.encryptAuthenticated(data, length, 0x01020304, &header, 1, mic);
+            doNotOptimize(mic[0]);
+        }), length);
+        reportPerByte("CCM seal, then open", measure(iterations, [&]() {
+            crypto.encryptAuthenticated(data, length, 0x01020304, &header, 1, mic);
+            doNotOptimize(crypto.decryptAuthenticated(data, length, 0x01020304, &header, 1, mic));
+        }), length);
+        const size_t frameLength = 1 + CRYPTO_PREFIX_LENGTH + length;
+        reportPerByte("CMAC sign", measure(iterations, [&]() {
+            crypto.sign(data, frameLength, mic);
+            doNotOptimize(mic[0]);
+        }), length);
+        reportPerByte("CMAC sign, then verify", measure(iterations, [&]() {
+            crypto.sign(data, frameLength, mic);
+            doNotOptimize(crypto.verifySignature(data, frameLength, mic));
+        }), length);
+    }
+    return 0;
+}
@@ -0,0 +1,258 @@
+/**
+ * @file duty_cycle_benchmark.cpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Checks the time on air calculator against the SX127x datasheet and the duty cycle
+ * token bucket against the hourly allowance of its sub-band, then replays a day of readings
+ * through a node on LoraBand::EUROPE, batching them as LoraInterface does, with and without
+ * the bucket, on the host.
+ * @version 0.1
+ * @date 2022-05-07
+ *
+ * Build and run from the repository root:
+ *   g++ -std=gnu++17 -O2 -Isrc -Itest/shims -Itest test/services/duty_cycle_benchmark.cpp -o duty_cycle_benchmark
+ *   ./duty_cycle_benchmark [trace.csv]
+ *
+ * Without a trace a day of synthetic household load is used, held between its samples as
+ * the node samples every NODE_SAMPLE_INTERVAL. A trace is a CSV file of
+ * "timestamp_ms,current,voltage" lines, with increasing timestamps.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <assert.h>
+
+#include <deque>
+
+#include "benchmark.hpp"
+#include "models/reading_batch.hpp"
+#include "services/airtime.hpp"
+#include "services/duty_cycle.hpp"
+#include "traces.hpp"
+
+/// How often the node samples, and the batch it sends with, as the firmware does.
+#define NODE_SAMPLE_INTERVAL 1000
+#define BATCH_READINGS 8
+#define BATCH_LATENCY 60000
+
+/// The frequency LoraBand::EUROPE sends on, in Hz.
+#define EUROPE_FREQUENCY 866000000
+
+/**
+ * @brief Get the settings LoraInterface sends with, at a spreading factor.
+ *
+ */
+static RadioSettings radioAt(uint8_t spreadingFactor) {
+    return RadioSettings { spreadingFactor, 125000, 5, 8, false, true, false };
+}
+
+/**
+ * @brief What a node sent over the day.
+ *
+ */
+struct DayResult {
+    /// The frames sent, and the readings they carried.
+    size_t frames, delivered;
+
+    /// The readings dropped while waiting for airtime, and still queued at the end.
+    size_t dropped, queued;
+
+    /// The most airtime sent in any hour, as a share of the hour.
+    double worstHour;
+
+    /// The mean time a delivered reading waited before it was sent, in seconds.
+    double meanDelay;
+
+    /// The budget usage at the end of the day.
+    float usage;
+};
+
+/**
+ * @brief Replay readings through a node, batching them as LoraInterface::queueReading does:
+ * a full batch, or one whose oldest reading reached the latency deadline, is sent if the
+ * bucket allows, and otherwise keeps coalescing readings up to what one frame holds.
+ *
+ */
+static DayResult replay(const std::vector<MeterReading> &readings, uint8_t spreadingFactor, uint16_t dutyCycleDivisor) {
+    DayResult result = {};
+    DutyCycleBudget budget(dutyCycleDivisor, 0);
+    ReadingBatch batch(BATCH_READINGS, true);
+    uint8_t frame[WIRE_MAX_FRAME_LENGTH];
+    std::deque<std::pair<uint32_t, uint32_t>> window;
+    uint64_t windowAirtime = 0, worstAirtime = 0;
+    double delay = 0;
+
+    const auto flush = [&](uint32_t now) {
+        if (batch.size() == 0) {
+            return true;
+        }
+        if (!budget.allows(timeOnAir(radioAt(spreadingFactor), batch.maxEncodedLength()), now)) {
+            return false;
+        }
+        const size_t length = batch.encode(frame, sizeof(frame), now);
+        assert(length > 0 && length <= batch.maxEncodedLength());
+        const uint32_t airtime = timeOnAir(radioAt(spreadingFactor), length);
+        const bool spent = budget.spend(airtime, now);
+        assert(spent);
+        window.emplace_back(now, airtime);
+        windowAirtime += airtime;
+        while (now - window.front().first >= DUTY_CYCLE_WINDOW) {
+            windowAirtime -= window.front().second;
+            window.pop_front();
+        }
+        worstAirtime = windowAirtime > worstAirtime ? windowAirtime : worstAirtime;
+        result.frames++;
+        result.delivered += batch.size();
+        MeterReading sent[BATCH_MAX_READINGS];
+        const size_t decoded = ReadingBatch::decode(frame, length, sent, BATCH_MAX_READINGS, now);
+        assert(decoded == batch.size());
+        for (size_t i = 0; i < decoded; i++) {
+            delay += (now - sent[i].timestamp) / 1000.0;
+        }
+        batch.clear();
+        return true;
+    };
+
+    for (const MeterReading &reading : readings) {
+        const uint32_t now = reading.timestamp;
+        if (!batch.add(reading)) {
+            const bool added = flush(now) ? batch.add(reading) : batch.add(reading, true);
+            if (!added) {
+                result.dropped++;
+                continue;
+            }
+        }
+        if (batch.isFull() || now - batch.oldestTimestamp() >= BATCH_LATENCY) {
+            flush(now);
+        }
+    }
+    result.queued = batch.size();
+    result.worstHour = worstAirtime / (DUTY_CYCLE_WINDOW * 1000.0);
+    result.meanDelay = result.delivered > 0 ? delay / result.delivered : 0;
+    result.usage = budget.usage(readings.back().timestamp);
+    return result;
+}
+
+int main(int argc, char **argv) {
+    // The time on air of the datasheet and of the LoRaWAN airtime tables, to the
+    // microsecond: 10 bytes at SF7, and a 64 byte frame at SF12 with and without low data
+    // rate optimization.
+    RadioSettings radio = radioAt(7);
+    assert(timeOnAir(radio, 10) == 41216);
+    radio = radioAt(12);
+    radio.lowDataRateOptimize = true;
+    assert(needsLowDataRateOptimize(12, 125000) && !needsLowDataRateOptimize(10, 125000));
+    assert(timeOnAir(radio, 64) == 2793472);
+    radio.lowDataRateOptimize = false;
+    assert(timeOnAir(radio, 64) == 2465792);
+    radio = radioAt(7);
+    radio.implicitHeader = true;
+    radio.crc = false;
+    assert(timeOnAir(radio, 0) == 12544 + 8 * 1024);
+    radio = radioAt(9);
+    radio.bandwidth = 500000;
+    radio.codingRate = 8;
+    assert(timeOnAir(radio, 10) == (4 * (8 + 8 + 3 * 8) + 17) * 1024 / 4);
+
+    // The sub-bands of the bands the firmware sends on.
+    assert(DutyCycleBudget::dutyCycleDivisorOf(EUROPE_FREQUENCY) == 100);
+    assert(DutyCycleBudget::dutyCycleDivisorOf(869525000) == 10);
+    assert(DutyCycleBudget::dutyCycleDivisorOf(868900000) == 1000);
+    assert(DutyCycleBudget::dutyCycleDivisorOf(915000000) == 0);
+    assert(DutyCycleBudget::dutyCycleDivisorOf(433000000) == 0);
+
+    // A full bucket sends a burst of a quarter of the hourly allowance, then refills at the
+    // rest of it, and a full length SF12 frame still fits.
+    DutyCycleBudget budget(100, 0);
+    assert(budget.usage(0) == 0);
+    const bool burst = budget.spend(9000000, 0);
+    assert(burst && budget.usage(0) == 1);
+    const bool overdrawn = budget.spend(1000, 0);
+    assert(!overdrawn && budget.deferredFrames() == 1);
+    assert(budget.waitFor(1000, 0) == 134);
+    assert(!budget.allows(1000, 133) && budget.allows(1000, 134));
+    assert(budget.usage(DUTY_CYCLE_WINDOW) == 0);
+    assert(timeOnAir(radioAt(12), WIRE_MAX_FRAME_LENGTH) <= 9000000);
+    const bool longest = budget.spend(timeOnAir(radioAt(12), WIRE_MAX_FRAME_LENGTH), DUTY_CYCLE_WINDOW);
+    assert(longest);
+
+    // A frame longer than the whole bucket waits for it to be full, then overdraws it.
+    DutyCycleBudget slow(1000, 0);
+    const bool oversized = slow.spend(2000000, 0);
+    assert(oversized && slow.usage(0) > 1);
+    assert(!slow.allows(2000000, 1000000));
+
+    // Whatever is asked of it, no hour ever sends more than the allowance.
+    DutyCycleBudget greedy(100, 0);
+    std::deque<std::pair<uint32_t, uint32_t>> sent;
+    uint64_t hour = 0;
+    for (uint32_t now = 0; now < 6 * DUTY_CYCLE_WINDOW; now += 250) {
+        const uint32_t airtime = 50000 + (now * 7919) % 1500000;
+        if (greedy.spend(airtime, now)) {
+            sent.emplace_back(now, airtime);
+            hour += airtime;
+        }
+        while (now - sent.front().first >= DUTY_CYCLE_WINDOW) {
+            hour -= sent.front().second;
+            sent.pop_front();
+        }
+        assert(hour <= (uint64_t) DUTY_CYCLE_WINDOW * 1000 / 100);
+    }
+    assert(greedy.spentAirtime() > (uint64_t) 6 * DUTY_CYCLE_WINDOW * 1000 / 100 * 3 / 4 * 95 / 100);
+
+    // What checking and charging a frame costs per transmission.
+    DutyCycleBudget timed(100, 0);
+    uint32_t at = 0;
+    size_t length = 0;
+    const Measurement perFrame = measure(2000000, [&]() {
+        at += 1000;
+        length = (length + 37) % WIRE_MAX_FRAME_LENGTH;
+        doNotOptimize(timed.spend(timeOnAir(radioAt(7 + at / 1000 % 6), length), at));
+    });
+    reportResult("airtime and duty cycle check, per frame", perFrame, 0);
+
+    // A day of readings, sampled every second.
+    const std::vector<TraceSample> samples = traceFromArguments(argc, argv);
+    assert(!samples.empty());
+    std::vector<MeterReading> readings;
+    size_t next = 0;
+    for (uint32_t now = samples.front().timestamp; now <= samples.back().timestamp; now += NODE_SAMPLE_INTERVAL) {
+        while (next + 1 < samples.size() && samples[next + 1].timestamp <= now) {
+            next++;
+        }
+        MeterReading reading = { "QB5ckYt0CS7Yc7swMKPu", 0, 0, 0, 0 };
+        reading.current = samples[next].current;
+        reading.voltage = samples[next].voltage;
+        reading.timestamp = now;
+        readings.push_back(reading);
+    }
+
+    printf("\n%-34s %12s %12s %12s %12s\n", "866 MHz, 1% duty cycle", "SF7 free", "SF7 bucket", "SF11 free", "SF11 bucket");
+    DayResult results[4];
+    for (int i = 0; i < 4; i++) {
+        results[i] = replay(readings, i < 2 ? 7 : 11, i % 2 == 0 ? 0 : DutyCycleBudget::dutyCycleDivisorOf(EUROPE_FREQUENCY));
+    }
+    const struct { const char *name; double (*value)(const DayResult &); } rows[] = {
+        { "frames per hour", [](const DayResult &r) { return r.frames / 24.0; } },
+        { "readings delivered, %", [](const DayResult &r) { return 100.0 * r.delivered / (r.delivered + r.dropped + r.queued); } },
+        { "readings per frame", [](const DayResult &r) { return (double) r.delivered / r.frames; } },
+        { "mean reading delay, s", [](const DayResult &r) { return r.meanDelay; } },
+        { "airtime in the worst hour, %", [](const DayResult &r) { return 100 * r.worstHour; } },
+        { "readings dropped", [](const DayResult &r) { return (double) r.dropped; } },
+        { "budget usage at the end, %", [](const DayResult &r) { return 100.0 * r.usage; } }
+    };
+    for (const auto &row : rows) {
+        printf("%-34s", row.name);
+        for (const DayResult &result : results) {
+            printf(" %12.2f", row.value(result));
+        }
+        printf("\n");
+    }
+    for (int i = 0; i < 4; i++) {
+        assert(results[i].delivered + results[i].dropped + results[i].queued == readings.size());
+        if (i % 2 == 1) {
+            assert(results[i].worstHour <= 0.01);
+        }
+    }
+    return 0;
+}
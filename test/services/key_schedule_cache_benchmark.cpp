@@ -0,0 +1,149 @@
+/**
+ * @file key_schedule_cache_benchmark.cpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Checks the LRU order of the KeyScheduleCache, and compares the per-packet cost of a
+ * gateway opening frames under 1, 100 and 5000 distinct keys with and without it, on the host.
+ * @version 0.1
+ * @date 2022-04-29
+ *
+ * Build and run from the repository root:
+ *   gcc -O2 -DAES_TTABLE=1 -c lib/tiny-AES-c-master/aes.c -o aes.o
+ *   g++ -std=gnu++17 -O2 -Isrc -Itest/shims -Itest -Ilib/tiny-AES-c-master test/services/key_schedule_cache_benchmark.cpp aes.o -o key_schedule_cache_benchmark
+ *   ./key_schedule_cache_benchmark
+ *
+ * Each packet comes from a node drawn at random, with a skew towards busy nodes: half of the
+ * packets come from the busiest tenth of the nodes. Cycles are read from the time stamp
+ * counter, so they are only reported on x86 hosts.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <assert.h>
+
+#include <vector>
+
+#include "benchmark.hpp"
+#include "services/crypto.hpp"
+
+/// The bytes of the body of every packet, a single reading.
+#define PACKET_LENGTH 30
+
+/**
+ * @brief Fill the key of a node, distinct for every node.
+ *
+ */
+static void nodeKey(uint16_t node, uint8_t *key) {
+    memset(key, 0x5a, AES_KEYLEN);
+    key[0] = (uint8_t) node;
+    key[1] = (uint8_t) (node >> 8);
+}
+
+/**
+ * @brief Draw the nodes the packets come from.
+ *
+ */
+static std::vector<uint16_t> trafficFrom(size_t nodes, size_t packets) {
+    std::vector<uint16_t> senders(packets);
+    uint32_t seed = 11;
+    for (size_t i = 0; i < packets; i++) {
+        seed = seed * 1103515245 + 12345;
+        const size_t busy = nodes / 10 > 0 ? nodes / 10 : 1;
+        const bool fromBusy = (seed >> 30) & 1;
+        seed = seed * 1103515245 + 12345;
+        senders[i] = 1 + (seed >> 8) % (fromBusy ? busy : nodes);
+    }
+    return senders;
+}
+
+int main() {
+    // Entries are replaced least recently used first, and an ID with a new key is expanded
+    // again.
+    KeyScheduleCache cache(2);
+    uint8_t key[AES_KEYLEN];
+    AES_ctx expected;
+    nodeKey(1, key);
+    cache.schedule(1, key);
+    nodeKey(2, key);
+    cache.schedule(2, key);
+    nodeKey(1, key);
+    cache.schedule(1, key);
+    nodeKey(3, key);
+    cache.schedule(3, key);
+    assert(cache.hits() == 1 && cache.misses() == 3);
+    nodeKey(1, key);
+    AES_init_ctx(&expected, key);
+    assert(memcmp(cache.schedule(1, key).RoundKey, expected.RoundKey, sizeof(expected.RoundKey)) == 0);
+    assert(cache.hits() == 2);
+    nodeKey(2, key);
+    cache.schedule(2, key);
+    assert(cache.misses() == 4);
+    nodeKey(4, key);
+    AES_init_ctx(&expected, key);
+    assert(memcmp(cache.schedule(2, key).RoundKey, expected.RoundKey, sizeof(expected.RoundKey)) == 0);
+    assert(cache.misses() == 5);
+
+    // A cached context must seal and open exactly like one expanding every key.
+    Crypto plain, cached;
+    cached.enableKeyCache();
+    uint8_t body[PACKET_LENGTH] = {}, mic[CRYPTO_MIC_LENGTH];
+    const uint8_t header[3] = { 0x92, 0, 0 };
+    for (uint16_t node = 1; node <= 200; node++) {
+        nodeKey(node, key);
+        plain.setKey(key);
+        plain.encryptAuthenticated(body, sizeof(body), node, header, sizeof(header), mic);
+        nodeKey(node % 70 + 1, key);
+        cached.setKey(key, node % 70 + 1);
+        nodeKey(node, key);
+        cached.setKey(key, node);
+        assert(cached.decryptAuthenticated(body, sizeof(body), node, header, sizeof(header), mic));
+    }
+
+    const size_t packets = 200000;
+    const size_t nodeCounts[] = { 1, 100, 5000 };
+    for (size_t nodes : nodeCounts) {
+        const std::vector<uint16_t> senders = trafficFrom(nodes, packets);
+        std::vector<uint8_t> keys((nodes + 1) * AES_KEYLEN);
+        for (uint16_t node = 1; node <= nodes; node++) {
+            nodeKey(node, keys.data() + node * AES_KEYLEN);
+        }
+        Crypto uncached, lru;
+        lru.enableKeyCache();
+        size_t next = 0;
+        const auto expandSwitch = [&]() {
+            const uint16_t node = senders[next++ % packets];
+            uncached.setKey(keys.data() + node * AES_KEYLEN);
+        };
+        const auto lruSwitch = [&]() {
+            const uint16_t node = senders[next++ % packets];
+            lru.setKey(keys.data() + node * AES_KEYLEN, node);
+        };
+        const Measurement expandOnly = measure(packets, expandSwitch);
+        next = 0;
+        const Measurement lruOnly = measure(packets, lruSwitch);
+        next = 0;
+        const Measurement expanding = measure(packets, [&]() {
+            expandSwitch();
+            doNotOptimize(uncached.decryptAuthenticated(body, sizeof(body), 1, header, sizeof(header), mic));
+        });
+        next = 0;
+        lru.getKeyCache()->resetCounters();
+        const Measurement caching = measure(packets, [&]() {
+            lruSwitch();
+            doNotOptimize(lru.decryptAuthenticated(body, sizeof(body), 1, header, sizeof(header), mic));
+        });
+        const KeyScheduleCache *stats = lru.getKeyCache();
+        const double lookups = stats->hits() + stats->misses();
+        printf("%zu keys, %.1f%% hits over %.0f key changes\n", nodes,
+            lookups > 0 ? 100.0 * stats->hits() / lookups : 100.0, lookups);
+        printf("  %-34s %8.1f ns/packet %8.1f cycles/packet\n", "key switch, expand on change",
+            expandOnly.nanosPerOp, expandOnly.cyclesPerOp);
+        printf("  %-34s %8.1f ns/packet %8.1f cycles/packet\n", "key switch, LRU cache",
+            lruOnly.nanosPerOp, lruOnly.cyclesPerOp);
+        printf("  %-34s %8.1f ns/packet %8.1f cycles/packet\n", "switch and open, expand on change",
+            expanding.nanosPerOp, expanding.cyclesPerOp);
+        printf("  %-34s %8.1f ns/packet %8.1f cycles/packet\n", "switch and open, LRU cache",
+            caching.nanosPerOp, caching.cyclesPerOp);
+    }
+    return 0;
+}
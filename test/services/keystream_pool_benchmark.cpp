@@ -0,0 +1,150 @@
+/**
+ * @file keystream_pool_benchmark.cpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Checks that frames sealed with precomputed keystream match those sealed without it,
+ * and compares the time a node spends sealing a frame between sampling and sending with and
+ * without a KeystreamPool filled in between, on the host.
+ * @version 0.1
+ * @date 2022-04-30
+ *
+ * Build and run from the repository root, with tiny-AES built as the firmware builds it:
+ *   gcc -O2 -DAES_TTABLE=1 -c lib/tiny-AES-c-master/aes.c -o aes.o
+ *   g++ -std=gnu++17 -O2 -Isrc -Itest/shims -Itest -Ilib/tiny-AES-c-master test/services/keystream_pool_benchmark.cpp aes.o -o keystream_pool_benchmark
+ *   ./keystream_pool_benchmark
+ *
+ * Only the sealing is timed; the pool is filled outside the timed region, as a node fills it
+ * between sampling windows. Cycles are read from the time stamp counter, so they are only
+ * reported on x86 hosts.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <assert.h>
+
+#include <vector>
+
+#include "benchmark.hpp"
+#include "services/cipher_stream.hpp"
+
+/**
+ * @brief Collects what a CipherStream passes on, standing in for the radio FIFO.
+ *
+ */
+class BufferSink : public Print {
+    public:
+        /// The bytes written.
+        std::vector<uint8_t> bytes;
+
+        size_t write(uint8_t value) override {
+            this->bytes.push_back(value);
+            return 1;
+        }
+
+        size_t write(const uint8_t *buffer, size_t size) override {
+            this->bytes.insert(this->bytes.end(), buffer, buffer + size);
+            return size;
+        }
+};
+
+/**
+ * @brief Fill a frame body the same way every time.
+ *
+ */
+static void fillBody(uint8_t *body, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        body[i] = (uint8_t) (i * 7 + 3);
+    }
+}
+
+/**
+ * @brief Seal bodies of every length, up to past what the pool holds per nonce, with a pooled and a plain context,
+ * in a buffer and through a CipherStream, and check that they match.
+ *
+ */
+static void checkSealing(Crypto &pooled, Crypto &plain) {
+    const uint8_t header[3] = { 0x92, 0, 0 };
+    uint8_t expected[(KEYSTREAM_POOL_BLOCKS + 2) * AES_BLOCKLEN], actual[sizeof(expected)];
+    uint8_t expectedMIC[CRYPTO_MIC_LENGTH], actualMIC[CRYPTO_MIC_LENGTH];
+    for (size_t length = 0; length <= sizeof(expected); length++) {
+        pooled.precomputeKeystream();
+        const uint32_t nonce = pooled.takeNonce();
+        fillBody(expected, length);
+        fillBody(actual, length);
+        plain.encryptAuthenticated(expected, length, nonce, header, sizeof(header), expectedMIC);
+        if (length % 2 == 0) {
+            pooled.encryptAuthenticated(actual, length, nonce, header, sizeof(header), actualMIC);
+        } else {
+            BufferSink sink;
+            CipherStream stream(pooled, sink, nonce, header, sizeof(header), length);
+            stream.write(actual, length);
+            assert(stream.finish() == length + CRYPTO_MIC_LENGTH);
+            memcpy(actual, sink.bytes.data(), length);
+            memcpy(actualMIC, sink.bytes.data() + length, CRYPTO_MIC_LENGTH);
+        }
+        assert(memcmp(expected, actual, length) == 0);
+        assert(memcmp(expectedMIC, actualMIC, CRYPTO_MIC_LENGTH) == 0);
+        assert(plain.decryptAuthenticated(actual, length, nonce, header, sizeof(header), actualMIC));
+    }
+}
+
+/**
+ * @brief Measure sealing frames of one length, optionally filling the pool before each one
+ * outside the timed region, and print the sealing latency and what the pool reports.
+ *
+ */
+static void measureSealing(const char *name, size_t length, bool precompute) {
+    Crypto crypto("1234567890ABCDEF");
+    crypto.enableKeystreamPool();
+    const uint8_t header[3] = { 0x92, 0, 0 };
+    uint8_t body[WIRE_MAX_FRAME_LENGTH], mic[CRYPTO_MIC_LENGTH];
+    fillBody(body, length);
+    const long frames = 20000;
+    double nanos = 0, cycles = 0;
+    for (long i = 0; i < frames; i++) {
+        if (precompute) {
+            crypto.precomputeKeystream();
+        }
+        const uint32_t nonce = crypto.takeNonce();
+        const Measurement seal = measure(1, [&]() {
+            crypto.encryptAuthenticated(body, length, nonce, header, sizeof(header), mic);
+            doNotOptimize(mic[0]);
+        });
+        nanos += seal.nanosPerOp;
+        cycles += seal.cyclesPerOp;
+    }
+    const KeystreamPool *pool = crypto.getKeystreamPool();
+    const double blocks = pool->hits() + pool->misses();
+    printf("%-30s %3zu bytes %8.1f ns/frame %8.1f cycles/frame %5.1f%% hits, %.2f us saved/frame\n",
+        name, length, nanos / frames, cycles / frames, 100.0 * pool->hits() / blocks,
+        (double) pool->savedMicros() / frames);
+}
+
+int main() {
+    // Sealing with the pool, full, partly filled or empty, must match sealing without it.
+    Crypto pooled("1234567890ABCDEF"), plain("1234567890ABCDEF");
+    pooled.enableKeystreamPool();
+    checkSealing(pooled, plain);
+    pooled.getKeystreamPool()->resetCounters();
+    for (int i = 0; i < 3; i++) {
+        pooled.precomputeKeystream(5);
+        checkSealing(pooled, plain);
+    }
+    const KeystreamPool *pool = pooled.getKeystreamPool();
+    assert(pool->hits() > 0 && pool->misses() > 0);
+
+    // A new key drops the keystream of the old one.
+    const uint8_t sessionKey[AES_KEYLEN] = { 1, 2, 3 };
+    pooled.precomputeKeystream();
+    pooled.startSession(sessionKey, 7);
+    plain.startSession(sessionKey, 7);
+    checkSealing(pooled, plain);
+
+    // A single reading, and a batch of eight filling most of a frame.
+    const size_t lengths[] = { 30, 200 };
+    for (size_t length : lengths) {
+        measureSealing("seal, keystream on the spot", length, false);
+        measureSealing("seal, keystream precomputed", length, true);
+    }
+    return 0;
+}
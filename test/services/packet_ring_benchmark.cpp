@@ -0,0 +1,278 @@
+/**
+ * @file packet_ring_benchmark.cpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Checks that a PacketRing hands every packet from a producer thread to a consumer
+ * thread intact and in order, and compares the packets a gateway loses under load when it
+ * polls the radio and when a radio task copies them into a PacketRing, against a simulated
+ * radio, on the host.
+ * @version 0.1
+ * @date 2022-05-02
+ *
+ * Build and run from the repository root:
+ *   g++ -std=gnu++17 -O2 -Isrc -Itest/shims -Itest test/services/packet_ring_benchmark.cpp -o packet_ring_benchmark
+ *   ./packet_ring_benchmark
+ *
+ * The simulated gateway runs the loop of GatewayController::operate in simulated time: it
+ * queues frames of readings until GATEWAY_FRAME_QUEUE_LENGTH are waiting or nothing more was
+ * received, then blocks in one upload per reading. Packets arrive from many nodes at random.
+ * The radio only keeps the last packet in its FIFO, so every packet but the last to arrive
+ * between two reads is overwritten. Polled, the FIFO is read once per loop, after all the
+ * uploads of a queue. With the ring, the DIO0 interrupt wakes the radio task of
+ * LoraInterface::listen, which outranks the blocked loop and copies each packet out of the
+ * FIFO as it arrives, so packets are only lost once the ring is full. The task takes well
+ * under a millisecond, far less than the gap between packets, so the copy is modelled as
+ * immediate.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <assert.h>
+
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "benchmark.hpp"
+#include "services/packet_ring.hpp"
+
+/// The frames a gateway queues before decoding them, as GATEWAY_FRAME_QUEUE_LENGTH.
+#define QUEUE_LENGTH 4
+
+/// The bytes of every simulated packet, a sealed single reading.
+#define PACKET_LENGTH 30
+
+/**
+ * @brief The packets a simulated gateway received, and those it lost.
+ *
+ */
+struct LoadResult {
+    /// The packets received and uploaded.
+    size_t received;
+
+    /// The packets lost, overwritten in the FIFO or dropped by a full ring.
+    size_t lost;
+};
+
+/**
+ * @brief Stands in for the radio: packets from many nodes arriving at random over an hour.
+ *
+ */
+class SimulatedRadio {
+    private:
+        /// When each packet arrives, in milliseconds, in order.
+        std::vector<double> arrivals;
+
+        /// The next packet to arrive.
+        size_t next;
+
+    public:
+        /**
+         * @brief Draw an hour of arrivals at an average rate.
+         *
+         * @param perMinute The packets arriving per minute on average.
+         */
+        SimulatedRadio(double perMinute) {
+            std::mt19937 random(7);
+            std::exponential_distribution<double> gap(perMinute / 60000.0);
+            for (double at = gap(random); at < 3600000.0; at += gap(random)) {
+                this->arrivals.push_back(at);
+            }
+            this->next = 0;
+        }
+
+        /**
+         * @brief Deliver every packet arrived by a time to a handler, as the DIO0 interrupt
+         * would flag them, in order.
+         *
+         * @param now The simulated time, in milliseconds.
+         * @param onPacket Called with the sequence number of each packet.
+         */
+        template <typename Handler>
+        void deliverUntil(double now, Handler onPacket) {
+            while (this->next < this->arrivals.size() && this->arrivals[this->next] <= now) {
+                onPacket((uint32_t) this->next++);
+            }
+        }
+
+        /**
+         * @brief Get when the next packet arrives, or a negative time once none are left.
+         *
+         */
+        double nextArrival() const {
+            return this->next < this->arrivals.size() ? this->arrivals[this->next] : -1;
+        }
+
+        /**
+         * @brief Get the number of packets sent over the hour.
+         *
+         */
+        size_t sent() const {
+            return this->arrivals.size();
+        }
+};
+
+/**
+ * @brief Fill a packet slot the way the DIO0 handler does, tagging it with its sequence
+ * number.
+ *
+ */
+static void fillPacket(ReceivedFrame &slot, uint32_t sequence, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        slot.bytes[i] = (uint8_t) (sequence + i);
+    }
+    memcpy(slot.bytes, &sequence, sizeof(sequence));
+    slot.length = length;
+    slot.rssi = -90;
+    slot.snr = 7.5;
+    slot.receivedAt = sequence;
+}
+
+/**
+ * @brief Run the gateway loop against a simulated radio until every packet has arrived and
+ * been handled.
+ *
+ * @param radio The radio the packets arrive at.
+ * @param uploadMillis How long the gateway blocks uploading one reading.
+ * @param ring The ring the radio task copies packets into, or null to poll the radio's FIFO.
+ */
+static LoadResult simulateGateway(SimulatedRadio &radio, double uploadMillis, PacketRing *ring) {
+    LoadResult result = {};
+    bool fifoFull = false;
+    size_t queued = 0;
+    double now = 0;
+    const auto onPacket = [&](uint32_t sequence) {
+        if (ring != nullptr) {
+            ReceivedFrame *slot = ring->claim();
+            if (slot != nullptr) {
+                fillPacket(*slot, sequence, PACKET_LENGTH);
+                ring->publish();
+            }
+            return;
+        }
+        result.lost += fifoFull;
+        fifoFull = true;
+    };
+    while (true) {
+        radio.deliverUntil(now, onPacket);
+        bool received = false;
+        if (ring != nullptr && ring->peek() != nullptr) {
+            ring->release();
+            received = true;
+        } else if (ring == nullptr && fifoFull) {
+            fifoFull = false;
+            received = true;
+        }
+        if (received) {
+            result.received++;
+            queued++;
+        }
+        if (queued == QUEUE_LENGTH || (!received && queued > 0)) {
+            for (; queued > 0; queued--) {
+                now += uploadMillis;
+                radio.deliverUntil(now, onPacket);
+            }
+        } else if (!received) {
+            if (radio.nextArrival() < 0) {
+                break;
+            }
+            now = radio.nextArrival();
+        }
+    }
+    if (ring != nullptr) {
+        result.lost += ring->dropped();
+    }
+    assert(result.received + result.lost == radio.sent());
+    return result;
+}
+
+/**
+ * @brief Pass packets from a producer thread to a consumer thread, with the producer
+ * dropping those that do not fit, and check that each arrives whole and in order.
+ *
+ */
+static void checkConcurrentHandover(uint32_t packets) {
+    PacketRing ring;
+    std::thread producer([&]() {
+        for (uint32_t sequence = 0; sequence < packets; sequence++) {
+            ReceivedFrame *slot = ring.claim();
+            if (slot != nullptr) {
+                fillPacket(*slot, sequence, 8 + sequence % 200);
+                ring.publish();
+            }
+        }
+    });
+    uint32_t received = 0, last = 0;
+    bool any = false;
+    while (true) {
+        ReceivedFrame *packet = ring.peek();
+        if (packet == nullptr) {
+            if (received + ring.dropped() == packets && ring.size() == 0) {
+                break;
+            }
+            continue;
+        }
+        uint32_t sequence;
+        memcpy(&sequence, packet->bytes, sizeof(sequence));
+        assert(!any || sequence > last);
+        assert(packet->length == 8 + sequence % 200 && packet->receivedAt == sequence);
+        for (size_t i = sizeof(sequence); i < packet->length; i++) {
+            assert(packet->bytes[i] == (uint8_t) (sequence + i));
+        }
+        last = sequence;
+        any = true;
+        received++;
+        ring.release();
+    }
+    producer.join();
+    assert(received > 0 && received + ring.dropped() == packets);
+}
+
+int main() {
+    // A full ring drops the newest packet, and keeps the order of those it holds.
+    PacketRing ring;
+    for (uint32_t sequence = 0; sequence < PACKET_RING_LENGTH + 3; sequence++) {
+        ReceivedFrame *slot = ring.claim();
+        assert((slot != nullptr) == (sequence < PACKET_RING_LENGTH));
+        if (slot != nullptr) {
+            fillPacket(*slot, sequence, PACKET_LENGTH);
+            ring.publish();
+        }
+    }
+    assert(ring.size() == PACKET_RING_LENGTH && ring.dropped() == 3);
+    for (uint32_t sequence = 0; sequence < PACKET_RING_LENGTH; sequence++) {
+        assert(ring.peek()->receivedAt == sequence);
+        ring.release();
+    }
+    assert(ring.peek() == nullptr && ring.size() == 0);
+
+    checkConcurrentHandover(2000000);
+
+    // What one packet costs to hand over, filled and read back on one thread.
+    PacketRing timed;
+    uint32_t sequence = 0;
+    const Measurement handover = measure(5000000, [&]() {
+        fillPacket(*timed.claim(), sequence++, PACKET_LENGTH);
+        timed.publish();
+        doNotOptimize(timed.peek()->bytes[0]);
+        timed.release();
+    });
+    reportResult("ring handover, 30 byte packet", handover, PACKET_LENGTH);
+
+    // Loss under load, with uploads that each block the gateway for a third of a second.
+    const double uploadMillis = 300;
+    const double rates[] = { 10, 40, 120, 180, 240 };
+    printf("%-12s %22s %22s\n", "packets/min", "polled radio, lost", "packet ring, lost");
+    for (double perMinute : rates) {
+        SimulatedRadio polledRadio(perMinute), ringRadio(perMinute);
+        PacketRing loadRing;
+        const LoadResult polled = simulateGateway(polledRadio, uploadMillis, nullptr);
+        const LoadResult ringed = simulateGateway(ringRadio, uploadMillis, &loadRing);
+        printf("%-12.0f %8zu of %5zu %5.1f%% %8zu of %5zu %5.1f%%\n", perMinute,
+            polled.lost, polledRadio.sent(), 100.0 * polled.lost / polledRadio.sent(),
+            ringed.lost, ringRadio.sent(), 100.0 * ringed.lost / ringRadio.sent());
+        // Packets arriving during an upload are only lost polled, until uploads fall behind.
+        assert(polled.lost == 0 ? ringed.lost == 0 : ringed.lost < polled.lost);
+    }
+    return 0;
+}
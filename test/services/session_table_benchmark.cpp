@@ -0,0 +1,158 @@
+/**
+ * @file session_table_benchmark.cpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Checks the replay window and session keys of the SessionTable, and measures finding
+ * a session and opening a frame with it once the table is full, on the host.
+ * @version 0.1
+ * @date 2022-04-28
+ *
+ * Build and run from the repository root:
+ *   gcc -O2 -DAES_TTABLE=1 -c lib/tiny-AES-c-master/aes.c -o aes.o
+ *   g++ -std=gnu++17 -O2 -Isrc -Itest/shims -Itest -Ilib/tiny-AES-c-master test/services/session_table_benchmark.cpp aes.o -o session_table_benchmark
+ *   ./session_table_benchmark
+ *
+ * Cycles are read from the time stamp counter, so they are only reported on x86 hosts.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <assert.h>
+
+#include "benchmark.hpp"
+#include "models/join_message.hpp"
+#include "services/session_table.hpp"
+
+/**
+ * @brief Accept a frame counter the way LoraInterface does once the MIC matched.
+ *
+ * @return bool Whether the counter was fresh.
+ */
+static bool acceptCounter(NodeSession &session, uint32_t counter) {
+    if (!SessionTable::isFresh(session, counter)) {
+        return false;
+    }
+    SessionTable::markSeen(session, counter);
+    return true;
+}
+
+int main() {
+    SessionTable *sessions = new SessionTable();
+    Crypto network("1234567890ABCDEF1234567890ABCDE");
+
+    // Both sides of a join must derive the same key, and every join a different one. The join
+    // nonces must survive the wire exactly.
+    JoinMessage request = {};
+    strcpy(request.deviceID, "QB5ckYt0CS7Yc7swMKPu");
+    request.nodeNonce = 0xdeadbeef;
+    uint8_t frame[WIRE_MAX_FRAME_LENGTH];
+    size_t frameLength = encodeJoinMessage(JOIN_REQUEST, request, frame, sizeof(frame));
+    JoinMessage accept = {};
+    const bool requested = decodeJoinMessage(frame, frameLength, JOIN_REQUEST, accept);
+    assert(requested && accept.nodeNonce == 0xdeadbeef);
+    accept.nodeAddress = 7;
+    accept.gatewayNonce = 0x80000001;
+    frameLength = encodeJoinMessage(JOIN_ACCEPT, accept, frame, sizeof(frame));
+    JoinMessage received = {};
+    const bool accepted = decodeJoinMessage(frame, frameLength, JOIN_ACCEPT, received);
+    assert(accepted);
+    assert(received.nodeAddress == 7 && received.nodeNonce == 0xdeadbeef && received.gatewayNonce == 0x80000001);
+
+    uint8_t gatewayKey[AES_KEYLEN], nodeKey[AES_KEYLEN], rejoinKey[AES_KEYLEN];
+    network.deriveSessionKey(accept.nodeAddress, accept.nodeNonce, accept.gatewayNonce, gatewayKey);
+    network.deriveSessionKey(received.nodeAddress, received.nodeNonce, received.gatewayNonce, nodeKey);
+    network.deriveSessionKey(received.nodeAddress, received.nodeNonce, received.gatewayNonce + 1, rejoinKey);
+    assert(memcmp(gatewayKey, nodeKey, AES_KEYLEN) == 0 && memcmp(gatewayKey, rejoinKey, AES_KEYLEN) != 0);
+
+    // A gateway that lost the session asks the node, by Device ID and address, to join again.
+    uint8_t rejoinFrame[WIRE_MAX_FRAME_LENGTH];
+    const size_t rejoinLength = encodeJoinMessage(REJOIN, received, rejoinFrame, sizeof(rejoinFrame));
+    JoinMessage rejoin = {};
+    const bool rejoinAccepted = decodeJoinMessage(rejoinFrame, rejoinLength, JOIN_ACCEPT, rejoin);
+    const bool rejoinAsked = decodeJoinMessage(rejoinFrame, rejoinLength, REJOIN, rejoin);
+    assert(!rejoinAccepted && rejoinAsked);
+    assert(rejoin.nodeAddress == 7 && strcmp(rejoin.deviceID, request.deviceID) == 0);
+
+    // A node's frames must open with the gateway's copy of its session, counting from 0.
+    Crypto node;
+    node.startSession(nodeKey, received.nodeAddress);
+    const uint32_t firstNonce = node.takeNonce();
+    const uint32_t secondNonce = node.takeNonce();
+    assert(node.getKeyID() == 7 && firstNonce == 0 && secondNonce == 1);
+    NodeSession *session = sessions->open(7, gatewayKey);
+    assert(session != nullptr && sessions->find(7) == session && sessions->find(8) == nullptr);
+    uint8_t body[30] = {}, mic[CRYPTO_MIC_LENGTH];
+    node.encryptAuthenticated(body, sizeof(body), 2, frame, 3, mic);
+    const bool uplinkOpened = sessions->cipherFor(*session)->decryptAuthenticated(body, sizeof(body), 2, frame, 3, mic);
+    assert(uplinkOpened);
+
+    // Frames sealed for the node take nonces of their own under the same key, which the
+    // node opens and the gateway never takes back as the node's.
+    const uint32_t firstDownlink = sessions->downlinkCipherFor(*session)->takeNonce();
+    Crypto *downlink = sessions->downlinkCipherFor(*session);
+    const uint32_t secondDownlink = downlink->takeNonce();
+    assert(downlink->getKeyID() == 7 && firstDownlink == SESSION_DOWNLINK_NONCE && secondDownlink == SESSION_DOWNLINK_NONCE + 1);
+    downlink->encryptAuthenticated(body, sizeof(body), secondDownlink, frame, 3, mic);
+    const bool downlinkOpened = node.decryptAuthenticated(body, sizeof(body), secondDownlink, frame, 3, mic);
+    assert(downlinkOpened);
+    assert(!SessionTable::isFresh(*session, secondDownlink));
+
+    // Every counter is accepted once, late ones only within the window.
+    const uint32_t counters[] = {
+        0, 0, 5, 3, 3, 5, 5 + SESSION_REPLAY_WINDOW - 1, 5 + SESSION_REPLAY_WINDOW, 5, 7, 1000, 1000 - SESSION_REPLAY_WINDOW, 999
+    };
+    const bool fresh[] = { true, false, true, true, false, false, true, true, false, true, true, false, true };
+    for (size_t i = 0; i < sizeof(counters) / sizeof(counters[0]); i++) {
+        const bool counted = acceptCounter(*session, counters[i]);
+        assert(counted == fresh[i]);
+    }
+    // A join again leaves the key in use until a frame sealed with the new one opens, which
+    // then takes over and counts from 0.
+    session = sessions->open(7, rejoinKey, 0x80000002);
+    assert(sessions->size() == 1 && session->pending && session->gatewayNonce == 0x80000002);
+    node.encryptAuthenticated(body, sizeof(body), 1001, frame, 3, mic);
+    const bool stillOpened = sessions->cipherFor(*session)->decryptAuthenticated(body, sizeof(body), 1001, frame, 3, mic);
+    assert(stillOpened && !acceptCounter(*session, 1000) && acceptCounter(*session, 1001));
+    Crypto rejoined;
+    rejoined.startSession(rejoinKey, 7);
+    rejoined.encryptAuthenticated(body, sizeof(body), 0, frame, 3, mic);
+    const bool oldKeyOpened = sessions->cipherFor(*session)->decryptAuthenticated(body, sizeof(body), 0, frame, 3, mic);
+    SessionTable::markFailed(*session);
+    assert(!oldKeyOpened && session->failures == 1);
+    rejoined.encryptAuthenticated(body, sizeof(body), 0, frame, 3, mic);
+    const bool newKeyOpened = sessions->pendingCipherFor(*session)->decryptAuthenticated(body, sizeof(body), 0, frame, 3, mic);
+    assert(newKeyOpened);
+    SessionTable::promote(*session);
+    const bool restarted = acceptCounter(*session, 0);
+    assert(!session->pending && memcmp(session->key, rejoinKey, AES_KEYLEN) == 0 && restarted && session->failures == 0);
+
+    // The table holds its maximum, with any addresses, and refuses one more.
+    for (uint16_t address = 1; sessions->size() < SESSION_TABLE_MAX_SESSIONS; address += 3) {
+        memcpy(nodeKey, &address, sizeof(address));
+        const NodeSession *filled = sessions->open(address, nodeKey);
+        assert(filled != nullptr);
+    }
+    const NodeSession *overflow = sessions->open(65535, gatewayKey);
+    assert(overflow == nullptr && sessions->find(7) != nullptr);
+    printf("%zu sessions in %zu slots, %zu bytes\n", sessions->size(), SESSION_TABLE_CAPACITY, sizeof(SessionTable));
+
+    const long iterations = 1000000;
+    uint16_t address = 1;
+    const Measurement lookup = measure(iterations, [&]() {
+        NodeSession *found = sessions->find(address);
+        doNotOptimize(found != nullptr && SessionTable::isFresh(*found, 1));
+        address = (size_t) address + 3 > 3 * SESSION_TABLE_MAX_SESSIONS ? 1 : address + 3;
+    });
+    printf("%-44s %10.1f ns/op %8.1f cycles/op\n", "find and check a counter, full table", lookup.nanosPerOp, lookup.cyclesPerOp);
+    for (const size_t nodes : { (size_t) 1, (size_t) 2 }) {
+        size_t next = 0;
+        const Measurement open = measure(iterations / 10, [&]() {
+            NodeSession *found = sessions->find(1 + 3 * (next++ % nodes));
+            doNotOptimize(sessions->cipherFor(*found)->decryptAuthenticated(body, sizeof(body), 2, frame, 3, mic));
+        });
+        printf("%-32s %zu node(s) %10.1f ns/op %8.1f cycles/op\n", "open a 30 byte frame, from", nodes,
+            open.nanosPerOp, open.cyclesPerOp);
+    }
+    delete sessions;
+    return 0;
+}
@@ -0,0 +1,105 @@
+/**
+ * @file Arduino.h
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief A minimal host stand-in for the Arduino core, so that the models and services can be
+ * compiled and benchmarked natively.
+ * @version 0.1
+ * @date 2022-04-02
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <random>
+#include <thread>
+
+#include "Print.h"
+#include "Stream.h"
+#include "WString.h"
+
+typedef uint8_t byte;
+
+/// Places interrupt handlers in instruction RAM on the ESP32; nothing to do on the host.
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define LOW 0x0
+#define HIGH 0x1
+#define RISING 0x01
+#define HEX 16
+
+/**
+ * @brief Pins, and the interrupts on them, do nothing on the host.
+ *
+ */
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalPinToInterrupt(int pin) {
+    return pin;
+}
+inline void attachInterrupt(uint8_t, void (*)(), int) {}
+inline void detachInterrupt(uint8_t) {}
+
+/**
+ * @brief Microseconds elapsed since the host program started.
+ *
+ */
+inline unsigned long micros() {
+    static const auto start = std::chrono::steady_clock::now();
+    return (unsigned long) std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start
+    ).count();
+}
+
+/**
+ * @brief Milliseconds elapsed since the host program started.
+ *
+ */
+inline unsigned long millis() {
+    return micros() / 1000;
+}
+
+/**
+ * @brief Block the calling thread for the given number of milliseconds.
+ *
+ */
+inline void delay(unsigned long ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+/**
+ * @brief Block the calling thread for the given number of microseconds.
+ *
+ */
+inline void delayMicroseconds(unsigned int us) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+/**
+ * @brief Let other tasks run.
+ *
+ */
+inline void yield() {
+    std::this_thread::yield();
+}
+
+/**
+ * @brief A random 32 bit number, from the hardware generator on the ESP32.
+ *
+ */
+inline uint32_t esp_random() {
+    static std::random_device device;
+    return device();
+}
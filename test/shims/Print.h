@@ -0,0 +1,87 @@
+/**
+ * @file Print.h
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief A minimal host stand-in for the Arduino Print interface, the byte sink that serial
+ * ports and the LoRa radio implement.
+ * @version 0.1
+ * @date 2022-04-20
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "WString.h"
+
+/**
+ * @brief Something bytes can be written to.
+ *
+ */
+class Print {
+    public:
+        /**
+         * @brief Write one byte.
+         *
+         * @return size_t The number of bytes written.
+         */
+        virtual size_t write(uint8_t value) = 0;
+
+        /**
+         * @brief Write many bytes, one at a time unless overridden.
+         *
+         * @return size_t The number of bytes written.
+         */
+        virtual size_t write(const uint8_t *buffer, size_t size) {
+            size_t written = 0;
+            while (written < size && write(buffer[written])) {
+                written++;
+            }
+            return written;
+        }
+
+        /**
+         * @brief Write the characters of a String.
+         *
+         * @return size_t The number of bytes written.
+         */
+        size_t print(const String &text) {
+            return write((const uint8_t *) text.c_str(), text.length());
+        }
+
+        /**
+         * @brief Write the characters of a NUL-terminated string.
+         *
+         * @return size_t The number of bytes written.
+         */
+        size_t print(const char *text) {
+            return write((const uint8_t *) text, strlen(text));
+        }
+
+        /**
+         * @brief Write a number in a base, 16 or 10.
+         *
+         * @return size_t The number of bytes written.
+         */
+        size_t print(long value, int base) {
+            char text[24];
+            snprintf(text, sizeof(text), base == 16 ? "%lX" : "%ld", value);
+            return print(text);
+        }
+
+        /**
+         * @brief Write a number in a base, 16 or 10, then a line break.
+         *
+         * @return size_t The number of bytes written.
+         */
+        size_t println(long value, int base) {
+            return print(value, base) + print("\r\n");
+        }
+
+        virtual ~Print() {}
+};
@@ -0,0 +1,99 @@
+/**
+ * @file SPI.h
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief A minimal host stand-in for the ESP32 SPI bus, passing every byte to a simulated
+ * device and counting the transactions and bytes it takes.
+ * @version 0.1
+ * @date 2022-05-04
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MSBFIRST 1
+#define SPI_MODE0 0
+
+/**
+ * @brief The clock, bit order and mode of a transaction. Ignored on the host.
+ *
+ */
+class SPISettings {
+    public:
+        SPISettings() {}
+
+        SPISettings(uint32_t, uint8_t, uint8_t) {}
+};
+
+/**
+ * @brief A device on the bus, simulated on the host.
+ *
+ */
+class SPIDevice {
+    public:
+        /**
+         * @brief Start a transaction, as when chip select goes low.
+         *
+         */
+        virtual void select() = 0;
+
+        /**
+         * @brief Exchange one byte.
+         *
+         * @param value The byte sent.
+         * @return uint8_t The byte received.
+         */
+        virtual uint8_t transfer(uint8_t value) = 0;
+
+        virtual ~SPIDevice() {}
+};
+
+/**
+ * @brief The SPI bus, with a simulated device on it.
+ *
+ */
+class SPIClass {
+    public:
+        /// The device the bus talks to, or null to read zeroes.
+        SPIDevice *device = nullptr;
+
+        /// The transactions started, and the bytes exchanged.
+        unsigned long transactions = 0, bytes = 0;
+
+        void begin() {}
+
+        void end() {}
+
+        void beginTransaction(SPISettings) {
+            this->transactions++;
+            if (this->device != nullptr) {
+                this->device->select();
+            }
+        }
+
+        void endTransaction() {}
+
+        uint8_t transfer(uint8_t value) {
+            this->bytes++;
+            return this->device != nullptr ? this->device->transfer(value) : 0;
+        }
+
+        void transfer(uint8_t *data, uint32_t size) {
+            for (uint32_t i = 0; i < size; i++) {
+                data[i] = transfer(data[i]);
+            }
+        }
+
+        void writeBytes(const uint8_t *data, uint32_t size) {
+            for (uint32_t i = 0; i < size; i++) {
+                transfer(data[i]);
+            }
+        }
+};
+
+/// The bus the radio is on.
+inline SPIClass SPI;
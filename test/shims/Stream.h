@@ -0,0 +1,55 @@
+/**
+ * @file Stream.h
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief A minimal host stand-in for the Arduino Stream interface, the byte source that serial
+ * ports and the LoRa radio implement.
+ * @version 0.1
+ * @date 2022-05-04
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include "Print.h"
+
+/**
+ * @brief Something bytes can be written to and read from.
+ *
+ */
+class Stream : public Print {
+    public:
+        /**
+         * @brief Get the number of bytes left to read.
+         *
+         */
+        virtual int available() = 0;
+
+        /**
+         * @brief Read one byte.
+         *
+         * @return int The byte, or -1 if there is none.
+         */
+        virtual int read() = 0;
+
+        /**
+         * @brief Get the next byte without reading it.
+         *
+         * @return int The byte, or -1 if there is none.
+         */
+        virtual int peek() = 0;
+
+        /**
+         * @brief Wait until everything written is sent.
+         *
+         */
+        virtual void flush() {}
+
+        /**
+         * @brief Set how long reads wait for data, in milliseconds. Reads never wait on the
+         * host.
+         *
+         */
+        void setTimeout(unsigned long) {}
+};
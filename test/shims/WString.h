@@ -0,0 +1,268 @@
+/**
+ * @file WString.h
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief A minimal host stand-in for the Arduino String class, so that the models and services
+ * can be compiled and benchmarked natively.
+ * @version 0.1
+ * @date 2022-04-02
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Heap backed String with the subset of the Arduino API that the project uses.
+ *
+ * Like the Arduino implementation, every non-empty String owns a heap buffer, so allocation
+ * counts measured on the host are representative of the ones on the microcontroller.
+ */
+class String {
+    private:
+        /// The heap buffer holding the NUL-terminated characters, or null when empty.
+        char *buffer;
+
+        /// The number of characters held, excluding the terminator.
+        unsigned int len;
+
+        /**
+         * @brief Replace the contents with the given characters.
+         *
+         * @param chars The characters to copy.
+         * @param length The number of characters to copy.
+         */
+        void assign(const char *chars, unsigned int length) {
+            char *copy = nullptr;
+            if (length > 0) {
+                copy = new char[length + 1];
+                memcpy(copy, chars, length);
+                copy[length] = '\0';
+            }
+            delete[] buffer;
+            buffer = copy;
+            len = length;
+        }
+
+        /**
+         * @brief Append the given characters.
+         *
+         * @param chars The characters to append.
+         * @param length The number of characters to append.
+         */
+        void append(const char *chars, unsigned int length) {
+            if (length == 0) {
+                return;
+            }
+            char *grown = new char[len + length + 1];
+            if (len > 0) {
+                memcpy(grown, buffer, len);
+            }
+            memcpy(grown + len, chars, length);
+            grown[len + length] = '\0';
+            delete[] buffer;
+            buffer = grown;
+            len += length;
+        }
+
+    public:
+        String(const char *chars = "") : buffer(nullptr), len(0) {
+            if (chars != nullptr) {
+                assign(chars, strlen(chars));
+            }
+        }
+
+        String(const char *chars, unsigned int length) : buffer(nullptr), len(0) {
+            assign(chars, length);
+        }
+
+        String(const String &other) : buffer(nullptr), len(0) {
+            assign(other.c_str(), other.len);
+        }
+
+        String(String &&other) : buffer(other.buffer), len(other.len) {
+            other.buffer = nullptr;
+            other.len = 0;
+        }
+
+        explicit String(char c) : buffer(nullptr), len(0) {
+            assign(&c, 1);
+        }
+
+        explicit String(int value) : buffer(nullptr), len(0) {
+            char text[16];
+            assign(text, snprintf(text, sizeof(text), "%d", value));
+        }
+
+        explicit String(unsigned int value) : buffer(nullptr), len(0) {
+            char text[16];
+            assign(text, snprintf(text, sizeof(text), "%u", value));
+        }
+
+        explicit String(long value) : buffer(nullptr), len(0) {
+            char text[24];
+            assign(text, snprintf(text, sizeof(text), "%ld", value));
+        }
+
+        explicit String(unsigned long value) : buffer(nullptr), len(0) {
+            char text[24];
+            assign(text, snprintf(text, sizeof(text), "%lu", value));
+        }
+
+        explicit String(double value, unsigned int decimalPlaces = 2) : buffer(nullptr), len(0) {
+            char text[40];
+            assign(text, snprintf(text, sizeof(text), "%.*f", decimalPlaces, value));
+        }
+
+        explicit String(float value, unsigned int decimalPlaces = 2)
+            : String((double) value, decimalPlaces) { }
+
+        ~String() {
+            delete[] buffer;
+        }
+
+        String &operator=(const String &other) {
+            if (this != &other) {
+                assign(other.c_str(), other.len);
+            }
+            return *this;
+        }
+
+        String &operator=(String &&other) {
+            if (this != &other) {
+                delete[] buffer;
+                buffer = other.buffer;
+                len = other.len;
+                other.buffer = nullptr;
+                other.len = 0;
+            }
+            return *this;
+        }
+
+        String &operator=(const char *chars) {
+            assign(chars, strlen(chars));
+            return *this;
+        }
+
+        String &operator+=(const String &other) {
+            append(other.c_str(), other.len);
+            return *this;
+        }
+
+        String &operator+=(const char *chars) {
+            append(chars, strlen(chars));
+            return *this;
+        }
+
+        String &operator+=(char c) {
+            append(&c, 1);
+            return *this;
+        }
+
+        friend String operator+(const String &lhs, const String &rhs) {
+            String result(lhs);
+            result += rhs;
+            return result;
+        }
+
+        friend String operator+(const String &lhs, const char *rhs) {
+            String result(lhs);
+            result += rhs;
+            return result;
+        }
+
+        friend String operator+(const char *lhs, const String &rhs) {
+            String result(lhs);
+            result += rhs;
+            return result;
+        }
+
+        bool operator==(const String &other) const {
+            return len == other.len && memcmp(c_str(), other.c_str(), len) == 0;
+        }
+
+        bool operator==(const char *chars) const {
+            return chars != nullptr && strcmp(c_str(), chars) == 0;
+        }
+
+        bool operator!=(const String &other) const {
+            return !(*this == other);
+        }
+
+        bool operator!=(const char *chars) const {
+            return !(*this == chars);
+        }
+
+        unsigned int length() const {
+            return len;
+        }
+
+        const char *c_str() const {
+            return buffer != nullptr ? buffer : "";
+        }
+
+        char charAt(unsigned int index) const {
+            return index < len ? buffer[index] : '\0';
+        }
+
+        int indexOf(char c, unsigned int from = 0) const {
+            for (unsigned int i = from; i < len; i++) {
+                if (buffer[i] == c) {
+                    return i;
+                }
+            }
+            return -1;
+        }
+
+        int indexOf(const char *chars, unsigned int from = 0) const {
+            if (from >= len) {
+                return -1;
+            }
+            const char *found = strstr(buffer + from, chars);
+            return found != nullptr ? found - buffer : -1;
+        }
+
+        String substring(unsigned int from) const {
+            return substring(from, len);
+        }
+
+        String substring(unsigned int from, unsigned int to) const {
+            if (from > to) {
+                unsigned int swap = from;
+                from = to;
+                to = swap;
+            }
+            if (from >= len) {
+                return String();
+            }
+            if (to > len) {
+                to = len;
+            }
+            return String(buffer + from, to - from);
+        }
+
+        void toCharArray(char *out, unsigned int size) const {
+            if (size == 0) {
+                return;
+            }
+            unsigned int count = len < size - 1 ? len : size - 1;
+            memcpy(out, c_str(), count);
+            out[count] = '\0';
+        }
+
+        long toInt() const {
+            return atol(c_str());
+        }
+
+        float toFloat() const {
+            return (float) atof(c_str());
+        }
+
+        double toDouble() const {
+            return atof(c_str());
+        }
+};
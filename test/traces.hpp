@@ -0,0 +1,92 @@
+/**
+ * @file traces.hpp
+ * @author dhi13man (https://www.github.com/dhi13man/)
+ * @brief Contains the load traces replayed by the host benchmarks.
+ * @version 0.1
+ * @date 2022-04-22
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <random>
+#include <vector>
+
+/**
+ * @brief One sample of a load trace, at the precision the sensors report it.
+ *
+ */
+struct TraceSample {
+    /// When the sample was taken, in milliseconds.
+    uint32_t timestamp;
+
+    /// The RMS current in Amperes.
+    double current;
+
+    /// The RMS voltage in Volts.
+    double voltage;
+};
+
+/**
+ * @brief Generate a day of household load sampled every 15 seconds: a cycling fridge, a few
+ * kettle and oven runs, sensor noise, and a slowly drifting mains voltage.
+ *
+ */
+inline std::vector<TraceSample> syntheticTrace() {
+    std::vector<TraceSample> trace;
+    std::mt19937 random(42);
+    std::normal_distribution<double> noise(0, 0.012);
+    for (uint32_t second = 0; second < 24 * 3600; second += 15) {
+        const uint32_t minute = second / 60;
+        double current = 0.25 + ((minute / 20) % 2 == 0 ? 0.6 : 0);
+        if (minute % 180 < 4) {
+            current += 8.7;
+        }
+        if (minute > 18 * 60 && minute < 19 * 60) {
+            current += 10.2;
+        }
+        TraceSample sample;
+        sample.timestamp = second * 1000;
+        sample.current = current + noise(random);
+        sample.voltage = 236 + 6 * sin(second / 7200.0) + 4 * noise(random);
+        trace.push_back(sample);
+    }
+    return trace;
+}
+
+/**
+ * @brief Load a trace of "timestamp_ms,current,voltage" lines, with increasing timestamps.
+ * Exits if the file cannot be read.
+ *
+ */
+inline std::vector<TraceSample> loadTrace(const char *path) {
+    std::vector<TraceSample> trace;
+    FILE *file = fopen(path, "r");
+    if (file == nullptr) {
+        perror(path);
+        exit(1);
+    }
+    TraceSample sample;
+    unsigned long timestamp;
+    while (fscanf(file, "%lu,%lf,%lf", &timestamp, &sample.current, &sample.voltage) == 3) {
+        sample.timestamp = (uint32_t) timestamp;
+        trace.push_back(sample);
+    }
+    fclose(file);
+    return trace;
+}
+
+/**
+ * @brief Load the trace named on the command line, or the synthetic one if none is.
+ *
+ */
+inline std::vector<TraceSample> traceFromArguments(int argc, char **argv) {
+    return argc > 1 ? loadTrace(argv[1]) : syntheticTrace();
+}